@@ -0,0 +1,115 @@
+#!/usr/bin/env python3
+"""Turn u-center CFG-VALGET dumps into key/value tables for the firmware.
+
+    f9p_cfg_gen.py --out f9p_cfg_tables.c [--set KEY=VALUE ...] NAME=DUMP ...
+
+Each DUMP is a u-center message export: one message per line as
+"NAME - <hex bytes>" (class, id, length, payload, no sync or checksum).
+Only CFG-VALGET lines are used; a key seen twice keeps its last value.
+Keys are emitted in ascending order with their values packed little-endian
+at the size encoded in the key (bits 28..30), plus an FNV-1a hash of the
+table that the boot-time engine (main/f9p_cfg.c) uses to skip receivers
+already configured. --set overrides (or adds) a key in every table.
+"""
+
+import argparse
+import sys
+
+VALUE_SIZE = {1: 1, 2: 1, 3: 2, 4: 4, 5: 8}
+
+
+def value_size(key):
+    size = VALUE_SIZE.get((key >> 28) & 7)
+    if size is None:
+        raise ValueError("key 0x%08X has no valid size field" % key)
+    return size
+
+
+def parse_dump(path):
+    table = {}
+    with open(path) as f:
+        for lineno, line in enumerate(f, 1):
+            name, sep, hexstr = line.partition(" - ")
+            if not sep or name.strip() != "CFG-VALGET":
+                continue
+            msg = bytes.fromhex(hexstr)
+            if len(msg) < 8 or msg[0] != 0x06 or msg[1] != 0x8B:
+                raise ValueError("%s:%d: not a CFG-VALGET message" % (path, lineno))
+            length = msg[2] | msg[3] << 8
+            payload = msg[4:4 + length]
+            if len(payload) != length:
+                raise ValueError("%s:%d: truncated payload" % (path, lineno))
+            i = 4  # version, layer, position
+            while i < length:
+                key = int.from_bytes(payload[i:i + 4], "little")
+                size = value_size(key)
+                value = payload[i + 4:i + 4 + size]
+                if len(value) != size:
+                    raise ValueError("%s:%d: truncated value for 0x%08X" % (path, lineno, key))
+                table[key] = value
+                i += 4 + size
+    if not table:
+        raise ValueError("%s: no CFG-VALGET data" % path)
+    return table
+
+
+def fnv1a(data, h=0x811C9DC5):
+    for b in data:
+        h = ((h ^ b) * 0x01000193) & 0xFFFFFFFF
+    return h
+
+
+def parse_override(arg):
+    key, sep, value = arg.partition("=")
+    if not sep:
+        raise argparse.ArgumentTypeError("expected KEY=VALUE, got %r" % arg)
+    key = int(key, 0)
+    return key, int(value, 0).to_bytes(value_size(key), "little")
+
+
+def emit_table(out, name, source, table):
+    keys = sorted(table)
+    blob = b"".join(table[k] for k in keys)
+    digest = fnv1a(b"".join(k.to_bytes(4, "little") + table[k] for k in keys))
+    out.write("\n// %s: %d keys, %d value bytes\n" % (source, len(keys), len(blob)))
+    out.write("static const uint32_t %s_keys[%d] = {\n" % (name, len(keys)))
+    for i in range(0, len(keys), 6):
+        out.write("    " + " ".join("0x%08X," % k for k in keys[i:i + 6]) + "\n")
+    out.write("};\n")
+    out.write("static const uint8_t %s_values[%d] = {\n" % (name, len(blob)))
+    for i in range(0, len(blob), 16):
+        out.write("    " + " ".join("0x%02X," % b for b in blob[i:i + 16]) + "\n")
+    out.write("};\n")
+    out.write("const f9p_cfg_table_t f9p_cfg_table_%s = {\n" % name)
+    out.write("    .name = \"%s\",\n" % name)
+    out.write("    .keys = %s_keys,\n" % name)
+    out.write("    .values = %s_values,\n" % name)
+    out.write("    .count = %d,\n" % len(keys))
+    out.write("    .hash = 0x%08X,\n" % digest)
+    out.write("};\n")
+    return len(keys), digest
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("--out", required=True)
+    ap.add_argument("--set", action="append", default=[], type=parse_override, metavar="KEY=VALUE")
+    ap.add_argument("tables", nargs="+", metavar="NAME=DUMP")
+    args = ap.parse_args()
+
+    with open(args.out, "w") as out:
+        out.write("// Generated by f9p-config/f9p_cfg_gen.py - do not edit\n")
+        out.write("#include \"f9p_cfg.h\"\n")
+        for spec in args.tables:
+            name, sep, path = spec.partition("=")
+            if not sep or not name.isidentifier():
+                sys.exit("bad table spec %r, expected NAME=DUMP" % spec)
+            table = parse_dump(path)
+            for key, value in args.set:
+                table[key] = value
+            count, digest = emit_table(out, name, path.rsplit("/", 1)[-1], table)
+            print("f9p_cfg_gen: %s: %d keys, hash %08X" % (name, count, digest))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,352 @@
+// ESP-NOW link adaptation (main/link_adapt.c) against a simulated lossy channel.
+//
+//   adapt_sim [--scenario sweep|walk|jam] [--seconds S] [--rate PKT_S] [--seed N]
+//     sweep   fixed distances; adaptive against fixed 1M (the ESP-NOW
+//             default) and fixed LR 250k: delivery, airtime, worst gap
+//     walk    the rover walks out to 900 m and back; timeline every 10 s
+//     jam     150 m, heavy interference on the first channel from a third
+//             of the run on; timeline every 10 s
+//     --seconds S  run length (per distance for sweep; default 120, walk 600, jam 180)
+//     --rate N     base data packets per second, a divisor of 1000 (20, about
+//                  an MSM7 epoch a second)
+//
+// Channel model: log-distance path loss (exponent 3, 20 dBm transmit) with
+// slow log-normal shadowing and per-packet fading; packet error follows a
+// logistic curve through 10% at each rate's sensitivity (link_adapt_rates[]).
+// Interference on each channel is bursts of about 1 ms covering a busy
+// fraction of the time, so a packet collides more often the longer it is on
+// the air. Reports go back over the same path. The controller is
+// the firmware code unchanged, driven on a 1 ms clock.
+//
+// Shadowing, data packets and control traffic (probes, announcements,
+// reports) draw from separate random streams, and a data packet draws its
+// fade and loss even when the rover listens elsewhere, so every mode at a
+// distance sees the same channel and the same losses.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "link_adapt.h"
+
+#define SIM_TX_DBM        20.0
+#define SIM_PL0_DB        40.0    // free space at 1 m, 2.4 GHz
+#define SIM_PL_EXPONENT   3.0
+#define SIM_SHADOW_DB     4.0
+#define SIM_SHADOW_TAU_S  5.0
+#define SIM_FADE_DB       2.0
+#define SIM_PER_SLOPE     1.0     // per dB
+#define SIM_BURST_US      1000.0
+#define SIM_PKT_BYTES     230     // typical filled link packet
+#define SIM_MAC_BYTES     43      // 802.11 action frame and ESP-NOW vendor header
+#define SIM_CHANNELS      14
+#define SIM_FIXED_NONE    (-1)
+
+enum { SIM_RNG_SHADOW, SIM_RNG_DATA, SIM_RNG_CONTROL, SIM_RNG_STREAMS };
+
+static const uint8_t channels[] = { 1, 6, 11 };
+
+typedef struct {
+    double distance_m;
+    double shadow_db;
+    double busy[SIM_CHANNELS];    // interference duty per channel
+    uint64_t rng[SIM_RNG_STREAMS];
+} sim_channel_t;
+
+typedef struct {
+    int fixed;                    // rate index, or SIM_FIXED_NONE for adaptive
+    uint8_t base_rate;
+    uint8_t rover_rate;
+    uint8_t base_channel;
+    uint8_t rover_channel;
+    uint16_t seq;
+    // Rover RSSI since the last report
+    double rssi_sum;
+    int8_t rssi_min;
+    uint32_t rssi_count;
+    // Results
+    uint32_t sent;
+    uint32_t received;
+    uint64_t airtime_us;
+    int64_t last_rx_us;
+    int64_t worst_gap_us;
+    uint64_t us_at[LINK_ADAPT_RATES];
+    double last_rssi;
+} sim_t;
+
+static sim_channel_t ch;
+static sim_t sim;
+static link_adapt_base_t base;
+static link_adapt_rover_t rover;
+static int64_t now_us;
+
+static double uniform(int stream) {
+    // xorshift64*
+    uint64_t *x = &ch.rng[stream];
+    *x ^= *x >> 12;
+    *x ^= *x << 25;
+    *x ^= *x >> 27;
+    return ((*x * 2685821657736338717ULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double gaussian(int stream) {
+    double u = uniform(stream), v = uniform(stream);
+    return sqrt(-2.0 * log(u + 1e-300)) * cos(2.0 * M_PI * v);
+}
+
+static double airtime_us(uint8_t rate, size_t len) {
+    const link_adapt_rate_t *r = &link_adapt_rates[rate];
+    double overhead = r->long_range ? 1000.0 : r->kbps < 6000 ? 192.0 : 20.0;
+    return overhead + (len + SIM_MAC_BYTES) * 8 * 1000.0 / r->kbps;
+}
+
+static double path_rssi(int stream) {
+    return SIM_TX_DBM - SIM_PL0_DB - 10.0 * SIM_PL_EXPONENT * log10(ch.distance_m) + ch.shadow_db +
+           SIM_FADE_DB * gaussian(stream);
+}
+
+// One packet over the air; returns its RSSI, or NAN when it was lost
+static double transmit(uint8_t rate, uint8_t tx_channel, uint8_t rx_channel, size_t len, int stream) {
+    double rssi = path_rssi(stream);
+    double draw = uniform(stream);
+    if (tx_channel != rx_channel) return NAN;
+    double per = 1.0 / (1.0 + 9.0 * exp(SIM_PER_SLOPE * (rssi - link_adapt_rates[rate].sensitivity_dbm)));
+    double busy = ch.busy[tx_channel];
+    if (busy > 0.0) {
+        double bursts_per_us = busy / (SIM_BURST_US * (1.0 - busy));
+        per = 1.0 - (1.0 - per) * (1.0 - busy) * exp(-bursts_per_us * airtime_us(rate, len));
+    }
+    return draw < per ? NAN : rssi;
+}
+
+static void rover_receive(const uint8_t *pkt, size_t len, int stream) {
+    double rssi = transmit(sim.base_rate, sim.base_channel, sim.rover_channel, len, stream);
+    if (isnan(rssi)) return;
+    sim.last_rssi = rssi;
+    int8_t r = (int8_t)(rssi < -127 ? -127 : rssi);
+    if (sim.rssi_count == 0 || r < sim.rssi_min) sim.rssi_min = r;
+    sim.rssi_sum += r;
+    sim.rssi_count++;
+    link_adapt_rover_input(&rover, pkt, len, now_us);
+}
+
+static void base_set_rate(uint8_t rate, void *ctx) {
+    sim.base_rate = rate;
+}
+
+static void base_set_channel(uint8_t channel, void *ctx) {
+    sim.base_channel = channel;
+}
+
+static void base_send(const uint8_t *msg, size_t len, void *ctx) {
+    sim.airtime_us += (uint64_t)airtime_us(sim.base_rate, len);
+    rover_receive(msg, len, SIM_RNG_CONTROL);
+}
+
+static void rover_set_rate(uint8_t rate, void *ctx) {
+    sim.rover_rate = rate;
+}
+
+static void rover_set_channel(uint8_t channel, void *ctx) {
+    sim.rover_channel = channel;
+}
+
+static void rover_send(const uint8_t *msg, size_t len, void *ctx) {
+    if (sim.fixed != SIM_FIXED_NONE) return;
+    if (isnan(transmit(sim.rover_rate, sim.rover_channel, sim.base_channel, len, SIM_RNG_CONTROL))) return;
+    link_adapt_base_input(&base, msg, len, sim.seq, now_us);
+}
+
+static void rover_read_rssi(int8_t *avg, int8_t *min, void *ctx) {
+    if (sim.rssi_count) {
+        *avg = (int8_t)lround(sim.rssi_sum / sim.rssi_count);
+        *min = sim.rssi_min;
+    }
+    sim.rssi_sum = 0;
+    sim.rssi_count = 0;
+}
+
+static void sim_start(int fixed, double distance_m, uint64_t seed) {
+    memset(&sim, 0, sizeof(sim));
+    memset(&ch, 0, sizeof(ch));
+    ch.distance_m = distance_m;
+    for (int i = 0; i < SIM_RNG_STREAMS; i++) ch.rng[i] = (seed * SIM_RNG_STREAMS + i) * 0x9E3779B97F4A7C15ULL + 1;
+    ch.shadow_db = SIM_SHADOW_DB * gaussian(SIM_RNG_SHADOW);
+    now_us = 0;
+    sim.fixed = fixed;
+    sim.base_channel = sim.rover_channel = channels[0];
+
+    int adaptive = fixed == SIM_FIXED_NONE;
+    const link_adapt_io_t base_io = {
+        .set_rate = base_set_rate,
+        .set_channel = adaptive ? base_set_channel : NULL,
+        .send = base_send,
+        .channels = channels,
+        .channel_count = sizeof(channels),
+        .channel = channels[0],
+    };
+    const link_adapt_io_t rover_io = {
+        .set_rate = rover_set_rate,
+        .set_channel = adaptive ? rover_set_channel : NULL,
+        .send = rover_send,
+        .read_rssi = rover_read_rssi,
+        .channels = channels,
+        .channel_count = sizeof(channels),
+        .channel = channels[0],
+    };
+    link_adapt_base_init(&base, &base_io, now_us);
+    link_adapt_rover_init(&rover, &rover_io, now_us);
+    sim.base_rate = adaptive ? base.rate : (uint8_t)fixed;
+}
+
+// Advance the simulation by ms milliseconds
+static void sim_run(int64_t ms, int pkt_per_s) {
+    int64_t period_us = 1000000 / pkt_per_s;
+    for (int64_t i = 0; i < ms; i++) {
+        now_us += 1000;
+        if (now_us % 100000 == 0) {
+            double a = exp(-0.1 / SIM_SHADOW_TAU_S);
+            ch.shadow_db = a * ch.shadow_db + sqrt(1.0 - a * a) * SIM_SHADOW_DB * gaussian(SIM_RNG_SHADOW);
+        }
+        if (now_us % period_us == 0) {
+            uint8_t pkt[SIM_PKT_BYTES] = { 0 };
+            link_hdr_t hdr = { .version = LINK_PACKET_VERSION, .seq = sim.seq++ };
+            memcpy(pkt, &hdr, sizeof(hdr));
+            sim.sent++;
+            sim.airtime_us += (uint64_t)airtime_us(sim.base_rate, sizeof(pkt));
+            uint32_t before = rover.rx_count;
+            rover_receive(pkt, sizeof(pkt), SIM_RNG_DATA);
+            if (rover.rx_count != before) {
+                sim.received++;
+                if (sim.last_rx_us && now_us - sim.last_rx_us > sim.worst_gap_us) {
+                    sim.worst_gap_us = now_us - sim.last_rx_us;
+                }
+                sim.last_rx_us = now_us;
+            }
+        }
+        if (sim.fixed == SIM_FIXED_NONE) link_adapt_base_poll(&base, now_us);
+        link_adapt_rover_poll(&rover, now_us);
+        sim.us_at[sim.base_rate] += 1000;
+    }
+}
+
+static uint8_t most_used_rate(void) {
+    uint8_t best = 0;
+    for (uint8_t i = 1; i < LINK_ADAPT_RATES; i++) {
+        if (sim.us_at[i] > sim.us_at[best]) best = i;
+    }
+    return best;
+}
+
+static void scenario_sweep(int seconds, int pkt_per_s, uint64_t seed) {
+    static const double distances[] = { 20, 60, 120, 200, 300, 400, 500, 600, 700, 800 };
+    static const int modes[] = { SIM_FIXED_NONE, LINK_ADAPT_RATE_DEFAULT, 0 };
+    printf("%5s  %-9s %9s %8s %10s  %-8s %s\n", "dist", "mode", "delivery", "airtime", "worst gap", "mostly",
+           "rate changes");
+    for (size_t d = 0; d < sizeof(distances) / sizeof(distances[0]); d++) {
+        for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+            sim_start(modes[m], distances[d], seed + d);
+            sim_run(seconds * 1000LL, pkt_per_s);
+            char mode[16];
+            snprintf(mode, sizeof(mode), "%s", modes[m] == SIM_FIXED_NONE ? "adaptive" : link_adapt_rates[modes[m]].name);
+            printf("%4.0fm  %-9s %8.2f%% %7.2f%% %8.0fms  %-8s", distances[d], mode,
+                   sim.sent ? 100.0 * sim.received / sim.sent : 0.0, sim.airtime_us * 100.0 / now_us,
+                   sim.worst_gap_us / 1000.0, link_adapt_rates[most_used_rate()].name);
+            if (modes[m] == SIM_FIXED_NONE) {
+                printf(" %u up, %u down, %u failed probes, %u channel moves, %u hops", (unsigned)base.stats.ups,
+                       (unsigned)base.stats.downs, (unsigned)base.stats.failed_probes,
+                       (unsigned)base.stats.channel_moves, (unsigned)rover.stats.hops);
+            }
+            printf("\n");
+        }
+    }
+}
+
+static void print_timeline_head(void) {
+    printf("%6s %7s %7s  %-8s %4s %4s %9s %8s\n", "t", "dist", "RSSI", "rate", "base", "rovr", "delivery", "airtime");
+}
+
+static void print_timeline(uint32_t sent, uint32_t received, uint64_t airtime_us, int64_t span_us) {
+    printf("%5llds %6.0fm %6.1f  %-8s %4u %4u %8.1f%% %7.2f%%\n", (long long)(now_us / 1000000), ch.distance_m,
+           sim.last_rssi, link_adapt_rates[sim.base_rate].name, sim.base_channel, sim.rover_channel,
+           sent ? 100.0 * received / sent : 0.0, airtime_us * 100.0 / span_us);
+}
+
+static void print_summary(void) {
+    printf("total: delivery %.2f%%, airtime %.2f%%, worst gap %.0f ms, %u up, %u down, %u failed probes, %u timeouts, "
+           "%u channel moves, rover %u hops\n",
+           sim.sent ? 100.0 * sim.received / sim.sent : 0.0, sim.airtime_us * 100.0 / now_us, sim.worst_gap_us / 1000.0,
+           (unsigned)base.stats.ups, (unsigned)base.stats.downs, (unsigned)base.stats.failed_probes,
+           (unsigned)base.stats.timeouts, (unsigned)base.stats.channel_moves, (unsigned)rover.stats.hops);
+    printf("time at rate:");
+    for (uint8_t i = 0; i < LINK_ADAPT_RATES; i++) {
+        if (sim.us_at[i]) printf("  %s %.1f%%", link_adapt_rates[i].name, sim.us_at[i] * 100.0 / now_us);
+    }
+    printf("\n");
+}
+
+static void scenario_walk(int seconds, int pkt_per_s, uint64_t seed) {
+    sim_start(SIM_FIXED_NONE, 20, seed);
+    print_timeline_head();
+    for (int s = 0; s < seconds; s += 10) {
+        uint32_t sent = sim.sent, received = sim.received;
+        uint64_t air = sim.airtime_us;
+        for (int k = 0; k < 10; k++) {
+            double phase = (double)(s + k) / seconds;
+            ch.distance_m = 20.0 + 880.0 * (phase < 0.5 ? phase * 2 : (1.0 - phase) * 2);
+            sim_run(1000, pkt_per_s);
+        }
+        print_timeline(sim.sent - sent, sim.received - received, sim.airtime_us - air, 10000000);
+    }
+    print_summary();
+}
+
+static void scenario_jam(int seconds, int pkt_per_s, uint64_t seed) {
+    sim_start(SIM_FIXED_NONE, 150, seed);
+    print_timeline_head();
+    for (int s = 0; s < seconds; s += 10) {
+        uint32_t sent = sim.sent, received = sim.received;
+        uint64_t air = sim.airtime_us;
+        for (int k = 0; k < 10; k++) {
+            ch.busy[channels[0]] = s + k >= seconds / 3 ? 0.3 : 0.005;
+            ch.busy[channels[1]] = 0.02;
+            ch.busy[channels[2]] = 0.005;
+            sim_run(1000, pkt_per_s);
+        }
+        print_timeline(sim.sent - sent, sim.received - received, sim.airtime_us - air, 10000000);
+    }
+    print_summary();
+}
+
+int main(int argc, char **argv) {
+    const char *scenario = "sweep";
+    int seconds = 0, pkt_per_s = 20;
+    uint64_t seed = 1;
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        int has_val = i + 1 < argc;
+        if (strcmp(a, "--scenario") == 0 && has_val) scenario = argv[++i];
+        else if (strcmp(a, "--seconds") == 0 && has_val) seconds = atoi(argv[++i]);
+        else if (strcmp(a, "--rate") == 0 && has_val) pkt_per_s = atoi(argv[++i]);
+        else if (strcmp(a, "--seed") == 0 && has_val) seed = strtoull(argv[++i], NULL, 0);
+        else {
+            fprintf(stderr, "usage: %s [--scenario sweep|walk|jam] [--seconds S] [--rate PKT_S] [--seed N]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (pkt_per_s <= 0 || 1000 % pkt_per_s) {
+        fprintf(stderr, "--rate must divide 1000 (the clock is 1 ms)\n");
+        return 2;
+    }
+    if (strcmp(scenario, "sweep") == 0) {
+        scenario_sweep(seconds ? seconds : 120, pkt_per_s, seed);
+    } else if (strcmp(scenario, "walk") == 0) {
+        scenario_walk(seconds ? seconds : 600, pkt_per_s, seed);
+    } else if (strcmp(scenario, "jam") == 0) {
+        scenario_jam(seconds ? seconds : 180, pkt_per_s, seed);
+    } else {
+        fprintf(stderr, "unknown scenario %s\n", scenario);
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,197 @@
+// Compression benchmark for the MSM delta codec (rtcm_delta.c).
+//
+//   rtk_codec [--key N] [--loss PCT] [--seed N] [--repeat N] CAPTURE...
+//     --key N        frames per MSM type between unchanged key frames (RTCM_DELTA_KEY_INTERVAL)
+//     --loss PCT     drop this percentage of coded frames before decoding
+//     --seed N       loss pattern seed (1)
+//     --repeat N     timing iterations, best time is reported (5)
+//
+// Each capture is framed, every RTCM3 frame is encoded as the base would
+// send it and decoded as the rover would. Reports the compression ratio per
+// message type and the encode/decode cost. Without loss the decoded stream
+// must be byte-identical to the input; with loss, reports how many frames
+// were lost to missing references on top of the dropped ones. Exit status is
+// non-zero on any mismatch.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "host_io.h"
+#include "rtcm_delta.h"
+
+#define MAX_TYPES 32
+
+typedef struct {
+    uint16_t type;
+    uint32_t frames;
+    uint32_t coded;
+    uint64_t raw_bytes;
+    uint64_t link_bytes;
+} type_stats_t;
+
+static int key_interval;
+static int loss_pct;
+static uint32_t seed = 1;
+static int repeat = 5;
+
+static host_buf_t frames;          // framed input: every CRC-valid frame back to back
+static host_buf_t coded;           // encoder output
+static host_buf_t decoded;
+static rtcm_delta_t enc;
+static rtcm_delta_t dec;
+static type_stats_t types[MAX_TYPES];
+static size_t type_count;
+static uint32_t rng;
+static const char *paths[16];
+static int path_count;
+
+static uint32_t next_rand(void) {
+    rng = rng * 1103515245u + 12345u;
+    return rng >> 8;
+}
+
+static type_stats_t *stats_for(uint16_t type) {
+    for (size_t i = 0; i < type_count; i++) {
+        if (types[i].type == type) return &types[i];
+    }
+    if (type_count == MAX_TYPES) return NULL;
+    types[type_count].type = type;
+    return &types[type_count++];
+}
+
+static void collect_frame(const uint8_t *frame, size_t len, void *ctx) {
+    host_buf_append(&frames, frame, len);
+}
+
+static size_t frame_len(const uint8_t *frame) {
+    return RTCM3_HEADER_LEN + rtcm3_payload_len(frame) + RTCM3_CRC_LEN;
+}
+
+// Encode every frame; with stats set, also account per type
+static void encode_all(int account) {
+    static uint8_t out[RTCM3_MAX_FRAME];
+    rtcm_delta_init(&enc, key_interval);
+    coded.len = 0;
+    for (size_t pos = 0; pos < frames.len;) {
+        size_t len = frame_len(frames.data + pos);
+        const uint8_t *res;
+        size_t n = rtcm_delta_encode(&enc, frames.data + pos, len, out, &res);
+        host_buf_append(&coded, res, n);
+        if (account) {
+            type_stats_t *t = stats_for(rtcm3_msg_type(frames.data + pos, len));
+            if (t) {
+                t->frames++;
+                t->coded += res == out;
+                t->raw_bytes += len;
+                t->link_bytes += n;
+            }
+        }
+        pos += len;
+    }
+}
+
+// Decode the coded stream, dropping frames at loss_pct. Every rebuilt frame
+// is checked against the input frame it was coded from
+static uint32_t decode_all(int lossy, uint32_t *mismatched) {
+    static uint8_t out[RTCM3_MAX_FRAME];
+    uint32_t dropped = 0;
+    rtcm_delta_init(&dec, key_interval);
+    decoded.len = 0;
+    rng = seed;
+    *mismatched = 0;
+    for (size_t pos = 0, src = 0; pos < coded.len;) {
+        size_t len = frame_len(coded.data + pos);
+        size_t src_len = frame_len(frames.data + src);
+        if (lossy && (int)(next_rand() % 100) < loss_pct) {
+            dropped++;
+        } else {
+            const uint8_t *res;
+            size_t n = rtcm_delta_decode(&dec, coded.data + pos, len, out, &res);
+            if (n) host_buf_append(&decoded, res, n);
+            if (n && (n != src_len || memcmp(res, frames.data + src, n) != 0)) (*mismatched)++;
+        }
+        pos += len;
+        src += src_len;
+    }
+    return dropped;
+}
+
+static int parse_args(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        int has_val = i + 1 < argc;
+        if (strcmp(a, "--key") == 0 && has_val) key_interval = atoi(argv[++i]);
+        else if (strcmp(a, "--loss") == 0 && has_val) loss_pct = atoi(argv[++i]);
+        else if (strcmp(a, "--seed") == 0 && has_val) seed = (uint32_t)strtoul(argv[++i], NULL, 0);
+        else if (strcmp(a, "--repeat") == 0 && has_val) repeat = atoi(argv[++i]);
+        else if (a[0] != '-' && path_count < 16) paths[path_count++] = a;
+        else return -1;
+    }
+    if (repeat < 1) repeat = 1;
+    return path_count ? 0 : -1;
+}
+
+int main(int argc, char **argv) {
+    if (parse_args(argc, argv) != 0) {
+        fprintf(stderr, "usage: %s [--key N] [--loss PCT] [--seed N] [--repeat N] CAPTURE...\n", argv[0]);
+        return 2;
+    }
+    for (int i = 0; i < path_count; i++) {
+        host_buf_t in = {0};
+        if (host_buf_load(&in, paths[i]) != 0) {
+            fprintf(stderr, "cannot read %s\n", paths[i]);
+            return 2;
+        }
+        rtcm3_framer_t framer;
+        rtcm3_framer_init(&framer);
+        rtcm3_framer_feed(&framer, in.data, in.len, collect_frame, NULL);
+        host_buf_free(&in);
+    }
+    host_buf_reserve(&coded, frames.len + 64 * 1024);
+    host_buf_reserve(&decoded, frames.len + 64 * 1024);
+
+    encode_all(1);
+    uint64_t enc_best = UINT64_MAX, dec_best = UINT64_MAX, allocs = 0;
+    uint32_t mismatched = 0;
+    for (int r = 0; r < repeat; r++) {
+        uint64_t a0 = host_alloc_count();
+        uint64_t t0 = host_now_ns();
+        encode_all(0);
+        uint64_t t1 = host_now_ns();
+        decode_all(0, &mismatched);
+        uint64_t t2 = host_now_ns();
+        allocs += host_alloc_count() - a0;
+        if (t1 - t0 < enc_best) enc_best = t1 - t0;
+        if (t2 - t1 < dec_best) dec_best = t2 - t1;
+    }
+
+    printf("%u frames, %zu B in, key interval %u\n", (unsigned)enc.frames, frames.len, (unsigned)enc.key_interval);
+    printf("  type  frames  delta      raw B     link B   ratio\n");
+    for (size_t i = 0; i < type_count; i++) {
+        const type_stats_t *t = &types[i];
+        printf("  %4u  %6u  %5u  %9llu  %9llu  %5.1f%%\n", t->type, (unsigned)t->frames, (unsigned)t->coded,
+               (unsigned long long)t->raw_bytes, (unsigned long long)t->link_bytes,
+               t->raw_bytes ? 100.0 * t->link_bytes / t->raw_bytes : 0.0);
+    }
+    printf("  total %zu B -> %zu B (%.1f%%), %u delta, %u key frames\n", frames.len, coded.len,
+           frames.len ? 100.0 * coded.len / frames.len : 0.0, (unsigned)enc.coded, (unsigned)enc.keys);
+    printf("  encode %.0f ns/frame (%.1f MB/s), decode %.0f ns/frame (%.1f MB/s), allocs %llu\n",
+           (double)enc_best / enc.frames, frames.len * 1000.0 / enc_best,
+           (double)dec_best / enc.frames, frames.len * 1000.0 / dec_best, (unsigned long long)allocs);
+
+    int rc = 0;
+    if (!mismatched && decoded.len == frames.len && memcmp(decoded.data, frames.data, frames.len) == 0) {
+        printf("decoded stream identical to input\n");
+    } else {
+        printf("decoded stream differs from input (%zu B vs %zu B, %u missing ref, %u errors)\n",
+               decoded.len, frames.len, (unsigned)dec.missing_ref, (unsigned)dec.errors);
+        rc = 1;
+    }
+    if (loss_pct > 0) {
+        uint32_t dropped = decode_all(1, &mismatched);
+        printf("with %d%% loss: %u frames dropped, %u more lost to missing references, %u errors, %u wrong\n",
+               loss_pct, (unsigned)dropped, (unsigned)dec.missing_ref, (unsigned)dec.errors, (unsigned)mismatched);
+        if (dec.errors || mismatched) rc = 1;
+    }
+    return rc;
+}
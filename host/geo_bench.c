@@ -0,0 +1,209 @@
+// Fixed-point geodesy (main/geo.c) against the double-precision path.
+//
+//   geo_bench [--points N] [--seed N] [--repeat N]
+//     --points N     random rover positions per base point and range (2000)
+//     --seed N       position pattern seed (1)
+//     --repeat N     timing iterations, best time is reported (5)
+//
+// Rover positions are drawn around base points from the equator to 80 deg at
+// ranges from 10 m to 100 km, written as NMEA coordinate fields with 7
+// decimals of minutes as the ZED-F9P outputs them. Each is taken through both
+// paths: strtod parsing plus the ECEF rotation in double, and
+// geo_parse_nmea_coord plus geo_ltp_enu. Reports the largest ENU, distance and
+// bearing differences per range, and the cost of each path. On the host both
+// run on a double-precision FPU; on the ESP32 the double path is emulated in
+// software, so the timing here understates the gap. Exit status is non-zero
+// when an ENU component is off by more than 1 mm (half of it is the rounding
+// to whole millimetres) plus 0.02 ppm of the range.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "host_io.h"
+#include "geo.h"
+
+#define WGS84_A  6378137.0
+#define WGS84_E2 6.69437999014e-3
+#define MAX_POINTS 100000
+
+typedef struct {
+    char lat[20], ns[2];
+    char lon[20], ew[2];
+    int32_t height;               // mm
+} nmea_point_t;
+
+typedef struct {
+    double lat, lon, h;           // deg, deg, m
+} dpos_t;
+
+static const double base_lats[] = { 0.5, 23.4, 47.3, 65.1, 80.2 };
+static const double ranges_m[] = { 10, 1000, 10000, 100000 };
+
+static int points = 2000;
+static uint32_t seed = 1;
+static int repeat = 5;
+static uint32_t rng;
+static nmea_point_t pts[MAX_POINTS];
+static volatile float sink;
+
+static uint32_t next_rand(void) {
+    rng = rng * 1664525u + 1013904223u;
+    return rng >> 8;
+}
+
+static double uniform(void) {
+    return next_rand() / 16777216.0;
+}
+
+// The double path: the old nmea_parse_coord() and the textbook ECEF rotation
+static double parse_coord_double(const char *value, const char *hemisphere) {
+    double v = strtod(value, NULL);
+    int deg = (int)(v / 100);
+    double out = deg + (v - deg * 100) / 60.0;
+    return hemisphere[0] == 'S' || hemisphere[0] == 'W' ? -out : out;
+}
+
+static void ecef(const dpos_t *p, double *x, double *y, double *z) {
+    double lat = p->lat * M_PI / 180.0, lon = p->lon * M_PI / 180.0;
+    double n = WGS84_A / sqrt(1.0 - WGS84_E2 * sin(lat) * sin(lat));
+    *x = (n + p->h) * cos(lat) * cos(lon);
+    *y = (n + p->h) * cos(lat) * sin(lon);
+    *z = (n * (1.0 - WGS84_E2) + p->h) * sin(lat);
+}
+
+static void enu_double(const dpos_t *o, const dpos_t *p, double enu[3]) {
+    double x0, y0, z0, x, y, z;
+    ecef(o, &x0, &y0, &z0);
+    ecef(p, &x, &y, &z);
+    double dx = x - x0, dy = y - y0, dz = z - z0;
+    double lat = o->lat * M_PI / 180.0, lon = o->lon * M_PI / 180.0;
+    enu[0] = -sin(lon) * dx + cos(lon) * dy;
+    enu[1] = -sin(lat) * cos(lon) * dx - sin(lat) * sin(lon) * dy + cos(lat) * dz;
+    enu[2] = cos(lat) * cos(lon) * dx + cos(lat) * sin(lon) * dy + sin(lat) * dz;
+}
+
+static void to_nmea(double deg, int lon, char *field, char *hemi) {
+    hemi[0] = deg < 0 ? (lon ? 'W' : 'S') : (lon ? 'E' : 'N');
+    hemi[1] = 0;
+    deg = fabs(deg);
+    // Rounded to 1e-7 minutes first, so both paths parse the same text
+    long long min_e7 = llround(deg * 60.0 * 1e7);
+    long long d = min_e7 / 600000000LL, m = min_e7 % 600000000LL;
+    snprintf(field, 20, lon ? "%03d%02d.%07d" : "%02d%02d.%07d", (int)d, (int)(m / 10000000), (int)(m % 10000000));
+}
+
+static void make_points(double base_lat, double base_lon, double range_m) {
+    for (int i = 0; i < points; i++) {
+        double r = range_m * (0.5 + 0.5 * uniform()), az = 2.0 * M_PI * uniform();
+        double lat = base_lat + r * cos(az) / 111000.0;
+        double lon = base_lon + r * sin(az) / (111000.0 * cos(base_lat * M_PI / 180.0));
+        if (lon > 180.0) lon -= 360.0;
+        to_nmea(lat, 0, pts[i].lat, pts[i].ns);
+        to_nmea(lon, 1, pts[i].lon, pts[i].ew);
+        pts[i].height = (int32_t)((uniform() - 0.5) * 200000.0);
+    }
+}
+
+static uint64_t time_double(const dpos_t *base) {
+    uint64_t best = UINT64_MAX;
+    for (int r = 0; r < repeat; r++) {
+        uint64_t t0 = host_now_ns();
+        for (int i = 0; i < points; i++) {
+            dpos_t p = { parse_coord_double(pts[i].lat, pts[i].ns), parse_coord_double(pts[i].lon, pts[i].ew),
+                         base->h + pts[i].height * 1e-3 };
+            double enu[3];
+            enu_double(base, &p, enu);
+            sink = (float)(sqrt(enu[0] * enu[0] + enu[1] * enu[1]) + atan2(enu[0], enu[1]));
+        }
+        uint64_t dt = host_now_ns() - t0;
+        if (dt < best) best = dt;
+    }
+    return best;
+}
+
+static uint64_t time_fixed(const geo_ltp_t *ltp) {
+    uint64_t best = UINT64_MAX;
+    for (int r = 0; r < repeat; r++) {
+        uint64_t t0 = host_now_ns();
+        for (int i = 0; i < points; i++) {
+            geo_pos_t p = { geo_parse_nmea_coord(pts[i].lat, pts[i].ns), geo_parse_nmea_coord(pts[i].lon, pts[i].ew),
+                            ltp->origin.height + pts[i].height };
+            geo_enu_t enu;
+            geo_ltp_enu(ltp, &p, &enu);
+            sink = (float)geo_enu_horizontal(&enu) + geo_enu_bearing(&enu);
+        }
+        uint64_t dt = host_now_ns() - t0;
+        if (dt < best) best = dt;
+    }
+    return best;
+}
+
+static int parse_args(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        int has_val = i + 1 < argc;
+        if (strcmp(a, "--points") == 0 && has_val) points = atoi(argv[++i]);
+        else if (strcmp(a, "--seed") == 0 && has_val) seed = (uint32_t)strtoul(argv[++i], NULL, 0);
+        else if (strcmp(a, "--repeat") == 0 && has_val) repeat = atoi(argv[++i]);
+        else return -1;
+    }
+    if (repeat < 1) repeat = 1;
+    return points > 0 && points <= MAX_POINTS ? 0 : -1;
+}
+
+int main(int argc, char **argv) {
+    if (parse_args(argc, argv) != 0) {
+        fprintf(stderr, "usage: geo_bench [--points N] [--seed N] [--repeat N]\n");
+        return 2;
+    }
+    rng = seed;
+    int rc = 0;
+    uint64_t ns_double = 0, ns_fixed = 0;
+    printf("%-10s %10s %10s %10s %10s %10s\n", "range", "east mm", "north mm", "up mm", "dist mm", "bearing \"");
+    for (size_t ri = 0; ri < sizeof(ranges_m) / sizeof(ranges_m[0]); ri++) {
+        double max_err[5] = { 0 };
+        double limit_mm = 1.0 + ranges_m[ri] * 2e-5;
+        for (size_t bi = 0; bi < sizeof(base_lats) / sizeof(base_lats[0]); bi++) {
+            // Both sides of the antimeridian on the last base point
+            double base_lon = bi + 1 == sizeof(base_lats) / sizeof(base_lats[0]) ? 179.99 : 8.5 + 20.0 * bi;
+            make_points(base_lats[bi], base_lon, ranges_m[ri]);
+            char lat_s[20], ns[2], lon_s[20], ew[2];
+            to_nmea(base_lats[bi], 0, lat_s, ns);
+            to_nmea(base_lon, 1, lon_s, ew);
+            dpos_t dbase = { parse_coord_double(lat_s, ns), parse_coord_double(lon_s, ew), 412.345 };
+            geo_pos_t fbase = { geo_parse_nmea_coord(lat_s, ns), geo_parse_nmea_coord(lon_s, ew), 412345 };
+            geo_ltp_t ltp;
+            geo_ltp_init(&ltp, &fbase);
+            for (int i = 0; i < points; i++) {
+                dpos_t p = { parse_coord_double(pts[i].lat, pts[i].ns), parse_coord_double(pts[i].lon, pts[i].ew),
+                             dbase.h + pts[i].height * 1e-3 };
+                double ref[3];
+                enu_double(&dbase, &p, ref);
+                geo_pos_t fp = { geo_parse_nmea_coord(pts[i].lat, pts[i].ns),
+                                 geo_parse_nmea_coord(pts[i].lon, pts[i].ew), fbase.height + pts[i].height };
+                geo_enu_t enu;
+                geo_ltp_enu(&ltp, &fp, &enu);
+                double err[5] = {
+                    fabs(enu.east - ref[0] * 1e3), fabs(enu.north - ref[1] * 1e3), fabs(enu.up - ref[2] * 1e3),
+                    fabs(geo_enu_distance(&enu) - sqrt(ref[0] * ref[0] + ref[1] * ref[1] + ref[2] * ref[2]) * 1e3),
+                    fabs(remainder(geo_enu_bearing(&enu) - atan2(ref[0], ref[1]) * 180.0 / M_PI, 360.0)) * 3600.0,
+                };
+                for (int k = 0; k < 5; k++) {
+                    if (err[k] > max_err[k]) max_err[k] = err[k];
+                }
+            }
+            ns_double += time_double(&dbase);
+            ns_fixed += time_fixed(&ltp);
+        }
+        char label[16];
+        snprintf(label, sizeof(label), "%.0f m", ranges_m[ri]);
+        printf("%-10s %10.3f %10.3f %10.3f %10.3f %10.3f%s\n", label, max_err[0], max_err[1], max_err[2], max_err[3],
+               max_err[4], max_err[0] > limit_mm || max_err[1] > limit_mm || max_err[2] > limit_mm ? "  FAIL" : "");
+        if (max_err[0] > limit_mm || max_err[1] > limit_mm || max_err[2] > limit_mm) rc = 1;
+    }
+    double n = (double)points * (sizeof(ranges_m) / sizeof(ranges_m[0])) * (sizeof(base_lats) / sizeof(base_lats[0]));
+    printf("double path: %.1f ns/point, fixed-point path: %.1f ns/point (parse, ENU, distance, bearing)\n",
+           ns_double / n, ns_fixed / n);
+    return rc;
+}
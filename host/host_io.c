@@ -0,0 +1,87 @@
+#define _GNU_SOURCE
+#include "host_io.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+
+static uint64_t alloc_count = 0;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+    alloc_count++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size) {
+    alloc_count++;
+    return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    alloc_count++;
+    return __real_realloc(ptr, size);
+}
+
+uint64_t host_alloc_count(void) {
+    return alloc_count;
+}
+
+int host_buf_load(host_buf_t *b, const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return -1;
+    uint8_t chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) host_buf_append(b, chunk, n);
+    int err = ferror(f);
+    fclose(f);
+    return err ? -1 : 0;
+}
+
+int host_buf_save(const host_buf_t *b, const char *path) {
+    FILE *f = fopen(path, "wb");
+    if (!f) return -1;
+    size_t n = fwrite(b->data, 1, b->len, f);
+    return (fclose(f) == 0 && n == b->len) ? 0 : -1;
+}
+
+void host_buf_reserve(host_buf_t *b, size_t cap) {
+    if (cap <= b->cap) return;
+    uint8_t *p = realloc(b->data, cap);
+    if (!p) {
+        fprintf(stderr, "out of memory (%zu bytes)\n", cap);
+        exit(1);
+    }
+    b->data = p;
+    b->cap = cap;
+}
+
+void host_buf_append(host_buf_t *b, const void *data, size_t len) {
+    if (b->len + len > b->cap) host_buf_reserve(b, (b->len + len) * 2 + 4096);
+    memcpy(b->data + b->len, data, len);
+    b->len += len;
+}
+
+void host_buf_free(host_buf_t *b) {
+    free(b->data);
+    memset(b, 0, sizeof(*b));
+}
+
+uint64_t host_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+void host_sleep_until_ns(uint64_t deadline_ns) {
+    struct timespec ts = {
+        .tv_sec = (time_t)(deadline_ns / 1000000000ull),
+        .tv_nsec = (long)(deadline_ns % 1000000000ull),
+    };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+    }
+}
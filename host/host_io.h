@@ -0,0 +1,34 @@
+#ifndef HOST_IO_H
+#define HOST_IO_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Host stand-ins for the device UART and radio: growable in-memory byte
+// buffers that can be loaded from and saved to capture files, plus
+// allocation counters and a monotonic clock for the benchmarks.
+
+typedef struct {
+    uint8_t *data;
+    size_t len;
+    size_t cap;
+} host_buf_t;
+
+// Read a whole file. Returns 0 on success
+int host_buf_load(host_buf_t *b, const char *path);
+// Write the buffer to a file. Returns 0 on success
+int host_buf_save(const host_buf_t *b, const char *path);
+// Make room for cap bytes up front so timed runs do not reallocate
+void host_buf_reserve(host_buf_t *b, size_t cap);
+void host_buf_append(host_buf_t *b, const void *data, size_t len);
+void host_buf_free(host_buf_t *b);
+
+// malloc/calloc/realloc calls made anywhere in the binary (linked with --wrap)
+uint64_t host_alloc_count(void);
+
+// Monotonic nanoseconds
+uint64_t host_now_ns(void);
+// Sleep until the monotonic clock reaches deadline_ns
+void host_sleep_until_ns(uint64_t deadline_ns);
+
+#endif // HOST_IO_H
@@ -0,0 +1,299 @@
+// Local NTRIP client stand-in and fan-out benchmark for ntrip_caster.c.
+//
+//   ntrip_bench [--clients N[,N..]] [--seconds S] [--rate BPS] [--slow K]
+//
+// For each client count, starts a caster on a loopback port, connects that
+// many NTRIP clients (alternating v1 and v2 requests), streams numbered RTCM
+// frames and checks every client receives them complete, CRC-valid and in
+// order. --rate 0 (default) writes as fast as the slowest client drains,
+// giving the caster's maximum fan-out throughput. --slow K makes K extra
+// clients read only 1 KB every 100 ms, which the caster must evict without
+// disturbing the others. Exit status is non-zero on any gap or CRC error.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "host_io.h"
+#include "ntrip_caster.h"
+#include "rtcm3.h"
+
+#define MOUNT          "BENCH"
+#define FRAME_PAYLOAD  200
+#define MAX_BENCH_CLIENTS NTRIP_MAX_CLIENTS
+
+typedef struct {
+    int fd;
+    int slow;
+    int header_done;
+    char header[512];
+    size_t header_len;
+    rtcm3_framer_t framer;
+    uint32_t next_seq;
+    int have_seq;
+    uint64_t bytes;
+    uint32_t frames;
+    uint32_t gaps;
+    int closed;
+    uint16_t local_port;
+    uint64_t next_read_ns;
+} bench_client_t;
+
+static bench_client_t clients[MAX_BENCH_CLIENTS];
+static uint8_t slot_slow[NTRIP_MAX_CLIENTS];
+
+// Mark the caster slots serving slow clients, matched by the peer port
+static void map_slow_slots(const ntrip_caster_t *caster, int total) {
+    for (int i = 0; i < NTRIP_MAX_CLIENTS; i++) {
+        slot_slow[i] = 0;
+        struct sockaddr_in addr;
+        socklen_t len = sizeof(addr);
+        if (caster->clients[i].fd < 0 || getpeername(caster->clients[i].fd, (struct sockaddr *)&addr, &len) < 0) continue;
+        for (int k = 0; k < total; k++) {
+            if (clients[k].slow && clients[k].local_port == ntohs(addr.sin_port)) slot_slow[i] = 1;
+        }
+    }
+}
+
+static size_t make_frame(uint8_t *f, uint32_t seq) {
+    uint8_t *p = f + RTCM3_HEADER_LEN;
+    memset(p, 0, FRAME_PAYLOAD);
+    rtcm3_set_bits(p, 0, 12, 4095);
+    rtcm3_set_bits(p, 16, 32, seq);
+    for (int i = 8; i < FRAME_PAYLOAD; i++) p[i] = (uint8_t)(seq + i);
+    return rtcm3_finish_frame(f, FRAME_PAYLOAD);
+}
+
+static void on_frame(const uint8_t *frame, size_t len, void *ctx) {
+    bench_client_t *c = ctx;
+    uint32_t seq = rtcm3_get_bits(frame + RTCM3_HEADER_LEN, 16, 32);
+    if (c->have_seq && seq != c->next_seq) c->gaps++;
+    c->have_seq = 1;
+    c->next_seq = seq + 1;
+    c->frames++;
+}
+
+static int connect_client(uint16_t port, const char *path, int v2) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    char req[256];
+    int n = v2 ? snprintf(req, sizeof(req), "GET /%s HTTP/1.1\r\nHost: localhost\r\nNtrip-Version: Ntrip/2.0\r\n"
+                                            "User-Agent: NTRIP bench\r\n\r\n", path)
+               : snprintf(req, sizeof(req), "GET /%s HTTP/1.0\r\nUser-Agent: NTRIP bench\r\n\r\n", path);
+    if (send(fd, req, n, 0) != n) {
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    return fd;
+}
+
+static void client_read(bench_client_t *c, uint64_t now_ns) {
+    static uint8_t buf[65536];
+    if (c->closed || (c->slow && now_ns < c->next_read_ns)) return;
+    size_t want = c->slow ? 1024 : sizeof(buf);
+    for (;;) {
+        ssize_t n = recv(c->fd, buf, want, 0);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+            c->closed = 1;
+            return;
+        }
+        if (n < 0) return;
+        size_t off = 0;
+        if (!c->header_done) {
+            // Reply header up to the blank line, the stream follows
+            while (off < (size_t)n && !c->header_done) {
+                if (c->header_len < sizeof(c->header) - 1) c->header[c->header_len++] = (char)buf[off];
+                c->header[c->header_len] = '\0';
+                off++;
+                if (c->header_len >= 4 && strcmp(c->header + c->header_len - 4, "\r\n\r\n") == 0) c->header_done = 1;
+                if (c->header_len == 14 && strcmp(c->header, "ICY 200 OK\r\n\r\n") == 0) c->header_done = 1;
+            }
+        }
+        c->bytes += (size_t)n - off;
+        rtcm3_framer_feed(&c->framer, buf + off, (size_t)n - off, on_frame, c);
+        if (c->slow) {
+            c->next_read_ns = now_ns + 100000000ull;
+            return;
+        }
+    }
+}
+
+// Fetch the sourcetable once and check it lists the mountpoint
+static int check_sourcetable(ntrip_caster_t *caster, uint16_t port, int v2) {
+    int fd = connect_client(port, "", v2);
+    if (fd < 0) return -1;
+    char buf[2048];
+    size_t len = 0;
+    uint64_t deadline = host_now_ns() + 1000000000ull;
+    while (host_now_ns() < deadline) {
+        ntrip_caster_poll(caster, (int64_t)(host_now_ns() / 1000));
+        ssize_t n = recv(fd, buf + len, sizeof(buf) - 1 - len, 0);
+        if (n == 0) break;
+        if (n > 0) len += (size_t)n;
+    }
+    close(fd);
+    buf[len] = '\0';
+    const char *status = v2 ? "HTTP/1.1 200 OK" : "SOURCETABLE 200 OK";
+    int ok = strncmp(buf, status, strlen(status)) == 0 && strstr(buf, "STR;" MOUNT ";") && strstr(buf, "ENDSOURCETABLE");
+    printf("sourcetable (v%d): %s\n", v2 ? 2 : 1, ok ? "ok" : "BAD");
+    return ok ? 0 : -1;
+}
+
+static int run(int nclients, int nslow, double seconds, int rate_bps, int check_table) {
+    ntrip_caster_t *caster = malloc(sizeof(*caster));
+    const ntrip_caster_config_t cfg = { .port = 0, .mountpoint = MOUNT, .identifier = "Bench" };
+    if (!caster || ntrip_caster_init(caster, &cfg) != 0) {
+        fprintf(stderr, "caster init failed\n");
+        return -1;
+    }
+    uint16_t port = ntrip_caster_port(caster);
+    int rc = 0;
+    if (check_table && (check_sourcetable(caster, port, 0) != 0 || check_sourcetable(caster, port, 1) != 0)) rc = -1;
+
+    int total = nclients + nslow;
+    memset(clients, 0, sizeof(clients));
+    for (int i = 0; i < total; i++) {
+        clients[i].fd = connect_client(port, MOUNT, i & 1);
+        clients[i].slow = i >= nclients;
+        rtcm3_framer_init(&clients[i].framer);
+        if (clients[i].fd < 0) {
+            fprintf(stderr, "client %d connect failed\n", i);
+            return -1;
+        }
+        struct sockaddr_in addr;
+        socklen_t alen = sizeof(addr);
+        getsockname(clients[i].fd, (struct sockaddr *)&addr, &alen);
+        clients[i].local_port = ntohs(addr.sin_port);
+        // Accept as we go, the listen backlog is short
+        ntrip_caster_poll(caster, (int64_t)(host_now_ns() / 1000));
+    }
+    // Wait until every client is streaming
+    uint64_t deadline = host_now_ns() + 2000000000ull;
+    while (ntrip_caster_streaming(caster) < (size_t)total && host_now_ns() < deadline) {
+        ntrip_caster_poll(caster, (int64_t)(host_now_ns() / 1000));
+        for (int i = 0; i < total; i++) client_read(&clients[i], host_now_ns());
+    }
+    map_slow_slots(caster, total);
+
+    uint8_t frame[RTCM3_MAX_FRAME];
+    uint32_t seq = 0;
+    uint64_t written = 0;
+    clock_t cpu0 = clock();
+    uint64_t t0 = host_now_ns();
+    uint64_t end = t0 + (uint64_t)(seconds * 1e9);
+    uint64_t now;
+    while ((now = host_now_ns()) < end) {
+        int64_t now_us = (int64_t)(now / 1000);
+        if (rate_bps > 0) {
+            while (written < (uint64_t)((now - t0) / 1e9 * rate_bps)) {
+                size_t n = make_frame(frame, seq++);
+                ntrip_caster_write(caster, frame, n);
+                written += n;
+            }
+        } else {
+            // As fast as the slowest fast client keeps up
+            uint32_t lag = 0;
+            for (int i = 0; i < NTRIP_MAX_CLIENTS; i++) {
+                const ntrip_client_t *cl = &caster->clients[i];
+                if (cl->state == NTRIP_CLIENT_STREAM && !slot_slow[i] && caster->head - cl->pos > lag &&
+                    caster->head - cl->pos <= NTRIP_RING_SIZE) {
+                    lag = caster->head - cl->pos;
+                }
+            }
+            while (lag < NTRIP_RING_SIZE / 2) {
+                size_t n = make_frame(frame, seq++);
+                ntrip_caster_write(caster, frame, n);
+                written += n;
+                lag += (uint32_t)n;
+            }
+        }
+        ntrip_caster_poll(caster, now_us);
+        for (int i = 0; i < total; i++) client_read(&clients[i], now);
+    }
+    // Let the fast clients drain what was written
+    deadline = host_now_ns() + 1000000000ull;
+    for (;;) {
+        ntrip_caster_poll(caster, (int64_t)(host_now_ns() / 1000));
+        int done = 1;
+        for (int i = 0; i < nclients; i++) {
+            client_read(&clients[i], host_now_ns());
+            if (!clients[i].closed && clients[i].bytes < written) done = 0;
+        }
+        if (done || host_now_ns() > deadline) break;
+    }
+    double wall = (host_now_ns() - t0) / 1e9;
+    double cpu = (double)(clock() - cpu0) / CLOCKS_PER_SEC;
+
+    uint64_t delivered = 0, min_bytes = UINT64_MAX;
+    uint32_t gaps = 0, crc = 0, incomplete = 0;
+    for (int i = 0; i < total; i++) {
+        bench_client_t *c = &clients[i];
+        if (!c->slow) {
+            delivered += c->bytes;
+            if (c->bytes < min_bytes) min_bytes = c->bytes;
+            gaps += c->gaps;
+            crc += c->framer.crc_errors;
+            if (c->bytes != written) incomplete++;
+        }
+        close(c->fd);
+    }
+    printf("%3d clients (+%d slow): stream %7.2f MB/s, delivered %8.2f MB/s, %6.1f ns/B cpu, "
+           "gaps %u, crc %u, short %u, evicted %u\n",
+           nclients, nslow, written / wall / 1e6, delivered / wall / 1e6,
+           delivered ? cpu * 1e9 / delivered : 0.0, (unsigned)gaps, (unsigned)crc, (unsigned)incomplete,
+           (unsigned)caster->evicted);
+    if (gaps || crc || incomplete) rc = -1;
+    if (nslow && caster->evicted < (uint32_t)nslow) rc = -1;
+    ntrip_caster_close(caster);
+    free(caster);
+    return rc;
+}
+
+int main(int argc, char **argv) {
+    int counts[16] = { 1, 2, 4, 8, 16, 32 };
+    int ncounts = 6;
+    double seconds = 1.0;
+    int rate = 0;
+    int slow = 0;
+    for (int i = 1; i < argc; i++) {
+        int has_val = i + 1 < argc;
+        if (strcmp(argv[i], "--clients") == 0 && has_val) {
+            ncounts = 0;
+            for (char *s = argv[++i]; *s && ncounts < 16;) {
+                counts[ncounts++] = (int)strtol(s, &s, 10);
+                if (*s == ',') s++;
+            }
+        } else if (strcmp(argv[i], "--seconds") == 0 && has_val) seconds = atof(argv[++i]);
+        else if (strcmp(argv[i], "--rate") == 0 && has_val) rate = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--slow") == 0 && has_val) slow = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "usage: %s [--clients N[,N..]] [--seconds S] [--rate BPS] [--slow K]\n", argv[0]);
+            return 2;
+        }
+    }
+    int rc = 0;
+    for (int i = 0; i < ncounts; i++) {
+        if (counts[i] < 1 || counts[i] + slow > MAX_BENCH_CLIENTS) {
+            fprintf(stderr, "%d clients: caster built for %d\n", counts[i], MAX_BENCH_CLIENTS);
+            rc = 1;
+            continue;
+        }
+        if (run(counts[i], slow, seconds, rate, i == 0) != 0) rc = 1;
+    }
+    return rc;
+}
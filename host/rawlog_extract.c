@@ -0,0 +1,159 @@
+// Split a raw stream log partition dump (main/raw_log.h) into capture files.
+//
+//   rawlog_extract [-o PREFIX] [--boot N] DUMP
+//     -o PREFIX      output file prefix (rawlog)
+//     --boot N       only this boot (default: every boot in the dump)
+//
+// Read the partition from the device with
+//   esptool.py read_flash 0x190000 0x270000 rawlog.bin
+// Sectors are put back in write order and every source of every boot is
+// written to its own file as the raw bytes that went over the UART or the
+// link: PREFIX_bootN_SOURCE.rtcm3 for the RTCM streams (convbin -r rtcm3),
+// .ubx for the rover receiver (convbin -r ubx) and .raw for the base
+// receiver, whose RTCM, UBX and NMEA are interleaved. rtk_replay takes the
+// .raw file as its base capture.
+// Lost data is reported: sectors missing from a boot (overwritten by the
+// circular log or failed writes) and records the device dropped.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "host_io.h"
+#include "raw_log.h"
+
+typedef struct {
+    uint32_t offset;
+    uint32_t seq;
+    uint32_t boot;
+} sector_ref_t;
+
+typedef struct {
+    host_buf_t data;
+    uint32_t records;
+    uint32_t first_ms;
+    uint32_t last_ms;
+} source_out_t;
+
+static const char *prefix = "rawlog";
+static const char *dump_path;
+static long only_boot = -1;
+static host_buf_t dump;
+static source_out_t out[RAW_LOG_SRC_COUNT];
+
+static int by_seq(const void *a, const void *b) {
+    const sector_ref_t *x = a, *y = b;
+    return x->seq < y->seq ? -1 : x->seq > y->seq;
+}
+
+static const char *extension(raw_log_source_t source) {
+    switch (source) {
+    case RAW_LOG_SRC_BASE_GNSS: return "raw";    // mixed RTCM, UBX and NMEA
+    case RAW_LOG_SRC_ROVER_GNSS: return "ubx";
+    default: return "rtcm3";
+    }
+}
+
+// Returns the records in the sector; *bad counts a record header that made no sense
+static uint32_t read_sector(const uint8_t *s, uint32_t *bad) {
+    uint32_t records = 0;
+    size_t pos = sizeof(raw_log_sector_hdr_t);
+    while (pos + sizeof(raw_log_rec_hdr_t) <= RAW_LOG_SECTOR_SIZE) {
+        raw_log_rec_hdr_t rec;
+        memcpy(&rec, s + pos, sizeof(rec));
+        if (rec.sync != RAW_LOG_REC_SYNC) {
+            if (rec.sync != 0xFF) (*bad)++;
+            break;
+        }
+        pos += sizeof(rec);
+        if (rec.source == 0 || rec.source >= RAW_LOG_SRC_COUNT || pos + rec.len > RAW_LOG_SECTOR_SIZE) {
+            (*bad)++;
+            break;
+        }
+        source_out_t *o = &out[rec.source];
+        if (o->records == 0) o->first_ms = rec.time_ms;
+        o->last_ms = rec.time_ms;
+        o->records++;
+        host_buf_append(&o->data, s + pos, rec.len);
+        pos += rec.len;
+        records++;
+    }
+    return records;
+}
+
+static int write_boot(uint32_t boot) {
+    for (int src = 1; src < RAW_LOG_SRC_COUNT; src++) {
+        source_out_t *o = &out[src];
+        if (o->records == 0) continue;
+        char path[512];
+        snprintf(path, sizeof(path), "%s_boot%u_%s.%s", prefix, (unsigned)boot, raw_log_source_name(src),
+                 extension(src));
+        if (host_buf_save(&o->data, path) != 0) {
+            fprintf(stderr, "cannot write %s\n", path);
+            return -1;
+        }
+        printf("  %-28s %9zu B  %6u records  %.1f..%.1f s\n", path, o->data.len, (unsigned)o->records,
+               o->first_ms / 1000.0, o->last_ms / 1000.0);
+        host_buf_free(&o->data);
+        memset(o, 0, sizeof(*o));
+    }
+    return 0;
+}
+
+static int parse_args(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        int has_val = i + 1 < argc;
+        if (strcmp(a, "-o") == 0 && has_val) prefix = argv[++i];
+        else if (strcmp(a, "--boot") == 0 && has_val) only_boot = strtol(argv[++i], NULL, 0);
+        else if (a[0] != '-' && !dump_path) dump_path = a;
+        else return -1;
+    }
+    return dump_path ? 0 : -1;
+}
+
+int main(int argc, char **argv) {
+    if (parse_args(argc, argv) != 0) {
+        fprintf(stderr, "usage: %s [-o PREFIX] [--boot N] DUMP\n", argv[0]);
+        return 2;
+    }
+    if (host_buf_load(&dump, dump_path) != 0) {
+        fprintf(stderr, "cannot read %s\n", dump_path);
+        return 2;
+    }
+    size_t sectors = dump.len / RAW_LOG_SECTOR_SIZE;
+    sector_ref_t *refs = calloc(sectors ? sectors : 1, sizeof(*refs));
+    size_t used = 0;
+    for (size_t i = 0; i < sectors; i++) {
+        raw_log_sector_hdr_t hdr;
+        memcpy(&hdr, dump.data + i * RAW_LOG_SECTOR_SIZE, sizeof(hdr));
+        if (hdr.magic != RAW_LOG_MAGIC) continue;
+        if (only_boot >= 0 && hdr.boot != (uint32_t)only_boot) continue;
+        refs[used++] = (sector_ref_t){ (uint32_t)(i * RAW_LOG_SECTOR_SIZE), hdr.seq, hdr.boot };
+    }
+    printf("%s: %zu sectors, %zu with log data\n", dump_path, sectors, used);
+    qsort(refs, used, sizeof(*refs), by_seq);
+
+    int rc = 0;
+    for (size_t i = 0; i < used;) {
+        // One boot: consecutive sectors in write order
+        uint32_t boot = refs[i].boot, first_seq = refs[i].seq, gaps = 0, bad = 0, records = 0, dropped = 0;
+        size_t n = 0;
+        for (; i < used && refs[i].boot == boot; i++, n++) {
+            const uint8_t *s = dump.data + refs[i].offset;
+            raw_log_sector_hdr_t hdr;
+            memcpy(&hdr, s, sizeof(hdr));
+            if (n && refs[i].seq != refs[i - 1].seq + 1) gaps += refs[i].seq - refs[i - 1].seq - 1;
+            dropped = hdr.dropped;
+            records += read_sector(s, &bad);
+        }
+        printf("boot %u: %zu sectors (seq %u..%u), %u records\n", (unsigned)boot, n, (unsigned)first_seq,
+               (unsigned)refs[i - 1].seq, (unsigned)records);
+        if (gaps) printf("  %u sectors missing (overwritten or failed writes)\n", (unsigned)gaps);
+        if (dropped) printf("  %u records dropped on the device (writer behind)\n", (unsigned)dropped);
+        if (bad) printf("  %u sectors cut short by a malformed record\n", (unsigned)bad);
+        if (write_boot(boot) != 0) rc = 1;
+    }
+    free(refs);
+    host_buf_free(&dump);
+    return rc;
+}
@@ -0,0 +1,388 @@
+// ESP-NOW mesh relaying (main/link_relay.c) on a simulated field.
+//
+//   relay_sim [--layout field|line] [--nodes N] [--seconds S] [--rate PKT_S] [--ttl N] [--seed N]
+//     field   rovers scattered over a square with the base in one corner
+//     line    rovers strung out along a road away from the base
+//     --nodes N    rovers (default 30)
+//     --seconds S  run length per configuration (default 120)
+//     --rate N     base data packets per second (default 20), plus one parity
+//                  packet per LINK_FEC_GROUP_SIZE
+//     --ttl N      relays a packet may pass (the base's LINK_RELAY_TTL, default 3)
+//
+// The same placement runs with no rover relaying, a quarter, half and all of
+// them. Per distance band: delivery of the data packets as they arrive
+// (raw) and once the FEC parity has rebuilt single losses. Per hop count of
+// the copy that reached a rover first: how many, and their latency from the
+// base queueing the packet. Airtime is transmissions per base packet.
+//
+// Radio model as host/adapt_sim at the 1 Mbps ESP-NOW default: log-distance
+// path loss with fixed per-link shadowing and per-packet fading, packet error
+// on a logistic curve through 10% at the rate's sensitivity. The 802.11 MAC
+// is carrier sense (SIM_CS_DBM), DIFS and a random backoff that freezes while
+// the medium is busy, no retries for broadcasts. A packet survives
+// overlapping transmissions when it is SIM_CAPTURE_DB above their sum, and a
+// node hears nothing while it sends. The relays are the firmware code
+// unchanged, polled on the 1 ms tick the rover task sleeps to; every rover
+// keeps the first copy of each sequence number, as its bonded receiver does.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "link_relay.h"
+#include "link_fec.h"
+
+#define SIM_TX_DBM        20.0
+#define SIM_PL0_DB        40.0
+#define SIM_PL_EXPONENT   3.0
+#define SIM_SHADOW_DB     4.0
+#define SIM_FADE_DB       2.0
+#define SIM_PER_SLOPE     1.0
+#define SIM_SENS_DBM      (-97.0) // 1 Mbps
+#define SIM_CS_DBM        (-95.0) // preamble detection: the medium is busy
+#define SIM_CAPTURE_DB    10.0
+#define SIM_MAC_BYTES     43
+#define SIM_DATA_BYTES    230
+#define SIM_STEP_US       10
+#define SIM_DIFS_US       50
+#define SIM_SLOT_US       20
+#define SIM_CW            15
+#define SIM_MAC_QUEUE     16
+#define SIM_MAX_NODES     65      // the base and up to 64 rovers
+#define SIM_TX_RING       256
+#define SIM_BANDS         4
+#define SIM_BAND_M        350.0   // about the 1 Mbps range
+#define SIM_HOPS          4       // 0, 1, 2, 3 or more relays
+#define SIM_LAT_BINS      2000    // 0.1 ms each
+#define SIM_MAX_SEQS      60000
+
+typedef struct {
+    uint8_t pkt[LINK_MAX_PACKET];
+    uint8_t len;
+} sim_frame_t;
+
+typedef struct {
+    double x, y, dist;
+    int relaying;
+    link_relay_t relay;
+    sim_frame_t q[SIM_MAC_QUEUE];
+    int q_head, q_count;
+    int64_t tx_end;               // sending until, 0 = idle
+    int64_t idle_since;
+    int64_t backoff_us;           // left to count down, -1 = none drawn
+    uint8_t *got;                 // per data seq
+    uint8_t *parity;              // per FEC group
+} sim_node_t;
+
+typedef struct {
+    int sender;
+    int64_t start, end;
+    int delivered;
+    sim_frame_t frame;
+} sim_tx_t;
+
+typedef struct {
+    uint64_t first[SIM_HOPS];
+    double lat_sum[SIM_HOPS];
+    uint32_t lat_hist[SIM_HOPS][SIM_LAT_BINS];
+    uint32_t transmissions;
+    uint32_t mac_drops;
+} sim_stats_t;
+
+static sim_node_t nodes[SIM_MAX_NODES];
+static int node_count;
+static double link_db[SIM_MAX_NODES][SIM_MAX_NODES];   // mean RSSI
+static sim_tx_t txs[SIM_TX_RING];
+static int tx_next;
+static int64_t gen_us[SIM_MAX_SEQS];
+static sim_stats_t st;
+static int64_t now_us;
+static uint64_t rng;
+static sim_node_t *sending;   // node whose relay is being polled
+
+static double uniform(void) {
+    // xorshift64*
+    rng ^= rng >> 12;
+    rng ^= rng << 25;
+    rng ^= rng >> 27;
+    return ((rng * 2685821657736338717ULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double gaussian(void) {
+    double u = uniform(), v = uniform();
+    return sqrt(-2.0 * log(u + 1e-300)) * cos(2.0 * M_PI * v);
+}
+
+static int64_t airtime_us(size_t len) {
+    return 192 + (int64_t)((len + SIM_MAC_BYTES) * 8);
+}
+
+static void mac_queue(sim_node_t *n, const uint8_t *pkt, size_t len) {
+    if (n->q_count == SIM_MAC_QUEUE) {
+        st.mac_drops++;
+        return;
+    }
+    sim_frame_t *f = &n->q[(n->q_head + n->q_count++) % SIM_MAC_QUEUE];
+    memcpy(f->pkt, pkt, len);
+    f->len = (uint8_t)len;
+}
+
+static void relay_send(const uint8_t *pkt, size_t len) {
+    mac_queue(sending, pkt, len);
+}
+
+static void place(const char *layout, int rovers, uint64_t seed) {
+    rng = seed * 0x9E3779B97F4A7C15ULL + 1;
+    node_count = rovers + 1;
+    nodes[0].x = nodes[0].y = 0;
+    for (int i = 1; i < node_count; i++) {
+        if (strcmp(layout, "line") == 0) {
+            nodes[i].x = 1400.0 * i / rovers;
+            nodes[i].y = 40.0 * (uniform() - 0.5);
+        } else {
+            nodes[i].x = 1000.0 * uniform();
+            nodes[i].y = 1000.0 * uniform();
+        }
+    }
+    for (int i = 0; i < node_count; i++) {
+        nodes[i].dist = hypot(nodes[i].x, nodes[i].y);
+        for (int j = 0; j < i; j++) {
+            double d = hypot(nodes[i].x - nodes[j].x, nodes[i].y - nodes[j].y);
+            if (d < 1.0) d = 1.0;
+            double db = SIM_TX_DBM - SIM_PL0_DB - 10.0 * SIM_PL_EXPONENT * log10(d) + SIM_SHADOW_DB * gaussian();
+            link_db[i][j] = link_db[j][i] = db;
+        }
+    }
+}
+
+static int busy_at(int n) {
+    for (int k = 0; k < SIM_TX_RING; k++) {
+        const sim_tx_t *t = &txs[k];
+        if (t->end > now_us && t->start <= now_us && t->sender != n && link_db[t->sender][n] > SIM_CS_DBM) return 1;
+    }
+    return 0;
+}
+
+static void rover_receive(int r, const sim_frame_t *f) {
+    sim_node_t *n = &nodes[r];
+    if (n->relaying) link_relay_input(&n->relay, f->pkt, f->len, now_us);
+    link_hdr_t hdr;
+    memcpy(&hdr, f->pkt, sizeof(hdr));
+    if (hdr.flags & LINK_FLAG_PARITY) {
+        n->parity[hdr.seq / LINK_FEC_GROUP_SIZE] = 1;
+        return;
+    }
+    if (n->got[hdr.seq]) return;
+    n->got[hdr.seq] = 1;
+    int hops = LINK_HOPS(hdr.hops);
+    if (hops >= SIM_HOPS) hops = SIM_HOPS - 1;
+    double lat_ms = (now_us - gen_us[hdr.seq]) / 1000.0;
+    st.first[hops]++;
+    st.lat_sum[hops] += lat_ms;
+    int bin = (int)(lat_ms * 10);
+    st.lat_hist[hops][bin < SIM_LAT_BINS ? bin : SIM_LAT_BINS - 1]++;
+}
+
+// A transmission ends: every other node gets it unless it was sending
+// itself, the signal was too weak or an overlapping one drowned it
+static void deliver(const sim_tx_t *t) {
+    for (int r = 1; r < node_count; r++) {
+        if (r == t->sender) continue;
+        double interference_mw = 0;
+        int deaf = 0;
+        for (int k = 0; k < SIM_TX_RING; k++) {
+            const sim_tx_t *o = &txs[k];
+            if (o == t || o->end <= t->start || o->start >= t->end || o->end == 0) continue;
+            if (o->sender == r) deaf = 1;
+            else interference_mw += pow(10.0, link_db[o->sender][r] / 10.0);
+        }
+        if (deaf) continue;
+        double rssi = link_db[t->sender][r] + SIM_FADE_DB * gaussian();
+        double per = 1.0 / (1.0 + 9.0 * exp(SIM_PER_SLOPE * (rssi - SIM_SENS_DBM)));
+        if (uniform() < per) continue;
+        if (interference_mw > 0 && rssi - 10.0 * log10(interference_mw) < SIM_CAPTURE_DB) continue;
+        rover_receive(r, &t->frame);
+    }
+}
+
+static void mac_step(int i) {
+    sim_node_t *n = &nodes[i];
+    if (n->tx_end) {
+        if (n->tx_end > now_us) return;
+        n->tx_end = 0;
+        n->idle_since = now_us;
+    }
+    if (!n->q_count) return;
+    if (busy_at(i)) {
+        n->idle_since = -1;
+        return;
+    }
+    if (n->idle_since < 0) n->idle_since = now_us;
+    if (n->backoff_us < 0) n->backoff_us = (int64_t)(uniform() * (SIM_CW + 1)) * SIM_SLOT_US;
+    if (now_us - n->idle_since < SIM_DIFS_US) return;
+    if (n->backoff_us > 0) {
+        n->backoff_us -= SIM_STEP_US;
+        return;
+    }
+    sim_tx_t *t = &txs[tx_next];
+    tx_next = (tx_next + 1) % SIM_TX_RING;
+    t->sender = i;
+    t->frame = n->q[n->q_head];
+    t->start = now_us;
+    t->end = now_us + airtime_us(t->frame.len);
+    t->delivered = 0;
+    n->q_head = (n->q_head + 1) % SIM_MAC_QUEUE;
+    n->q_count--;
+    n->tx_end = t->end;
+    n->backoff_us = -1;
+    st.transmissions++;
+}
+
+static void base_packet(uint16_t seq, int parity, uint8_t ttl) {
+    uint8_t pkt[LINK_MAX_PACKET];
+    memset(pkt, 0xA5, sizeof(pkt));
+    link_hdr_t hdr = {
+        .version = LINK_PACKET_VERSION,
+        .flags = parity ? LINK_FLAG_PARITY : 0,
+        .seq = seq,
+        .frag_count = parity ? LINK_FEC_GROUP_SIZE : 1,
+        .source = 1,
+        .hops = LINK_HOPS_BYTE(0, ttl),
+    };
+    memcpy(pkt, &hdr, sizeof(hdr));
+    mac_queue(&nodes[0], pkt, parity ? LINK_FEC_PARITY_LEN : SIM_DATA_BYTES);
+}
+
+static void run(double relay_fraction, int seconds, int pkt_per_s, uint8_t ttl, uint64_t seed) {
+    memset(&st, 0, sizeof(st));
+    memset(txs, 0, sizeof(txs));
+    tx_next = 0;
+    int seqs = seconds * pkt_per_s;
+    rng = seed * 0x2545F4914F6CDD1DULL + 7;
+    for (int i = 0; i < node_count; i++) {
+        sim_node_t *n = &nodes[i];
+        n->q_head = n->q_count = 0;
+        n->tx_end = 0;
+        n->idle_since = 0;
+        n->backoff_us = -1;
+        // Relays picked by index: the same ones at every fraction, spread over the field
+        n->relaying = i > 0 && relay_fraction > 0 && fmod((i - 1) * relay_fraction, 1.0) + relay_fraction >= 1.0 - 1e-9;
+        link_relay_init(&n->relay, relay_send, (uint32_t)(seed * 7919 + i));
+        free(n->got);
+        free(n->parity);
+        n->got = calloc(seqs, 1);
+        n->parity = calloc(seqs / LINK_FEC_GROUP_SIZE + 1, 1);
+    }
+
+    int64_t interval_us = 1000000 / pkt_per_s;
+    int seq = 0;
+    int64_t end_us = (int64_t)seconds * 1000000 + 200000;   // drain the last packets
+    for (now_us = 0; now_us < end_us; now_us += SIM_STEP_US) {
+        if (seq < seqs && now_us >= seq * interval_us) {
+            gen_us[seq] = now_us;
+            base_packet((uint16_t)seq, 0, ttl);
+            if (++seq % LINK_FEC_GROUP_SIZE == 0) base_packet((uint16_t)(seq - LINK_FEC_GROUP_SIZE), 1, ttl);
+        }
+        for (int k = 0; k < SIM_TX_RING; k++) {
+            if (txs[k].end && txs[k].end <= now_us && !txs[k].delivered) {
+                txs[k].delivered = 1;
+                deliver(&txs[k]);
+            }
+        }
+        if (now_us % 1000 == 0) {
+            for (int i = 1; i < node_count; i++) {
+                if (!nodes[i].relaying) continue;
+                sending = &nodes[i];
+                link_relay_poll(&nodes[i].relay, now_us);
+            }
+        }
+        for (int i = 0; i < node_count; i++) mac_step(i);
+    }
+
+    // Delivery per distance band, raw and with single losses per group rebuilt
+    uint64_t expected[SIM_BANDS] = { 0 }, raw[SIM_BANDS] = { 0 }, fec[SIM_BANDS] = { 0 };
+    link_relay_stats_t total = { 0 };
+    int relays = 0;
+    for (int i = 1; i < node_count; i++) {
+        sim_node_t *n = &nodes[i];
+        int band = (int)(n->dist / SIM_BAND_M);
+        if (band >= SIM_BANDS) band = SIM_BANDS - 1;
+        for (int g = 0; g + LINK_FEC_GROUP_SIZE <= seqs; g += LINK_FEC_GROUP_SIZE) {
+            int have = 0;
+            for (int s = g; s < g + LINK_FEC_GROUP_SIZE; s++) have += n->got[s];
+            expected[band] += LINK_FEC_GROUP_SIZE;
+            raw[band] += have;
+            fec[band] += have == LINK_FEC_GROUP_SIZE - 1 && n->parity[g / LINK_FEC_GROUP_SIZE] ? LINK_FEC_GROUP_SIZE : have;
+        }
+        if (n->relaying) {
+            relays++;
+            total.relayed += n->relay.stats.relayed;
+            total.suppressed += n->relay.stats.suppressed;
+            total.queue_full += n->relay.stats.queue_full;
+        }
+    }
+    int base_pkts = seqs + seqs / LINK_FEC_GROUP_SIZE;
+    printf("%3d/%-3d %6.2f %6.1f%%", relays, node_count - 1, (double)st.transmissions / base_pkts,
+           total.relayed + total.suppressed ? 100.0 * total.suppressed / (total.relayed + total.suppressed) : 0.0);
+    for (int b = 0; b < SIM_BANDS; b++) {
+        if (expected[b]) printf("  %5.1f/%5.1f", 100.0 * raw[b] / expected[b], 100.0 * fec[b] / expected[b]);
+        else printf("  %11s", "-");
+    }
+    printf("\n        first copy by hops:");
+    for (int h = 0; h < SIM_HOPS; h++) {
+        if (!st.first[h]) continue;
+        uint64_t target = st.first[h] * 95 / 100, seen = 0;
+        int p95 = 0;
+        while (p95 < SIM_LAT_BINS - 1 && (seen += st.lat_hist[h][p95]) < target) p95++;
+        printf("  %d%s: %llu, %.1f ms (p95 %.1f)", h, h == SIM_HOPS - 1 ? "+" : "", (unsigned long long)st.first[h],
+               st.lat_sum[h] / st.first[h], p95 / 10.0);
+    }
+    printf("\n        MAC drops %u, relay queue full %u\n", (unsigned)st.mac_drops, (unsigned)total.queue_full);
+}
+
+int main(int argc, char **argv) {
+    const char *layout = "field";
+    int rovers = 30, seconds = 120, pkt_per_s = 20, ttl = 3;
+    uint64_t seed = 1;
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        int has_val = i + 1 < argc;
+        if (strcmp(a, "--layout") == 0 && has_val) layout = argv[++i];
+        else if (strcmp(a, "--nodes") == 0 && has_val) rovers = atoi(argv[++i]);
+        else if (strcmp(a, "--seconds") == 0 && has_val) seconds = atoi(argv[++i]);
+        else if (strcmp(a, "--rate") == 0 && has_val) pkt_per_s = atoi(argv[++i]);
+        else if (strcmp(a, "--ttl") == 0 && has_val) ttl = atoi(argv[++i]);
+        else if (strcmp(a, "--seed") == 0 && has_val) seed = strtoull(argv[++i], NULL, 0);
+        else {
+            fprintf(stderr, "usage: %s [--layout field|line] [--nodes N] [--seconds S] [--rate PKT_S] [--ttl N] "
+                    "[--seed N]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (strcmp(layout, "field") && strcmp(layout, "line")) {
+        fprintf(stderr, "unknown layout %s\n", layout);
+        return 2;
+    }
+    if (rovers < 1 || rovers >= SIM_MAX_NODES || pkt_per_s <= 0 || 1000000 % pkt_per_s || seconds <= 0 ||
+        (long)seconds * pkt_per_s > SIM_MAX_SEQS || ttl < 0 || ttl > 15) {
+        fprintf(stderr, "--nodes 1..%d, --rate a divisor of 1000000, --seconds up to %d packets, --ttl 0..15\n",
+                SIM_MAX_NODES - 1, SIM_MAX_SEQS);
+        return 2;
+    }
+    place(layout, rovers, seed);
+    printf("%s, %d rovers, %d pkt/s + parity every %d, TTL %d, backoff up to %d us, cancelled by %d copies heard, %d s\n",
+           layout, rovers, pkt_per_s, LINK_FEC_GROUP_SIZE, ttl, LINK_RELAY_BACKOFF_US, LINK_RELAY_SUPPRESS, seconds);
+    printf("%-7s %6s %7s", "relays", "tx/pkt", "suppr");
+    for (int b = 0; b < SIM_BANDS; b++) {
+        char band[32];
+        if (b < SIM_BANDS - 1) snprintf(band, sizeof(band), "%.0f-%.0f m", b * SIM_BAND_M, (b + 1) * SIM_BAND_M);
+        else snprintf(band, sizeof(band), "%.0f+ m", b * SIM_BAND_M);
+        printf("  %11s", band);
+    }
+    printf("   (delivery %% raw/FEC)\n");
+    const double fractions[] = { 0.0, 0.25, 0.5, 1.0 };
+    for (size_t f = 0; f < sizeof(fractions) / sizeof(fractions[0]); f++) {
+        run(fractions[f], seconds, pkt_per_s, (uint8_t)ttl, seed);
+    }
+    return 0;
+}
@@ -0,0 +1,876 @@
+// Host replay and benchmark for the correction pipeline.
+//
+//   rtk_replay [options] BASE_CAPTURE
+//     -r FILE        rover receiver UART capture (NMEA/UBX) to decode as well
+//     --realtime     pace the replay at the UART baud rate instead of max speed
+//     --baud N       capture baud rate used for pacing and simulated time (115200)
+//     --budget BPS   scheduler link budget, 0 = unlimited (RTCM_SCHED_BUDGET_BPS)
+//     --loss PCT     drop this percentage of radio packets; a comma list
+//                    gives one value per path (e.g. 5,100 for a dead second path)
+//     --paths N      bonded transports carrying every packet (1..3)
+//     --seed N       loss pattern seed (1)
+//     --delta N      delta-code MSM frames on the link, N frames per type between
+//                    key frames (0 = RTCM_DELTA_KEY_INTERVAL); off by default
+//     --repeat N     stage benchmark iterations, best time is reported (5)
+//     --out FILE     write the RTCM stream delivered to the rover receiver
+//     --expect FILE  compare that stream with a reference capture
+//     --deadline MS  drop corrections older than this at the rover UART
+//                    (RTCM_TXQ_DEADLINE_US)
+//     --rawlog FILE  record the end-to-end run in a raw stream log (raw_log.h)
+//                    on a simulated flash partition saved as FILE, as the device
+//                    would; an existing FILE is continued like after a reboot
+//     --poll MS      schedule base and rover as the polling loop that runs every
+//                    MS milliseconds (PIPELINE_TASKS 0) instead of as tasks
+//
+// Captures are raw UART bytes as logged from the ZED-F9P. Their idle gaps
+// are restored from the receiver's own time tags (GPS/Galileo MSM epochs on
+// the base, NAV-PVT iTOW on the rover): each tagged burst starts at its GPS
+// time and then drains at the baud rate. Simulated time advances in 100 us
+// steps, so results do not depend on --realtime. By default each side runs
+// as the device's pipeline tasks do: the base feeds when the UART reports data
+// (RX FIFO threshold or line idle) or a pipeline deadline is due, radio packets
+// reach the rover as they are sent, and the rover forwards at its own
+// deadlines or once the UART has room for a waiting frame. With --poll the
+// base runs every MS and the rover half a period later, and radio packets
+// wait in the receive ring until the rover's turn. Both report how long GNSS
+// bytes waited for the base to pick them up and how often each side woke.
+// The rover receiver UART is a TX ring of UART_TX_RING bytes draining at the
+// baud rate, so corrections queue and age as on the device.
+// The end-to-end run reports the cost of each loop stage per call (prof.h).
+// Exit status is 0 only if the rover output matches the scheduler output
+// (unless --loss is set) and --expect.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "host_io.h"
+#include "base_pipeline.h"
+#include "rover_pipeline.h"
+#include "link_clock.h"
+#include "telemetry.h"
+#include "raw_log.h"
+#include "prof.h"
+
+#define STEP_US        100       // simulated time resolution, UART_GNSS_RX_IDLE_US
+#define DRAIN_US       1000000   // simulated time run after the capture ends
+#define UART_CHUNK     512       // largest single UART read, as on the device
+#define TOW_WEEK_MS    604800000u
+#define MAX_ALIGN_MS   60000     // captures further apart are not from one session
+#define RAWLOG_SIZE    0x270000  // the "rawlog" partition in partitions.csv
+#define RAWLOG_BUFFERS 2
+#define UART_TX_RING   4096      // UART_GNSS_TX_BUF_SIZE on the rover
+#define BENCH_POLL_US  10000     // stage benchmark schedule
+#define UART_FIFO_LEN  128       // RX FIFO and interrupt latency it absorbs, as uart_gnss.c
+#define UART_ISR_US    500
+#define IDLE_WAKE_US   100000    // TASK_IDLE_WAKE_MS
+
+typedef struct {
+    const char *base_path;
+    const char *rover_path;
+    const char *out_path;
+    const char *expect_path;
+    const char *rawlog_path;
+    int realtime;
+    int32_t baud;
+    int32_t budget_bps;
+    int loss_pct[LINK_BOND_MAX_PATHS];
+    int paths;
+    int delta;                    // key interval + 1, 0 = codec off
+    uint32_t deadline_us;         // 0 = RTCM_TXQ_DEADLINE_US
+    uint32_t seed;
+    int repeat;
+    int64_t poll_us;              // 0 = event-driven tasks
+} replay_opts_t;
+
+static replay_opts_t opts = {
+    .baud = 115200,
+    .budget_bps = RTCM_SCHED_BUDGET_BPS,
+    .seed = 1,
+    .repeat = 5,
+    .paths = 1,
+};
+
+// Capture offset where a burst tagged with a receiver time starts
+typedef struct {
+    size_t offset;
+    int64_t t_us;
+} pace_anchor_t;
+
+// A side's scheduling: when it woke and how long UART input waited for it
+typedef struct {
+    uint32_t wakes;
+    int64_t last_wake_us;
+    size_t seen;                  // UART bytes arrived at the previous step
+    int64_t pending_us;           // when the oldest unread UART byte arrived
+    uint64_t byte_wait_us;        // summed over every byte read
+    size_t bytes;
+    int64_t wait_max_us;          // oldest byte at a read
+} side_sched_t;
+
+typedef struct {
+    host_buf_t anchors;           // pace_anchor_t array, ascending
+    size_t count;
+    size_t idx;                   // current anchor during a run
+    uint32_t first_tow_ms;
+    uint32_t last_tow_ms;
+    int64_t tow_base_ms;          // week rollover correction
+} pacer_t;
+
+static host_buf_t base_in;        // base receiver capture
+static host_buf_t rover_in;       // rover receiver capture
+static pacer_t base_pace;
+static pacer_t rover_pace;
+static host_buf_t packets;        // radio packets: int64 time | uint16 len | bytes
+static host_buf_t radio_queue;    // packets waiting for the rover's turn (--poll)
+static host_buf_t sched_out;      // frames leaving the base scheduler
+static host_buf_t rover_out;      // RTCM written to the rover receiver
+static int64_t sim_now;
+static uint32_t rng;
+static uint32_t radio_sent;
+static uint32_t radio_dropped[LINK_BOND_MAX_PATHS];
+static int rover_path[LINK_BOND_MAX_PATHS];
+static int connect_rover;         // 1: radio packets go to the rover
+static int64_t poll_us;           // current run's polling period, 0 = tasks
+static size_t uart_rx_full;
+static telemetry_t telemetry;     // rover solutions batched as for the broker
+static host_buf_t flash_img;      // simulated raw log partition
+static raw_log_t rawlog;
+static raw_log_buf_t rawlog_bufs[RAWLOG_BUFFERS];
+static int rawlog_on;
+static size_t uart_tx_level;      // simulated rover UART TX ring
+static int64_t uart_tx_us;
+static uint64_t rawlog_append_max_ns;
+static side_sched_t base_sched;
+static side_sched_t rover_sched;
+// Per-call cost of each stage of the simulated device (prof.h)
+PROF_DECLARE(prof_wake);
+PROF_DECLARE(prof_base_feed);
+PROF_DECLARE(prof_base_poll);
+PROF_DECLARE(prof_rover_input);
+PROF_DECLARE(prof_rover_poll);
+PROF_DECLARE(prof_rover_gnss);
+PROF_DECLARE(prof_telemetry);
+PROF_DECLARE(prof_rawlog);
+PROF_DECLARE(prof_pool);
+
+typedef struct {
+    const char *name;
+    uint64_t best_ns;
+    size_t bytes;
+    uint64_t allocs;
+} stage_result_t;
+
+static uint32_t next_rand(void) {
+    rng = rng * 1664525u + 1013904223u;
+    return rng >> 8;
+}
+
+static void pacer_add(pacer_t *p, size_t offset, uint32_t tow_ms) {
+    if (p->count == 0) p->first_tow_ms = tow_ms;
+    else if (tow_ms == p->last_tow_ms) return;
+    else if (tow_ms < p->last_tow_ms) p->tow_base_ms += TOW_WEEK_MS;
+    p->last_tow_ms = tow_ms;
+    // Stored relative to the capture's own first tag until the origins are aligned
+    pace_anchor_t a = { offset, (p->tow_base_ms + tow_ms - p->first_tow_ms) * 1000 };
+    host_buf_append(&p->anchors, &a, sizeof(a));
+    p->count++;
+}
+
+static void pacer_shift(pacer_t *p, int64_t dt_us) {
+    pace_anchor_t *a = (pace_anchor_t *)p->anchors.data;
+    for (size_t i = 0; i < p->count; i++) a[i].t_us += dt_us;
+}
+
+// Capture bytes the UART has delivered by t_us
+static size_t bytes_due(pacer_t *p, int64_t t_us, size_t total) {
+    const pace_anchor_t *a = (const pace_anchor_t *)p->anchors.data;
+    int64_t rate = opts.baud / 10;
+    int64_t n;
+    if (p->count == 0) {
+        n = t_us * rate / 1000000;
+    } else {
+        while (p->idx + 1 < p->count && a[p->idx + 1].t_us <= t_us) p->idx++;
+        if (a[p->idx].t_us > t_us) {
+            // Bytes ahead of the first tag go out from time zero
+            n = t_us * rate / 1000000;
+            if (n > (int64_t)a[0].offset) n = (int64_t)a[0].offset;
+        } else {
+            n = (int64_t)a[p->idx].offset + (t_us - a[p->idx].t_us) * rate / 1000000;
+            if (p->idx + 1 < p->count && n > (int64_t)a[p->idx + 1].offset) n = (int64_t)a[p->idx + 1].offset;
+        }
+    }
+    return n < (int64_t)total ? (size_t)n : total;
+}
+
+static size_t scan_pos;
+
+static void scan_rtcm(const uint8_t *frame, size_t len, void *ctx) {
+    uint16_t type = rtcm3_msg_type(frame, len);
+    int gnss = rtcm_msm_gnss(type);
+    rtcm_msm_header_t h;
+    if ((gnss == RTCM_GNSS_GPS || gnss == RTCM_GNSS_GALILEO) &&
+        rtcm_msm_parse_header(frame + RTCM3_HEADER_LEN, rtcm3_payload_len(frame), &h) == 0) {
+        pacer_add(&base_pace, scan_pos + 1 - len, h.epoch);
+    }
+}
+
+static void scan_pvt(const ubx_nav_pvt_t *pvt, void *ctx) {
+    pacer_add(&rover_pace, scan_pos + 1 - (UBX_HEADER_LEN + sizeof(ubx_nav_pvt_t) + UBX_CHECKSUM_LEN), pvt->iTOW);
+}
+
+// Find the receiver time tags in both captures and put them on one time line
+static void build_pacing(void) {
+    rtcm3_framer_t f;
+    rtcm3_framer_init(&f);
+    for (scan_pos = 0; scan_pos < base_in.len; scan_pos++) {
+        rtcm3_framer_feed(&f, base_in.data + scan_pos, 1, scan_rtcm, NULL);
+    }
+    ubx_parser_t u;
+    const ubx_handlers_t handlers = { .on_pvt = scan_pvt };
+    ubx_parser_init(&u, &handlers);
+    for (scan_pos = 0; scan_pos < rover_in.len; scan_pos++) {
+        ubx_parser_feed(&u, rover_in.data + scan_pos, 1);
+    }
+
+    if (base_pace.count && rover_pace.count) {
+        int64_t d = (int64_t)rover_pace.first_tow_ms - base_pace.first_tow_ms;
+        if (d > 0 && d < MAX_ALIGN_MS) pacer_shift(&rover_pace, d * 1000);
+        else if (d < 0 && -d < MAX_ALIGN_MS) pacer_shift(&base_pace, -d * 1000);
+    }
+}
+
+// NOR flash: erase sets bits, writes can only clear them
+static int flash_read(void *ctx, uint32_t offset, void *data, size_t len) {
+    if (offset + len > flash_img.len) return -1;
+    memcpy(data, flash_img.data + offset, len);
+    return 0;
+}
+
+static int flash_write(void *ctx, uint32_t offset, const void *data, size_t len) {
+    if (offset + len > flash_img.len) return -1;
+    const uint8_t *d = data;
+    for (size_t i = 0; i < len; i++) flash_img.data[offset + i] &= d[i];
+    return 0;
+}
+
+static int flash_erase(void *ctx, uint32_t offset, size_t len) {
+    if (offset % RAW_LOG_SECTOR_SIZE || offset + len > flash_img.len) return -1;
+    memset(flash_img.data + offset, 0xFF, len);
+    return 0;
+}
+
+static int setup_rawlog(void) {
+    host_buf_load(&flash_img, opts.rawlog_path);
+    if (flash_img.len != RAWLOG_SIZE) {
+        flash_img.len = 0;
+        host_buf_reserve(&flash_img, RAWLOG_SIZE);
+        memset(flash_img.data, 0xFF, RAWLOG_SIZE);
+        flash_img.len = RAWLOG_SIZE;
+    }
+    const raw_log_flash_t flash = {
+        .read = flash_read,
+        .write = flash_write,
+        .erase = flash_erase,
+        .size = RAWLOG_SIZE,
+    };
+    return raw_log_init(&rawlog, &flash, rawlog_bufs, RAWLOG_BUFFERS, NULL, NULL);
+}
+
+// What the device's hot path pays per logged chunk
+static void log_raw(raw_log_source_t source, const uint8_t *data, size_t len) {
+    if (!rawlog_on) return;
+    PROF_SCOPE(prof_rawlog);
+    uint64_t t0 = host_now_ns();
+    raw_log_append(&rawlog, source, data, len, (uint32_t)(sim_now / 1000));
+    uint64_t dt = host_now_ns() - t0;
+    if (dt > rawlog_append_max_ns) rawlog_append_max_ns = dt;
+}
+
+static void queue_packet(host_buf_t *q, const uint8_t *pkt, size_t len) {
+    uint16_t n = (uint16_t)len;
+    host_buf_append(q, &sim_now, sizeof(sim_now));
+    host_buf_append(q, &n, sizeof(n));
+    host_buf_append(q, pkt, len);
+}
+
+static void rover_input(const uint8_t *pkt, size_t len) {
+    for (int i = 0; i < opts.paths; i++) {
+        if (opts.loss_pct[i] > 0 && (int)(next_rand() % 100) < opts.loss_pct[i]) {
+            radio_dropped[i]++;
+            continue;
+        }
+        PROF_SCOPE(prof_rover_input);
+        rover_pipeline_input(rover_path[i], pkt, len, sim_now);
+    }
+}
+
+static void rover_forward(void) {
+    PROF_SCOPE(prof_rover_poll);
+    rover_pipeline_poll(sim_now);
+}
+
+static void wake(side_sched_t *side) {
+    side->wakes++;
+    side->last_wake_us = sim_now;
+}
+
+static void radio_send(const uint8_t *pkt, size_t len) {
+    radio_sent++;
+    if (!connect_rover) {
+        queue_packet(&packets, pkt, len);
+    } else if (poll_us) {
+        queue_packet(&radio_queue, pkt, len);
+    } else {
+        // The receive callback wakes the rover's forwarding task
+        wake(&rover_sched);
+        rover_input(pkt, len);
+        rover_forward();
+    }
+}
+
+// The polling loop takes everything the receive ring holds
+static void radio_receive_all(void) {
+    for (size_t pos = 0; pos < radio_queue.len;) {
+        uint16_t n;
+        memcpy(&n, radio_queue.data + pos + sizeof(int64_t), sizeof(n));
+        pos += sizeof(int64_t) + sizeof(n);
+        rover_input(radio_queue.data + pos, n);
+        pos += n;
+    }
+    radio_queue.len = 0;
+}
+
+// Drain the simulated TX ring up to the pipeline's current time
+static size_t uart_tx_drain(void) {
+    int64_t now = rover_pipeline_state()->now_us;
+    size_t sent = (size_t)((now - uart_tx_us) * (opts.baud / 10) / 1000000);
+    if (sent) {
+        uart_tx_level = sent < uart_tx_level ? uart_tx_level - sent : 0;
+        uart_tx_us = now;
+    }
+    if (uart_tx_level == 0) uart_tx_us = now;
+    return uart_tx_level;
+}
+
+static size_t uart_tx_free(void) {
+    return UART_TX_RING - uart_tx_drain();
+}
+
+// TX ring room at sim_now, without moving the pipeline's clock
+static size_t uart_tx_room_now(void) {
+    size_t sent = (size_t)((sim_now - uart_tx_us) * (opts.baud / 10) / 1000000);
+    return UART_TX_RING - (sent < uart_tx_level ? uart_tx_level - sent : 0);
+}
+
+static uint32_t uart_tx_queue_us(size_t pending) {
+    return (uint32_t)((uint64_t)(uart_tx_drain() + pending) * 10 * 1000000 / opts.baud);
+}
+
+static void rover_uart_write(const uint8_t *data, size_t len) {
+    log_raw(RAW_LOG_SRC_ROVER_RTCM, data, len);
+    host_buf_append(&rover_out, data, len);
+    if (uart_tx_drain() + len > UART_TX_RING) {
+        fprintf(stderr, "rover UART write of %zu B would block\n", len);
+    }
+    uart_tx_level += len;
+}
+
+// The broker stand-in takes every message
+static int telemetry_sink(const uint8_t *msg, size_t len, void *ctx) {
+    return 0;
+}
+
+static void rover_solution(const ubx_nav_pvt_t *pvt, const ubx_nav_hpposllh_t *hp, void *ctx) {
+    const rover_pipeline_t *rp = rover_pipeline_state();
+    telemetry_record_t rec;
+    telemetry_record_from_nav(&rec, pvt, hp, rp->last_rtcm_us ? rp->now_us - rp->last_rtcm_us : -1);
+    telemetry_add(&telemetry, &rec, rp->now_us);
+}
+
+// uart: simulate the receiver UART, else it takes everything at once
+static void setup_rover(int uart) {
+    static const char *names[LINK_BOND_MAX_PATHS] = { "path0", "path1", "path2" };
+    uart_tx_level = 0;
+    uart_tx_us = 0;
+    if (uart) rover_pipeline_init(rover_uart_write, uart_tx_queue_us, uart_tx_free);
+    else rover_pipeline_init(rover_uart_write, NULL, NULL);
+    rover_pipeline_set_deadline(opts.deadline_us);
+    for (int i = 0; i < opts.paths; i++) rover_path[i] = rover_pipeline_add_path(names[i]);
+    telemetry_init(&telemetry, 0, 0, telemetry_sink, NULL);
+    rover_pipeline_set_solution_cb(rover_solution, NULL);
+}
+
+static void sched_tap(const uint8_t *frame, size_t len, void *ctx) {
+    log_raw(RAW_LOG_SRC_BASE_RTCM, frame, len);
+    host_buf_append(&sched_out, frame, len);
+}
+
+static void count_frame(const uint8_t *frame, size_t len, void *ctx) {
+    (*(uint32_t *)ctx)++;
+}
+
+static void setup_base(void) {
+    rtcm_sched_config_t cfg;
+    rtcm_sched_default_config(&cfg);
+    cfg.budget_bps = opts.budget_bps;
+    base_pipeline_init(&cfg, radio_send);
+    base_pipeline_set_tap(sched_tap, NULL);
+    if (opts.delta) base_pipeline_set_delta(1, opts.delta - 1);
+}
+
+// RX FIFO threshold that wakes the reader, as uart_gnss.c sets it for the rate
+static size_t rx_full_threshold(void) {
+    size_t headroom = (size_t)(((int64_t)opts.baud * UART_ISR_US + 10 * 1000000 - 1) / (10 * 1000000));
+    size_t threshold = headroom + 16 < UART_FIFO_LEN ? UART_FIFO_LEN - headroom : 16;
+    return threshold > 120 ? 120 : threshold;
+}
+
+// Note UART bytes arriving by sim_now; 1 when the driver would report them
+// to a waiting reader: the FIFO threshold is reached or the line went idle
+static int uart_rx_event(side_sched_t *side, size_t due, size_t pos, int64_t step_us) {
+    if (due > pos && side->seen <= pos) side->pending_us = sim_now;
+    side->byte_wait_us += (uint64_t)(due - pos) * step_us;
+    int idle = due > pos && due == side->seen;
+    side->seen = due;
+    return due - pos >= uart_rx_full || idle;
+}
+
+static void pickup(side_sched_t *side, size_t due, size_t pos) {
+    if (due <= pos) return;
+    side->bytes += due - pos;
+    if (sim_now - side->pending_us > side->wait_max_us) side->wait_max_us = sim_now - side->pending_us;
+}
+
+static void base_wake(size_t *pos, size_t due) {
+    PROF_START(wake_start);
+    wake(&base_sched);
+    pickup(&base_sched, due, *pos);
+    while (*pos < due) {
+        PROF_SCOPE(prof_base_feed);
+        size_t n = due - *pos > UART_CHUNK ? UART_CHUNK : due - *pos;
+        log_raw(RAW_LOG_SRC_BASE_GNSS, base_in.data + *pos, n);
+        base_pipeline_feed(base_in.data + *pos, n, sim_now);
+        *pos += n;
+    }
+    {
+        PROF_SCOPE(prof_base_poll);
+        base_pipeline_poll(sim_now);
+    }
+    PROF_STOP(prof_wake, wake_start);
+}
+
+static void rover_gnss(size_t *pos, size_t due) {
+    pickup(&rover_sched, due, *pos);
+    while (*pos < due) {
+        PROF_SCOPE(prof_rover_gnss);
+        size_t n = due - *pos > UART_CHUNK ? UART_CHUNK : due - *pos;
+        log_raw(RAW_LOG_SRC_ROVER_GNSS, rover_in.data + *pos, n);
+        rover_pipeline_feed_gnss(rover_in.data + *pos, n, sim_now);
+        *pos += n;
+    }
+    {
+        PROF_SCOPE(prof_telemetry);
+        telemetry_poll(&telemetry, sim_now);
+    }
+    pkt_pool_stats_t pool;
+    pkt_pool_get_stats(&pool);
+    PROF_SAMPLE(prof_pool, pool.in_use);
+}
+
+// Rover half of the polling loop
+static void rover_poll_wake(size_t *pos, size_t due) {
+    PROF_START(wake_start);
+    wake(&rover_sched);
+    radio_receive_all();
+    rover_forward();
+    rover_gnss(pos, due);
+    PROF_STOP(prof_wake, wake_start);
+}
+
+// The rover's forwarding task wakes at a pipeline deadline or once the UART
+// has room for the frame at the head of the TX queue, the navigation task on
+// UART data. Radio packets wake the forwarding task in radio_send()
+static void rover_task_wakes(size_t *pos, size_t due) {
+    size_t need;
+    int64_t next = rover_pipeline_next_us(&need);
+    if (sim_now >= next || (need && uart_tx_room_now() >= need) || sim_now - rover_sched.last_wake_us >= IDLE_WAKE_US) {
+        PROF_START(wake_start);
+        wake(&rover_sched);
+        rover_forward();
+        PROF_STOP(prof_wake, wake_start);
+    }
+    if (uart_rx_event(&rover_sched, due, *pos, STEP_US)) {
+        PROF_START(wake_start);
+        wake(&rover_sched);
+        rover_gnss(pos, due);
+        PROF_STOP(prof_wake, wake_start);
+    }
+}
+
+// Drive the base (and, when connected, the rover) over the captures, as
+// tasks or as a loop polling every poll MS (see the top of the file)
+static void run_ticks(int pace, int64_t poll, int64_t step_us) {
+    size_t base_pos = 0, rover_pos = 0;
+    base_pace.idx = rover_pace.idx = 0;
+    memset(&base_sched, 0, sizeof(base_sched));
+    memset(&rover_sched, 0, sizeof(rover_sched));
+    radio_queue.len = 0;
+    poll_us = poll;
+    uart_rx_full = rx_full_threshold();
+    uint64_t start_ns = host_now_ns();
+    int64_t end_us = 0;
+    for (sim_now = 0;; sim_now += step_us) {
+        uint32_t wakes = base_sched.wakes + rover_sched.wakes;
+        size_t due = bytes_due(&base_pace, sim_now, base_in.len);
+        int rx = uart_rx_event(&base_sched, due, base_pos, step_us);
+        if (poll_us ? sim_now % poll_us == 0
+                         : rx || sim_now >= base_pipeline_next_us() || sim_now - base_sched.last_wake_us >= IDLE_WAKE_US) {
+            base_wake(&base_pos, due);
+        }
+
+        if (connect_rover) {
+            due = bytes_due(&rover_pace, sim_now, rover_in.len);
+            if (!poll_us) {
+                rover_task_wakes(&rover_pos, due);
+            } else {
+                uart_rx_event(&rover_sched, due, rover_pos, step_us);
+                if (sim_now % poll_us == poll_us / 2) rover_poll_wake(&rover_pos, due);
+            }
+        }
+        // The device's writer task gets the CPU once the pipeline sleeps
+        if (rawlog_on && base_sched.wakes + rover_sched.wakes != wakes) raw_log_service(&rawlog);
+
+        if (base_pos == base_in.len && rover_pos == (connect_rover ? rover_in.len : 0)) {
+            if (end_us == 0) end_us = sim_now;
+            if (sim_now - end_us >= DRAIN_US) break;
+        }
+        if (pace) host_sleep_until_ns(start_ns + (uint64_t)sim_now * 1000u);
+    }
+}
+
+static void reserve_outputs(void) {
+    // Generous enough that timed runs never reallocate (and skew alloc counts)
+    size_t pkt_room = base_in.len * 2 + 64 * 1024;
+    host_buf_reserve(&packets, pkt_room * 2);
+    host_buf_reserve(&radio_queue, 64 * 1024);
+    host_buf_reserve(&sched_out, base_in.len + 64 * 1024);
+    host_buf_reserve(&rover_out, base_in.len + 64 * 1024);
+}
+
+static stage_result_t bench_framer(void) {
+    stage_result_t r = { "rtcm framer", UINT64_MAX, base_in.len, 0 };
+    for (int i = 0; i < opts.repeat; i++) {
+        rtcm3_framer_t f;
+        uint32_t frames = 0;
+        rtcm3_framer_init(&f);
+        uint64_t a0 = host_alloc_count();
+        uint64_t t0 = host_now_ns();
+        for (size_t pos = 0; pos < base_in.len; pos += UART_CHUNK) {
+            size_t n = base_in.len - pos > UART_CHUNK ? UART_CHUNK : base_in.len - pos;
+            rtcm3_framer_feed(&f, base_in.data + pos, n, count_frame, &frames);
+        }
+        uint64_t dt = host_now_ns() - t0;
+        r.allocs = host_alloc_count() - a0;
+        if (dt < r.best_ns) r.best_ns = dt;
+    }
+    return r;
+}
+
+static stage_result_t bench_base(void) {
+    stage_result_t r = { "base pipeline", UINT64_MAX, base_in.len, 0 };
+    connect_rover = 0;
+    for (int i = 0; i < opts.repeat; i++) {
+        packets.len = 0;
+        sched_out.len = 0;
+        radio_sent = 0;
+        setup_base();
+        uint64_t a0 = host_alloc_count();
+        uint64_t t0 = host_now_ns();
+        // Polled coarsely so that the simulation's own stepping hardly counts
+        run_ticks(0, BENCH_POLL_US, BENCH_POLL_US);
+        uint64_t dt = host_now_ns() - t0;
+        r.allocs = host_alloc_count() - a0;
+        if (dt < r.best_ns) r.best_ns = dt;
+    }
+    return r;
+}
+
+static stage_result_t bench_rover_link(void) {
+    stage_result_t r = { "rover link", UINT64_MAX, 0, 0 };
+    for (int i = 0; i < opts.repeat; i++) {
+        rover_out.len = 0;
+        setup_rover(0);
+        size_t pkt_bytes = 0;
+        int64_t t = 0;
+        uint64_t a0 = host_alloc_count();
+        uint64_t t0 = host_now_ns();
+        for (size_t pos = 0; pos < packets.len;) {
+            uint16_t n;
+            memcpy(&t, packets.data + pos, sizeof(t));
+            memcpy(&n, packets.data + pos + sizeof(t), sizeof(n));
+            pos += sizeof(t) + sizeof(n);
+            rover_pipeline_input(rover_path[0], packets.data + pos, n, t);
+            pos += n;
+            pkt_bytes += n;
+        }
+        rover_pipeline_poll(t + DRAIN_US);
+        uint64_t dt = host_now_ns() - t0;
+        r.allocs = host_alloc_count() - a0;
+        r.bytes = pkt_bytes;
+        if (dt < r.best_ns) r.best_ns = dt;
+    }
+    return r;
+}
+
+static stage_result_t bench_rover_gnss(void) {
+    stage_result_t r = { "rover nmea/ubx", UINT64_MAX, rover_in.len, 0 };
+    for (int i = 0; i < opts.repeat && rover_in.len; i++) {
+        setup_rover(0);
+        uint64_t a0 = host_alloc_count();
+        uint64_t t0 = host_now_ns();
+        for (size_t pos = 0; pos < rover_in.len; pos += UART_CHUNK) {
+            size_t n = rover_in.len - pos > UART_CHUNK ? UART_CHUNK : rover_in.len - pos;
+            rover_pipeline_feed_gnss(rover_in.data + pos, n, 0);
+        }
+        uint64_t dt = host_now_ns() - t0;
+        r.allocs = host_alloc_count() - a0;
+        if (dt < r.best_ns) r.best_ns = dt;
+    }
+    return r;
+}
+
+static void print_stage(const stage_result_t *r) {
+    if (r->bytes == 0 || r->best_ns == UINT64_MAX) {
+        printf("  %-16s no input\n", r->name);
+        return;
+    }
+    printf("  %-16s %9zu B  %8.2f ns/B  %8.1f MB/s  allocs %llu\n", r->name, r->bytes,
+           (double)r->best_ns / r->bytes, r->bytes * 1000.0 / r->best_ns,
+           (unsigned long long)r->allocs);
+}
+
+// Index of the first differing byte, or -1 when equal
+static long first_diff(const host_buf_t *a, const uint8_t *b, size_t b_len) {
+    size_t n = a->len < b_len ? a->len : b_len;
+    for (size_t i = 0; i < n; i++) {
+        if (a->data[i] != b[i]) return (long)i;
+    }
+    return a->len == b_len ? -1 : (long)n;
+}
+
+static void parse_loss(const char *arg) {
+    char *end;
+    int last = 0;
+    for (int i = 0; i < LINK_BOND_MAX_PATHS; i++) {
+        if (*arg) {
+            last = (int)strtol(arg, &end, 10);
+            arg = *end == ',' ? end + 1 : end;
+        }
+        opts.loss_pct[i] = last;
+    }
+}
+
+static int parse_args(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        int has_val = i + 1 < argc;
+        if (strcmp(a, "-r") == 0 && has_val) opts.rover_path = argv[++i];
+        else if (strcmp(a, "--realtime") == 0) opts.realtime = 1;
+        else if (strcmp(a, "--baud") == 0 && has_val) opts.baud = atoi(argv[++i]);
+        else if (strcmp(a, "--budget") == 0 && has_val) opts.budget_bps = atoi(argv[++i]);
+        else if (strcmp(a, "--loss") == 0 && has_val) parse_loss(argv[++i]);
+        else if (strcmp(a, "--paths") == 0 && has_val) opts.paths = atoi(argv[++i]);
+        else if (strcmp(a, "--delta") == 0 && has_val) opts.delta = atoi(argv[++i]) + 1;
+        else if (strcmp(a, "--seed") == 0 && has_val) opts.seed = (uint32_t)strtoul(argv[++i], NULL, 0);
+        else if (strcmp(a, "--repeat") == 0 && has_val) opts.repeat = atoi(argv[++i]);
+        else if (strcmp(a, "--out") == 0 && has_val) opts.out_path = argv[++i];
+        else if (strcmp(a, "--expect") == 0 && has_val) opts.expect_path = argv[++i];
+        else if (strcmp(a, "--deadline") == 0 && has_val) opts.deadline_us = (uint32_t)atoi(argv[++i]) * 1000;
+        else if (strcmp(a, "--rawlog") == 0 && has_val) opts.rawlog_path = argv[++i];
+        else if (strcmp(a, "--poll") == 0 && has_val) opts.poll_us = (int64_t)atoi(argv[++i]) * 1000;
+        else if (a[0] != '-' && !opts.base_path) opts.base_path = a;
+        else return -1;
+    }
+    if (opts.repeat < 1) opts.repeat = 1;
+    if (opts.paths < 1 || opts.paths > LINK_BOND_MAX_PATHS || opts.delta < 0 || opts.poll_us < 0) return -1;
+    return (opts.base_path && opts.baud > 0) ? 0 : -1;
+}
+
+int main(int argc, char **argv) {
+    if (parse_args(argc, argv) != 0) {
+        fprintf(stderr, "usage: %s [-r ROVER_CAPTURE] [--realtime] [--baud N] [--budget BPS] [--loss PCT[,PCT..]]\n"
+                        "       [--paths N] [--delta N] [--seed N] [--repeat N] [--out FILE] [--expect FILE]\n"
+                        "       [--rawlog FILE] [--poll MS] BASE_CAPTURE\n", argv[0]);
+        return 2;
+    }
+    if (host_buf_load(&base_in, opts.base_path) != 0) {
+        fprintf(stderr, "cannot read %s\n", opts.base_path);
+        return 2;
+    }
+    if (opts.rover_path && host_buf_load(&rover_in, opts.rover_path) != 0) {
+        fprintf(stderr, "cannot read %s\n", opts.rover_path);
+        return 2;
+    }
+    reserve_outputs();
+    build_pacing();
+    prof_init(1000);
+    PROF_REGISTER_STAGE(prof_wake, "wake");
+    PROF_REGISTER_STAGE(prof_base_feed, "base feed");
+    PROF_REGISTER_STAGE(prof_base_poll, "base poll");
+    PROF_REGISTER_STAGE(prof_rover_input, "rover input");
+    PROF_REGISTER_STAGE(prof_rover_poll, "rover poll");
+    PROF_REGISTER_STAGE(prof_rover_gnss, "rover gnss");
+    PROF_REGISTER_STAGE(prof_telemetry, "telemetry");
+    PROF_REGISTER_STAGE(prof_rawlog, "raw log");
+    PROF_REGISTER_DEPTH(prof_pool, "pkt pool", PKT_POOL_BLOCKS);
+    if (opts.rawlog_path && setup_rawlog() != 0) {
+        fprintf(stderr, "cannot mount the raw log in %s\n", opts.rawlog_path);
+        return 2;
+    }
+
+    printf("base capture %zu B (%zu epochs), rover capture %zu B (%zu epochs), %d baud, budget %d B/s\n",
+           base_in.len, base_pace.count, rover_in.len, rover_pace.count, (int)opts.baud, (int)opts.budget_bps);
+
+    // Stage benchmarks (max speed, no loss)
+    stage_result_t stages[4];
+    stages[0] = bench_framer();
+    stages[1] = bench_base();
+    stages[2] = bench_rover_link();
+    stages[3] = bench_rover_gnss();
+    printf("stages (best of %d):\n", opts.repeat);
+    for (int i = 0; i < 4; i++) print_stage(&stages[i]);
+
+    // End to end: base -> radio (with optional loss) -> rover
+    connect_rover = 1;
+    rng = opts.seed;
+    radio_sent = 0;
+    memset(radio_dropped, 0, sizeof(radio_dropped));
+    sched_out.len = 0;
+    rover_out.len = 0;
+    setup_base();
+    setup_rover(1);
+    rawlog_on = opts.rawlog_path != NULL;
+    prof_reset();
+    uint64_t a0 = host_alloc_count();
+    uint64_t t0 = host_now_ns();
+    run_ticks(opts.realtime, opts.poll_us, STEP_US);
+    uint64_t wall_ns = host_now_ns() - t0;
+    uint64_t allocs = host_alloc_count() - a0;
+    if (rawlog_on) {
+        raw_log_flush(&rawlog);
+        raw_log_service(&rawlog);
+        rawlog_on = 0;
+    }
+
+    const base_pipeline_t *bp = base_pipeline_state();
+    const rover_pipeline_t *rp = rover_pipeline_state();
+    const rover_source_t *src = rover_pipeline_source();
+    double wall_s = wall_ns / 1e9;
+    printf("end to end (%s): %.3f s wall, %.3f s simulated, %.0f B/s in, allocs %llu\n",
+           opts.realtime ? "real time" : "max speed", wall_s, sim_now / 1e6,
+           wall_s > 0 ? base_in.len / wall_s : 0.0, (unsigned long long)allocs);
+    printf("  base: %u frames (crc err %u), %u epochs, %u over budget, %u packets, %u parity\n",
+           (unsigned)bp->framer.frames, (unsigned)bp->framer.crc_errors, (unsigned)bp->sched.epochs,
+           (unsigned)bp->sched.over_budget, (unsigned)bp->packetizer.packets, (unsigned)bp->fec.parity_packets);
+    if (bp->delta_on) {
+        printf("  delta codec: %u B -> %u B (%.1f%%), %u delta, %u key frames\n", (unsigned)bp->delta.bytes_in,
+               (unsigned)bp->delta.bytes_out, bp->delta.bytes_in ? 100.0 * bp->delta.bytes_out / bp->delta.bytes_in : 0.0,
+               (unsigned)bp->delta.coded, (unsigned)bp->delta.keys);
+    }
+    printf("  scheduling: %s\n", opts.poll_us ? "polling loop" : "event-driven tasks");
+    const side_sched_t *sides[2] = { &base_sched, &rover_sched };
+    for (int i = 0; i < 2; i++) {
+        printf("  %s: %.1f wakeups/s, UART bytes wait avg %.2f ms, max %.2f ms\n", i ? "rover" : "base",
+               sides[i]->wakes / (sim_now / 1e6),
+               sides[i]->bytes ? (double)sides[i]->byte_wait_us / sides[i]->bytes / 1000.0 : 0.0,
+               sides[i]->wait_max_us / 1000.0);
+    }
+    printf("  link clock: %s\n", link_clock_has_gps(sim_now) ? "GPS time" : "free running");
+    printf("  radio: %u sent\n", (unsigned)radio_sent);
+    for (int i = 0; i < opts.paths; i++) {
+        const link_bond_rx_path_t *p = &src->bond.paths[rover_path[i]];
+        printf("  %s: %u dropped, %u received, %u first, %u duplicate, delivery %u.%u%%\n", p->name,
+               (unsigned)radio_dropped[i], (unsigned)p->received, (unsigned)p->first, (unsigned)p->duplicates,
+               p->delivery_permille / 10, p->delivery_permille % 10);
+    }
+    printf("  rover: FEC recovered %u unrecoverable %u, depacketizer lost %u frag dropped %u\n",
+           (unsigned)src->fec.recovered, (unsigned)src->fec.unrecoverable,
+           (unsigned)src->depacketizer.lost, (unsigned)src->depacketizer.frag_dropped);
+    const rtcm_txq_stats_t *tq = &rp->txq.stats;
+    printf("  rover jitter buffer: %u reordered, %u late, %u duplicate, %u corrupted\n",
+           (unsigned)src->fec.reordered, (unsigned)src->fec.late, (unsigned)src->fec.duplicates, (unsigned)rp->corrupted);
+    printf("  rover UART: %u runs in %u writes, %u deferred (wait max %.1f ms, queue max %u B), "
+           "%u stale, %u overflow\n", (unsigned)tq->runs, (unsigned)tq->writes, (unsigned)tq->deferred,
+           tq->wait_max_us / 1000.0, tq->queued_high_water, (unsigned)tq->stale, (unsigned)tq->overflow);
+    pkt_pool_stats_t pool;
+    pkt_pool_get_stats(&pool);
+    printf("  packet pool: %u blocks, high-water %u, %u in use after drain, exhausted %u\n", PKT_POOL_BLOCKS,
+           (unsigned)pool.high_water, (unsigned)pool.in_use, (unsigned)pool.exhausted);
+    if (src->delta.coded || src->delta.missing_ref || src->delta.errors) {
+        printf("  rover delta: %u rebuilt, %u missing reference, %u errors\n", (unsigned)src->delta.coded,
+               (unsigned)src->delta.missing_ref, (unsigned)src->delta.errors);
+    }
+    if (rover_in.len) {
+        printf("  rover receiver: %u GGA, %u NAV-PVT decoded\n", (unsigned)rp->gga_count, (unsigned)rp->pvt_count);
+        if (rp->have_baseline) {
+            const geo_enu_t *b = &rp->baseline;
+            printf("  baseline: %u epochs, last E %.3f N %.3f U %.3f m, %.3f m at %.1f deg from station %u\n",
+                   (unsigned)rp->baseline_count, b->east / 1000.0, b->north / 1000.0, b->up / 1000.0,
+                   geo_enu_distance(b) / 1000.0, geo_enu_bearing(b), rp->base_arp.station_id);
+        }
+        const telemetry_stats_t *ts = &telemetry.stats;
+        printf("  telemetry: %u records in %u messages (avg %.1f, max %u records), %u B, dropped %u\n",
+               (unsigned)ts->records, (unsigned)ts->messages, ts->messages ? (double)ts->sent / ts->messages : 0.0,
+               ts->max_batch, (unsigned)ts->bytes, (unsigned)ts->dropped);
+    }
+    if (opts.rawlog_path) {
+        const raw_log_stats_t *ls = &rawlog.stats;
+        printf("  raw log: boot %u, %u records, %u B in %u sectors, dropped %u (%u B), oversize %u, "
+               "buffers waiting max %u/%u, append max %.2f us\n",
+               (unsigned)rawlog.boot, (unsigned)ls->records, (unsigned)ls->bytes, (unsigned)ls->sectors,
+               (unsigned)ls->dropped, (unsigned)ls->dropped_bytes, (unsigned)ls->oversize, ls->sealed_high_water,
+               RAWLOG_BUFFERS, rawlog_append_max_ns / 1000.0);
+    }
+    prof_print("replay");
+    if (src->stats.samples) {
+        printf("  latency: avg %.2f ms, max %.2f ms, jitter %.2f ms\n",
+               (double)src->stats.lat_sum_us / src->stats.samples / 1000.0,
+               src->stats.lat_max_us / 1000.0, src->stats.jitter_us / 1000.0);
+    }
+
+    int rc = 0;
+    long diff = first_diff(&rover_out, sched_out.data, sched_out.len);
+    if (diff < 0) {
+        printf("output: %zu B, identical to scheduler output\n", rover_out.len);
+    } else if (opts.loss_pct[0] > 0) {
+        printf("output: %zu B, %zu B short of scheduler output after radio loss\n",
+               rover_out.len, sched_out.len - (rover_out.len < sched_out.len ? rover_out.len : sched_out.len));
+    } else {
+        printf("output: %zu B, differs from scheduler output (%zu B) at byte %ld\n",
+               rover_out.len, sched_out.len, diff);
+        rc = 1;
+    }
+    if (opts.expect_path) {
+        host_buf_t expect = {0};
+        if (host_buf_load(&expect, opts.expect_path) != 0) {
+            fprintf(stderr, "cannot read %s\n", opts.expect_path);
+            return 2;
+        }
+        diff = first_diff(&rover_out, expect.data, expect.len);
+        if (diff < 0) printf("output matches %s\n", opts.expect_path);
+        else {
+            printf("output differs from %s at byte %ld\n", opts.expect_path, diff);
+            rc = 1;
+        }
+        host_buf_free(&expect);
+    }
+    if (opts.rawlog_path && host_buf_save(&flash_img, opts.rawlog_path) != 0) {
+        fprintf(stderr, "cannot write %s\n", opts.rawlog_path);
+        return 2;
+    }
+    if (opts.out_path && host_buf_save(&rover_out, opts.out_path) != 0) {
+        fprintf(stderr, "cannot write %s\n", opts.out_path);
+        return 2;
+    }
+    return rc;
+}
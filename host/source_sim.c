@@ -0,0 +1,339 @@
+// Rover base selection (main/rover_source.c) with two bases on one site.
+//
+//   source_sim [--scenario roam|fail|flap] [--seconds S] [--seed N]
+//     roam   the rover drives from base 1 to base 2, 600 m apart
+//     fail   the rover sits 200 m from base 1 and 400 m from base 2; base 1
+//            goes off the air a third of the way in
+//     flap   the rover sits 400 m off the road half way between the bases,
+//            both equally good and both losing packets
+//     --seconds S  run length (default roam 300, fail 120, flap 600)
+//
+// Each base sends a 1 Hz epoch of four MSM4 frames (GPS, GLONASS, Galileo,
+// BeiDou, the last without the multiple message flag), with 1005 and 1230
+// every tenth epoch, through its own packetizer and FEC encoder with its own
+// LINK_BASE_ID. Radio: log-distance path loss (exponent 2.7, 20 dBm) with
+// per-packet fading and a logistic packet error curve through 10% at
+// -97 dBm (1 Mbps), 2 ms of airtime per packet plus 3 ms in the stacks. The
+// rover runs the firmware pipeline unchanged, driven on a 1 ms clock, with a
+// GGA solution a second for the baseline and the RSSI of the packets it
+// heard, per base. Its output is checked frame by frame: an epoch with MSMs
+// of two stations, or MSMs of a station other than the one of the last 1005
+// the receiver had, is a failure.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "rover_pipeline.h"
+#include "rtcm_msm.h"
+
+#define SIM_BASES         2
+#define SIM_TX_DBM        20.0
+#define SIM_PL0_DB        40.0
+#define SIM_PL_EXPONENT   2.7
+#define SIM_FADE_DB       4.0
+#define SIM_PER_SLOPE     1.0
+#define SIM_SENS_DBM      (-97.0)
+#define SIM_LAT_DEG       52.0
+#define SIM_LON_DEG       5.0
+#define SIM_SPACING_M     600.0
+#define SIM_MSM_BYTES     180     // body of each synthetic MSM
+#define SIM_AIRTIME_US    2000    // a full packet at 1 Mbps with preamble and ack
+#define SIM_STACK_US      3000    // queueing and Wi-Fi stack on both ends
+#define SIM_IN_FLIGHT     256
+#define SIM_ROW_S         10
+
+typedef struct {
+    uint8_t id;
+    uint16_t station;
+    double east_m;                // along the road from base 1
+    int64_t x, y, z;              // ECEF, 0.1 mm
+    int on;
+    int64_t offset_us;            // epoch output after the second
+    int64_t air_free_us;          // end of its last transmission
+    double heard_dbm;             // rover's average RSSI of its packets, 0 = none yet
+    link_packetizer_t packetizer;
+    link_fec_encoder_t fec;
+} sim_base_t;
+
+typedef struct {
+    int64_t at_us;
+    sim_base_t *from;
+    double rssi;
+    uint8_t len;
+    uint8_t pkt[LINK_MAX_PACKET];
+} sim_flight_t;
+
+static sim_base_t bases[SIM_BASES];
+static sim_base_t *sending;
+static sim_flight_t flights[SIM_IN_FLIGHT];
+static int64_t now_us;
+static double rover_east_m;
+static double rover_north_m;
+static uint64_t rng;
+static int path;
+
+// Receiver side checks
+static uint16_t epoch_station;    // station of the open epoch, 0 = between epochs
+static uint16_t known_station;    // last 1005 written
+static uint32_t mixed;
+static uint32_t unknown;
+static uint32_t epochs_out[SIM_BASES];
+static int64_t last_epoch_out_us;
+static int64_t longest_gap_us;
+
+static double uniform(void) {
+    // xorshift64*
+    rng ^= rng >> 12;
+    rng ^= rng << 25;
+    rng ^= rng >> 27;
+    return ((rng * 2685821657736338717ULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double gaussian(void) {
+    double u = uniform(), v = uniform();
+    return sqrt(-2.0 * log(u + 1e-300)) * cos(2.0 * M_PI * v);
+}
+
+static double lon_at(double east_m) {
+    return SIM_LON_DEG + east_m / (111320.0 * cos(SIM_LAT_DEG * M_PI / 180.0));
+}
+
+static void to_ecef(double lat_deg, double lon_deg, double h, int64_t *x, int64_t *y, int64_t *z) {
+    const double a = 6378137.0, e2 = 6.69437999014e-3;
+    double lat = lat_deg * M_PI / 180.0, lon = lon_deg * M_PI / 180.0;
+    double n = a / sqrt(1.0 - e2 * sin(lat) * sin(lat));
+    *x = llround((n + h) * cos(lat) * cos(lon) * 10000.0);
+    *y = llround((n + h) * cos(lat) * sin(lon) * 10000.0);
+    *z = llround((n * (1.0 - e2) + h) * sin(lat) * 10000.0);
+}
+
+static double mean_rssi(const sim_base_t *b) {
+    double d = hypot(rover_east_m - b->east_m, rover_north_m);
+    if (d < 1.0) d = 1.0;
+    return SIM_TX_DBM - SIM_PL0_DB - 10.0 * SIM_PL_EXPONENT * log10(d);
+}
+
+static int8_t rover_rssi(uint8_t source) {
+    for (int i = 0; i < SIM_BASES; i++) {
+        if (bases[i].id == source && bases[i].heard_dbm) return (int8_t)lround(fmax(bases[i].heard_dbm, -127.0));
+    }
+    return ROVER_SOURCE_RSSI_NONE;
+}
+
+static void radio_send(const uint8_t *pkt, size_t len) {
+    // One packet on the air at a time per base, in order
+    int64_t start = now_us > sending->air_free_us ? now_us : sending->air_free_us;
+    sending->air_free_us = start + SIM_AIRTIME_US;
+    double rssi = mean_rssi(sending) + SIM_FADE_DB * gaussian();
+    double per = 1.0 / (1.0 + 9.0 * exp(SIM_PER_SLOPE * (rssi - SIM_SENS_DBM)));
+    if (uniform() < per) return;
+    for (int i = 0; i < SIM_IN_FLIGHT; i++) {
+        sim_flight_t *f = &flights[i];
+        if (f->len) continue;
+        f->at_us = sending->air_free_us + SIM_STACK_US;
+        f->from = sending;
+        f->rssi = rssi;
+        f->len = (uint8_t)len;
+        memcpy(f->pkt, pkt, len);
+        return;
+    }
+}
+
+static void fec_send(const uint8_t *pkt, size_t len) {
+    link_fec_encode(&sending->fec, pkt, len, now_us);
+}
+
+static void add_frame(sim_base_t *b, uint8_t *f, size_t payload_len) {
+    size_t len = rtcm3_finish_frame(f, payload_len);
+    link_packetizer_add_frame(&b->packetizer, f, len, now_us);
+}
+
+static void send_epoch(sim_base_t *b, uint32_t epoch) {
+    uint8_t f[RTCM3_MAX_FRAME];
+    uint8_t *p = f + RTCM3_HEADER_LEN;
+    sending = b;
+    if (epoch % 10 == 0) {
+        memset(f, 0, sizeof(f));
+        rtcm3_set_bits(p, 0, 12, 1005);
+        rtcm3_set_bits(p, 12, 12, b->station);
+        const int64_t v[3] = { b->x, b->y, b->z };
+        for (int i = 0; i < 3; i++) {
+            rtcm3_set_bits(p, 34 + 40 * i, 6, (uint32_t)((uint64_t)v[i] >> 32) & 0x3F);
+            rtcm3_set_bits(p, 40 + 40 * i, 32, (uint32_t)v[i]);
+        }
+        add_frame(b, f, 19);
+        memset(f, 0, sizeof(f));
+        rtcm3_set_bits(p, 0, 12, 1230);
+        rtcm3_set_bits(p, 12, 12, b->station);
+        add_frame(b, f, 4);
+    }
+    static const uint16_t types[] = { 1074, 1084, 1094, 1124 };
+    for (int t = 0; t < 4; t++) {
+        memset(f, 0, sizeof(f));
+        rtcm3_set_bits(p, 0, 12, types[t]);
+        rtcm3_set_bits(p, 12, 12, b->station);
+        rtcm3_set_bits(p, 24, 30, epoch * 1000);
+        rtcm3_set_bits(p, 54, 1, t < 3);
+        // Empty satellite and signal masks, then filler the receiver never reads
+        for (size_t i = 22; i < 22 + SIM_MSM_BYTES; i++) p[i] = (uint8_t)(uniform() * 256);
+        add_frame(b, f, 22 + SIM_MSM_BYTES);
+    }
+    link_packetizer_flush(&b->packetizer);
+}
+
+static int base_index(uint16_t station) {
+    for (int i = 0; i < SIM_BASES; i++) {
+        if (bases[i].station == station) return i;
+    }
+    return -1;
+}
+
+// The receiver UART: whole frames only
+static void gnss_write(const uint8_t *data, size_t len) {
+    size_t pos = 0;
+    while (len - pos >= RTCM3_HEADER_LEN + RTCM3_CRC_LEN) {
+        size_t flen = RTCM3_HEADER_LEN + rtcm3_payload_len(data + pos) + RTCM3_CRC_LEN;
+        const uint8_t *p = data + pos + RTCM3_HEADER_LEN;
+        uint16_t type = rtcm3_msg_type(data + pos, flen);
+        uint16_t station = (uint16_t)rtcm3_get_bits(p, 12, 12);
+        if (type == 1005) known_station = station;
+        if (rtcm_msm_level(type)) {
+            // Before the first 1005 the receiver just waits, as with one base
+            if (known_station && station != known_station) unknown++;
+            if (epoch_station && epoch_station != station) mixed++;
+            epoch_station = station;
+            if (!rtcm3_get_bits(p, 54, 1)) {
+                epoch_station = 0;
+                int b = base_index(station);
+                if (b >= 0) epochs_out[b]++;
+                if (last_epoch_out_us && now_us - last_epoch_out_us > longest_gap_us) {
+                    longest_gap_us = now_us - last_epoch_out_us;
+                }
+                last_epoch_out_us = now_us;
+            }
+        }
+        pos += flen;
+    }
+}
+
+static void feed_gga(void) {
+    double lat = SIM_LAT_DEG + rover_north_m / 111320.0, lon = lon_at(rover_east_m);
+    double lat_min = fmod(lat, 1.0) * 60.0, lon_min = fmod(lon, 1.0) * 60.0;
+    char body[160], line[192];
+    snprintf(body, sizeof(body), "GPGGA,%02d%02d%02d.00,%02d%011.8f,N,%03d%011.8f,E,4,12,0.5,0.000,M,47.000,M,1.0,0100",
+             (int)(now_us / 3600000000LL) % 24, (int)(now_us / 60000000) % 60, (int)(now_us / 1000000) % 60,
+             (int)lat, lat_min, (int)lon, lon_min);
+    uint8_t sum = 0;
+    for (const char *c = body; *c; c++) sum ^= (uint8_t)*c;
+    int n = snprintf(line, sizeof(line), "$%s*%02X\r\n", body, sum);
+    rover_pipeline_feed_gnss((const uint8_t *)line, (size_t)n, now_us);
+}
+
+static void print_row(int64_t t_us, const uint32_t *epochs_before) {
+    const rover_pipeline_t *rp = rover_pipeline_state();
+    printf("%5.0f %6.0f", t_us / 1e6, rover_east_m);
+    for (int b = 0; b < SIM_BASES; b++) {
+        const rover_source_t *s = NULL;
+        for (int i = 0; i < ROVER_SOURCES; i++) {
+            if (rp->sources[i].used && rp->sources[i].id == bases[b].id) s = &rp->sources[i];
+        }
+        if (!s) {
+            printf("  %28s", "-");
+            continue;
+        }
+        char cost[12] = "-";
+        if (s->cost != ROVER_SOURCE_UNUSABLE) snprintf(cost, sizeof(cost), "%ld", (long)s->cost);
+        printf("  %5.1f%% %4d %5.0f m %5s %3u", s->loss_permille / 10.0, s->rssi,
+               s->have_baseline ? geo_enu_distance(&s->baseline) / 1000.0 : -1.0, cost,
+               (unsigned)(epochs_out[b] - epochs_before[b]));
+    }
+    printf("   %u\n", rp->source ? rp->source->id : 0);
+}
+
+int main(int argc, char **argv) {
+    const char *scenario = "roam";
+    int seconds = 0;
+    uint64_t seed = 1;
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i];
+        int has_val = i + 1 < argc;
+        if (strcmp(a, "--scenario") == 0 && has_val) scenario = argv[++i];
+        else if (strcmp(a, "--seconds") == 0 && has_val) seconds = atoi(argv[++i]);
+        else if (strcmp(a, "--seed") == 0 && has_val) seed = strtoull(argv[++i], NULL, 0);
+        else {
+            fprintf(stderr, "usage: %s [--scenario roam|fail|flap] [--seconds S] [--seed N]\n", argv[0]);
+            return 2;
+        }
+    }
+    int roam = strcmp(scenario, "roam") == 0, fail = strcmp(scenario, "fail") == 0;
+    if (!roam && !fail && strcmp(scenario, "flap") != 0) {
+        fprintf(stderr, "unknown scenario %s\n", scenario);
+        return 2;
+    }
+    if (!seconds) seconds = roam ? 300 : fail ? 120 : 600;
+    rng = seed * 0x9E3779B97F4A7C15ULL + 1;
+
+    for (int b = 0; b < SIM_BASES; b++) {
+        sim_base_t *s = &bases[b];
+        s->id = (uint8_t)(b + 1);
+        s->station = (uint16_t)(100 * (b + 1));
+        s->east_m = b * SIM_SPACING_M;
+        s->on = 1;
+        s->offset_us = 20000 + 15000 * b;
+        to_ecef(SIM_LAT_DEG, lon_at(s->east_m), 47.0, &s->x, &s->y, &s->z);
+        link_fec_encoder_init(&s->fec, LINK_FEC_GROUP_SIZE, 0, radio_send);
+        s->fec.source = s->id;
+        link_packetizer_init(&s->packetizer, fec_send, 0);
+        s->packetizer.source = s->id;
+    }
+    rover_pipeline_init(gnss_write, NULL, NULL);
+    path = rover_pipeline_add_path("espnow");
+    rover_pipeline_set_source_rssi(rover_rssi);
+
+    printf("%s, %d s, bases %.0f m apart, hold %d s, hysteresis %d points\n", scenario, seconds, SIM_SPACING_M,
+           ROVER_SOURCE_HOLD_US / 1000000, ROVER_SOURCE_HYSTERESIS);
+    printf("%5s %6s  %-28s  %-28s  %s\n", "t s", "east", "base 1: loss rssi base cost ep", "base 2: loss rssi base cost ep",
+           "active");
+    uint32_t row_epochs[SIM_BASES] = { 0 };
+    int64_t end_us = (int64_t)seconds * 1000000;
+    for (now_us = 0; now_us <= end_us; now_us += 1000) {
+        if (roam) rover_east_m = SIM_SPACING_M * now_us / end_us;
+        else if (fail) rover_east_m = SIM_SPACING_M / 3;
+        else {
+            rover_east_m = SIM_SPACING_M / 2;
+            rover_north_m = 400.0;
+        }
+        if (fail && now_us == end_us / 3 / 1000000 * 1000000) bases[0].on = 0;
+
+        int64_t in_second = now_us % 1000000;
+        for (int b = 0; b < SIM_BASES; b++) {
+            sim_base_t *s = &bases[b];
+            sending = s;
+            if (s->on && in_second == s->offset_us) send_epoch(s, (uint32_t)(now_us / 1000000));
+            link_packetizer_poll(&s->packetizer, now_us);
+            link_fec_encoder_poll(&s->fec, now_us);
+        }
+        for (int i = 0; i < SIM_IN_FLIGHT; i++) {
+            sim_flight_t *f = &flights[i];
+            if (!f->len || f->at_us > now_us) continue;
+            // Averaged over 16 packets like rover_espnow_source_rssi()
+            sim_base_t *b = f->from;
+            b->heard_dbm = b->heard_dbm ? b->heard_dbm + (f->rssi - b->heard_dbm) / 16.0 : f->rssi;
+            rover_pipeline_input(path, f->pkt, f->len, now_us);
+            f->len = 0;
+        }
+        rover_pipeline_poll(now_us);
+        if (in_second == 500000) feed_gga();
+        if (now_us && now_us % (SIM_ROW_S * 1000000LL) == 0) {
+            print_row(now_us, row_epochs);
+            memcpy(row_epochs, epochs_out, sizeof(row_epochs));
+        }
+    }
+
+    const rover_pipeline_t *rp = rover_pipeline_state();
+    printf("epochs written: base 1 %u, base 2 %u; switches %u; longest gap between epochs %.1f s\n",
+           (unsigned)epochs_out[0], (unsigned)epochs_out[1], (unsigned)rp->source_changes, longest_gap_us / 1e6);
+    printf("mixed epochs %u, MSMs without their base position %u\n", (unsigned)mixed, (unsigned)unknown);
+    return mixed || unknown ? 1 : 0;
+}
@@ -0,0 +1,103 @@
+#include "base_pipeline.h"
+#include "link_clock.h"
+#include <string.h>
+
+// Single instance: the link callbacks carry no context pointer
+static base_pipeline_t bp;
+
+static void on_packet(const uint8_t *pkt, size_t len) {
+    link_fec_encode(&bp.fec, pkt, len, bp.now_us);
+}
+
+static void on_scheduled_frame(const uint8_t *frame, size_t len, void *ctx) {
+    if (bp.tap) bp.tap(frame, len, bp.tap_ctx);
+    const uint8_t *out = frame;
+    size_t n = len;
+    if (bp.delta_on) {
+        n = rtcm_delta_encode(&bp.delta, frame, len, bp.delta_buf, &out);
+        // The budget is charged with what actually goes on the link
+        rtcm_sched_set_link_len(&bp.sched, n);
+    }
+    // Stamp with the time the epoch came off the UART, not the release time
+    link_packetizer_add_frame(&bp.packetizer, out, n, bp.sched.epoch_start_us);
+}
+
+static void on_rtcm_frame(const uint8_t *frame, size_t len, void *ctx) {
+    if (bp.source_tap) bp.source_tap(frame, len, bp.source_tap_ctx);
+    // GPS and Galileo MSM epochs are time of week in ms: use them to put the
+    // link timestamps on GPS time
+    uint16_t type = rtcm3_msg_type(frame, len);
+    int gnss = rtcm_msm_gnss(type);
+    rtcm_msm_header_t h;
+    if ((gnss == RTCM_GNSS_GPS || gnss == RTCM_GNSS_GALILEO) &&
+        rtcm_msm_parse_header(frame + RTCM3_HEADER_LEN, rtcm3_payload_len(frame), &h) == 0) {
+        link_clock_discipline(h.epoch, bp.now_us - LINK_CLOCK_MSM_DELAY_US);
+    }
+    rtcm_sched_add_frame(&bp.sched, frame, len, bp.now_us);
+}
+
+void base_pipeline_init(const rtcm_sched_config_t *cfg, link_output_fn_t send) {
+    memset(&bp, 0, sizeof(bp));
+    rtcm3_framer_init(&bp.framer);
+    ubx_parser_init(&bp.ubx, NULL);
+    // The framer gets every byte itself (see base_pipeline_feed): only UBX comes from the demux
+    const gnss_demux_targets_t targets = { .ubx = &bp.ubx };
+    gnss_demux_init(&bp.demux, &targets);
+    rtcm_sched_init(&bp.sched, cfg, on_scheduled_frame, NULL);
+    link_fec_encoder_init(&bp.fec, LINK_FEC_GROUP_SIZE, LINK_FLUSH_TIMEOUT_US, send);
+    link_packetizer_init(&bp.packetizer, on_packet, LINK_FLUSH_TIMEOUT_US);
+}
+
+void base_pipeline_feed(const uint8_t *data, size_t len, int64_t now_us) {
+    bp.now_us = now_us;
+    // Only whole, CRC-valid RTCM3 frames are packed and sent. The framer sees
+    // the raw stream and resyncs on CRC; a demux misled by a length (B5 62
+    // inside a frame) would cost the corrections, not just a UBX message
+    rtcm3_framer_feed(&bp.framer, data, len, on_rtcm_frame, NULL);
+    gnss_demux_feed(&bp.demux, data, len);
+}
+
+void base_pipeline_poll(int64_t now_us) {
+    bp.now_us = now_us;
+    rtcm_sched_poll(&bp.sched, now_us);
+    link_packetizer_poll(&bp.packetizer, now_us);
+    link_fec_encoder_poll(&bp.fec, now_us);
+}
+
+int64_t base_pipeline_next_us(void) {
+    int64_t next = rtcm_sched_next_us(&bp.sched);
+    int64_t t = link_packetizer_next_us(&bp.packetizer);
+    if (t < next) next = t;
+    t = link_fec_encoder_next_us(&bp.fec);
+    return t < next ? t : next;
+}
+
+void base_pipeline_set_ubx_handlers(const ubx_handlers_t *handlers) {
+    ubx_parser_init(&bp.ubx, handlers);
+}
+
+void base_pipeline_set_tap(rtcm3_frame_cb_t tap, void *ctx) {
+    bp.tap = tap;
+    bp.tap_ctx = ctx;
+}
+
+void base_pipeline_set_delta(int enable, int key_interval) {
+    // Restarting from empty references makes the next frame of each type a key frame
+    rtcm_delta_init(&bp.delta, key_interval);
+    bp.delta_on = enable;
+}
+
+void base_pipeline_set_source(uint8_t id, uint8_t max_hops) {
+    uint8_t hops = LINK_HOPS_BYTE(0, max_hops);
+    bp.packetizer.source = bp.fec.source = id;
+    bp.packetizer.hops = bp.fec.hops = hops;
+}
+
+void base_pipeline_set_source_tap(rtcm3_frame_cb_t tap, void *ctx) {
+    bp.source_tap = tap;
+    bp.source_tap_ctx = ctx;
+}
+
+base_pipeline_t *base_pipeline_state(void) {
+    return &bp;
+}
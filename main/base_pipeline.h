@@ -0,0 +1,61 @@
+#ifndef BASE_PIPELINE_H
+#define BASE_PIPELINE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "rtcm3.h"
+#include "rtcm_sched.h"
+#include "link_packet.h"
+#include "link_fec.h"
+#include "rtcm_delta.h"
+#include "gnss_demux.h"
+
+// Base correction path: ZED-F9P UART bytes -> RTCM3 framer -> epoch
+// scheduler -> (MSM delta codec) -> link packetizer -> FEC encoder -> transport. No ESP-IDF
+// calls: the caller supplies the time and the send function, so the same
+// code runs on the device and in the host replay tool (host/). UBX messages
+// interleaved with the RTCM (survey-in status, ACKs) are picked out by a
+// gnss_demux alongside and go to optional handlers.
+
+typedef struct {
+    gnss_demux_t demux;
+    ubx_parser_t ubx;
+    rtcm3_framer_t framer;
+    rtcm_sched_t sched;
+    link_packetizer_t packetizer;
+    link_fec_encoder_t fec;
+    rtcm_delta_t delta;
+    int delta_on;
+    uint8_t delta_buf[RTCM3_MAX_FRAME];
+    int64_t now_us;
+    rtcm3_frame_cb_t tap;         // optional copy of every scheduled frame
+    void *tap_ctx;
+    rtcm3_frame_cb_t source_tap;  // optional copy of every frame from the receiver
+    void *source_tap_ctx;
+} base_pipeline_t;
+
+// cfg may be NULL for the scheduler defaults; send gets every radio packet
+void base_pipeline_init(const rtcm_sched_config_t *cfg, link_output_fn_t send);
+// Raw receiver UART bytes read at now_us
+void base_pipeline_feed(const uint8_t *data, size_t len, int64_t now_us);
+// Run the epoch, packet and parity timeouts
+void base_pipeline_poll(int64_t now_us);
+// Earliest time base_pipeline_poll() has work, INT64_MAX for none: a task can
+// sleep until then or until more bytes arrive
+int64_t base_pipeline_next_us(void);
+// UBX messages from the receiver; NULL to ignore them
+void base_pipeline_set_ubx_handlers(const ubx_handlers_t *handlers);
+// Observe the frames leaving the scheduler (replay equivalence checks)
+void base_pipeline_set_tap(rtcm3_frame_cb_t tap, void *ctx);
+// Observe every CRC-valid frame before scheduling (full-rate IP consumers)
+void base_pipeline_set_source_tap(rtcm3_frame_cb_t tap, void *ctx);
+// Code MSM frames against the previous epoch before packing (rtcm_delta.h);
+// key_interval 0 selects the default. The tap still sees the original frames
+void base_pipeline_set_delta(int enable, int key_interval);
+// Base id and relay allowance stamped on every data and parity packet
+// (link_hdr_t source and hops)
+void base_pipeline_set_source(uint8_t id, uint8_t max_hops);
+// Pipeline state for statistics and runtime settings
+base_pipeline_t *base_pipeline_state(void);
+
+#endif // BASE_PIPELINE_H
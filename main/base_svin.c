@@ -0,0 +1,281 @@
+#include "base_svin.h"
+#include <string.h>
+
+#define TMODE_MODE        0x20030001   // CFG-TMODE-MODE: 0 disabled, 1 survey-in, 2 fixed
+#define TMODE_POS_TYPE    0x20030002   // 0 ECEF
+#define TMODE_ECEF_X      0x40030003   // cm
+#define TMODE_ECEF_Y      0x40030004
+#define TMODE_ECEF_Z      0x40030005
+#define TMODE_ECEF_X_HP   0x20030006   // 0.1 mm
+#define TMODE_ECEF_Y_HP   0x20030007
+#define TMODE_ECEF_Z_HP   0x20030008
+#define TMODE_FIXED_ACC   0x4003000F   // 0.1 mm
+#define LAYER_RAM         0x01
+#define MAX_OFFSET        1000000000LL // 0.1 mm, past this an axis is not worth squaring
+
+_Static_assert(sizeof(base_svin_status_t) == 32, "survey status layout");
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static size_t add_key(uint8_t *p, uint32_t key, uint32_t value, size_t size) {
+    put_u32(p, key);
+    for (size_t b = 0; b < size; b++) p[4 + b] = (uint8_t)(value >> (8 * b));
+    return 4 + size;
+}
+
+// Split 0.1 mm into the cm field and the 0.1 mm remainder (-99..99) NAV-SVIN and CFG-TMODE use
+static void split(int64_t v, int32_t *cm, int8_t *hp) {
+    *cm = (int32_t)(v / 100);
+    *hp = (int8_t)(v % 100);
+}
+
+static void send(base_svin_t *s) {
+    s->cfg.write(s->tx, s->tx_len);
+    s->awaiting = 1;
+    s->sent_us = s->now_us;
+}
+
+// CFG-VALSET to RAM of the keys already written after the 4-byte header
+static void send_valset(base_svin_t *s, size_t len) {
+    uint8_t *t = s->tx;
+    t[0] = UBX_SYNC1;
+    t[1] = UBX_SYNC2;
+    t[2] = UBX_CLASS_CFG;
+    t[3] = UBX_CFG_VALSET;
+    t[4] = (uint8_t)len;
+    t[5] = (uint8_t)(len >> 8);
+    t[6] = 0;
+    t[7] = LAYER_RAM;
+    t[8] = t[9] = 0;
+    ubx_checksum(t + 2, len + 4, &t[UBX_HEADER_LEN + len], &t[UBX_HEADER_LEN + len + 1]);
+    s->tx_len = UBX_HEADER_LEN + len + UBX_CHECKSUM_LEN;
+    s->tries = 0;
+    send(s);
+}
+
+static void send_mode(base_svin_t *s, uint8_t mode) {
+    send_valset(s, 4 + add_key(s->tx + UBX_HEADER_LEN + 4, TMODE_MODE, mode, 1));
+}
+
+static void send_fixed(base_svin_t *s) {
+    uint8_t *p = s->tx + UBX_HEADER_LEN + 4;
+    const int64_t v[3] = { s->pos.x, s->pos.y, s->pos.z };
+    const uint32_t keys[3] = { TMODE_ECEF_X, TMODE_ECEF_Y, TMODE_ECEF_Z };
+    const uint32_t hp_keys[3] = { TMODE_ECEF_X_HP, TMODE_ECEF_Y_HP, TMODE_ECEF_Z_HP };
+    size_t len = add_key(p, TMODE_MODE, 2, 1);
+    len += add_key(p + len, TMODE_POS_TYPE, 0, 1);
+    for (int i = 0; i < 3; i++) {
+        int32_t cm;
+        int8_t hp;
+        split(v[i], &cm, &hp);
+        len += add_key(p + len, keys[i], (uint32_t)cm, 4);
+        len += add_key(p + len, hp_keys[i], (uint8_t)hp, 1);
+    }
+    len += add_key(p + len, TMODE_FIXED_ACC, s->pos.acc, 4);
+    s->state = BASE_SVIN_FIX;
+    send_valset(s, 4 + len);
+}
+
+static void mean_pos(const ubx_nav_svin_t *n, base_svin_pos_t *pos) {
+    pos->x = (int64_t)n->meanX * 100 + n->meanXHP;
+    pos->y = (int64_t)n->meanY * 100 + n->meanYHP;
+    pos->z = (int64_t)n->meanZ * 100 + n->meanZHP;
+    pos->acc = n->meanAcc;
+}
+
+static int64_t abs64(int64_t v) {
+    return v < 0 ? -v : v;
+}
+
+// Distance between the fresh mean and the stored position, 0.1 mm, saturated
+static uint32_t offset(const base_svin_pos_t *a, const base_svin_pos_t *b) {
+    int64_t d[3] = { a->x - b->x, a->y - b->y, a->z - b->z };
+    uint64_t sq = 0;
+    for (int i = 0; i < 3; i++) {
+        if (abs64(d[i]) > MAX_OFFSET) return UINT32_MAX;
+        sq += (uint64_t)(d[i] * d[i]);
+    }
+    // Integer square root, no FPU double on the ESP32
+    uint64_t r = 0, bit = (uint64_t)1 << 62;
+    while (bit > sq) bit >>= 2;
+    while (bit) {
+        if (sq >= r + bit) {
+            sq -= r + bit;
+            r = (r >> 1) + bit;
+        } else {
+            r >>= 1;
+        }
+        bit >>= 2;
+    }
+    return r > UINT32_MAX ? UINT32_MAX : (uint32_t)r;
+}
+
+static void settle(base_svin_t *s, base_svin_state_t state) {
+    s->state = state;
+    if (!s->settled_us) s->settled_us = s->now_us;
+}
+
+static void check(base_svin_t *s, const ubx_nav_svin_t *n) {
+    if (!n->active || n->dur < BASE_SVIN_CHECK_S) return;
+    if (n->meanAcc > BASE_SVIN_CHECK_ACC) {
+        // No usable fix in time: the full survey settles it
+        if (n->dur >= BASE_SVIN_CHECK_MAX_S) s->state = BASE_SVIN_SURVEY;
+        return;
+    }
+    base_svin_pos_t fresh;
+    mean_pos(n, &fresh);
+    s->check_offset = offset(&fresh, &s->pos);
+    uint64_t limit = (uint64_t)BASE_SVIN_MATCH_SIGMA * n->meanAcc + s->pos.acc;
+    if (limit < BASE_SVIN_MATCH_MIN) limit = BASE_SVIN_MATCH_MIN;
+    if (s->check_offset <= limit) {
+        send_fixed(s);
+        return;
+    }
+    s->flags |= BASE_SVIN_FLAG_MOVED;
+    s->have_pos = 0;
+    if (s->cfg.save) s->cfg.save(NULL, s->cfg.ctx);
+    s->state = BASE_SVIN_SURVEY;
+}
+
+void base_svin_init(base_svin_t *s, const base_svin_config_t *cfg, int64_t now_us) {
+    memset(s, 0, sizeof(*s));
+    s->cfg = *cfg;
+    s->now_us = s->start_us = now_us;
+    s->state = BASE_SVIN_SURVEY;
+    if (cfg->stored && cfg->write) {
+        s->pos = *cfg->stored;
+        s->have_pos = 1;
+        s->flags = BASE_SVIN_FLAG_STORED;
+        // Disabled then survey-in again: a fresh mean even if the receiver
+        // kept running through the reboot
+        s->state = BASE_SVIN_RESTART;
+        send_mode(s, 0);
+    }
+}
+
+void base_svin_on_nav(base_svin_t *s, const ubx_nav_svin_t *n) {
+    s->last = *n;
+    s->have_last = 1;
+    switch (s->state) {
+    case BASE_SVIN_SURVEY:
+        if (n->valid && !n->active) {
+            mean_pos(n, &s->pos);
+            s->have_pos = 1;
+            settle(s, BASE_SVIN_DONE);
+            if (s->cfg.save) s->cfg.save(&s->pos, s->cfg.ctx);
+        }
+        break;
+    case BASE_SVIN_CHECK:
+        check(s, n);
+        break;
+    case BASE_SVIN_FIXED:
+    case BASE_SVIN_DONE:
+        // The receiver restarted from its flash configuration. A report still
+        // on the way when the mode changed carries the check's survey time
+        if (n->active && n->dur < BASE_SVIN_CHECK_S && s->have_pos && s->cfg.write) {
+            s->receiver_restarts++;
+            send_fixed(s);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void base_svin_on_message(base_svin_t *s, uint8_t cls, uint8_t id, const uint8_t *payload, size_t len) {
+    if (!s->awaiting || cls != UBX_CLASS_ACK || len < 2) return;
+    if (payload[0] != UBX_CLASS_CFG || payload[1] != UBX_CFG_VALSET) return;
+    s->awaiting = 0;
+    if (id != UBX_ACK_ACK) {
+        s->errors++;
+        s->state = BASE_SVIN_SURVEY;
+        return;
+    }
+    if (s->state == BASE_SVIN_RESTART) {
+        uint8_t mode = s->tx[UBX_HEADER_LEN + 8];
+        if (mode == 0) {
+            send_mode(s, 1);
+        } else {
+            s->state = BASE_SVIN_CHECK;
+            s->check_us = s->now_us;
+        }
+    } else if (s->state == BASE_SVIN_FIX) {
+        settle(s, BASE_SVIN_FIXED);
+    }
+}
+
+void base_svin_poll(base_svin_t *s, int64_t now_us) {
+    s->now_us = now_us;
+    if (s->state == BASE_SVIN_CHECK && now_us - s->check_us >= BASE_SVIN_CHECK_MAX_S * 1000000LL) {
+        // NAV-SVIN is not arriving, or the survey never got going: the
+        // receiver is in survey-in again, let it finish
+        s->state = BASE_SVIN_SURVEY;
+    }
+    if (!s->awaiting || now_us - s->sent_us < BASE_SVIN_REPLY_US) return;
+    if (++s->tries > BASE_SVIN_RETRIES) {
+        s->awaiting = 0;
+        s->errors++;
+        // A restart stuck half way would leave survey-in off: ask for it
+        // back, unanswered or not, and let the survey run
+        if (s->state == BASE_SVIN_RESTART && s->tx[UBX_HEADER_LEN + 8] == 0) {
+            send_mode(s, 1);
+            s->awaiting = 0;
+        }
+        s->state = BASE_SVIN_SURVEY;
+        return;
+    }
+    send(s);
+}
+
+int base_svin_ready(const base_svin_t *s) {
+    return s->state == BASE_SVIN_FIXED || s->state == BASE_SVIN_DONE;
+}
+
+void base_svin_get_status(const base_svin_t *s, base_svin_status_t *st) {
+    memset(st, 0, sizeof(*st));
+    st->magic = BASE_SVIN_MAGIC;
+    st->version = BASE_SVIN_VERSION;
+    st->state = (uint8_t)s->state;
+    st->flags = s->flags;
+    if (s->have_last) {
+        const ubx_nav_svin_t *n = &s->last;
+        if (n->valid) st->flags |= BASE_SVIN_FLAG_VALID;
+        if (n->active) st->flags |= BASE_SVIN_FLAG_ACTIVE;
+        st->dur = n->dur;
+        st->obs = n->obs;
+    }
+    base_svin_pos_t pos = s->pos;
+    if (!base_svin_ready(s)) {
+        if (!s->have_last) return;
+        mean_pos(&s->last, &pos);
+    }
+    st->acc = pos.acc;
+    const int64_t v[3] = { pos.x, pos.y, pos.z };
+    int32_t cm[3];
+    int8_t hp[3];
+    for (int i = 0; i < 3; i++) split(v[i], &cm[i], &hp[i]);
+    // Packed fields: assigned, not written through pointers
+    st->x = cm[0];
+    st->y = cm[1];
+    st->z = cm[2];
+    st->x_hp = hp[0];
+    st->y_hp = hp[1];
+    st->z_hp = hp[2];
+}
+
+const char *base_svin_state_name(base_svin_state_t state) {
+    switch (state) {
+    case BASE_SVIN_SURVEY: return "survey-in";
+    case BASE_SVIN_RESTART: return "restart";
+    case BASE_SVIN_CHECK: return "check";
+    case BASE_SVIN_FIX: return "fix";
+    case BASE_SVIN_FIXED: return "fixed";
+    case BASE_SVIN_DONE: return "surveyed";
+    }
+    return "?";
+}
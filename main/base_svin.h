@@ -0,0 +1,122 @@
+#ifndef BASE_SVIN_H
+#define BASE_SVIN_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "ubx.h"
+
+// Base antenna position: surveyed in once, then remembered. Driven by the
+// receiver's NAV-SVIN reports:
+// - nothing stored: the receiver surveys in as its flash configuration says
+//   (CFG-TMODE). When NAV-SVIN reports the survey valid, the mean position
+//   and its accuracy go to save() for the caller to keep;
+// - a stored position: the survey is restarted and, once BASE_SVIN_CHECK_S
+//   seconds of fresh mean are in, compared with the stored one. If they agree
+//   within BASE_SVIN_MATCH_SIGMA times the fresh accuracy plus the stored
+//   accuracy, the receiver goes straight to fixed mode at the stored position.
+//   Further away the antenna has moved: save(NULL) drops the stored position
+//   and the survey runs to the end. A single-point mean only resolves metres,
+//   so this catches a relocated antenna, not a nudged one. No NAV-SVIN for
+//   BASE_SVIN_CHECK_MAX_S counts as no usable fix: the survey runs to the end;
+// - a receiver that restarts on its own (NAV-SVIN active again after the base
+//   position was settled) is put back to fixed mode at once.
+// Mode changes go to the RAM layer only: the receiver boots into survey-in,
+// never onto a stale fixed position. No ESP-IDF calls, see base_pipeline.h.
+
+#ifndef BASE_SVIN_CHECK_S
+#define BASE_SVIN_CHECK_S      10        // fresh survey before the comparison
+#endif
+#define BASE_SVIN_CHECK_ACC    50000     // 0.1 mm: fresh mean needed for the comparison
+#define BASE_SVIN_CHECK_MAX_S  120       // then give up and survey in fully
+#define BASE_SVIN_MATCH_SIGMA  3
+#define BASE_SVIN_MATCH_MIN    10000     // 0.1 mm, smallest allowed disagreement
+#define BASE_SVIN_REPLY_US     500000    // wait for the ACK before resending
+#define BASE_SVIN_RETRIES      3
+
+#define BASE_SVIN_MAGIC        'S'
+#define BASE_SVIN_VERSION      1
+#define BASE_SVIN_FLAG_VALID   0x01      // NAV-SVIN: survey-in position valid
+#define BASE_SVIN_FLAG_ACTIVE  0x02      // NAV-SVIN: survey-in in progress
+#define BASE_SVIN_FLAG_STORED  0x04      // a stored position was found at boot
+#define BASE_SVIN_FLAG_MOVED   0x08      // it failed the check
+
+// ECEF antenna position, as kept between boots
+typedef struct {
+    int64_t x;                // 0.1 mm
+    int64_t y;
+    int64_t z;
+    uint32_t acc;             // 0.1 mm
+} base_svin_pos_t;
+
+typedef enum {
+    BASE_SVIN_SURVEY = 0,     // surveying in, nothing (usable) stored
+    BASE_SVIN_RESTART,        // restarting the survey for the check
+    BASE_SVIN_CHECK,          // waiting for a fresh mean to compare
+    BASE_SVIN_FIX,            // sending the fixed position
+    BASE_SVIN_FIXED,          // fixed mode at the stored position
+    BASE_SVIN_DONE,           // survey-in complete
+} base_svin_state_t;
+
+// Survey progress for telemetry, little-endian, 32 bytes
+typedef struct __attribute__((packed)) {
+    uint8_t magic;
+    uint8_t version;
+    uint8_t state;            // base_svin_state_t
+    uint8_t flags;            // BASE_SVIN_FLAG_*
+    uint32_t dur;             // s, current or last survey-in
+    uint32_t obs;
+    uint32_t acc;             // 0.1 mm, of the position below
+    int32_t x;                // cm, ECEF: the survey mean, or the position in use once settled
+    int32_t y;
+    int32_t z;
+    int8_t x_hp;              // 0.1 mm
+    int8_t y_hp;
+    int8_t z_hp;
+    uint8_t reserved;
+} base_svin_status_t;
+
+typedef void (*base_svin_write_fn_t)(const uint8_t *data, size_t len);
+// pos NULL: forget the stored position
+typedef void (*base_svin_save_fn_t)(const base_svin_pos_t *pos, void *ctx);
+
+typedef struct {
+    base_svin_write_fn_t write;   // bytes to the receiver UART
+    base_svin_save_fn_t save;
+    void *ctx;
+    const base_svin_pos_t *stored;  // NULL = none
+} base_svin_config_t;
+
+typedef struct {
+    base_svin_config_t cfg;
+    base_svin_state_t state;
+    base_svin_pos_t pos;          // stored, then the position in use
+    int have_pos;
+    uint8_t flags;
+    ubx_nav_svin_t last;          // latest NAV-SVIN
+    int have_last;
+    uint8_t tx[UBX_HEADER_LEN + 4 + 8 * 8 + UBX_CHECKSUM_LEN];
+    size_t tx_len;
+    int awaiting;
+    uint8_t tries;
+    int64_t sent_us;
+    int64_t now_us;
+    int64_t start_us;
+    int64_t check_us;             // when the check started waiting for NAV-SVIN
+    int64_t settled_us;           // when the base position became known, 0 = not yet
+    uint32_t check_offset;        // 0.1 mm, fresh mean to stored position
+    uint32_t receiver_restarts;
+    uint32_t errors;              // NAKs and unanswered mode changes
+} base_svin_t;
+
+void base_svin_init(base_svin_t *s, const base_svin_config_t *cfg, int64_t now_us);
+// Feed from the base UART's UBX parser
+void base_svin_on_nav(base_svin_t *s, const ubx_nav_svin_t *svin);
+void base_svin_on_message(base_svin_t *s, uint8_t cls, uint8_t id, const uint8_t *payload, size_t len);
+// Retries; also the time base for the two above
+void base_svin_poll(base_svin_t *s, int64_t now_us);
+// The base position is known: surveyed, or stored and checked
+int base_svin_ready(const base_svin_t *s);
+void base_svin_get_status(const base_svin_t *s, base_svin_status_t *st);
+const char *base_svin_state_name(base_svin_state_t state);
+
+#endif // BASE_SVIN_H
@@ -0,0 +1,33 @@
+#include "console.h"
+#include "esp_console.h"
+#include "esp_log.h"
+
+static const char *TAG = "CONSOLE";
+
+void console_init(void) {
+    esp_console_repl_t *repl = NULL;
+    esp_console_repl_config_t repl_config = ESP_CONSOLE_REPL_CONFIG_DEFAULT();
+    repl_config.prompt = "rtk>";
+    esp_console_dev_uart_config_t uart_config = ESP_CONSOLE_DEV_UART_CONFIG_DEFAULT();
+
+    esp_err_t err = esp_console_new_repl_uart(&uart_config, &repl_config, &repl);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "console init failed: %s", esp_err_to_name(err));
+        return;
+    }
+    esp_console_register_help_command();
+    err = esp_console_start_repl(repl);
+    ESP_LOGI(TAG, "esp_console_start_repl: %s", esp_err_to_name(err));
+}
+
+void console_register_command(const char *name, const char *help, console_cmd_fn_t fn) {
+    const esp_console_cmd_t cmd = {
+        .command = name,
+        .help = help,
+        .func = fn,
+    };
+    esp_err_t err = esp_console_cmd_register(&cmd);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "register '%s' failed: %s", name, esp_err_to_name(err));
+    }
+}
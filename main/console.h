@@ -0,0 +1,13 @@
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+// Serial command console on the USB UART (esp_console REPL)
+
+typedef int (*console_cmd_fn_t)(int argc, char **argv);
+
+// Start the REPL task; commands can be registered before or after
+void console_init(void);
+// Add a command; help is shown by the built-in "help" command
+void console_register_command(const char *name, const char *help, console_cmd_fn_t fn);
+
+#endif // CONSOLE_H
@@ -1,11 +1,31 @@
 #include "espnow_comm.h"
+#include "platform.h"
 #include "esp_now.h"
 #include "esp_wifi.h"
 #include "esp_log.h"
+#include "role_config.h"
+#include "link_adapt.h"
 #include <string.h>
 
+#define ESPNOW_FEEDBACK_SLOTS 4  // rover reports arrive every LINK_ADAPT_WINDOW_MS
+
 static const char *TAG = "ESPNOW_COMM";
 static uint8_t broadcast_mac[6] = {0xFF,0xFF,0xFF,0xFF,0xFF,0xFF};
+static pkt_block_t *rx_slots[ESPNOW_FEEDBACK_SLOTS];
+static pkt_ring_t rx_ring;
+
+// Index of link_adapt_rates[]
+static const esp_now_rate_config_t phy_rates[LINK_ADAPT_RATES] = {
+    { WIFI_PHY_MODE_LR, WIFI_PHY_RATE_LORA_250K },
+    { WIFI_PHY_MODE_LR, WIFI_PHY_RATE_LORA_500K },
+    { WIFI_PHY_MODE_11B, WIFI_PHY_RATE_1M_L },
+    { WIFI_PHY_MODE_11B, WIFI_PHY_RATE_2M_L },
+    { WIFI_PHY_MODE_11G, WIFI_PHY_RATE_6M },
+    { WIFI_PHY_MODE_11G, WIFI_PHY_RATE_12M },
+    { WIFI_PHY_MODE_11G, WIFI_PHY_RATE_24M },
+    { WIFI_PHY_MODE_11G, WIFI_PHY_RATE_36M },
+    { WIFI_PHY_MODE_11G, WIFI_PHY_RATE_54M },
+};
 
 static void espnow_send_cb(const uint8_t *mac_addr, esp_now_send_status_t status) {
     // Silent - only log failures
@@ -14,19 +34,26 @@ static void espnow_send_cb(const uint8_t *mac_addr, esp_now_send_status_t status
     }
 }
 
+static void espnow_recv_cb(const esp_now_recv_info_t *recv_info, const uint8_t *data, int len) {
+    // Runs in the Wi-Fi task: never blocks, drops (and counts) when full
+    pkt_ring_push(&rx_ring, data, len > 0 ? (size_t)len : 0);
+}
+
 void espnow_comm_init(void) {
-    esp_netif_init();
-    esp_event_loop_create_default();
-    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
-    esp_wifi_init(&cfg);
-    esp_wifi_set_mode(WIFI_MODE_STA);
-    esp_wifi_start();
+    // Wi-Fi may already be up (bonded UDP/MQTT paths); ESP-NOW then shares the AP channel
+    platform_wifi_init();
+#if LINK_ADAPT
+    // Long-range rates need LR on both ends; the 802.11 rates keep working alongside
+    esp_wifi_set_protocol(WIFI_IF_STA, WIFI_PROTOCOL_11B | WIFI_PROTOCOL_11G | WIFI_PROTOCOL_11N | WIFI_PROTOCOL_LR);
+#endif
+    pkt_ring_init(&rx_ring, rx_slots, ESPNOW_FEEDBACK_SLOTS);
 
     if (esp_now_init() != ESP_OK) {
         ESP_LOGE(TAG, "ESP-NOW init failed");
         return;
     }
     esp_now_register_send_cb(espnow_send_cb);
+    esp_now_register_recv_cb(espnow_recv_cb);
 
     esp_now_peer_info_t peerInfo = {0};
     memcpy(peerInfo.peer_addr, broadcast_mac, 6);
@@ -45,3 +72,27 @@ void espnow_comm_send(const uint8_t *data, size_t len) {
         ESP_LOGE(TAG, "ESP-NOW send error: %d", result);
     }
 }
+
+void espnow_comm_set_rate(uint8_t rate) {
+    if (rate >= LINK_ADAPT_RATES) return;
+    esp_now_rate_config_t cfg = phy_rates[rate];
+    esp_err_t err = esp_now_set_peer_rate_config(broadcast_mac, &cfg);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "rate %s: %d", link_adapt_rates[rate].name, err);
+    }
+}
+
+void espnow_comm_set_channel(uint8_t channel) {
+    esp_err_t err = esp_wifi_set_channel(channel, WIFI_SECOND_CHAN_NONE);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "channel %u: %d", channel, err);
+    }
+}
+
+size_t espnow_comm_receive_batch(pkt_ring_cb_t cb, void *ctx) {
+    return pkt_ring_drain(&rx_ring, cb, ctx, ESPNOW_FEEDBACK_SLOTS);
+}
+
+void espnow_comm_set_wake(pkt_ring_wake_fn_t wake, void *ctx) {
+    pkt_ring_set_wake(&rx_ring, wake, ctx);
+}
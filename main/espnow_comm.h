@@ -3,8 +3,17 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include "pkt_ring.h"
 
 void espnow_comm_init(void);
 void espnow_comm_send(const uint8_t *data, size_t len);
+// Link adaptation (link_adapt.h): rate index of link_adapt_rates[] for the
+// broadcast peer (either role, once its peer exists), channel 1-13
+void espnow_comm_set_rate(uint8_t rate);
+void espnow_comm_set_channel(uint8_t channel);
+// Hand every message from the rover to cb without copying (returns messages drained)
+size_t espnow_comm_receive_batch(pkt_ring_cb_t cb, void *ctx);
+// Run wake(ctx) from the Wi-Fi task whenever a message is queued
+void espnow_comm_set_wake(pkt_ring_wake_fn_t wake, void *ctx);
 
 #endif // ESPNOW_COMM_H
@@ -0,0 +1,428 @@
+#include "f9p_cfg.h"
+#include <string.h>
+
+enum { WRITE_TXN = 0, WRITE_BATCH, WRITE_SINGLE };
+
+// Rates tried after the configured one, most likely first
+static const uint32_t probe_bauds[] = { 38400, 115200, 9600, 230400, 460800, 921600 };
+#define PROBE_BAUDS  (sizeof(probe_bauds) / sizeof(probe_bauds[0]))
+#define PROBE_ROUNDS 2
+
+static size_t key_size(uint32_t key) {
+    switch ((key >> 28) & 7) {
+    case 1:
+    case 2: return 1;
+    case 3: return 2;
+    case 4: return 4;
+    case 5: return 8;
+    default: return 0;
+    }
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t fnv1a(uint32_t h, const uint8_t *p, size_t len) {
+    while (len--) h = (h ^ *p++) * 0x01000193u;
+    return h;
+}
+
+// Value key i should have: the table's, or an override written out into buf
+static const uint8_t *wanted(const f9p_cfg_t *c, uint16_t i, uint16_t off, uint8_t *buf) {
+    for (uint8_t k = 0; k < c->cfg.override_count; k++) {
+        if (c->override_index[k] != i) continue;
+        uint64_t v = c->cfg.overrides[k].value;
+        for (int b = 0; b < 8; b++) buf[b] = (uint8_t)(v >> (8 * b));
+        return buf;
+    }
+    return c->cfg.table->values + off;
+}
+
+static int differs(const f9p_cfg_t *c, uint16_t i) {
+    return (c->differ[i >> 3] >> (i & 7)) & 1;
+}
+
+static void mark(f9p_cfg_t *c, uint16_t i) {
+    c->differ[i >> 3] |= (uint8_t)(1u << (i & 7));
+}
+
+// First differing key at or after i that goes out with the batches (the baud key goes last)
+static int any_left(const f9p_cfg_t *c, uint16_t i) {
+    for (; i < c->cfg.table->count; i++) {
+        if (i != c->baud_index && differs(c, i)) return 1;
+    }
+    return 0;
+}
+
+static uint32_t table_baud(const f9p_cfg_t *c) {
+    const f9p_cfg_table_t *t = c->cfg.table;
+    uint16_t off = 0;
+    uint8_t buf[8];
+    for (uint16_t i = 0; i < c->baud_index; i++) off += key_size(t->keys[i]);
+    return c->baud_index < t->count ? get_u32(wanted(c, c->baud_index, off, buf)) : c->baud;
+}
+
+static void finish(f9p_cfg_t *c, f9p_cfg_state_t state) {
+    c->state = state;
+    c->await_cls = 0;
+    c->elapsed_us = c->now_us - c->start_us;
+}
+
+// Frame the payload already written at tx + UBX_HEADER_LEN and send it
+static void send_msg(f9p_cfg_t *c, uint8_t cls, uint8_t id, size_t len, int await) {
+    uint8_t *t = c->tx;
+    t[0] = UBX_SYNC1;
+    t[1] = UBX_SYNC2;
+    t[2] = cls;
+    t[3] = id;
+    t[4] = (uint8_t)len;
+    t[5] = (uint8_t)(len >> 8);
+    ubx_checksum(t + 2, len + 4, &t[UBX_HEADER_LEN + len], &t[UBX_HEADER_LEN + len + 1]);
+    c->cfg.write(t, UBX_HEADER_LEN + len + UBX_CHECKSUM_LEN);
+    if (await) {
+        c->await_cls = cls;
+        c->await_id = id;
+        c->sent_us = c->now_us;
+    }
+}
+
+static void resend(f9p_cfg_t *c) {
+    size_t len = c->tx[4] | ((size_t)c->tx[5] << 8);
+    c->cfg.write(c->tx, UBX_HEADER_LEN + len + UBX_CHECKSUM_LEN);
+    c->sent_us = c->now_us;
+}
+
+static void send_valget(f9p_cfg_t *c, const uint32_t *keys, size_t n) {
+    uint8_t *p = c->tx + UBX_HEADER_LEN;
+    memset(p, 0, 4);              // version 0, RAM layer, position 0
+    for (size_t i = 0; i < n; i++) put_u32(p + 4 + i * 4, keys[i]);
+    send_msg(c, UBX_CLASS_CFG, UBX_CFG_VALGET, 4 + n * 4, 1);
+}
+
+static void send_probe(f9p_cfg_t *c) {
+    if (c->step > 0 && c->cfg.set_baud) {
+        c->baud = probe_bauds[(c->step - 1) % PROBE_BAUDS];
+        c->cfg.set_baud(c->baud);
+    }
+    // A receiver configured without UBX output on this port could never answer
+    if (c->cfg.ubx_out_key) {
+        uint8_t *p = c->tx + UBX_HEADER_LEN;
+        p[0] = 0;
+        p[1] = F9P_CFG_LAYER_RAM;
+        p[2] = p[3] = 0;
+        put_u32(p + 4, c->cfg.ubx_out_key);
+        p[8] = 1;
+        send_msg(c, UBX_CLASS_CFG, UBX_CFG_VALSET, 9, 0);
+    }
+    send_valget(c, &c->cfg.baud_key, 1);
+}
+
+static void send_read(f9p_cfg_t *c) {
+    const f9p_cfg_table_t *t = c->cfg.table;
+    size_t n = t->count - c->pos < F9P_CFG_BATCH ? t->count - c->pos : F9P_CFG_BATCH;
+    c->next = c->pos;
+    c->next_off = c->pos_off;
+    for (size_t i = 0; i < n; i++) c->next_off += key_size(t->keys[c->next++]);
+    send_valget(c, t->keys + c->pos, n);
+}
+
+static void send_write(f9p_cfg_t *c) {
+    const f9p_cfg_table_t *t = c->cfg.table;
+    uint8_t *p = c->tx + UBX_HEADER_LEN;
+    size_t len = 4;
+    uint16_t i = c->pos, off = c->pos_off, n = 0;
+    uint16_t end = c->mode == WRITE_SINGLE ? c->single_end : t->count;
+    uint16_t max = c->mode == WRITE_SINGLE ? 1 : F9P_CFG_BATCH;
+    uint8_t buf[8];
+    for (; i < end && n < max; off += key_size(t->keys[i]), i++) {
+        if (i == c->baud_index || !differs(c, i)) continue;
+        size_t sz = key_size(t->keys[i]);
+        put_u32(p + len, t->keys[i]);
+        memcpy(p + len + 4, wanted(c, i, off, buf), sz);
+        len += 4 + sz;
+        if (n++ == 0) c->first_key = t->keys[i];
+    }
+    c->next = i;
+    c->next_off = off;
+    c->batch_keys = n;
+
+    // One transaction when the keys span several messages: the receiver
+    // applies them together on the last one
+    uint8_t version = 0, txn = 0;
+    int more = any_left(c, i);
+    if (c->mode == WRITE_TXN && (c->txn_keys || more)) {
+        version = 1;
+        txn = c->txn_keys == 0 ? 1 : more ? 2 : 3;
+    }
+    p[0] = version;
+    p[1] = F9P_CFG_LAYER_RAM | F9P_CFG_LAYER_BBR | F9P_CFG_LAYER_FLASH;
+    p[2] = txn;
+    p[3] = 0;
+    send_msg(c, UBX_CLASS_CFG, UBX_CFG_VALSET, len, 1);
+}
+
+static void send_baud(f9p_cfg_t *c) {
+    uint8_t *p = c->tx + UBX_HEADER_LEN;
+    p[0] = 0;
+    p[1] = F9P_CFG_LAYER_RAM | F9P_CFG_LAYER_BBR | F9P_CFG_LAYER_FLASH;
+    p[2] = p[3] = 0;
+    put_u32(p + 4, c->cfg.baud_key);
+    put_u32(p + 8, table_baud(c));
+    // The answer may come at either rate: not waited for, the probe afterwards confirms
+    send_msg(c, UBX_CLASS_CFG, UBX_CFG_VALSET, 12, 0);
+    c->sent_us = c->now_us;
+    c->step = 0;
+}
+
+static void after_write(f9p_cfg_t *c) {
+    if (c->baud_index < c->cfg.table->count && differs(c, c->baud_index) && c->cfg.set_baud) {
+        c->state = F9P_CFG_BAUD;
+        send_baud(c);
+        return;
+    }
+    finish(c, F9P_CFG_DONE);
+}
+
+static void start_write(f9p_cfg_t *c) {
+    c->differing = 0;
+    for (uint16_t i = 0; i < c->cfg.table->count; i++) c->differing += differs(c, i);
+    c->state = F9P_CFG_WRITE;
+    c->mode = WRITE_TXN;
+    c->pos = c->pos_off = 0;
+    c->txn_keys = 0;
+    c->tries = 0;
+    if (any_left(c, 0)) send_write(c);
+    else after_write(c);
+}
+
+static void start_read(f9p_cfg_t *c) {
+    c->state = F9P_CFG_READ;
+    c->pos = c->pos_off = 0;
+    c->tries = 0;
+    send_read(c);
+}
+
+// Compare a VALGET reply with the batch it answers. Returns 0 if it is a
+// stale reply to an earlier request
+static int read_reply(f9p_cfg_t *c, const uint8_t *payload, size_t len) {
+    const f9p_cfg_table_t *t = c->cfg.table;
+    if (len < 8) return 0;
+    uint32_t first = get_u32(payload + 4);
+    if (first < t->keys[c->pos] || first > t->keys[c->next - 1]) return 0;
+
+    // Replies keep the requested order; keys the receiver does not know are left out
+    uint64_t seen = 0;
+    uint16_t i = c->pos, off = c->pos_off;
+    uint8_t buf[8];
+    for (size_t at = 4; at + 4 <= len;) {
+        uint32_t key = get_u32(payload + at);
+        size_t sz = key_size(key);
+        if (sz == 0 || at + 4 + sz > len) break;
+        while (i < c->next && t->keys[i] != key) off += key_size(t->keys[i++]);
+        if (i == c->next) break;
+        seen |= (uint64_t)1 << (i - c->pos);
+        if (memcmp(payload + at + 4, wanted(c, i, off, buf), sz) != 0) mark(c, i);
+        at += 4 + sz;
+    }
+    for (uint16_t k = c->pos; k < c->next; k++) {
+        if (!(seen >> (k - c->pos) & 1)) mark(c, k);
+    }
+    return 1;
+}
+
+static void write_answer(f9p_cfg_t *c, int ack) {
+    if (!ack && c->mode == WRITE_TXN) {
+        // The transaction is dropped whole: resend plainly to find the culprit
+        c->mode = WRITE_BATCH;
+        c->pos = c->pos_off = 0;
+        c->txn_keys = 0;
+        send_write(c);
+        return;
+    }
+    if (!ack && c->mode == WRITE_BATCH) {
+        c->mode = WRITE_SINGLE;
+        c->single_end = c->next;
+        send_write(c);
+        return;
+    }
+
+    if (c->mode == WRITE_TXN) {
+        c->txn_keys += c->batch_keys;
+        if (!any_left(c, c->next)) c->written += c->txn_keys;
+    } else if (ack) {
+        c->written += c->batch_keys;
+    } else {
+        c->rejected++;
+        c->rejected_key = c->first_key;
+    }
+    c->pos = c->next;
+    c->pos_off = c->next_off;
+    if (c->mode == WRITE_SINGLE && c->pos >= c->single_end) c->mode = WRITE_BATCH;
+    if (any_left(c, c->pos)) send_write(c);
+    else after_write(c);
+}
+
+static void on_ubx(uint8_t cls, uint8_t id, const uint8_t *payload, size_t len, void *ctx) {
+    f9p_cfg_t *c = ctx;
+    if (!c->await_cls) return;
+    int polled = c->await_cls != UBX_CLASS_CFG || c->await_id != UBX_CFG_VALSET;
+    int ack = -1;                 // -1 reply message, 0 NAK, 1 ACK
+    if (cls == UBX_CLASS_ACK && len >= 2 && payload[0] == c->await_cls && payload[1] == c->await_id) {
+        // Polls are answered by the message itself; their ACK trails it
+        if (polled && id == UBX_ACK_ACK) return;
+        ack = id == UBX_ACK_ACK;
+    } else if (cls != c->await_cls || id != c->await_id || !polled) {
+        return;
+    }
+
+    switch (c->state) {
+    case F9P_CFG_PROBE:
+        // Any answer means the receiver is there at this rate
+        c->await_cls = 0;
+        c->state = F9P_CFG_IDENTIFY;
+        c->tries = 0;
+        send_msg(c, UBX_CLASS_SEC, UBX_SEC_UNIQID, 0, 1);
+        break;
+    case F9P_CFG_IDENTIFY:
+        c->await_cls = 0;
+        if (ack < 0 && len > 4) {
+            uint32_t h = fnv1a(c->hash, payload + 4, len - 4);
+            c->stamp = h ? h : 1;
+        }
+        if (c->stamp && c->stamp == c->cfg.stamp && c->baud == table_baud(c)) {
+            c->skipped = 1;
+            finish(c, F9P_CFG_DONE);
+            return;
+        }
+        start_read(c);
+        break;
+    case F9P_CFG_READ:
+        if (ack < 0 && !read_reply(c, payload, len)) return;
+        c->await_cls = 0;
+        if (ack == 0) {
+            for (uint16_t k = c->pos; k < c->next; k++) mark(c, k);
+        }
+        c->pos = c->next;
+        c->pos_off = c->next_off;
+        c->tries = 0;
+        if (c->pos < c->cfg.table->count) send_read(c);
+        else start_write(c);
+        break;
+    case F9P_CFG_WRITE:
+        c->await_cls = 0;
+        c->tries = 0;
+        write_answer(c, ack == 1);
+        break;
+    case F9P_CFG_BAUD:
+        c->await_cls = 0;
+        c->written++;
+        finish(c, F9P_CFG_DONE);
+        break;
+    default:
+        break;
+    }
+}
+
+void f9p_cfg_start(f9p_cfg_t *c, const f9p_cfg_config_t *cfg, int64_t now_us) {
+    memset(c, 0, sizeof(*c));
+    c->cfg = *cfg;
+    c->now_us = c->start_us = now_us;
+    c->baud = cfg->baud;
+    const ubx_handlers_t handlers = { .on_message = on_ubx, .ctx = c };
+    ubx_parser_init(&c->parser, &handlers);
+
+    const f9p_cfg_table_t *t = cfg->table;
+    if (!t || t->count == 0 || t->count > F9P_CFG_MAX_KEYS || !cfg->write ||
+        cfg->override_count > F9P_CFG_MAX_OVERRIDES) {
+        finish(c, F9P_CFG_FAILED);
+        return;
+    }
+    c->baud_index = t->count;
+    for (uint16_t i = 0; i < t->count; i++) {
+        if (t->keys[i] == cfg->baud_key) c->baud_index = i;
+    }
+
+    // Overrides change what a configured receiver looks like, so they go into its stamp
+    c->hash = t->hash;
+    for (uint8_t k = 0; k < cfg->override_count; k++) {
+        const f9p_cfg_value_t *o = &cfg->overrides[k];
+        uint16_t i = 0;
+        while (i < t->count && t->keys[i] != o->key) i++;
+        if (i == t->count) {
+            finish(c, F9P_CFG_FAILED);
+            return;
+        }
+        c->override_index[k] = i;
+        uint8_t buf[12];
+        put_u32(buf, o->key);
+        for (int b = 0; b < 8; b++) buf[4 + b] = (uint8_t)(o->value >> (8 * b));
+        c->hash = fnv1a(c->hash, buf, 4 + key_size(o->key));
+    }
+    c->state = F9P_CFG_PROBE;
+    send_probe(c);
+}
+
+void f9p_cfg_feed(f9p_cfg_t *c, const uint8_t *data, size_t len, int64_t now_us) {
+    c->now_us = now_us;
+    if (c->state < F9P_CFG_DONE) ubx_parser_feed(&c->parser, data, len);
+}
+
+int f9p_cfg_poll(f9p_cfg_t *c, int64_t now_us) {
+    c->now_us = now_us;
+    if (c->state >= F9P_CFG_DONE) return 0;
+    if (now_us - c->start_us > F9P_CFG_TIMEOUT_US) {
+        finish(c, F9P_CFG_FAILED);
+        return 0;
+    }
+
+    int64_t waited = now_us - c->sent_us;
+    if (c->state == F9P_CFG_PROBE) {
+        if (waited < F9P_CFG_PROBE_US) return 1;
+        if (++c->step > PROBE_BAUDS * PROBE_ROUNDS) {
+            finish(c, F9P_CFG_FAILED);
+            return 0;
+        }
+        send_probe(c);
+    } else if (c->state == F9P_CFG_BAUD && c->step == 0) {
+        if (waited < F9P_CFG_BAUD_SETTLE_US) return 1;
+        c->baud = table_baud(c);
+        c->cfg.set_baud(c->baud);
+        c->step = 1;
+        c->tries = 0;
+        send_valget(c, &c->cfg.baud_key, 1);
+    } else if (c->await_cls && waited >= F9P_CFG_REPLY_US) {
+        if (c->state == F9P_CFG_IDENTIFY && c->tries >= F9P_CFG_RETRIES) {
+            // Older firmware without SEC-UNIQID: configure anyway, just never skip
+            c->await_cls = 0;
+            start_read(c);
+            return 1;
+        }
+        if (++c->tries > F9P_CFG_RETRIES) {
+            finish(c, F9P_CFG_FAILED);
+            return 0;
+        }
+        resend(c);
+    }
+    return 1;
+}
+
+const char *f9p_cfg_state_name(f9p_cfg_state_t state) {
+    switch (state) {
+    case F9P_CFG_PROBE: return "probe";
+    case F9P_CFG_IDENTIFY: return "identify";
+    case F9P_CFG_READ: return "read";
+    case F9P_CFG_WRITE: return "write";
+    case F9P_CFG_BAUD: return "baud";
+    case F9P_CFG_DONE: return "done";
+    case F9P_CFG_FAILED: return "failed";
+    }
+    return "?";
+}
@@ -0,0 +1,124 @@
+#ifndef F9P_CFG_H
+#define F9P_CFG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "ubx.h"
+
+// Boot-time ZED-F9P configuration. The wanted configuration is a key/value
+// table generated at build time from the u-center CFG-VALGET dumps in
+// f9p-config/ (f9p_cfg_gen.py). At boot the engine:
+// - finds the receiver, trying the usual baud rates (a factory unit runs 38400);
+// - stops there if the stamp saved by the last successful run matches this
+//   receiver (SEC-UNIQID) and this table (hash, with any run-time overrides);
+// - reads the running (RAM) configuration in CFG-VALGET batches and marks
+//   the keys that differ from the table;
+// - writes only those, as one CFG-VALSET transaction to RAM, BBR and flash.
+//   If the receiver NAKs it, the keys are resent batch by batch and then
+//   key by key to isolate the ones it rejects;
+// - changes the baud rate of the port it talks on last, then finds the
+//   receiver again at the new rate.
+// No ESP-IDF calls: the caller supplies the UART functions and the time.
+
+#define F9P_CFG_BATCH         64         // key/value pairs per VALGET / VALSET (receiver limit)
+#define F9P_CFG_MAX_KEYS      1536
+#define F9P_CFG_MAX_OVERRIDES 8
+#define F9P_CFG_LAYER_RAM     0x01
+#define F9P_CFG_LAYER_BBR     0x02
+#define F9P_CFG_LAYER_FLASH   0x04
+#define F9P_CFG_REPLY_US      500000     // wait for an answer before resending
+#define F9P_CFG_PROBE_US      250000     // per baud rate while looking for the receiver
+#define F9P_CFG_RETRIES       3
+#define F9P_CFG_BAUD_SETTLE_US 100000    // after the baud rate change, before probing again
+#ifndef F9P_CFG_TIMEOUT_US
+#define F9P_CFG_TIMEOUT_US    30000000   // give up on the whole run
+#endif
+
+// Generated table (f9p_cfg_tables.c)
+typedef struct {
+    const char *name;
+    const uint32_t *keys;         // ascending
+    const uint8_t *values;        // packed little-endian, each at the size encoded in its key
+    uint16_t count;
+    uint32_t hash;                // FNV-1a over keys and values
+} f9p_cfg_table_t;
+
+extern const f9p_cfg_table_t f9p_cfg_table_base;
+extern const f9p_cfg_table_t f9p_cfg_table_rover;
+
+// A value set at run time in place of the table's (the key must be in the table)
+typedef struct {
+    uint32_t key;
+    uint64_t value;
+} f9p_cfg_value_t;
+
+typedef void (*f9p_cfg_write_fn_t)(const uint8_t *data, size_t len);
+typedef void (*f9p_cfg_baud_fn_t)(uint32_t baud);
+
+typedef struct {
+    const f9p_cfg_table_t *table;
+    f9p_cfg_write_fn_t write;     // bytes to the receiver UART
+    f9p_cfg_baud_fn_t set_baud;   // host UART rate; NULL = fixed, no probing or baud change
+    uint32_t baud;                // host UART rate at start
+    uint32_t baud_key;            // CFG-UARTn-BAUDRATE of the receiver port the host is wired to
+    uint32_t ubx_out_key;         // CFG-UARTnOUTPROT-UBX of that port, forced on while probing
+    uint32_t stamp;               // saved after the last successful run, 0 = none
+    const f9p_cfg_value_t *overrides;
+    uint8_t override_count;
+} f9p_cfg_config_t;
+
+typedef enum {
+    F9P_CFG_PROBE = 0,
+    F9P_CFG_IDENTIFY,
+    F9P_CFG_READ,
+    F9P_CFG_WRITE,
+    F9P_CFG_BAUD,
+    F9P_CFG_DONE,
+    F9P_CFG_FAILED,
+} f9p_cfg_state_t;
+
+typedef struct {
+    f9p_cfg_config_t cfg;
+    f9p_cfg_state_t state;
+    ubx_parser_t parser;
+    uint8_t tx[UBX_HEADER_LEN + 4 + F9P_CFG_BATCH * 12 + UBX_CHECKSUM_LEN];
+    uint8_t differ[(F9P_CFG_MAX_KEYS + 7) / 8];
+    int64_t now_us;
+    int64_t start_us;
+    int64_t sent_us;
+    uint8_t await_cls;            // reply being waited for
+    uint8_t await_id;
+    uint8_t tries;
+    uint8_t step;                 // baud index while probing, phase in BAUD
+    uint8_t mode;                 // how differing keys are being written
+    uint16_t pos;                 // first key of the current batch
+    uint16_t pos_off;             // its offset into the table values
+    uint16_t next;                // key after the current batch
+    uint16_t next_off;
+    uint16_t single_end;          // key-by-key mode runs up to here
+    uint16_t batch_keys;
+    uint32_t first_key;           // first key of the message in flight
+    uint16_t txn_keys;            // keys sent in the open transaction
+    uint16_t baud_index;          // table index of baud_key, count if absent
+    uint16_t override_index[F9P_CFG_MAX_OVERRIDES];
+    uint32_t hash;                // table hash with the overrides folded in
+
+    uint32_t baud;                // rate the receiver was found at / ends at
+    uint32_t stamp;               // to save when the run succeeds, 0 = receiver not identified
+    uint16_t differing;           // keys that differed from the table
+    uint16_t written;             // keys the receiver accepted
+    uint16_t rejected;            // keys the receiver refused
+    uint32_t rejected_key;        // last refused key
+    uint8_t skipped;              // stamp matched: nothing read or written
+    int64_t elapsed_us;
+} f9p_cfg_t;
+
+// Begin a run; feed the receiver's output and poll until it returns 0
+void f9p_cfg_start(f9p_cfg_t *c, const f9p_cfg_config_t *cfg, int64_t now_us);
+// Bytes read from the receiver UART (NMEA, RTCM and the like are skipped)
+void f9p_cfg_feed(f9p_cfg_t *c, const uint8_t *data, size_t len, int64_t now_us);
+// Retries and timeouts; returns 1 while the run is in progress
+int f9p_cfg_poll(f9p_cfg_t *c, int64_t now_us);
+const char *f9p_cfg_state_name(f9p_cfg_state_t state);
+
+#endif // F9P_CFG_H
@@ -0,0 +1,83 @@
+#include "flash_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_partition.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "FLASH_LOG";
+static const esp_partition_t *part = NULL;
+static raw_log_t log_state;
+static raw_log_buf_t bufs[FLASH_LOG_BUFFERS];
+static TaskHandle_t writer = NULL;
+static uint32_t append_max_us;
+
+static int part_read(void *ctx, uint32_t offset, void *data, size_t len) {
+    return esp_partition_read(part, offset, data, len) == ESP_OK ? 0 : -1;
+}
+
+static int part_write(void *ctx, uint32_t offset, const void *data, size_t len) {
+    return esp_partition_write(part, offset, data, len) == ESP_OK ? 0 : -1;
+}
+
+static int part_erase(void *ctx, uint32_t offset, size_t len) {
+    return esp_partition_erase_range(part, offset, len) == ESP_OK ? 0 : -1;
+}
+
+static void wake_writer(void *ctx) {
+    if (writer) xTaskNotifyGive(writer);
+}
+
+// Erases and writes run here, at a priority below the forwarding loop. While
+// the flash is busy the cache is off on both cores, so the stall the loop can
+// see is bounded by erase_max_us + write_max_us; the UART ISR keeps running
+// from IRAM (CONFIG_UART_ISR_IN_IRAM) and the RX ring absorbs the gap
+static void writer_task(void *arg) {
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        raw_log_service(&log_state);
+    }
+}
+
+int flash_log_init(void) {
+    part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, FLASH_LOG_PARTITION);
+    if (!part) {
+        ESP_LOGW(TAG, "No \"%s\" partition, raw logging off", FLASH_LOG_PARTITION);
+        return -1;
+    }
+    const raw_log_flash_t flash = {
+        .read = part_read,
+        .write = part_write,
+        .erase = part_erase,
+        .now_us = esp_timer_get_time,
+        .size = (uint32_t)part->size,
+    };
+    if (raw_log_init(&log_state, &flash, bufs, FLASH_LOG_BUFFERS, wake_writer, NULL) != 0) {
+        ESP_LOGE(TAG, "Cannot mount the raw log at 0x%lx", (unsigned long)part->address);
+        part = NULL;
+        return -1;
+    }
+    xTaskCreate(writer_task, "flash_log", FLASH_LOG_TASK_STACK, NULL, FLASH_LOG_TASK_PRIO, &writer);
+    ESP_LOGI(TAG, "Raw log: %lu sectors at 0x%lx, boot %lu, next sector %lu", (unsigned long)log_state.sectors,
+             (unsigned long)part->address, (unsigned long)log_state.boot, (unsigned long)log_state.next_sector);
+    return 0;
+}
+
+void flash_log_write(raw_log_source_t source, const uint8_t *data, size_t len) {
+    if (!part || !len) return;
+    int64_t t0 = esp_timer_get_time();
+    raw_log_append(&log_state, source, data, len, (uint32_t)(t0 / 1000));
+    uint32_t us = (uint32_t)(esp_timer_get_time() - t0);
+    if (us > append_max_us) append_max_us = us;
+}
+
+void flash_log_flush(void) {
+    if (part) raw_log_flush(&log_state);
+}
+
+void flash_log_get_stats(flash_log_stats_t *stats) {
+    stats->log = log_state.stats;
+    stats->append_max_us = append_max_us;
+    stats->sectors = log_state.sectors;
+    stats->boot = log_state.boot;
+}
@@ -0,0 +1,41 @@
+#ifndef FLASH_LOG_H
+#define FLASH_LOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "role_config.h"
+#include "raw_log.h"
+
+// Raw stream log (raw_log.h) in the "rawlog" data partition of partitions.csv.
+// flash_log_write() only copies into a RAM sector buffer; a low-priority task
+// erases and writes the sealed buffers. Read the partition back with
+//   esptool.py read_flash 0x190000 0x270000 rawlog.bin
+// and split it with host/rawlog_extract.
+
+#define FLASH_LOG_PARTITION   "rawlog"
+// Sector buffers: one filling while the rest wait for or are being written.
+// High-rate output fills a sector in ~130 ms, about two erase-and-write times
+#if GNSS_HIGH_RATE
+#define FLASH_LOG_BUFFERS     4
+#else
+#define FLASH_LOG_BUFFERS     2
+#endif
+#define FLASH_LOG_TASK_PRIO   1        // below the main loop: flash work only runs when it idles
+#define FLASH_LOG_TASK_STACK  3072
+
+typedef struct {
+    raw_log_stats_t log;
+    uint32_t append_max_us;            // longest flash_log_write(): the cost to the caller
+    uint32_t sectors;                  // in the partition
+    uint32_t boot;
+} flash_log_stats_t;
+
+// Returns -1 (and logging stays off) without the partition
+int flash_log_init(void);
+// Caller task only: one record of source bytes, timestamped now
+void flash_log_write(raw_log_source_t source, const uint8_t *data, size_t len);
+// Caller task only: hand the part-filled buffer to the writer (before a planned restart)
+void flash_log_flush(void);
+void flash_log_get_stats(flash_log_stats_t *stats);
+
+#endif // FLASH_LOG_H
@@ -0,0 +1,186 @@
+#include "geo.h"
+#include <math.h>
+#include <stdio.h>
+
+#define WGS84_A  6378137.0
+#define WGS84_E2 6.69437999014e-3
+#define RAD_PER_UNIT 1.74532925199e-11f   // pi / 180 / GEO_UNITS_PER_DEG
+// Geocentric radius of anything within 100 km of the ellipsoid
+#define GEO_ECEF_MIN_M 6256000.0
+#define GEO_ECEF_MAX_M 6478000.0
+
+int64_t geo_parse_nmea_coord(const char *value, const char *hemisphere) {
+    if (!value || !value[0]) return 0;
+    int64_t whole = 0;
+    const char *c = value;
+    while (*c >= '0' && *c <= '9') whole = whole * 10 + (*c++ - '0');
+    // Minutes in 1e-10 min: one degree is 600 units of 1e-9 deg per 1e-10 min
+    int64_t min = (whole % 100) * 10000000000LL;
+    if (*c == '.') {
+        int64_t scale = 1000000000LL;
+        for (c++; *c >= '0' && *c <= '9' && scale; c++, scale /= 10) min += (*c - '0') * scale;
+    }
+    int64_t deg = (whole / 100) * GEO_UNITS_PER_DEG + (min + 300) / 600;
+    if (hemisphere && (hemisphere[0] == 'S' || hemisphere[0] == 'W')) deg = -deg;
+    return deg;
+}
+
+void geo_from_pvt(const ubx_nav_pvt_t *pvt, geo_pos_t *pos) {
+    pos->lat = (int64_t)pvt->lat * 100;
+    pos->lon = (int64_t)pvt->lon * 100;
+    pos->height = pvt->height;
+}
+
+void geo_from_hpposllh(const ubx_nav_hpposllh_t *hp, geo_pos_t *pos) {
+    pos->lat = (int64_t)hp->lat * 100 + hp->latHp;
+    pos->lon = (int64_t)hp->lon * 100 + hp->lonHp;
+    // heightHp is 0.1 mm, -9..9: round to the nearest mm
+    pos->height = hp->height + (hp->heightHp >= 5 ? 1 : hp->heightHp <= -5 ? -1 : 0);
+}
+
+int geo_from_ecef(int64_t x, int64_t y, int64_t z, geo_pos_t *pos) {
+    double xm = x * 1e-4, ym = y * 1e-4, zm = z * 1e-4;
+    double r = sqrt(xm * xm + ym * ym + zm * zm);
+    if (r < GEO_ECEF_MIN_M || r > GEO_ECEF_MAX_M) return -1;
+    double p = sqrt(xm * xm + ym * ym);
+    double lat = atan2(zm, p * (1.0 - WGS84_E2));
+    double h = 0.0;
+    for (int i = 0; i < 5; i++) {
+        double s = sin(lat), c = cos(lat);
+        double n = WGS84_A / sqrt(1.0 - WGS84_E2 * s * s);
+        // Well conditioned at every latitude, unlike p / cos(lat) - n
+        h = p * c + zm * s - WGS84_A * WGS84_A / n;
+        lat = atan2(zm, p * (1.0 - WGS84_E2 * n / (n + h)));
+    }
+    pos->lat = llround(lat * (180.0 / M_PI) * GEO_UNITS_PER_DEG);
+    pos->lon = llround(atan2(ym, xm) * (180.0 / M_PI) * GEO_UNITS_PER_DEG);
+    pos->height = (int32_t)lround(h * 1000.0);
+    return 0;
+}
+
+int geo_format_deg(char *buf, size_t size, int64_t deg, int decimals) {
+    if (decimals < 0) decimals = 0;
+    if (decimals > 9) decimals = 9;
+    int64_t scale = GEO_UNITS_PER_DEG, half = 0;
+    for (int i = 0; i < decimals; i++) scale /= 10;
+    if (scale > 1) half = scale / 2;
+    uint64_t mag = (uint64_t)(deg < 0 ? -deg : deg) + (uint64_t)half;
+    uint64_t units = mag / GEO_UNITS_PER_DEG;
+    uint64_t frac = mag % GEO_UNITS_PER_DEG / (uint64_t)scale;
+    if (decimals == 0) return snprintf(buf, size, "%s%llu", deg < 0 ? "-" : "", (unsigned long long)units);
+    return snprintf(buf, size, "%s%llu.%0*llu", deg < 0 ? "-" : "", (unsigned long long)units, decimals,
+                    (unsigned long long)frac);
+}
+
+void geo_ltp_init(geo_ltp_t *ltp, const geo_pos_t *origin) {
+    double lat = (double)origin->lat / GEO_UNITS_PER_DEG * (M_PI / 180.0);
+    double s = sin(lat), c = cos(lat);
+    double w = 1.0 - WGS84_E2 * s * s;
+    double n = WGS84_A / sqrt(w);
+    double m = n * (1.0 - WGS84_E2) / w;      // meridian radius of curvature
+    double h = origin->height * 1e-3;
+    double mm_per_unit = M_PI / 180.0 / GEO_UNITS_PER_DEG * 1000.0 * 281474976710656.0;
+    ltp->origin = *origin;
+    ltp->east_scale = llround((n + h) * c * mm_per_unit);
+    ltp->north_scale = llround((m + h) * mm_per_unit);
+    ltp->sin_lat = (float)s;
+    ltp->cos_lat = (float)c;
+    ltp->n = (float)n;
+    ltp->a = (float)(n + h);
+    ltp->b = (float)(n * (1.0 - WGS84_E2) + h);
+    ltp->w = (float)w;
+    ltp->dn_du = (float)(n * WGS84_E2 * s * c / w);
+}
+
+// 1 - cos(x) without the cancellation
+static float versin(float x) {
+    float s = sinf(0.5f * x);
+    return 2.0f * s * s;
+}
+
+// sin(x) - x without the cancellation, |x| up to GEO_LTP_MAX_DEG
+static float sin_minus(float x) {
+    float x2 = x * x;
+    return -x * x2 * (1.0f / 6.0f) * (1.0f - x2 * (1.0f / 20.0f) * (1.0f - x2 * (1.0f / 42.0f)));
+}
+
+// Linear part d * scale (16.48 mm per unit) plus a float remainder, to the
+// nearest mm. The product is formed in 32.32 without overflowing 64 bits
+static int32_t to_mm(int64_t d, int64_t scale, float rest_m) {
+    int64_t linear = d * (scale >> 16) + ((d * (scale & 0xffff)) >> 16);
+    int64_t whole = linear >> 32;
+    float frac = (float)(uint32_t)linear * (1.0f / 4294967296.0f);
+    return (int32_t)(whole + (int64_t)floorf(frac + rest_m * 1000.0f + 0.5f));
+}
+
+// Every float term below is second order in the offset: the exact ECEF
+// rotation with the linear part (east_scale, north_scale, dh) taken out
+int geo_ltp_enu(const geo_ltp_t *ltp, const geo_pos_t *pos, geo_enu_t *enu) {
+    const int64_t max = GEO_LTP_MAX_DEG * GEO_UNITS_PER_DEG;
+    int64_t dlat = pos->lat - ltp->origin.lat;
+    int64_t dlon = pos->lon - ltp->origin.lon;
+    if (dlon > 180 * GEO_UNITS_PER_DEG) dlon -= 360 * GEO_UNITS_PER_DEG;
+    else if (dlon < -180 * GEO_UNITS_PER_DEG) dlon += 360 * GEO_UNITS_PER_DEG;
+    if (dlat > max || dlat < -max || dlon > max || dlon < -max) return -1;
+    int32_t dh_mm = pos->height - ltp->origin.height;
+
+    const float e2 = (float)WGS84_E2;
+    float S = ltp->sin_lat, C = ltp->cos_lat;
+    float u = (float)dlat * RAD_PER_UNIT;
+    float v = (float)dlon * RAD_PER_UNIT;
+    float dh = (float)dh_mm * 1e-3f;
+
+    // Latitude sine and cosine as changes from the origin's
+    float su_u = sin_minus(u), su = u + su_u, ku = versin(u);
+    float ds = C * su - S * ku;
+    float dc = -S * su - C * ku;
+    float sin_lat = S + ds, cos_lat = C + dc;
+
+    // Radius of curvature n = a / sqrt(w): linear part and the rest
+    float x = -e2 * ds * (sin_lat + S) / ltp->w;
+    float dn_lin = ltp->dn_du * u;
+    float dn_rest = ltp->n * (e2 / ltp->w * (S * (C * su_u - S * ku) + 0.5f * ds * ds) +
+                              x * x * (0.375f - 0.3125f * x));
+    float dn = dn_lin + dn_rest;
+
+    float a = ltp->a + dn + dh;               // n + h at the point
+    float acos_lat = a * cos_lat;
+    float kv = versin(v), sv_v = sin_minus(v), sv = v + sv_v;
+
+    float east = ltp->a * C * sv_v + (ltp->a * dc + (dn + dh) * cos_lat) * sv;
+    float north = (ltp->a * S * S + ltp->b * C * C) * su_u + ltp->n * e2 * S * C * ku + dh * su + dn * su -
+                  e2 * C * (dn_rest * sin_lat + dn_lin * ds) + S * acos_lat * kv;
+    float up = -dh * ku + ltp->w * dn_rest - ltp->n * e2 * S * C * su_u - dn * ku - e2 * S * ds * dn -
+               (ltp->a * C * C + ltp->b * S * S) * ku - C * acos_lat * kv;
+
+    enu->east = to_mm(dlon, ltp->east_scale, east);
+    enu->north = to_mm(dlat, ltp->north_scale, north);
+    enu->up = dh_mm + (int32_t)floorf(up * 1000.0f + 0.5f);
+    return 0;
+}
+
+static uint32_t isqrt_round(uint64_t v) {
+    uint64_t r = (uint64_t)sqrtf((float)v);
+    while (r * r > v) r--;
+    while ((r + 1) * (r + 1) <= v) r++;
+    // Nearest: v - r^2 > r means v is past (r + 1/2)^2
+    return (uint32_t)(v - r * r > r ? r + 1 : r);
+}
+
+uint32_t geo_enu_distance(const geo_enu_t *enu) {
+    return isqrt_round((uint64_t)((int64_t)enu->east * enu->east + (int64_t)enu->north * enu->north +
+                                  (int64_t)enu->up * enu->up));
+}
+
+uint32_t geo_enu_horizontal(const geo_enu_t *enu) {
+    return isqrt_round((uint64_t)((int64_t)enu->east * enu->east + (int64_t)enu->north * enu->north));
+}
+
+float geo_enu_bearing(const geo_enu_t *enu) {
+    float deg = atan2f((float)enu->east, (float)enu->north) * (180.0f / (float)M_PI);
+    return deg < 0.0f ? deg + 360.0f : deg;
+}
+
+int geo_enu_within(const geo_enu_t *enu, uint32_t radius_mm) {
+    return (int64_t)enu->east * enu->east + (int64_t)enu->north * enu->north < (int64_t)radius_mm * radius_mm;
+}
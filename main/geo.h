@@ -0,0 +1,76 @@
+#ifndef GEO_H
+#define GEO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "ubx.h"
+
+// Fixed-point geodesy for the rover's per-epoch work. Positions are 64-bit
+// integers in 1e-9 degree (0.1 mm of latitude), parsed straight from NMEA
+// text and UBX fields, so no per-epoch path needs double arithmetic, which
+// the ESP32 FPU does not have. Offsets from a base point go through a local
+// tangent plane set up once per base point (the only double math here). The
+// offset is the exact WGS84 ECEF rotation, not a flat-Earth approximation,
+// split in two: the part linear in the latitude and longitude difference is
+// an integer multiply by a precomputed 16.48 fixed-point scale, and only the
+// curvature terms, metres where the baseline is kilometres, are single
+// precision. ENU comes out in integer millimetres, within 1 mm plus 0.02 ppm
+// of the baseline of the double computation (host/geo_bench checks it). No
+// ESP-IDF calls, see base_pipeline.h.
+
+#define GEO_UNITS_PER_DEG 1000000000LL
+#define GEO_LTP_MAX_DEG   10      // farthest point geo_ltp_enu() takes
+
+typedef struct {
+    int64_t lat;              // 1e-9 deg, +N
+    int64_t lon;              // 1e-9 deg, +E
+    int32_t height;           // mm above the ellipsoid
+} geo_pos_t;
+
+typedef struct {
+    int32_t east;             // mm
+    int32_t north;
+    int32_t up;
+} geo_enu_t;
+
+// Local tangent plane at a base point
+typedef struct {
+    geo_pos_t origin;
+    int64_t east_scale;       // mm per unit of longitude, 16.48
+    int64_t north_scale;      // mm per unit of latitude, 16.48
+    float sin_lat;
+    float cos_lat;
+    float n;                  // prime vertical radius of curvature, m
+    float a;                  // n + h
+    float b;                  // n (1 - e^2) + h
+    float w;                  // 1 - e^2 sin^2(lat)
+    float dn_du;              // linear change of n with latitude, m/rad
+} geo_ltp_t;
+
+// NMEA ddmm.mmmm / dddmm.mmmm field plus N/S/E/W, up to 10 decimals of
+// minutes; 0 for an empty field
+int64_t geo_parse_nmea_coord(const char *value, const char *hemisphere);
+void geo_from_pvt(const ubx_nav_pvt_t *pvt, geo_pos_t *pos);
+// Full resolution; hp must be valid (flags bit 0 clear)
+void geo_from_hpposllh(const ubx_nav_hpposllh_t *hp, geo_pos_t *pos);
+// ECEF in 0.1 mm, as RTCM 1005/1006 carry the base antenna position. Double
+// precision: meant for the rare base point change, not per epoch. -1 for a
+// point nowhere near the Earth's surface, such as the zeros a base sends
+// before its survey-in completes
+int geo_from_ecef(int64_t x, int64_t y, int64_t z, geo_pos_t *pos);
+// "-12.345678901" with decimals (0..9) digits after the point; returns the length
+int geo_format_deg(char *buf, size_t size, int64_t deg, int decimals);
+
+void geo_ltp_init(geo_ltp_t *ltp, const geo_pos_t *origin);
+// East/north/up offset of pos from the plane's origin; -1 when pos is more
+// than GEO_LTP_MAX_DEG away
+int geo_ltp_enu(const geo_ltp_t *ltp, const geo_pos_t *pos, geo_enu_t *enu);
+// Rounded to the millimetre, integer square root
+uint32_t geo_enu_distance(const geo_enu_t *enu);
+uint32_t geo_enu_horizontal(const geo_enu_t *enu);
+// Degrees clockwise from true north, 0..360
+float geo_enu_bearing(const geo_enu_t *enu);
+// Horizontal distance from the origin below radius_mm, without a square root
+int geo_enu_within(const geo_enu_t *enu, uint32_t radius_mm);
+
+#endif // GEO_H
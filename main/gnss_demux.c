@@ -0,0 +1,131 @@
+#include "gnss_demux.h"
+#include <string.h>
+
+enum {
+    DEMUX_IDLE = 0,
+    DEMUX_NMEA,
+    DEMUX_UBX,
+    DEMUX_RTCM,
+};
+
+void gnss_demux_init(gnss_demux_t *d, const gnss_demux_targets_t *targets) {
+    memset(d, 0, sizeof(*d));
+    if (targets) d->targets = *targets;
+}
+
+static void deliver(gnss_demux_t *d, uint8_t state, const uint8_t *data, size_t len) {
+    if (len == 0) return;
+    const gnss_demux_targets_t *t = &d->targets;
+    switch (state) {
+    case DEMUX_NMEA:
+        d->nmea_bytes += len;
+        if (t->nmea) nmea_parser_feed(t->nmea, data, len);
+        break;
+    case DEMUX_UBX:
+        d->ubx_bytes += len;
+        if (t->ubx) ubx_parser_feed(t->ubx, data, len);
+        break;
+    case DEMUX_RTCM:
+        d->rtcm_bytes += len;
+        if (t->rtcm) rtcm3_framer_feed(t->rtcm, data, len, t->rtcm_cb, t->rtcm_ctx);
+        break;
+    }
+}
+
+// Returns 1 if c belongs to the current message, 0 if the message was
+// abandoned before c (c must then be looked at again from DEMUX_IDLE).
+// Sets *done when c was the last byte of the message.
+static int step(gnss_demux_t *d, uint8_t c, int *done) {
+    *done = 0;
+    switch (d->state) {
+    case DEMUX_NMEA:
+        if (c == '$' || (c < 0x20 && c != '\r' && c != '\n') || c > 0x7E ||
+            ++d->nmea_len > NMEA_MAX_LINE + 4) {
+            return 0;
+        }
+        *done = (c == '\n');
+        return 1;
+
+    case DEMUX_UBX:
+        if (d->hdr_len < UBX_HEADER_LEN) {
+            d->hdr[d->hdr_len++] = c;
+            if (d->hdr_len == 2 && c != UBX_SYNC2) return 0;
+            if (d->hdr_len == UBX_HEADER_LEN) {
+                size_t payload = d->hdr[4] | ((size_t)d->hdr[5] << 8);
+                // B5 62 inside RTCM or after an overrun: an unchecked length
+                // would swallow up to 64 KB of whatever follows
+                if (payload > UBX_MAX_PAYLOAD) {
+                    d->ubx_resync++;
+                    return 0;
+                }
+                d->remaining = payload + UBX_CHECKSUM_LEN;
+            }
+            return 1;
+        }
+        *done = (--d->remaining == 0);
+        return 1;
+
+    case DEMUX_RTCM:
+        if (d->hdr_len < RTCM3_HEADER_LEN) {
+            d->hdr[d->hdr_len++] = c;
+            if (d->hdr_len == 2 && (c & 0xFC)) return 0;
+            if (d->hdr_len == RTCM3_HEADER_LEN) {
+                d->remaining = rtcm3_payload_len(d->hdr) + RTCM3_CRC_LEN;
+            }
+            return 1;
+        }
+        *done = (--d->remaining == 0);
+        return 1;
+    }
+    return 0;
+}
+
+void gnss_demux_feed(gnss_demux_t *d, const uint8_t *data, size_t len) {
+    size_t run_start = 0;
+    size_t i = 0;
+
+    while (i < len) {
+        uint8_t c = data[i];
+
+        if (d->state == DEMUX_IDLE) {
+            if (c == '$') {
+                d->state = DEMUX_NMEA;
+                d->nmea_len = 1;
+            } else if (c == UBX_SYNC1) {
+                d->state = DEMUX_UBX;
+                d->hdr[0] = c;
+                d->hdr_len = 1;
+            } else if (c == RTCM3_PREAMBLE) {
+                d->state = DEMUX_RTCM;
+                d->hdr[0] = c;
+                d->hdr_len = 1;
+            } else {
+                d->unknown_bytes++;
+            }
+            i++;
+            run_start = d->state == DEMUX_IDLE ? i : i - 1;
+            continue;
+        }
+
+        int done;
+        if (!step(d, c, &done)) {
+            // Not the protocol it looked like: hand over what we had and
+            // re-examine this byte as a possible message start.
+            deliver(d, d->state, data + run_start, i - run_start);
+            d->state = DEMUX_IDLE;
+            run_start = i;
+            continue;
+        }
+        i++;
+        if (done) {
+            deliver(d, d->state, data + run_start, i - run_start);
+            d->state = DEMUX_IDLE;
+            run_start = i;
+        }
+    }
+
+    // Message continues in the next chunk
+    if (d->state != DEMUX_IDLE) {
+        deliver(d, d->state, data + run_start, len - run_start);
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef GNSS_DEMUX_H
+#define GNSS_DEMUX_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "nmea_parser.h"
+#include "ubx.h"
+#include "rtcm3.h"
+
+// Splits the mixed NMEA / UBX / RTCM3 byte stream coming out of a ZED-F9P
+// UART and hands each message's bytes, in runs, to the matching parser.
+// Message boundaries are found from the protocol headers only; the parsers
+// still validate checksums. A UBX length over UBX_MAX_PAYLOAD is taken as a
+// false sync and the demux starts looking again at the length's last byte.
+// Any target may be left NULL to discard it.
+
+typedef struct {
+    nmea_parser_t *nmea;
+    ubx_parser_t *ubx;
+    rtcm3_framer_t *rtcm;
+    rtcm3_frame_cb_t rtcm_cb;
+    void *rtcm_ctx;
+} gnss_demux_targets_t;
+
+typedef struct {
+    gnss_demux_targets_t targets;
+    uint8_t state;
+    uint8_t hdr[UBX_HEADER_LEN];  // header bytes seen so far for UBX/RTCM
+    size_t hdr_len;
+    size_t remaining;             // bytes left in the current binary message
+    size_t nmea_len;
+    uint32_t nmea_bytes;
+    uint32_t ubx_bytes;
+    uint32_t rtcm_bytes;
+    uint32_t unknown_bytes;       // bytes outside any recognised message
+    uint32_t ubx_resync;          // UBX headers with a length over UBX_MAX_PAYLOAD, dropped
+} gnss_demux_t;
+
+void gnss_demux_init(gnss_demux_t *d, const gnss_demux_targets_t *targets);
+void gnss_demux_feed(gnss_demux_t *d, const uint8_t *data, size_t len);
+
+#endif // GNSS_DEMUX_H
@@ -0,0 +1,300 @@
+#include "link_adapt.h"
+#include <string.h>
+
+_Static_assert(sizeof(link_adapt_report_t) <= LINK_MAX_PACKET, "link adapt report size");
+
+const link_adapt_rate_t link_adapt_rates[LINK_ADAPT_RATES] = {
+    { "LR 250k", 250, -105, 1 },
+    { "LR 500k", 500, -102, 1 },
+    { "1M", 1000, -97, 0 },
+    { "2M", 2000, -94, 0 },
+    { "6M", 6000, -93, 0 },
+    { "12M", 12000, -89, 0 },
+    { "24M", 24000, -84, 0 },
+    { "36M", 36000, -80, 0 },
+    { "54M", 54000, -75, 0 },
+};
+
+static void fill_hdr(link_adapt_hdr_t *h, uint8_t type, const link_adapt_io_t *io) {
+    h->version = LINK_PACKET_VERSION;
+    h->flags = LINK_FLAG_CONTROL;
+    h->type = type;
+    h->channel = io->channel;
+    h->source = io->source;
+}
+
+static uint8_t channel_after(const link_adapt_io_t *io, uint8_t channel) {
+    for (uint8_t i = 0; i < io->channel_count; i++) {
+        if (io->channels[i] == channel) return io->channels[(i + 1) % io->channel_count];
+    }
+    return io->channels[0];
+}
+
+static void set_rate(link_adapt_base_t *a, uint8_t rate) {
+    if (rate == a->rate) return;
+    if (rate > a->rate) a->stats.ups++;
+    else a->stats.downs++;
+    a->probing = rate > a->rate;
+    a->rate = rate;
+    a->good_windows = 0;
+    a->settle = 1;              // the next report straddles the change
+    if (a->io.set_rate) a->io.set_rate(rate, a->io.ctx);
+}
+
+void link_adapt_base_init(link_adapt_base_t *a, const link_adapt_io_t *io, int64_t now_us) {
+    memset(a, 0, sizeof(*a));
+    a->io = *io;
+    if (a->io.channel_count > LINK_ADAPT_MAX_CHANNELS) a->io.channel_count = LINK_ADAPT_MAX_CHANNELS;
+    a->rate = LINK_ADAPT_RATE_DEFAULT;
+    a->last_report_us = now_us;
+    a->last_hop_us = now_us;
+    a->stats.rssi_avg = a->stats.rssi_min = LINK_ADAPT_RSSI_NONE;
+    a->heard_rssi_min = LINK_ADAPT_RSSI_NONE;
+    if (a->io.set_rate) a->io.set_rate(a->rate, a->io.ctx);
+}
+
+static int can_move(const link_adapt_base_t *a) {
+    return a->io.set_channel && a->io.channel_count > 1 && !a->announces_left && !a->switch_at_us;
+}
+
+static void start_move(link_adapt_base_t *a, int64_t now_us) {
+    a->next_channel = channel_after(&a->io, a->io.channel);
+    a->change_id++;
+    a->announces_left = LINK_ADAPT_ANNOUNCES;
+    a->next_announce_us = now_us;
+    a->switch_at_us = now_us + LINK_ADAPT_SWITCH_DELAY_MS * 1000LL;
+    a->bad_windows = 0;
+}
+
+// A rate given up is not tried again for a while, twice as long each time
+static void back_off(link_adapt_base_t *a, int64_t now_us) {
+    uint32_t hold = a->hold_ms[a->rate] ? a->hold_ms[a->rate] * 2 : LINK_ADAPT_PROBE_HOLD_MS;
+    a->hold_ms[a->rate] = hold < LINK_ADAPT_PROBE_HOLD_MAX_MS ? hold : LINK_ADAPT_PROBE_HOLD_MAX_MS;
+    a->hold_until_us[a->rate] = now_us + a->hold_ms[a->rate] * 1000LL;
+}
+
+// The weakest packet of the window had margin for this rate
+static int signal_ok(int8_t rssi_min, uint8_t rate) {
+    return rssi_min != LINK_ADAPT_RSSI_NONE && rssi_min >= link_adapt_rates[rate].sensitivity_dbm + LINK_ADAPT_MARGIN_DB;
+}
+
+static void evaluate(link_adapt_base_t *a, uint32_t expected, uint32_t received, int8_t rssi_min, int64_t now_us) {
+    uint16_t loss = (uint16_t)((expected - received) * 1000 / expected);
+    uint8_t up = a->rate + 1;
+    int can_up = up < LINK_ADAPT_RATES && now_us >= a->hold_until_us[up] && signal_ok(rssi_min, up);
+    // Loss with a strong signal is collisions (interference), not range: a slower
+    // rate only keeps each packet on the air longer
+    int collisions = signal_ok(rssi_min, a->rate);
+    a->stats.windows++;
+    a->stats.windows_at[a->rate]++;
+    a->stats.loss_permille = loss;
+
+    if (loss >= LINK_ADAPT_DOWN_PERMILLE) {
+        if (a->probing) a->stats.failed_probes++;
+        a->good_windows = 0;
+        if (collisions) {
+            a->stats.collision_windows++;
+            if (can_up) set_rate(a, up);
+        } else {
+            back_off(a, now_us);
+            uint8_t step = loss >= LINK_ADAPT_DROP_PERMILLE ? 2 : 1;
+            set_rate(a, a->rate > step ? a->rate - step : 0);
+        }
+    } else if (loss <= LINK_ADAPT_UP_PERMILLE) {
+        a->probing = 0;
+        a->good_windows++;
+        // Held long enough to count as a rate that works here
+        if (a->good_windows >= LINK_ADAPT_STABLE_WINDOWS) a->hold_ms[a->rate] = 0;
+        if (a->good_windows >= LINK_ADAPT_UP_WINDOWS && can_up) set_rate(a, up);
+    } else {
+        a->good_windows = 0;
+    }
+
+    // Another channel may not have the interference; moving on range loss would
+    // only risk losing the rover
+    if (collisions && loss >= LINK_ADAPT_CHANNEL_PERMILLE) a->bad_windows++;
+    else a->bad_windows = 0;
+    if (a->bad_windows >= LINK_ADAPT_CHANNEL_WINDOWS && can_move(a) && now_us >= a->channel_hold_until_us) {
+        start_move(a, now_us);
+    }
+}
+
+void link_adapt_base_input(link_adapt_base_t *a, const uint8_t *msg, size_t len, uint16_t sent_seq, int64_t now_us) {
+    link_adapt_report_t r;
+    if (len < sizeof(r)) return;
+    memcpy(&r, msg, sizeof(r));
+    if (r.hdr.version != LINK_PACKET_VERSION || !(r.hdr.flags & LINK_FLAG_CONTROL) || r.hdr.type != LINK_ADAPT_MSG_REPORT) {
+        return;
+    }
+    // A rover following another base: its counts are of that base's packets
+    if (r.hdr.source != a->io.source) return;
+    a->stats.reports++;
+    a->stats.rssi_avg = r.rssi_avg;
+    a->stats.rssi_min = r.rssi_min;
+    a->last_report_us = now_us;
+    a->last_hop_us = now_us;
+    // A window with nothing heard says nothing about the signal; taking it for
+    // range loss would answer jamming with the longest packets
+    if (r.rssi_min != LINK_ADAPT_RSSI_NONE) a->heard_rssi_min = r.rssi_min;
+    if (!a->have_report) {
+        a->have_report = 1;
+    } else {
+        uint32_t received = (uint16_t)(r.rx_count - a->rx_count);
+        // Counted by sequence number; with nothing heard, by what the base sent
+        uint32_t expected = received ? (uint16_t)(r.last_seq - a->last_seq) : (uint16_t)(sent_seq - a->sent_seq);
+        if (received > expected) expected = received;
+        if (a->settle) {
+            a->settle--;
+        } else if (expected >= LINK_ADAPT_MIN_PACKETS) {
+            evaluate(a, expected, received, a->heard_rssi_min, now_us);
+        }
+    }
+    a->rx_count = r.rx_count;
+    a->last_seq = r.last_seq;
+    a->sent_seq = sent_seq;
+}
+
+void link_adapt_base_poll(link_adapt_base_t *a, int64_t now_us) {
+    if (now_us - a->last_report_us >= LINK_ADAPT_FEEDBACK_TIMEOUT_MS * 1000LL && a->rate != 0) {
+        // Nothing back from the rover: be heard as far away as possible
+        a->stats.timeouts++;
+        set_rate(a, 0);
+        a->probing = 0;
+    }
+    if (now_us - a->last_hop_us >= LINK_ADAPT_LOST_HOP_MS * 1000LL && can_move(a)) {
+        // The rover hunts on its own; a move it cannot hear still lets it find us
+        a->last_hop_us = now_us;
+        start_move(a, now_us);
+    }
+    if (a->announces_left && now_us >= a->next_announce_us) {
+        link_adapt_channel_msg_t m;
+        fill_hdr(&m.hdr, LINK_ADAPT_MSG_CHANNEL, &a->io);
+        m.next_channel = a->next_channel;
+        m.change_id = a->change_id;
+        int64_t left_ms = (a->switch_at_us - now_us) / 1000;
+        m.switch_in_ms = (uint16_t)(left_ms > 0 ? left_ms : 0);
+        if (a->io.send) a->io.send((const uint8_t *)&m, sizeof(m), a->io.ctx);
+        a->announces_left--;
+        a->next_announce_us = now_us + LINK_ADAPT_SWITCH_DELAY_MS * 1000LL / LINK_ADAPT_ANNOUNCES;
+    }
+    if (a->switch_at_us && now_us >= a->switch_at_us) {
+        a->switch_at_us = 0;
+        a->announces_left = 0;
+        a->io.channel = a->next_channel;
+        a->io.set_channel(a->io.channel, a->io.ctx);
+        a->stats.channel_moves++;
+        a->channel_hold_until_us = now_us + LINK_ADAPT_CHANNEL_HOLD_MS * 1000LL;
+        a->settle = 1;
+    }
+}
+
+void link_adapt_rover_init(link_adapt_rover_t *r, const link_adapt_io_t *io, int64_t now_us) {
+    memset(r, 0, sizeof(*r));
+    r->io = *io;
+    if (r->io.channel_count > LINK_ADAPT_MAX_CHANNELS) r->io.channel_count = LINK_ADAPT_MAX_CHANNELS;
+    r->last_rx_us = now_us;
+    r->heard_rssi_min = LINK_ADAPT_RSSI_NONE;
+    r->next_report_us = now_us + LINK_ADAPT_WINDOW_MS * 1000LL;
+    if (r->io.set_rate) r->io.set_rate(0, r->io.ctx);
+}
+
+static void rover_move(link_adapt_rover_t *r, uint8_t channel) {
+    r->io.channel = channel;
+    r->io.set_channel(channel, r->io.ctx);
+}
+
+int link_adapt_rover_input(link_adapt_rover_t *r, const uint8_t *pkt, size_t len, int64_t now_us) {
+    link_hdr_t hdr;
+    if (len < sizeof(link_adapt_hdr_t)) return 0;
+    memcpy(&hdr, pkt, len < sizeof(hdr) ? len : sizeof(hdr));
+    if (hdr.version != LINK_PACKET_VERSION) return 0;
+    if (hdr.flags & LINK_FLAG_CONTROL) {
+        r->stats.control++;
+        link_adapt_channel_msg_t m;
+        if (len >= sizeof(m)) {
+            memcpy(&m, pkt, sizeof(m));
+            // Only the followed base's messages: not another base's moves, not
+            // other rovers' reports
+            if (m.hdr.type != LINK_ADAPT_MSG_CHANNEL || m.hdr.source != r->io.source) return 1;
+            r->last_rx_us = now_us;
+            r->hunting = 0;
+            r->moved = 0;
+            if (r->io.set_channel &&
+                (!r->have_change || m.change_id != r->last_change_id)) {
+                r->have_change = 1;
+                r->last_change_id = m.change_id;
+                r->pending = 1;
+                r->pending_channel = m.next_channel;
+                r->switch_at_us = now_us + m.switch_in_ms * 1000LL;
+            }
+        }
+        return 1;
+    }
+    if (len < sizeof(hdr) || hdr.source != r->io.source) return 0;
+    r->last_rx_us = now_us;
+    r->hunting = 0;
+    r->moved = 0;
+    // Straight from the base only: relayed copies (link_relay.h) say nothing
+    // about the base's rate, and would count a sequence number twice
+    if (!(hdr.flags & LINK_FLAG_PARITY) && LINK_HOPS(hdr.hops) == 0) {
+        r->rx_count++;
+        r->last_seq = hdr.seq;
+        r->stats.data_packets++;
+    }
+    return 0;
+}
+
+void link_adapt_rover_set_source(link_adapt_rover_t *r, uint8_t source) {
+    if (source == r->io.source) return;
+    r->io.source = source;
+    // The old base's move and change ids mean nothing to the new one
+    r->pending = 0;
+    r->have_change = 0;
+}
+
+void link_adapt_rover_poll(link_adapt_rover_t *r, int64_t now_us) {
+    if (r->pending && now_us >= r->switch_at_us) {
+        r->pending = 0;
+        rover_move(r, r->pending_channel);
+        r->stats.channel_moves++;
+        r->last_rx_us = now_us;
+        r->moved = 1;
+    }
+    // Silence right after a move, or out of a strong signal, means the base is
+    // elsewhere; out of a weak one it is just out of range, and hopping away
+    // would miss it coming back. Its blind moves come LINK_ADAPT_LOST_HOP_MS apart.
+    int strong = signal_ok(r->heard_rssi_min, LINK_ADAPT_RATE_DEFAULT);
+    int64_t silence_ms = r->moved || strong ? LINK_ADAPT_SCAN_AFTER_MS : LINK_ADAPT_LOST_HOP_MS;
+    if (r->io.set_channel && r->io.channel_count > 1 && !r->pending &&
+        now_us - r->last_rx_us >= silence_ms * 1000LL) {
+        if (!r->hunting) {
+            r->hunting = 1;
+            r->next_hop_us = now_us;
+        }
+        if (now_us >= r->next_hop_us) {
+            rover_move(r, channel_after(&r->io, r->io.channel));
+            r->stats.hops++;
+            r->next_hop_us = now_us + LINK_ADAPT_DWELL_MS * 1000LL;
+        }
+    }
+    if (now_us >= r->next_report_us) {
+        r->next_report_us += LINK_ADAPT_WINDOW_MS * 1000LL;
+        if (r->next_report_us <= now_us) r->next_report_us = now_us + LINK_ADAPT_WINDOW_MS * 1000LL;
+        link_adapt_report_t m;
+        fill_hdr(&m.hdr, LINK_ADAPT_MSG_REPORT, &r->io);
+        m.rx_count = r->rx_count;
+        m.last_seq = r->last_seq;
+        int8_t rssi_avg = LINK_ADAPT_RSSI_NONE, rssi_min = LINK_ADAPT_RSSI_NONE;
+        if (r->io.read_rssi) r->io.read_rssi(&rssi_avg, &rssi_min, r->io.ctx);
+        m.rssi_avg = rssi_avg;
+        m.rssi_min = rssi_min;
+        if (rssi_min != LINK_ADAPT_RSSI_NONE) r->heard_rssi_min = rssi_min;
+        uint8_t rate = 0;
+        while (rate + 1 < LINK_ADAPT_RATES && signal_ok(rssi_min, rate + 1)) rate++;
+        if (rate != r->report_rate && r->io.set_rate) r->io.set_rate(rate, r->io.ctx);
+        r->report_rate = rate;
+        m.seq = r->report_seq++;
+        if (r->io.send) r->io.send((const uint8_t *)&m, sizeof(m), r->io.ctx);
+        r->stats.reports++;
+    }
+}
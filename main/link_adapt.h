@@ -0,0 +1,196 @@
+#ifndef LINK_ADAPT_H
+#define LINK_ADAPT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "link_packet.h"
+
+// ESP-NOW link adaptation. The rover reports what it receives from the base
+// (data packets counted by sequence number, RSSI) every LINK_ADAPT_WINDOW_MS
+// over a return channel; the base turns each report into a loss ratio and
+// steps its PHY rate along link_adapt_rates[]: down on loss, up one step after
+// LINK_ADAPT_UP_WINDOWS clean windows when the weakest packet leaves margin for
+// the faster rate. A rate stepped down from is not tried again for a hold time
+// that doubles each time. Loss while the signal is strong is taken for
+// interference: slower rates would only lengthen the packets, so the base
+// steps up if it can and otherwise stays, and when it persists announces a
+// move to the next channel; both ends switch together. With several bases
+// in range (rover_source.h) a rover follows one of them: it counts only that
+// base's packets, obeys only its moves, and addresses its reports to it; a
+// base ignores reports meant for another. A rover that goes
+// deaf right after following a move, or while the signal was strong (a move
+// it missed), hunts through the channel list on its own; silence after a weak
+// signal is range, and it keeps listening where the base is until the base
+// would move blind. Control
+// messages share the link packet version byte and carry LINK_FLAG_CONTROL, so
+// the rover can take them out before the correction pipeline. No ESP-IDF
+// calls, see base_pipeline.h; host/adapt_sim runs it against a lossy channel.
+
+#define LINK_ADAPT_RATES        9
+#define LINK_ADAPT_RATE_DEFAULT 2          // 1 Mbps, the ESP-NOW default
+
+#define LINK_ADAPT_WINDOW_MS        500    // rover report period
+#define LINK_ADAPT_MIN_PACKETS      4      // fewer packets in a window decide nothing
+#define LINK_ADAPT_DOWN_PERMILLE    100    // loss that steps the rate down
+#define LINK_ADAPT_DROP_PERMILLE    500    // loss that steps it down two
+#define LINK_ADAPT_UP_PERMILLE      20     // loss low enough to count toward a step up
+#define LINK_ADAPT_UP_WINDOWS       4
+#define LINK_ADAPT_STABLE_WINDOWS   20     // clean windows that clear a rate's hold time
+#define LINK_ADAPT_MARGIN_DB        6      // weakest packet above the faster rate's sensitivity
+#define LINK_ADAPT_PROBE_HOLD_MS    2000   // after stepping down from a rate, doubling each time
+#define LINK_ADAPT_PROBE_HOLD_MAX_MS 60000
+#define LINK_ADAPT_FEEDBACK_TIMEOUT_MS 3000 // no report: fall back to the most robust rate
+#define LINK_ADAPT_CHANNEL_PERMILLE 300    // collision loss that moves channel
+#define LINK_ADAPT_CHANNEL_WINDOWS  8
+#define LINK_ADAPT_CHANNEL_HOLD_MS  30000  // between channel moves
+#define LINK_ADAPT_LOST_HOP_MS      30000  // base: no report for this long, try the next channel
+#define LINK_ADAPT_SWITCH_DELAY_MS  300    // announced ahead of a channel move
+#define LINK_ADAPT_ANNOUNCES        3
+#define LINK_ADAPT_SCAN_AFTER_MS    4000   // rover: silence after a move or a strong signal before hunting
+#define LINK_ADAPT_DWELL_MS         1500   // rover: per channel while hunting
+#define LINK_ADAPT_MAX_CHANNELS     4
+#define LINK_ADAPT_RSSI_NONE        (-128)
+
+typedef struct {
+    const char *name;
+    uint16_t kbps;
+    int8_t sensitivity_dbm;       // ESP32 datasheet, 10% PER
+    uint8_t long_range;           // Espressif LR mode: both ends need WIFI_PROTOCOL_LR
+} link_adapt_rate_t;
+
+// Most robust first
+extern const link_adapt_rate_t link_adapt_rates[LINK_ADAPT_RATES];
+
+enum {
+    LINK_ADAPT_MSG_REPORT = 1,    // rover -> base
+    LINK_ADAPT_MSG_CHANNEL,       // base -> rover
+};
+
+typedef struct __attribute__((packed)) {
+    uint8_t version;              // LINK_PACKET_VERSION
+    uint8_t flags;                // LINK_FLAG_CONTROL
+    uint8_t type;                 // LINK_ADAPT_MSG_*
+    uint8_t channel;              // sender's channel
+    uint8_t source;               // LINK_BASE_ID: the sending base, or the base a report is for
+} link_adapt_hdr_t;
+
+typedef struct __attribute__((packed)) {
+    link_adapt_hdr_t hdr;
+    uint16_t rx_count;            // data packets received, running count
+    uint16_t last_seq;            // newest data seq received
+    int8_t rssi_avg;              // LINK_ADAPT_RSSI_NONE when nothing was heard
+    int8_t rssi_min;              // since the previous report
+    uint8_t seq;
+} link_adapt_report_t;
+
+typedef struct __attribute__((packed)) {
+    link_adapt_hdr_t hdr;
+    uint8_t next_channel;
+    uint8_t change_id;            // same for every announcement of one move
+    uint16_t switch_in_ms;
+} link_adapt_channel_msg_t;
+
+typedef struct {
+    // Apply a rate index of link_adapt_rates[]: base data, rover reports
+    void (*set_rate)(uint8_t rate, void *ctx);
+    // NULL when the channel is fixed (Wi-Fi associated with an AP)
+    void (*set_channel)(uint8_t channel, void *ctx);
+    void (*send)(const uint8_t *msg, size_t len, void *ctx);
+    // Rover: average and weakest RSSI since the previous call, LINK_ADAPT_RSSI_NONE when none
+    void (*read_rssi)(int8_t *avg, int8_t *min, void *ctx);
+    void *ctx;
+    const uint8_t *channels;      // both ends need the same list
+    uint8_t channel_count;
+    uint8_t channel;              // current channel, one of channels[]
+    uint8_t source;               // base: its LINK_BASE_ID; rover: the base to follow
+} link_adapt_io_t;
+
+typedef struct {
+    uint32_t reports;
+    uint32_t windows;             // reports that carried a decision
+    uint32_t ups;
+    uint32_t downs;
+    uint32_t failed_probes;
+    uint32_t collision_windows;   // lossy with a strong signal: interference
+    uint32_t timeouts;
+    uint32_t channel_moves;
+    uint32_t windows_at[LINK_ADAPT_RATES];
+    uint16_t loss_permille;       // last window
+    int8_t rssi_avg;
+    int8_t rssi_min;
+} link_adapt_base_stats_t;
+
+typedef struct {
+    link_adapt_io_t io;
+    uint8_t rate;
+    uint8_t good_windows;
+    uint8_t bad_windows;          // consecutive collision windows
+    uint8_t settle;               // reports to skip after a change
+    uint8_t probing;              // the current rate was reached by stepping up
+    uint8_t have_report;
+    uint16_t rx_count;            // previous report
+    uint16_t last_seq;
+    uint16_t sent_seq;            // base data seq at the previous report
+    int8_t heard_rssi_min;        // last report from a window with packets in it
+    int64_t last_report_us;
+    int64_t last_hop_us;
+    int64_t hold_until_us[LINK_ADAPT_RATES];
+    uint32_t hold_ms[LINK_ADAPT_RATES];
+    // Channel move in progress
+    uint8_t next_channel;
+    uint8_t change_id;
+    uint8_t announces_left;
+    int64_t switch_at_us;
+    int64_t next_announce_us;
+    int64_t channel_hold_until_us;
+    link_adapt_base_stats_t stats;
+} link_adapt_base_t;
+
+typedef struct {
+    uint32_t reports;
+    uint32_t data_packets;
+    uint32_t control;
+    uint32_t channel_moves;
+    uint32_t hops;                // channels tried while hunting
+} link_adapt_rover_stats_t;
+
+typedef struct {
+    link_adapt_io_t io;
+    uint16_t rx_count;
+    uint16_t last_seq;
+    uint8_t report_seq;
+    uint8_t report_rate;          // the fastest the base's packets leave margin for
+    uint8_t have_change;
+    uint8_t last_change_id;
+    uint8_t pending;              // a channel move is scheduled
+    uint8_t pending_channel;
+    uint8_t hunting;
+    uint8_t moved;                // followed a move, nothing heard since
+    int8_t heard_rssi_min;        // last report window with packets in it
+    int64_t switch_at_us;
+    int64_t last_rx_us;
+    int64_t next_report_us;
+    int64_t next_hop_us;
+    link_adapt_rover_stats_t stats;
+} link_adapt_rover_t;
+
+// Base: applies LINK_ADAPT_RATE_DEFAULT through io->set_rate
+void link_adapt_base_init(link_adapt_base_t *a, const link_adapt_io_t *io, int64_t now_us);
+// A message from the rover; sent_seq is the next data seq the base will send
+void link_adapt_base_input(link_adapt_base_t *a, const uint8_t *msg, size_t len, uint16_t sent_seq, int64_t now_us);
+// Report timeout and channel move timing
+void link_adapt_base_poll(link_adapt_base_t *a, int64_t now_us);
+
+void link_adapt_rover_init(link_adapt_rover_t *r, const link_adapt_io_t *io, int64_t now_us);
+// Every packet from the ESP-NOW path. Returns 1 for a control message, which
+// is not for the correction pipeline
+int link_adapt_rover_input(link_adapt_rover_t *r, const uint8_t *pkt, size_t len, int64_t now_us);
+// Follow another base (link header source byte): the one the rover takes its
+// corrections from
+void link_adapt_rover_set_source(link_adapt_rover_t *r, uint8_t source);
+// Sends the report when due, applies announced channel moves, hunts when silent.
+// Reports go at the fastest rate the weakest packet from the base leaves margin
+// for: short on the air when interference is the problem, long range otherwise
+void link_adapt_rover_poll(link_adapt_rover_t *r, int64_t now_us);
+
+#endif // LINK_ADAPT_H
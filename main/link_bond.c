@@ -0,0 +1,181 @@
+#include "link_bond.h"
+#include "link_clock.h"
+#include <string.h>
+
+void link_bond_tx_init(link_bond_tx_t *b) {
+    memset(b, 0, sizeof(*b));
+}
+
+int link_bond_tx_add_path(link_bond_tx_t *b, const char *name, link_output_fn_t send, link_path_ready_fn_t ready) {
+    if (b->count == LINK_BOND_MAX_PATHS || !send) return -1;
+    link_bond_tx_path_t *p = &b->paths[b->count];
+    memset(p, 0, sizeof(*p));
+    p->name = name;
+    p->send = send;
+    p->ready = ready;
+    return b->count++;
+}
+
+void link_bond_send(link_bond_tx_t *b, const uint8_t *pkt, size_t len) {
+    int sent = 0;
+    for (uint8_t i = 0; i < b->count; i++) {
+        link_bond_tx_path_t *p = &b->paths[i];
+        if (p->ready && !p->ready()) {
+            p->skipped++;
+            continue;
+        }
+        p->send(pkt, len);
+        p->sent++;
+        sent = 1;
+    }
+    // Nothing reports ready: still try the primary path rather than go silent
+    if (!sent && b->count > 0) {
+        b->paths[0].send(pkt, len);
+        b->paths[0].sent++;
+    }
+}
+
+void link_bond_rx_init(link_bond_rx_t *b) {
+    memset(b, 0, sizeof(*b));
+}
+
+int link_bond_rx_add_path(link_bond_rx_t *b, const char *name) {
+    if (b->count == LINK_BOND_MAX_PATHS) return -1;
+    link_bond_rx_path_t *p = &b->paths[b->count];
+    memset(p, 0, sizeof(*p));
+    p->name = name;
+    p->delivery_permille = 1000;
+    p->state = LINK_PATH_DOWN;   // until the first packet arrives
+    return b->count++;
+}
+
+// A seq leaves the window: charge every path that did or did not carry it
+static void account_slot(link_bond_rx_t *b, const link_bond_slot_t *s) {
+    for (uint8_t i = 0; i < b->count; i++) {
+        link_bond_rx_path_t *p = &b->paths[i];
+        int got = (s->paths >> i) & 1;
+        p->expected++;
+        p->delivered += got;
+        p->window_delivered += got;
+        if (++p->window_expected == LINK_BOND_WINDOW) {
+            p->delivery_permille = (uint16_t)(p->window_delivered * 1000 / LINK_BOND_WINDOW);
+            p->window_expected = 0;
+            p->window_delivered = 0;
+        }
+    }
+}
+
+static void reset_slot(link_bond_rx_t *b, link_bond_slot_t *s, uint16_t seq, uint8_t paths, int64_t now_us) {
+    if (s->valid) account_slot(b, s);
+    s->seq = seq;
+    s->valid = 1;
+    s->paths = paths;
+    s->first_us = now_us;
+}
+
+static void lag_sample(link_bond_rx_path_t *p, int32_t lag_us) {
+    p->lag_us += (lag_us - p->lag_us) / 16;
+}
+
+int link_bond_rx_input(link_bond_rx_t *b, int path, const uint8_t *pkt, size_t len, int64_t now_us) {
+    link_hdr_t hdr;
+    if (len < sizeof(hdr)) return 0;
+    memcpy(&hdr, pkt, sizeof(hdr));
+
+    link_bond_rx_path_t *p = (path >= 0 && path < b->count) ? &b->paths[path] : NULL;
+    uint8_t bit = p ? (uint8_t)(1u << path) : 0;
+    if (p) {
+        p->received++;
+        p->last_rx_us = now_us;
+    }
+
+    if (hdr.flags & LINK_FLAG_PARITY) {
+        int i = hdr.seq % LINK_BOND_PARITY_WINDOW;
+        if (b->parity_valid[i] && b->parity_seq[i] == hdr.seq) {
+            if (p) p->duplicates++;
+            return 0;
+        }
+        b->parity_valid[i] = 1;
+        b->parity_seq[i] = hdr.seq;
+        return 1;
+    }
+
+    if (p) {
+        int32_t transit = (int32_t)(link_clock_stamp(now_us) - hdr.stamp_us);
+        if (p->first == 0 && p->duplicates == 0) p->transit_us = transit;
+        else p->transit_us += (transit - p->transit_us) / 16;
+    }
+
+    if (!b->started) {
+        b->started = 1;
+        b->newest = (uint16_t)(hdr.seq - 1);
+    }
+    int16_t ahead = (int16_t)(hdr.seq - b->newest);
+    if (ahead <= -LINK_BOND_WINDOW) {
+        b->stale++;
+        return 0;
+    }
+
+    link_bond_slot_t *s = &b->data[hdr.seq % LINK_BOND_WINDOW];
+    if (s->valid && s->seq == hdr.seq) {
+        if (s->paths == 0) {
+            // Placeholder for a seq skipped on every path: this is its first copy
+            s->paths = bit;
+            s->first_us = now_us;
+            if (p) {
+                p->first++;
+                lag_sample(p, 0);
+            }
+            return 1;
+        }
+        if (p) {
+            p->duplicates++;
+            if (!(s->paths & bit)) lag_sample(p, (int32_t)(now_us - s->first_us));
+        }
+        s->paths |= bit;
+        return 0;
+    }
+    if (ahead <= 0) {
+        // Slot already reused by a newer seq
+        b->stale++;
+        return 0;
+    }
+
+    // Seqs jumped over count as missed on every path until a copy turns up
+    int skip = ahead - 1 < LINK_BOND_WINDOW - 1 ? ahead - 1 : LINK_BOND_WINDOW - 1;
+    for (int k = skip; k > 0; k--) {
+        uint16_t m = (uint16_t)(hdr.seq - k);
+        reset_slot(b, &b->data[m % LINK_BOND_WINDOW], m, 0, now_us);
+    }
+    reset_slot(b, s, hdr.seq, bit, now_us);
+    b->newest = hdr.seq;
+    if (p) {
+        p->first++;
+        lag_sample(p, 0);
+    }
+    return 1;
+}
+
+uint32_t link_bond_rx_poll(link_bond_rx_t *b, int64_t now_us) {
+    uint32_t changed = 0;
+    for (uint8_t i = 0; i < b->count; i++) {
+        link_bond_rx_path_t *p = &b->paths[i];
+        link_path_state_t st;
+        if (p->last_rx_us == 0 || now_us - p->last_rx_us > LINK_BOND_DOWN_US) st = LINK_PATH_DOWN;
+        else if (p->delivery_permille < LINK_BOND_DEGRADED_PERMILLE) st = LINK_PATH_DEGRADED;
+        else st = LINK_PATH_UP;
+        if (st != p->state) {
+            p->state = st;
+            changed |= 1u << i;
+        }
+    }
+    return changed;
+}
+
+const char *link_bond_state_name(link_path_state_t state) {
+    switch (state) {
+        case LINK_PATH_UP: return "up";
+        case LINK_PATH_DEGRADED: return "degraded";
+        default: return "down";
+    }
+}
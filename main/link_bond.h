@@ -0,0 +1,97 @@
+#ifndef LINK_BOND_H
+#define LINK_BOND_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "link_packet.h"
+
+// Bonded delivery over several transports (ESP-NOW, UDP broadcast, MQTT).
+// The base sends every link packet on each ready path; the rover keeps the
+// first copy of each sequence number from whichever path delivers it and
+// drops the rest, so a path that fades out costs nothing while another one
+// still works. Per-path delivery ratio and latency are tracked on the rover.
+
+#define LINK_BOND_MAX_PATHS    3
+#define LINK_BOND_WINDOW       64     // data seqs remembered for dedup and delivery stats
+#define LINK_BOND_PARITY_WINDOW 16
+
+#ifndef LINK_BOND_DOWN_US
+#define LINK_BOND_DOWN_US      3000000   // path silent this long is down
+#endif
+#ifndef LINK_BOND_DEGRADED_PERMILLE
+#define LINK_BOND_DEGRADED_PERMILLE 800  // delivery ratio below this is degraded
+#endif
+
+typedef enum {
+    LINK_PATH_UP = 0,
+    LINK_PATH_DEGRADED,
+    LINK_PATH_DOWN,
+} link_path_state_t;
+
+// Base: 1 if the transport can send right now (connected, socket open)
+typedef int (*link_path_ready_fn_t)(void);
+
+typedef struct {
+    const char *name;
+    link_output_fn_t send;
+    link_path_ready_fn_t ready;   // NULL = always ready
+    uint32_t sent;
+    uint32_t skipped;             // packets not sent because the path was not ready
+} link_bond_tx_path_t;
+
+typedef struct {
+    link_bond_tx_path_t paths[LINK_BOND_MAX_PATHS];
+    uint8_t count;
+} link_bond_tx_t;
+
+typedef struct {
+    const char *name;
+    uint32_t received;            // packets, data and parity, copies included
+    uint32_t first;               // data packets this path delivered first
+    uint32_t duplicates;          // copies already delivered by another path
+    uint32_t expected;            // data seqs accounted in the delivery ratio
+    uint32_t delivered;           // of those, how many this path carried
+    uint16_t delivery_permille;   // delivery ratio over the last LINK_BOND_WINDOW seqs
+    uint16_t window_expected;
+    uint16_t window_delivered;
+    int32_t lag_us;               // EWMA delay behind the first copy
+    int32_t transit_us;           // EWMA link clock transit (stamp to arrival)
+    int64_t last_rx_us;
+    link_path_state_t state;
+} link_bond_rx_path_t;
+
+typedef struct {
+    uint16_t seq;
+    uint8_t valid;
+    uint8_t paths;                // bit per path that delivered this seq
+    int64_t first_us;
+} link_bond_slot_t;
+
+typedef struct {
+    link_bond_slot_t data[LINK_BOND_WINDOW];
+    uint16_t parity_seq[LINK_BOND_PARITY_WINDOW];
+    uint8_t parity_valid[LINK_BOND_PARITY_WINDOW];
+    link_bond_rx_path_t paths[LINK_BOND_MAX_PATHS];
+    uint8_t count;
+    uint16_t newest;              // newest data seq seen
+    int started;
+    uint32_t stale;               // packets older than the window
+} link_bond_rx_t;
+
+void link_bond_tx_init(link_bond_tx_t *b);
+// Add a transport; returns its path index or -1 when full
+int link_bond_tx_add_path(link_bond_tx_t *b, const char *name, link_output_fn_t send, link_path_ready_fn_t ready);
+// Send one packet on every ready path (on the first path if none is ready)
+void link_bond_send(link_bond_tx_t *b, const uint8_t *pkt, size_t len);
+
+void link_bond_rx_init(link_bond_rx_t *b);
+// Add a receive path; returns its index or -1 when full
+int link_bond_rx_add_path(link_bond_rx_t *b, const char *name);
+// Account one packet received on a path. Returns 1 if it is the first copy
+// and should be processed, 0 for a duplicate or stale packet
+int link_bond_rx_input(link_bond_rx_t *b, int path, const uint8_t *pkt, size_t len, int64_t now_us);
+// Update path states; returns a bit mask of paths whose state changed
+uint32_t link_bond_rx_poll(link_bond_rx_t *b, int64_t now_us);
+const char *link_bond_state_name(link_path_state_t state);
+
+#endif // LINK_BOND_H
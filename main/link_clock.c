@@ -0,0 +1,30 @@
+#include "link_clock.h"
+
+static int64_t offset_us = 0;     // GPS TOW us - local us
+static int64_t last_tag_us = 0;
+static int locked = 0;
+
+void link_clock_discipline(uint32_t gps_tow_ms, int64_t local_us) {
+    // What is left of the output delay varies from tag to tag; the largest
+    // offset corresponds to the smallest delay. Follow increases at once and
+    // decreases slowly so oscillator drift is still tracked.
+    int64_t sample = (int64_t)gps_tow_ms * 1000 - local_us;
+    int64_t diff = sample - offset_us;
+    if (!locked || diff > 1000000 || diff < -1000000) {
+        offset_us = sample;    // first tag, week rollover or clock jump
+    } else if (diff > 0) {
+        offset_us = sample;
+    } else {
+        offset_us += diff / 32;
+    }
+    locked = 1;
+    last_tag_us = local_us;
+}
+
+int link_clock_has_gps(int64_t local_us) {
+    return locked && local_us - last_tag_us < LINK_CLOCK_HOLDOVER_US;
+}
+
+uint32_t link_clock_stamp(int64_t local_us) {
+    return (uint32_t)(locked ? local_us + offset_us : local_us);
+}
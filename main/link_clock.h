@@ -0,0 +1,36 @@
+#ifndef LINK_CLOCK_H
+#define LINK_CLOCK_H
+
+#include <stdint.h>
+
+// Shared time base for packet timestamps. The local esp_timer is steered
+// onto GPS time of week from receiver time tags (MSM epoch on the base,
+// NAV-PVT iTOW on the rover). A tag only reaches the ESP32 some time after
+// its epoch: the receiver computes the message and clocks it out of the
+// UART. Each end subtracts its configured output delay below. Base stamps
+// and rover times then differ by the link latency, as far as those figures
+// are right. Left at 0, the difference also carries the base's MSM delay
+// less the rover's NAV-PVT delay: a relative figure, good for comparing
+// runs and settings, not for an absolute latency budget. Stamps are GPS TOW
+// in microseconds modulo 2^32; compare them with a signed 32 bit difference.
+
+// Time tags older than this no longer count as a GPS lock
+#define LINK_CLOCK_HOLDOVER_US 10000000
+// Receiver epoch to the end of the tag's message on the UART, measured for
+// the message set and baud rate in use (e.g. PPS against the UART on a scope)
+#ifndef LINK_CLOCK_MSM_DELAY_US
+#define LINK_CLOCK_MSM_DELAY_US 0     // base: MSM epoch
+#endif
+#ifndef LINK_CLOCK_PVT_DELAY_US
+#define LINK_CLOCK_PVT_DELAY_US 0     // rover: NAV-PVT iTOW
+#endif
+
+// Feed a receiver time tag (GPS TOW, ms) with the local time of its epoch:
+// when it was seen less the output delay
+void link_clock_discipline(uint32_t gps_tow_ms, int64_t local_us);
+// 1 if the clock has a recent GPS time tag
+int link_clock_has_gps(int64_t local_us);
+// Convert a local esp_timer value into a link stamp (GPS TOW us when locked, local us otherwise)
+uint32_t link_clock_stamp(int64_t local_us);
+
+#endif // LINK_CLOCK_H
@@ -0,0 +1,256 @@
+#include "link_fec.h"
+#include <string.h>
+
+// Offsets inside a parity packet
+#define PAR_LEN_XOR   (sizeof(link_hdr_t))
+#define PAR_HDR_XOR   (PAR_LEN_XOR + 1)
+#define PAR_DATA_XOR  (sizeof(link_hdr_t) + LINK_FEC_OVERHEAD)
+
+void link_fec_encoder_init(link_fec_encoder_t *e, uint8_t group_size, int64_t flush_us, link_output_fn_t send) {
+    memset(e, 0, sizeof(*e));
+    e->group_size = group_size > LINK_FEC_MAX_GROUP ? LINK_FEC_MAX_GROUP : group_size;
+    e->flush_us = flush_us;
+    e->send = send;
+}
+
+static void encoder_emit(link_fec_encoder_t *e) {
+    if (e->count == 0) return;
+    link_hdr_t hdr = {
+        .version = LINK_PACKET_VERSION,
+        .flags = LINK_FLAG_PARITY,
+        .seq = e->first_seq,
+        .frag_index = 0,
+        .frag_count = e->count,
+        .source = e->source,
+        .hops = e->hops,
+    };
+    memcpy(e->parity, &hdr, sizeof(hdr));
+    // Payload XOR only as long as the longest member: bytes past it are zero
+    e->send(e->parity, PAR_DATA_XOR + e->max_payload);
+    e->parity_packets++;
+    e->count = 0;
+}
+
+void link_fec_encode(link_fec_encoder_t *e, const uint8_t *pkt, size_t len, int64_t now_us) {
+    e->send(pkt, len);
+    if (e->group_size == 0 || len < sizeof(link_hdr_t) || len > LINK_MAX_PACKET) return;
+
+    link_hdr_t hdr;
+    memcpy(&hdr, pkt, sizeof(hdr));
+    if (e->count == 0) {
+        memset(e->parity, 0, sizeof(e->parity));
+        e->first_seq = hdr.seq;
+        e->first_us = now_us;
+        e->max_payload = 0;
+    }
+    if (len - sizeof(hdr) > e->max_payload) e->max_payload = (uint8_t)(len - sizeof(hdr));
+
+    // Header and payload are folded in together; version and seq of a rebuilt
+    // packet are known anyway, everything else comes back from the XOR except
+    // the hops byte, which relays change on the way
+    e->parity[PAR_LEN_XOR] ^= (uint8_t)len;
+    uint8_t *x = e->parity + PAR_HDR_XOR;
+    for (size_t i = 0; i < sizeof(hdr); i++) x[i] ^= pkt[i];
+    x = e->parity + PAR_DATA_XOR;
+    for (size_t i = sizeof(hdr); i < len; i++) x[i - sizeof(hdr)] ^= pkt[i];
+
+    if (++e->count == e->group_size) encoder_emit(e);
+}
+
+void link_fec_encoder_poll(link_fec_encoder_t *e, int64_t now_us) {
+    if (e->count > 0 && now_us - e->first_us >= e->flush_us) encoder_emit(e);
+}
+
+int64_t link_fec_encoder_next_us(const link_fec_encoder_t *e) {
+    return e->count > 0 ? e->first_us + e->flush_us : INT64_MAX;
+}
+
+void link_fec_decoder_init(link_fec_decoder_t *d, link_output_fn_t output) {
+    memset(d, 0, sizeof(*d));
+    d->output = output;
+}
+
+void link_fec_decoder_clear(link_fec_decoder_t *d) {
+    for (int i = 0; i < LINK_FEC_WINDOW; i++) {
+        pkt_block_release(d->slots[i].pkt);
+        d->slots[i].pkt = NULL;
+    }
+}
+
+static link_fec_slot_t *slot_for(link_fec_decoder_t *d, uint16_t seq) {
+    link_fec_slot_t *s = &d->slots[seq % LINK_FEC_WINDOW];
+    return (s->pkt && s->seq == seq) ? s : NULL;
+}
+
+// Put a referenced block into the window, dropping whatever stale packet the slot held
+static void slot_store(link_fec_decoder_t *d, uint16_t seq, pkt_block_t *pkt) {
+    link_fec_slot_t *s = &d->slots[seq % LINK_FEC_WINDOW];
+    pkt_block_release(s->pkt);
+    s->pkt = pkt;
+    s->seq = seq;
+}
+
+// Deliver consecutive packets from next_seq; with force, skip gaps up to 'until'
+static void decoder_release(link_fec_decoder_t *d, int force, uint16_t until, int64_t now_us) {
+    for (;;) {
+        link_fec_slot_t *s = slot_for(d, d->next_seq);
+        if (s) {
+            d->output(s->pkt->data, s->pkt->len);
+            d->next_seq++;
+        } else if (force && (int16_t)(until - d->next_seq) > 0) {
+            d->next_seq++;
+        } else {
+            break;
+        }
+    }
+
+    // Delivered packets stay only while a parity packet may still need them:
+    // until their group's parity has been seen, and never more than one
+    // group back. Without a parity stream they go straight back to the pool
+    if ((int16_t)(d->next_seq - d->kept) > LINK_FEC_WINDOW) d->kept = (uint16_t)(d->next_seq - LINK_FEC_WINDOW);
+    while (d->kept != d->next_seq) {
+        if (d->last_parity_us != 0 && (int16_t)(d->next_seq - d->kept) <= LINK_FEC_MAX_GROUP &&
+            (int16_t)(d->parity_end - d->kept) <= 0) {
+            break;
+        }
+        link_fec_slot_t *s = slot_for(d, d->kept);
+        if (s) {
+            pkt_block_release(s->pkt);
+            s->pkt = NULL;
+        }
+        d->kept++;
+    }
+
+    // Anything still stored ahead of next_seq is held behind a gap
+    int holding = 0;
+    for (int i = 1; i < LINK_FEC_WINDOW && !holding; i++) {
+        holding = slot_for(d, (uint16_t)(d->next_seq + i)) != NULL;
+    }
+    if (!holding) d->hold_since_us = 0;
+    else if (d->hold_since_us == 0) d->hold_since_us = now_us;
+}
+
+static void decoder_parity(link_fec_decoder_t *d, const link_hdr_t *hdr, const uint8_t *pkt, size_t len, int64_t now_us) {
+    d->parity_packets++;
+    d->last_parity_us = now_us;
+    if (!d->started || hdr->frag_count == 0 || hdr->frag_count > LINK_FEC_MAX_GROUP || len < PAR_DATA_XOR) return;
+
+    uint16_t first = hdr->seq;
+    uint16_t end = (uint16_t)(first + hdr->frag_count);
+    if ((int16_t)(end - d->parity_end) > 0) d->parity_end = end;
+    int missing = 0;
+    uint16_t lost_seq = 0;
+    for (uint16_t s = first; s != end; s++) {
+        if (!slot_for(d, s)) {
+            missing++;
+            lost_seq = s;
+        }
+    }
+
+    // Rebuild straight into a pool block; without a free block the packet counts as lost
+    pkt_block_t *rb = missing == 1 && (int16_t)(lost_seq - d->next_seq) >= 0 ? pkt_pool_alloc() : NULL;
+    if (rb) {
+        // Rebuild the packet: parity XOR every other member of the group
+        uint8_t *rebuilt = rb->data;
+        uint8_t len_x = pkt[PAR_LEN_XOR];
+        memcpy(rebuilt, pkt + PAR_HDR_XOR, sizeof(link_hdr_t));
+        // Parity stops at the longest member of its group
+        size_t payload = len - PAR_DATA_XOR;
+        if (payload > LINK_MAX_PAYLOAD) payload = LINK_MAX_PAYLOAD;
+        memcpy(rebuilt + sizeof(link_hdr_t), pkt + PAR_DATA_XOR, payload);
+        memset(rebuilt + sizeof(link_hdr_t) + payload, 0, LINK_MAX_PAYLOAD - payload);
+        for (uint16_t s = first; s != end; s++) {
+            if (s == lost_seq) continue;
+            const pkt_block_t *m = slot_for(d, s)->pkt;
+            len_x ^= (uint8_t)m->len;
+            for (size_t i = 0; i < m->len; i++) rebuilt[i] ^= m->data[i];
+        }
+        if (len_x > sizeof(link_hdr_t) && len_x <= sizeof(link_hdr_t) + payload) {
+            link_hdr_t rh;
+            memcpy(&rh, rebuilt, sizeof(rh));
+            rh.version = LINK_PACKET_VERSION;
+            rh.seq = lost_seq;
+            rh.hops = 0;
+            memcpy(rebuilt, &rh, sizeof(rh));
+            rb->len = len_x;
+            slot_store(d, lost_seq, rb);
+            d->recovered++;
+            decoder_release(d, 0, 0, now_us);
+            return;
+        }
+        pkt_block_release(rb);
+    }
+
+    if (missing > 0) {
+        // More than one hole (or a corrupt rebuild): count what is still pending and move on
+        for (uint16_t s = first; s != end; s++) {
+            if (!slot_for(d, s) && (int16_t)(s - d->next_seq) >= 0) d->unrecoverable++;
+        }
+        decoder_release(d, 1, end, now_us);
+    } else {
+        // Whole group arrived: only frees the blocks it no longer needs
+        decoder_release(d, 0, 0, now_us);
+    }
+}
+
+void link_fec_decoder_input(link_fec_decoder_t *d, pkt_block_t *blk, int64_t now_us) {
+    const uint8_t *pkt = blk->data;
+    size_t len = blk->len;
+    link_hdr_t hdr;
+    if (len <= sizeof(hdr) || len > LINK_MAX_PACKET) return;
+    memcpy(&hdr, pkt, sizeof(hdr));
+    if (hdr.version != LINK_PACKET_VERSION) return;
+
+    if (hdr.flags & LINK_FLAG_PARITY) {
+        decoder_parity(d, &hdr, pkt, len, now_us);
+        return;
+    }
+
+    if (!d->started) {
+        d->started = 1;
+        d->next_seq = hdr.seq;
+        d->kept = hdr.seq;
+        d->newest_seq = hdr.seq;
+    }
+    int16_t ahead = (int16_t)(hdr.seq - d->next_seq);
+    if (slot_for(d, hdr.seq)) {
+        d->duplicates++;
+        return;
+    }
+    if (ahead < 0) {
+        d->late++;
+        return;
+    }
+    if ((int16_t)(hdr.seq - d->newest_seq) < 0) d->reordered++;
+    else d->newest_seq = hdr.seq;
+    if (ahead >= LINK_FEC_WINDOW) {
+        // Jumped past the history window: everything before it is gone
+        decoder_release(d, 1, (uint16_t)(hdr.seq - LINK_FEC_WINDOW + 1), now_us);
+    }
+
+    pkt_block_retain(blk);
+    slot_store(d, hdr.seq, blk);
+
+    // Without a parity stream there is nothing to wait for
+    int fec_active = d->last_parity_us != 0 && now_us - d->last_parity_us < 2000000;
+    decoder_release(d, !fec_active, hdr.seq, now_us);
+}
+
+void link_fec_decoder_poll(link_fec_decoder_t *d, int64_t now_us) {
+    if (d->hold_since_us == 0 || now_us - d->hold_since_us < LINK_FEC_HOLD_US) return;
+
+    // Parity never came: release up to the newest stored packet
+    uint16_t newest = d->next_seq;
+    for (int i = 1; i < LINK_FEC_WINDOW; i++) {
+        uint16_t s = (uint16_t)(d->next_seq + i);
+        if (slot_for(d, s)) newest = s;
+    }
+    for (uint16_t s = d->next_seq; s != newest; s++) {
+        if (!slot_for(d, s)) d->unrecoverable++;
+    }
+    decoder_release(d, 1, newest, now_us);
+}
+
+int64_t link_fec_decoder_next_us(const link_fec_decoder_t *d) {
+    return d->hold_since_us ? d->hold_since_us + LINK_FEC_HOLD_US : INT64_MAX;
+}
@@ -0,0 +1,91 @@
+#ifndef LINK_FEC_H
+#define LINK_FEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "link_packet.h"
+#include "pkt_pool.h"
+
+// XOR forward error correction for the broadcast link. The base follows every
+// group of up to LINK_FEC_MAX_GROUP data packets with one parity packet; the
+// rover can rebuild any single packet lost from a group without a
+// retransmission. Parity packet layout:
+//   link_hdr_t { flags = LINK_FLAG_PARITY, seq = first data seq, frag_count = group size }
+//   len_xor (1) | header xor (sizeof(link_hdr_t)) | payload xor (longest payload in the group)
+// A parity packet is the group's longest data packet plus LINK_FEC_OVERHEAD:
+// about 1/group_size of the data bytes for full packets, relatively more for
+// short ones, where the header, overhead and radio preamble dominate.
+
+#define LINK_FEC_MAX_GROUP   16
+#define LINK_FEC_WINDOW      32    // rover packet history, must exceed the group size
+
+#ifndef LINK_FEC_GROUP_SIZE
+#define LINK_FEC_GROUP_SIZE  4     // data packets per parity packet, 0 disables FEC
+#endif
+
+// Longest the rover holds packets behind a gap waiting for parity
+#ifndef LINK_FEC_HOLD_US
+#define LINK_FEC_HOLD_US     30000
+#endif
+
+#define LINK_FEC_PARITY_LEN  (sizeof(link_hdr_t) + LINK_FEC_OVERHEAD + LINK_MAX_PAYLOAD) // longest
+
+typedef struct {
+    uint8_t parity[LINK_FEC_PARITY_LEN];
+    uint8_t group_size;
+    uint8_t count;            // data packets in the open group
+    uint16_t first_seq;
+    uint8_t max_payload;      // longest data payload in the open group
+    uint8_t source;           // parity header source and hops bytes, set after init
+    uint8_t hops;
+    int64_t first_us;
+    int64_t flush_us;         // close a partial group after this long
+    link_output_fn_t send;
+    uint32_t parity_packets;
+} link_fec_encoder_t;
+
+typedef struct {
+    pkt_block_t *pkt;         // reference, NULL = empty
+    uint16_t seq;
+} link_fec_slot_t;
+
+typedef struct {
+    link_fec_slot_t slots[LINK_FEC_WINDOW];
+    uint16_t next_seq;        // next data seq to deliver
+    uint16_t parity_end;      // seq after the newest parity group seen
+    uint16_t kept;            // oldest delivered seq that may still hold a block
+    uint16_t newest_seq;      // highest data seq received
+    int started;
+    int64_t hold_since_us;    // 0 when nothing is held behind a gap
+    int64_t last_parity_us;
+    link_output_fn_t output;
+    uint32_t recovered;       // packets rebuilt from parity
+    uint32_t unrecoverable;   // packets lost despite FEC
+    uint32_t parity_packets;
+    uint32_t reordered;       // arrived after a later seq, still in time
+    uint32_t late;            // behind the delivery point: its gap was given up, or an old copy
+    uint32_t duplicates;      // a copy of a packet already held or delivered
+} link_fec_decoder_t;
+
+// Base: group_size 0 passes packets straight through; flush_us bounds how long a partial group stays open
+void link_fec_encoder_init(link_fec_encoder_t *e, uint8_t group_size, int64_t flush_us, link_output_fn_t send);
+// Base: send one data packet and fold it into the current parity group
+void link_fec_encode(link_fec_encoder_t *e, const uint8_t *pkt, size_t len, int64_t now_us);
+// Base: emit parity for a partial group that has been open too long
+void link_fec_encoder_poll(link_fec_encoder_t *e, int64_t now_us);
+// Base: when link_fec_encoder_poll() next has work, INT64_MAX for none
+int64_t link_fec_encoder_next_us(const link_fec_encoder_t *e);
+
+// Rover: data packets are released to output in sequence order
+void link_fec_decoder_init(link_fec_decoder_t *d, link_output_fn_t output);
+// Rover: a data packet that has to wait for its group is kept by reference,
+// not copied; the caller keeps its own reference either way
+void link_fec_decoder_input(link_fec_decoder_t *d, pkt_block_t *pkt, int64_t now_us);
+// Rover: return every held block to the pool (before re-init)
+void link_fec_decoder_clear(link_fec_decoder_t *d);
+// Rover: give up on a gap once LINK_FEC_HOLD_US has passed
+void link_fec_decoder_poll(link_fec_decoder_t *d, int64_t now_us);
+// Rover: when the gap held now is given up, INT64_MAX for none
+int64_t link_fec_decoder_next_us(const link_fec_decoder_t *d);
+
+#endif // LINK_FEC_H
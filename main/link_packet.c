@@ -0,0 +1,140 @@
+#include "link_packet.h"
+#include "link_clock.h"
+#include <string.h>
+
+static void packetizer_emit(link_packetizer_t *p, uint8_t flags, uint8_t frag_index, uint8_t frag_count,
+                            const uint8_t *payload, size_t len) {
+    if (link_clock_has_gps(p->first_us)) flags |= LINK_FLAG_GPS_TIME;
+    link_hdr_t hdr = {
+        .version = LINK_PACKET_VERSION,
+        .flags = flags,
+        .seq = p->seq++,
+        .frag_index = frag_index,
+        .frag_count = frag_count,
+        .stamp_us = link_clock_stamp(p->first_us),
+        .source = p->source,
+        .hops = p->hops,
+    };
+    memcpy(p->pkt, &hdr, sizeof(hdr));
+    if (payload != p->pkt + sizeof(hdr)) {
+        memcpy(p->pkt + sizeof(hdr), payload, len);
+    }
+    p->send(p->pkt, sizeof(hdr) + len);
+    p->packets++;
+    p->bytes += sizeof(hdr) + len;
+}
+
+void link_packetizer_init(link_packetizer_t *p, link_output_fn_t send, int64_t flush_us) {
+    memset(p, 0, sizeof(*p));
+    p->send = send;
+    p->flush_us = flush_us > 0 ? flush_us : LINK_FLUSH_TIMEOUT_US;
+}
+
+void link_packetizer_flush(link_packetizer_t *p) {
+    if (p->fill == 0) return;
+    packetizer_emit(p, 0, 0, 1, p->pkt + sizeof(link_hdr_t), p->fill);
+    p->fill = 0;
+}
+
+void link_packetizer_add_frame(link_packetizer_t *p, const uint8_t *frame, size_t len, int64_t capture_us) {
+    if (len == 0 || len > RTCM3_MAX_FRAME) return;
+    p->frames++;
+
+    if (p->fill + len > LINK_MAX_PAYLOAD) {
+        link_packetizer_flush(p);
+    }
+
+    if (len > LINK_MAX_PAYLOAD) {
+        // Frame larger than one packet (MSM7 etc.) - send as a fragment run
+        p->first_us = capture_us;
+        uint8_t count = (uint8_t)((len + LINK_MAX_PAYLOAD - 1) / LINK_MAX_PAYLOAD);
+        for (uint8_t i = 0; i < count; i++) {
+            size_t off = (size_t)i * LINK_MAX_PAYLOAD;
+            size_t chunk = len - off < LINK_MAX_PAYLOAD ? len - off : LINK_MAX_PAYLOAD;
+            packetizer_emit(p, LINK_FLAG_FRAGMENT, i, count, frame + off, chunk);
+            p->fragments++;
+        }
+        return;
+    }
+
+    if (p->fill == 0) p->first_us = capture_us;
+    memcpy(p->pkt + sizeof(link_hdr_t) + p->fill, frame, len);
+    p->fill += len;
+    if (p->fill == LINK_MAX_PAYLOAD) {
+        link_packetizer_flush(p);
+    }
+}
+
+int64_t link_packetizer_next_us(const link_packetizer_t *p) {
+    return p->fill > 0 ? p->first_us + p->flush_us : INT64_MAX;
+}
+
+void link_packetizer_poll(link_packetizer_t *p, int64_t now_us) {
+    if (p->fill > 0 && now_us - p->first_us >= p->flush_us) {
+        link_packetizer_flush(p);
+    }
+}
+
+void link_depacketizer_init(link_depacketizer_t *d, link_output_fn_t output) {
+    memset(d, 0, sizeof(*d));
+    d->output = output;
+}
+
+void link_depacketizer_input(link_depacketizer_t *d, const uint8_t *pkt, size_t len) {
+    link_hdr_t hdr;
+    if (len <= sizeof(hdr)) {
+        d->bad++;
+        return;
+    }
+    memcpy(&hdr, pkt, sizeof(hdr));
+    if (hdr.version != LINK_PACKET_VERSION || (hdr.flags & LINK_FLAG_PARITY) ||
+        hdr.frag_count == 0 || hdr.frag_index >= hdr.frag_count) {
+        d->bad++;
+        return;
+    }
+    d->packets++;
+    if (d->seq_valid) {
+        uint16_t gap = (uint16_t)(hdr.seq - d->last_seq - 1);
+        if (gap < 0x8000) d->lost += gap;
+    }
+    d->last_seq = hdr.seq;
+    d->seq_valid = 1;
+
+    const uint8_t *payload = pkt + sizeof(hdr);
+    size_t payload_len = len - sizeof(hdr);
+
+    if (!(hdr.flags & LINK_FLAG_FRAGMENT)) {
+        if (d->next_frag) {
+            d->frag_dropped++;
+            d->next_frag = 0;
+        }
+        d->output(payload, payload_len);
+        return;
+    }
+
+    // Fragments must arrive back to back: index 0 starts a frame, every
+    // following one must carry the next seq and index or the frame is lost.
+    if (hdr.frag_index == 0) {
+        if (d->next_frag) d->frag_dropped++;
+        d->frame_len = 0;
+    } else if (d->next_frag != hdr.frag_index || (uint16_t)(d->frag_seq + 1) != hdr.seq) {
+        if (d->next_frag) d->frag_dropped++;
+        d->next_frag = 0;
+        return;
+    }
+    if (d->frame_len + payload_len > sizeof(d->frame)) {
+        d->frag_dropped++;
+        d->next_frag = 0;
+        return;
+    }
+    memcpy(d->frame + d->frame_len, payload, payload_len);
+    d->frame_len += payload_len;
+    d->frag_seq = hdr.seq;
+    d->next_frag = hdr.frag_index + 1;
+
+    if (d->next_frag == hdr.frag_count) {
+        d->output(d->frame, d->frame_len);
+        d->next_frag = 0;
+        d->frame_len = 0;
+    }
+}
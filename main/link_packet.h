@@ -0,0 +1,95 @@
+#ifndef LINK_PACKET_H
+#define LINK_PACKET_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "rtcm3.h"
+
+// Radio packet layout: link_hdr_t followed by either one or more complete
+// RTCM3 frames, or one fragment of a frame too large for a single packet.
+#define LINK_PACKET_VERSION  4
+#define LINK_MAX_PACKET      250   // ESP_NOW_MAX_DATA_LEN
+#define LINK_FLAG_FRAGMENT   0x01  // payload is part of one RTCM3 frame
+#define LINK_FLAG_PARITY     0x02  // FEC parity over a group of data packets (see link_fec.h)
+#define LINK_FLAG_GPS_TIME   0x04  // stamp_us is GPS time of week (see link_clock.h)
+#define LINK_FLAG_CONTROL    0x08  // link adaptation message, not RTCM (see link_adapt.h)
+
+// Default latency bound: flush a partially filled packet after this long
+#ifndef LINK_FLUSH_TIMEOUT_US
+#define LINK_FLUSH_TIMEOUT_US 5000
+#endif
+
+typedef struct __attribute__((packed)) {
+    uint8_t  version;
+    uint8_t  flags;       // LINK_FLAG_*
+    uint16_t seq;         // increments by one per data packet sent
+    uint8_t  frag_index;  // fragment number (0 when not fragmented)
+    uint8_t  frag_count;  // total fragments (1 when not fragmented)
+    uint32_t stamp_us;    // link clock when the oldest payload byte left the base receiver
+    uint8_t  source;      // id of the base that sent it (LINK_BASE_ID)
+    uint8_t  hops;        // relays passed and relays still allowed, see LINK_HOPS()
+} link_hdr_t;
+
+// The hops byte: relays the packet has passed (low nibble) and how many more
+// may repeat it (high nibble). The base sends 0 hops; link_relay.h
+#define LINK_HOPS(h)              ((h) & 0x0F)
+#define LINK_TTL(h)               ((h) >> 4)
+#define LINK_HOPS_BYTE(hops, ttl) ((uint8_t)(((ttl) << 4) | ((hops) & 0x0F)))
+
+// Room kept free in data packets so a parity packet covering them still fits
+// (length byte plus a copy of the header)
+#define LINK_FEC_OVERHEAD (1 + sizeof(link_hdr_t))
+
+#define LINK_MAX_PAYLOAD (LINK_MAX_PACKET - sizeof(link_hdr_t) - LINK_FEC_OVERHEAD)
+
+// Same signature as espnow_comm_send() / uart_gnss_write()
+typedef void (*link_output_fn_t)(const uint8_t *data, size_t len);
+
+// Base side: packs whole RTCM3 frames into radio packets
+typedef struct {
+    uint8_t pkt[LINK_MAX_PACKET];
+    size_t fill;              // payload bytes pending in pkt
+    uint16_t seq;
+    uint8_t source;           // header source and hops bytes, set after init
+    uint8_t hops;
+    int64_t first_us;         // capture time of the oldest pending frame
+    int64_t flush_us;         // latency bound for pending data
+    link_output_fn_t send;
+    uint32_t packets;
+    uint32_t frames;
+    uint32_t fragments;
+    uint32_t bytes;
+} link_packetizer_t;
+
+// Rover side: rebuilds the RTCM3 stream from received packets
+typedef struct {
+    uint8_t frame[RTCM3_MAX_FRAME];
+    size_t frame_len;
+    uint8_t next_frag;        // expected fragment index, 0 = idle
+    uint16_t frag_seq;        // seq of the last fragment accepted
+    uint16_t last_seq;
+    int seq_valid;
+    link_output_fn_t output;
+    uint32_t packets;
+    uint32_t lost;            // packets missing from the sequence
+    uint32_t bad;             // malformed / wrong version
+    uint32_t frag_dropped;    // frames discarded because a fragment was missing
+} link_depacketizer_t;
+
+// Set up a packetizer; flush_us <= 0 selects LINK_FLUSH_TIMEOUT_US
+void link_packetizer_init(link_packetizer_t *p, link_output_fn_t send, int64_t flush_us);
+// Queue one complete RTCM3 frame captured from the UART at capture_us; sends packets as they fill
+void link_packetizer_add_frame(link_packetizer_t *p, const uint8_t *frame, size_t len, int64_t capture_us);
+// Send the pending packet if it has waited longer than the latency bound
+void link_packetizer_poll(link_packetizer_t *p, int64_t now_us);
+// When link_packetizer_poll() next sends, INT64_MAX with nothing pending
+int64_t link_packetizer_next_us(const link_packetizer_t *p);
+// Send the pending packet unconditionally
+void link_packetizer_flush(link_packetizer_t *p);
+
+// Set up a depacketizer that writes reassembled RTCM3 bytes to output
+void link_depacketizer_init(link_depacketizer_t *d, link_output_fn_t output);
+// Process one received radio packet
+void link_depacketizer_input(link_depacketizer_t *d, const uint8_t *pkt, size_t len);
+
+#endif // LINK_PACKET_H
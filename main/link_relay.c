@@ -0,0 +1,122 @@
+#include "link_relay.h"
+#include <string.h>
+
+#define KIND_DATA   1
+#define KIND_PARITY 2
+
+void link_relay_init(link_relay_t *r, link_output_fn_t send, uint32_t seed) {
+    memset(r, 0, sizeof(*r));
+    r->send = send;
+    r->rng = seed ? seed : 1;
+}
+
+// xorshift32: cheap, and only has to differ between neighbours
+static uint32_t next_random(link_relay_t *r) {
+    uint32_t x = r->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    r->rng = x;
+    return x;
+}
+
+static int same_key(const link_relay_key_t *a, const link_relay_key_t *b) {
+    return a->seq == b->seq && a->source == b->source && a->kind == b->kind;
+}
+
+// Consecutive seqs of one source take consecutive slots; a collision forgets the older key
+static link_relay_key_t *seen_slot(link_relay_t *r, const link_relay_key_t *k) {
+    uint32_t h = ((uint32_t)k->seq * 2u + k->kind) ^ ((uint32_t)k->source * 37u);
+    return &r->seen[h & (LINK_RELAY_SEEN - 1)];
+}
+
+static link_relay_entry_t *waiting_for(link_relay_t *r, const link_relay_key_t *k) {
+    for (int i = 0; i < LINK_RELAY_QUEUE && r->waiting; i++) {
+        if (r->queue[i].key.kind && same_key(&r->queue[i].key, k)) return &r->queue[i];
+    }
+    return NULL;
+}
+
+static link_relay_entry_t *free_entry(link_relay_t *r) {
+    for (int i = 0; i < LINK_RELAY_QUEUE; i++) {
+        if (!r->queue[i].key.kind) return &r->queue[i];
+    }
+    return NULL;
+}
+
+static void finish(link_relay_t *r, link_relay_entry_t *e) {
+    e->key.kind = 0;
+    r->waiting--;
+}
+
+void link_relay_input(link_relay_t *r, const uint8_t *pkt, size_t len, int64_t now_us) {
+    r->stats.heard++;
+    link_hdr_t hdr;
+    if (len <= sizeof(hdr) || len > LINK_MAX_PACKET) {
+        r->stats.control++;
+        return;
+    }
+    memcpy(&hdr, pkt, sizeof(hdr));
+    // Link adaptation is between the base and the rovers that hear it directly
+    if (hdr.version != LINK_PACKET_VERSION || (hdr.flags & LINK_FLAG_CONTROL)) {
+        r->stats.control++;
+        return;
+    }
+
+    const link_relay_key_t key = {
+        .seq = hdr.seq,
+        .source = hdr.source,
+        .kind = (hdr.flags & LINK_FLAG_PARITY) ? KIND_PARITY : KIND_DATA,
+    };
+    link_relay_key_t *seen = seen_slot(r, &key);
+    if (same_key(seen, &key)) {
+        r->stats.duplicates++;
+        link_relay_entry_t *e = waiting_for(r, &key);
+        if (e && ++e->heard >= LINK_RELAY_SUPPRESS) {
+            finish(r, e);
+            r->stats.suppressed++;
+        }
+        return;
+    }
+    *seen = key;
+    r->stats.first++;
+    uint8_t hops = LINK_HOPS(hdr.hops);
+    r->stats.first_by_hops[hops < 3 ? hops : 3]++;
+
+    if (!r->send) return;
+    if (LINK_TTL(hdr.hops) == 0) {
+        r->stats.ttl_expired++;
+        return;
+    }
+    link_relay_entry_t *e = free_entry(r);
+    if (!e) {
+        r->stats.queue_full++;
+        return;
+    }
+    e->key = key;
+    e->heard = 0;
+    e->len = (uint8_t)len;
+    memcpy(e->pkt, pkt, len);
+    e->pkt[offsetof(link_hdr_t, hops)] = LINK_HOPS_BYTE(hops + 1, LINK_TTL(hdr.hops) - 1);
+    e->due_us = now_us + next_random(r) % (LINK_RELAY_BACKOFF_US + 1);
+    r->waiting++;
+}
+
+void link_relay_poll(link_relay_t *r, int64_t now_us) {
+    for (int i = 0; i < LINK_RELAY_QUEUE && r->waiting; i++) {
+        link_relay_entry_t *e = &r->queue[i];
+        if (!e->key.kind || e->due_us > now_us) continue;
+        r->send(e->pkt, e->len);
+        r->stats.relayed++;
+        finish(r, e);
+    }
+}
+
+int64_t link_relay_next_us(const link_relay_t *r) {
+    int64_t next = INT64_MAX;
+    for (int i = 0; i < LINK_RELAY_QUEUE && r->waiting; i++) {
+        const link_relay_entry_t *e = &r->queue[i];
+        if (e->key.kind && e->due_us < next) next = e->due_us;
+    }
+    return next;
+}
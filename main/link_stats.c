@@ -0,0 +1,124 @@
+#include "link_stats.h"
+#include "link_clock.h"
+#include <stdio.h>
+#include <string.h>
+
+#define LINK_STATS_FRAME_VERSION 2
+#define MIN_TRANSIT_WINDOW_US    60000000   // re-learn the relative floor every minute
+
+const uint16_t link_stats_bucket_ms[LINK_STATS_BUCKETS - 1] = {
+    10, 20, 30, 50, 75, 100, 150, 200, 300, 500, 1000,
+};
+
+void link_stats_init(link_stats_t *s) {
+    memset(s, 0, sizeof(*s));
+    s->lat_min_us = UINT32_MAX;
+}
+
+static void add_latency(link_stats_t *s, uint32_t lat_us) {
+    uint32_t ms = lat_us / 1000;
+    int b = 0;
+    while (b < LINK_STATS_BUCKETS - 1 && ms >= link_stats_bucket_ms[b]) b++;
+    s->hist[b]++;
+    s->samples++;
+    s->lat_sum_us += lat_us;
+    s->lat_last_us = lat_us;
+    if (lat_us < s->lat_min_us) s->lat_min_us = lat_us;
+    if (lat_us > s->lat_max_us) s->lat_max_us = lat_us;
+}
+
+void link_stats_record(link_stats_t *s, const link_hdr_t *hdr, int64_t rx_us, uint32_t uart_queue_us) {
+    s->packets++;
+    if (s->have_last) {
+        uint16_t gap = (uint16_t)(hdr->seq - s->last_seq - 1);
+        if (gap < 0x8000) {
+            if (gap) {
+                s->lost += gap;
+                s->gaps++;
+                if (gap > s->max_gap) s->max_gap = gap;
+            }
+            s->last_seq = hdr->seq;
+        }
+    } else {
+        s->last_seq = hdr->seq;
+    }
+
+    s->uart_queue_us = uart_queue_us;
+    if (uart_queue_us > s->uart_queue_max_us) s->uart_queue_max_us = uart_queue_us;
+
+    // Bytes reach the receiver once everything queued ahead of them has been clocked out
+    int64_t at_gnss = rx_us + uart_queue_us;
+    int32_t transit = (int32_t)(link_clock_stamp(at_gnss) - hdr->stamp_us);
+    uint8_t absolute = (hdr->flags & LINK_FLAG_GPS_TIME) && link_clock_has_gps(rx_us);
+
+    if (s->have_last) {
+        int32_t d = transit - s->last_transit_us;
+        if (d < 0) d = -d;
+        s->jitter_us += (int32_t)(d - (int32_t)s->jitter_us) / 16;
+    }
+
+    if (absolute != s->absolute || !s->have_last || rx_us - s->min_reset_us > MIN_TRANSIT_WINDOW_US) {
+        // Time base changed or window expired: restart the relative floor
+        s->min_transit_us = transit;
+        s->min_reset_us = rx_us;
+    } else if (transit < s->min_transit_us) {
+        s->min_transit_us = transit;
+    }
+    s->absolute = absolute;
+    s->last_transit_us = transit;
+    s->have_last = 1;
+
+    int32_t lat = absolute ? transit : transit - s->min_transit_us;
+    add_latency(s, lat > 0 ? (uint32_t)lat : 0);
+}
+
+static uint16_t sat_ms(uint64_t us) {
+    uint64_t ms = us / 1000;
+    return ms > UINT16_MAX ? UINT16_MAX : (uint16_t)ms;
+}
+
+size_t link_stats_pack(const link_stats_t *s, link_stats_frame_t *out) {
+    memset(out, 0, sizeof(*out));
+    out->magic[0] = 'L';
+    out->magic[1] = 'S';
+    out->version = LINK_STATS_FRAME_VERSION;
+    out->absolute = s->absolute;
+    out->samples = s->samples;
+    out->packets = s->packets;
+    out->lost = s->lost;
+    out->gaps = s->gaps;
+    out->max_gap = s->max_gap > UINT16_MAX ? UINT16_MAX : (uint16_t)s->max_gap;
+    out->lat_min_ms = s->samples ? sat_ms(s->lat_min_us) : 0;
+    out->lat_avg_ms = s->samples ? sat_ms(s->lat_sum_us / s->samples) : 0;
+    out->lat_max_ms = sat_ms(s->lat_max_us);
+    out->lat_last_ms = sat_ms(s->lat_last_us);
+    out->jitter_ms = sat_ms(s->jitter_us);
+    out->uart_queue_ms = sat_ms(s->uart_queue_us);
+    out->uart_queue_max_ms = sat_ms(s->uart_queue_max_us);
+    for (int i = 0; i < LINK_STATS_BUCKETS; i++) {
+        out->hist[i] = s->hist[i] > UINT16_MAX ? UINT16_MAX : (uint16_t)s->hist[i];
+    }
+    out->delta_dropped = s->delta_dropped;
+    return sizeof(*out);
+}
+
+void link_stats_print(const link_stats_t *s) {
+    if (s->samples == 0) {
+        printf("[LINK] no packets yet\n");
+        return;
+    }
+    printf("[LINK] latency (%s): last %.1f  min %.1f  avg %.1f  max %.1f ms  jitter %.1f ms\n",
+           !s->absolute ? "relative to floor" :
+           LINK_CLOCK_MSM_DELAY_US || LINK_CLOCK_PVT_DELAY_US ? "GPS time" : "GPS time, receiver delays not removed",
+           s->lat_last_us / 1000.0, s->lat_min_us / 1000.0,
+           (double)s->lat_sum_us / s->samples / 1000.0, s->lat_max_us / 1000.0, s->jitter_us / 1000.0);
+    printf("[LINK] packets %u  lost %u  gaps %u  max gap %u  delta dropped %u  UART queue %.1f ms (max %.1f)\n",
+           (unsigned)s->packets, (unsigned)s->lost, (unsigned)s->gaps, (unsigned)s->max_gap,
+           (unsigned)s->delta_dropped, s->uart_queue_us / 1000.0, s->uart_queue_max_us / 1000.0);
+    printf("[LINK] hist ms:");
+    for (int i = 0; i < LINK_STATS_BUCKETS; i++) {
+        if (i < LINK_STATS_BUCKETS - 1) printf(" <%u:%u", link_stats_bucket_ms[i], (unsigned)s->hist[i]);
+        else printf(" >=%u:%u", link_stats_bucket_ms[i - 1], (unsigned)s->hist[i]);
+    }
+    printf("\n");
+}
@@ -0,0 +1,73 @@
+#ifndef LINK_STATS_H
+#define LINK_STATS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "link_packet.h"
+
+// Rover-side correction latency and link quality statistics. Latency runs
+// from the base receiver UART (header stamp) to the rover receiver UART
+// (delivery time plus the bytes already queued ahead in the TX ring).
+// With both clocks locked to GPS time it is the stamp difference, which is
+// absolute only as far as the receiver output delays are configured
+// (link_clock.h); otherwise it is measured against the smallest delay seen,
+// i.e. it shows the queueing and jitter above the link floor.
+
+#define LINK_STATS_BUCKETS 12
+
+// Upper bucket edges in ms; the last bucket collects everything above
+extern const uint16_t link_stats_bucket_ms[LINK_STATS_BUCKETS - 1];
+
+typedef struct {
+    uint32_t hist[LINK_STATS_BUCKETS];
+    uint32_t samples;
+    uint32_t lat_min_us;
+    uint32_t lat_max_us;
+    uint64_t lat_sum_us;
+    uint32_t lat_last_us;
+    uint32_t jitter_us;          // RFC 3550 style inter-arrival jitter
+    uint32_t packets;
+    uint32_t lost;               // packets missing from the sequence
+    uint32_t gaps;               // loss events
+    uint32_t max_gap;            // longest run of lost packets
+    uint32_t delta_dropped;      // delta frames not rebuilt: reference lost or malformed (rtcm_delta.h)
+    uint32_t uart_queue_us;      // last UART TX queueing delay
+    uint32_t uart_queue_max_us;
+    uint8_t absolute;            // last sample used GPS time on both ends (see above)
+    // internal
+    uint16_t last_seq;
+    uint8_t have_last;
+    int32_t last_transit_us;
+    int32_t min_transit_us;
+    int64_t min_reset_us;
+} link_stats_t;
+
+// Compact binary telemetry frame (little-endian)
+typedef struct __attribute__((packed)) {
+    uint8_t  magic[2];           // 'L','S'
+    uint8_t  version;
+    uint8_t  absolute;
+    uint32_t samples;
+    uint32_t packets;
+    uint32_t lost;
+    uint32_t gaps;
+    uint16_t max_gap;
+    uint16_t lat_min_ms;
+    uint16_t lat_avg_ms;
+    uint16_t lat_max_ms;
+    uint16_t lat_last_ms;
+    uint16_t jitter_ms;
+    uint16_t uart_queue_ms;
+    uint16_t uart_queue_max_ms;
+    uint16_t hist[LINK_STATS_BUCKETS];
+    uint32_t delta_dropped;
+} link_stats_frame_t;
+
+void link_stats_init(link_stats_t *s);
+// Record one delivered data packet; rx_us is the local time it was handed to the UART
+void link_stats_record(link_stats_t *s, const link_hdr_t *hdr, int64_t rx_us, uint32_t uart_queue_us);
+// Fill a telemetry frame. Returns its size
+size_t link_stats_pack(const link_stats_t *s, link_stats_frame_t *out);
+void link_stats_print(const link_stats_t *s);
+
+#endif // LINK_STATS_H
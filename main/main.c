@@ -3,94 +3,1264 @@
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "nvs_flash.h"
+#include "esp_timer.h"
 #include "role_config.h"
+#include "platform.h"
+#if PIPELINE_TASKS
+#include "freertos/semphr.h"
+#endif
+#include "uart_gnss.h"
+#if F9P_AUTO_CONFIG
+#include "nvs.h"
+#include "f9p_cfg.h"
+#endif
+#include "link_bond.h"
+#include "prof.h"
+#if PROFILING
+#include "esp_rom_sys.h"
+#include "task_stats.h"
+#endif
+#if RAW_LOG
+#include "flash_log.h"
+#endif
+#if LINK_ADAPT
+#include "link_adapt.h"
+#endif
+#if LINK_BOND_UDP || LINK_BOND_MQTT || (NTRIP_CASTER && DEVICE_ROLE == DEVICE_ROLE_BASE) || \
+    (ROVER_TELEMETRY && DEVICE_ROLE == DEVICE_ROLE_ROVER)
+#include "wifi_comm.h"
+#endif
+#if LINK_BOND_MQTT || (ROVER_TELEMETRY && DEVICE_ROLE == DEVICE_ROLE_ROVER)
+#include "mqtt_comm.h"
+#include "esp_mac.h"
+#endif
 
 #if DEVICE_ROLE == DEVICE_ROLE_BASE
-#include "uart_gnss.h"
 #include "espnow_comm.h"
+#include "base_pipeline.h"
+#if BASE_SVIN_STORE
+#include "base_svin.h"
+#endif
+#if NTRIP_CASTER
+#include "ntrip_caster.h"
+#include "geo.h"
+#endif
 #elif DEVICE_ROLE == DEVICE_ROLE_ROVER
 #include "rover_espnow_receiver.h"
+#if LINK_ADAPT
+#include "espnow_comm.h"
+#endif
+#include "rover_pipeline.h"
+#include "console.h"
+#if ROVER_RELAY
+#include "link_relay.h"
+#include "esp_random.h"
+#endif
+#if ROVER_TELEMETRY
+#include "telemetry.h"
+#endif
+#endif
+
+// Shown once the UART driver has reported lost or garbled bytes
+static void print_uart_errors(const char *role) {
+    uart_gnss_stats_t u;
+    uart_gnss_get_stats(&u);
+    if (!u.fifo_overflow && !u.buffer_full && !u.frame_errors && !u.parity_errors) return;
+    printf("[%s] GNSS UART %lu baud: FIFO overrun %u  RX full %u  frame err %u  parity err %u  RX high-water %u/%u\n",
+           role, (unsigned long)uart_gnss_baud(), (unsigned)u.fifo_overflow, (unsigned)u.buffer_full,
+           (unsigned)u.frame_errors, (unsigned)u.parity_errors, (unsigned)u.rx_high_water, UART_GNSS_RX_BUF_SIZE);
+}
+
+#if RAW_LOG
+static void print_flash_log(const char *role) {
+    flash_log_stats_t f;
+    flash_log_get_stats(&f);
+    const raw_log_stats_t *l = &f.log;
+    printf("[%s] Raw log: %u records, %u B, %u sectors (of %u, boot %u)  dropped %u (%u B)  flash errors %u\n",
+           role, (unsigned)l->records, (unsigned)l->bytes, (unsigned)l->sectors, (unsigned)f.sectors, (unsigned)f.boot,
+           (unsigned)l->dropped, (unsigned)l->dropped_bytes, (unsigned)l->flash_errors);
+    printf("[%s] Raw log stall: append max %u us, erase max %u us, write max %u us, buffers waiting max %u/%u\n",
+           role, (unsigned)f.append_max_us, (unsigned)l->erase_max_us, (unsigned)l->write_max_us,
+           l->sealed_high_water, FLASH_LOG_BUFFERS);
+}
+#endif
+
+#if LINK_ADAPT
+static const uint8_t adapt_channels[] = { LINK_ADAPT_CHANNELS };
+#endif
+
+// Loop stages and queue depths (prof.h); compiled out without PROFILING
+PROF_DECLARE(prof_loop);
+PROF_DECLARE(prof_uart_read);
+PROF_DECLARE(prof_stats);
+PROF_DECLARE(prof_uart_rx);
+
+#if PROFILING
+static void print_profile(const char *role) {
+    prof_print(role);
+    task_stats_print(role);
+}
+#endif
+
+#if PIPELINE_TASKS
+#define TASK_STACK 4096
+
+// Taken around every call into the pipeline singletons, whichever task makes
+// it. The forwarding task holds it for one packet or one UART read's worth of
+// work; priority inheritance keeps a lower task holding it from delaying it more
+static SemaphoreHandle_t pipeline_lock;
+#define PIPELINE_LOCK()   xSemaphoreTake(pipeline_lock, portMAX_DELAY)
+#define PIPELINE_UNLOCK() xSemaphoreGive(pipeline_lock)
+
+static TaskHandle_t forward_task;
+static TaskHandle_t aux_task;
+
+// Producers (driver callbacks, the UDP reader) run these after queueing a packet
+static void wake_forward(void *ctx) {
+    if (forward_task) xTaskNotifyGive(forward_task);
+}
+
+#if LINK_ADAPT && DEVICE_ROLE == DEVICE_ROLE_BASE
+static void wake_aux(void *ctx) {
+    if (aux_task) xTaskNotifyGive(aux_task);
+}
+#endif
+
+// Sleep for a pipeline deadline: milliseconds until due_us, rounded up so the
+// task wakes with the work due, and no longer than TASK_IDLE_WAKE_MS
+static uint32_t wait_ms_until(int64_t due_us, int64_t now_us) {
+    if (due_us <= now_us) return 0;
+    int64_t ms = (due_us - now_us + 999) / 1000;
+    return ms < TASK_IDLE_WAKE_MS ? (uint32_t)ms : TASK_IDLE_WAKE_MS;
+}
+
+static void start_tasks(TaskFunction_t forward, const char *forward_name, TaskFunction_t aux, const char *aux_name) {
+    pipeline_lock = xSemaphoreCreateMutex();
+    xTaskCreatePinnedToCore(forward, forward_name, TASK_STACK, NULL, TASK_FORWARD_PRIO, &forward_task,
+                            TASK_FORWARD_CORE);
+    if (aux) xTaskCreatePinnedToCore(aux, aux_name, TASK_STACK, NULL, TASK_AUX_PRIO, &aux_task, TASK_AUX_CORE);
+    printf("Pipeline tasks: %s on core %d (priority %d)", forward_name, TASK_FORWARD_CORE, TASK_FORWARD_PRIO);
+    if (aux) printf(", %s on core %d (priority %d)", aux_name, TASK_AUX_CORE, TASK_AUX_PRIO);
+    printf("\n");
+}
+#else
+#define PIPELINE_LOCK()
+#define PIPELINE_UNLOCK()
+#endif
+
+#if DEVICE_ROLE == DEVICE_ROLE_BASE
+PROF_DECLARE(prof_base_feed);
+PROF_DECLARE(prof_base_poll);
+PROF_DECLARE(prof_ntrip_poll);
+
+static int rtcm_seen = 0;
+static link_bond_tx_t bond_tx;
+
+static int base_first_sent = 0;
+
+static void base_send_bonded(const uint8_t *pkt, size_t len) {
+    link_bond_send(&bond_tx, pkt, len);
+    if (!base_first_sent) {
+        base_first_sent = 1;
+        platform_mark(PLATFORM_PHASE_FIRST_CORRECTION, esp_timer_get_time());
+    }
+}
+
+#if NTRIP_CASTER
+static ntrip_caster_t caster;
+
+static rtcm3_arp_t caster_arp;
+
+static void base_to_caster(const uint8_t *frame, size_t len, void *ctx) {
+    // The sourcetable advertises the antenna position from the stream's own
+    // 1005/1006; the double math runs only when it changes
+    rtcm3_arp_t arp;
+    geo_pos_t pos;
+    if (rtcm3_parse_arp(frame, len, &arp) == 0 &&
+        (arp.x != caster_arp.x || arp.y != caster_arp.y || arp.z != caster_arp.z)) {
+        caster_arp = arp;
+        if (geo_from_ecef(arp.x, arp.y, arp.z, &pos) == 0) ntrip_caster_set_position(&caster, pos.lat * 1e-9, pos.lon * 1e-9);
+    }
+    ntrip_caster_write(&caster, frame, len);
+}
+#endif
+
+#if RAW_LOG
+static void base_log_rtcm(const uint8_t *frame, size_t len, void *ctx) {
+    flash_log_write(RAW_LOG_SRC_BASE_RTCM, frame, len);
+}
+#endif
+
+#if LINK_ADAPT
+static link_adapt_base_t adapt;
+
+static void base_adapt_rate(uint8_t rate, void *ctx) {
+    espnow_comm_set_rate(rate);
+}
+
+static void base_adapt_channel(uint8_t channel, void *ctx) {
+    espnow_comm_set_channel(channel);
+}
+
+static void base_adapt_send(const uint8_t *msg, size_t len, void *ctx) {
+    espnow_comm_send(msg, len);
+}
+
+static void base_on_feedback(pkt_block_t *pkt, void *ctx) {
+    link_adapt_base_input(&adapt, pkt->data, pkt->len, base_pipeline_state()->packetizer.seq, esp_timer_get_time());
+}
+
+static void base_print_adapt(void) {
+    PIPELINE_LOCK();
+    link_adapt_base_stats_t a = adapt.stats;
+    uint8_t rate = adapt.rate, channel = adapt.io.channel;
+    PIPELINE_UNLOCK();
+    printf("[BASE] Link: %s on channel %u  loss %u.%u%%  RSSI avg %d min %d dBm  up %u  down %u  failed probes %u  "
+           "collisions %u  timeouts %u  channel moves %u\n",
+           link_adapt_rates[rate].name, channel, a.loss_permille / 10, a.loss_permille % 10,
+           a.rssi_avg, a.rssi_min, (unsigned)a.ups, (unsigned)a.downs, (unsigned)a.failed_probes,
+           (unsigned)a.collision_windows, (unsigned)a.timeouts, (unsigned)a.channel_moves);
+}
+#endif
+
+#if BASE_SVIN_STORE
+static base_svin_t svin;
+static base_svin_pos_t svin_stored;
+static int svin_reported = 0;
+
+// The surveyed position lives next to the receiver's configuration stamp
+static void base_store_position(const base_svin_pos_t *pos, void *ctx) {
+    nvs_handle_t nvs;
+    if (nvs_open("f9p", NVS_READWRITE, &nvs) != ESP_OK) return;
+    if (pos) nvs_set_blob(nvs, "svin_pos", pos, sizeof(*pos));
+    else nvs_erase_key(nvs, "svin_pos");
+    nvs_commit(nvs);
+    nvs_close(nvs);
+    if (!pos) {
+        printf("[BASE] Antenna %.2f m from the stored position: surveying in again\n", svin.check_offset / 10000.0);
+    }
+}
+
+static void base_on_svin(const ubx_nav_svin_t *nav, void *ctx) {
+    base_svin_on_nav(&svin, nav);
+#if LINK_BOND_MQTT
+    base_svin_status_t st;
+    base_svin_get_status(&svin, &st);
+    mqtt_comm_enqueue(LINK_MQTT_TELEMETRY_TOPIC "/hagps-base", (const uint8_t *)&st, sizeof(st));
+#endif
+}
+
+static void base_on_ubx(uint8_t cls, uint8_t id, const uint8_t *payload, size_t len, void *ctx) {
+    base_svin_on_message(&svin, cls, id, payload, len);
+}
+
+// After base_pipeline_init(): the receiver's replies come through its parser
+static void base_position_start(void) {
+    nvs_handle_t nvs;
+    size_t size = sizeof(svin_stored);
+    int stored = 0;
+    if (nvs_open("f9p", NVS_READONLY, &nvs) == ESP_OK) {
+        stored = nvs_get_blob(nvs, "svin_pos", &svin_stored, &size) == ESP_OK && size == sizeof(svin_stored);
+        nvs_close(nvs);
+    }
+    const base_svin_config_t cfg = {
+        .write = uart_gnss_write,
+        .save = base_store_position,
+        .stored = stored ? &svin_stored : NULL,
+    };
+    base_svin_init(&svin, &cfg, esp_timer_get_time());
+    const ubx_handlers_t handlers = { .on_svin = base_on_svin, .on_message = base_on_ubx };
+    base_pipeline_set_ubx_handlers(&handlers);
+    if (stored) {
+        printf("Base position: stored (%.3f m), checking it against a %d s survey\n", svin_stored.acc / 10000.0,
+               BASE_SVIN_CHECK_S);
+    } else {
+        printf("Base position: none stored, surveying in\n");
+    }
+}
+
+static void base_print_position(void) {
+    PIPELINE_LOCK();
+    ubx_nav_svin_t n = svin.last;
+    base_svin_state_t state = svin.state;
+    uint32_t restarts = svin.receiver_restarts, errors = svin.errors;
+    PIPELINE_UNLOCK();
+    printf("[BASE] Position: %s  survey %lu s  %lu obs  acc %.3f m  receiver restarts %u  errors %u\n",
+           base_svin_state_name(state), (unsigned long)n.dur, (unsigned long)n.obs, n.meanAcc / 10000.0,
+           (unsigned)restarts, (unsigned)errors);
+}
+#endif
+
+// Receiver bytes into the correction path
+static void base_feed(const uint8_t *data, int len, int64_t now) {
+    PROF_SCOPE(prof_base_feed);
+#if RAW_LOG
+    flash_log_write(RAW_LOG_SRC_BASE_GNSS, data, len);
+#endif
+    base_pipeline_feed(data, len, now);
+}
+
+// Pipeline timeouts and the NTRIP clients, after every read
+static void base_service(int64_t now) {
+#if BASE_SVIN_STORE
+    base_svin_poll(&svin, now);
+    if (!svin_reported && base_svin_ready(&svin)) {
+        svin_reported = 1;
+        platform_mark(PLATFORM_PHASE_BASE_POSITION, svin.settled_us);
+        if (svin.state == BASE_SVIN_FIXED) {
+            printf("\n*** BASE POSITION FIXED (stored, %.2f m off) after %.1f s ***\n\n",
+                   svin.check_offset / 10000.0, svin.settled_us / 1e6);
+        } else {
+            printf("\n*** SURVEY-IN COMPLETE (%.3f m) after %.1f s ***\n\n", svin.pos.acc / 10000.0,
+                   svin.settled_us / 1e6);
+        }
+    }
+#endif
+    if (!rtcm_seen && base_pipeline_state()->framer.frames) {
+        rtcm_seen = 1;
+        printf("\n*** RTCM ACTIVE after %.1f s ***\n\n", now / 1e6);
+    }
+    {
+        PROF_SCOPE(prof_base_poll);
+        base_pipeline_poll(now);
+    }
+#if NTRIP_CASTER
+    {
+        PROF_SCOPE(prof_ntrip_poll);
+        ntrip_caster_poll(&caster, now);
+    }
+#endif
+}
+
+#if PIPELINE_TASKS
+// Receiver UART -> framing, scheduling, packets and FEC -> radio. Sleeps until
+// the UART interrupt hands over bytes or the pipeline's next timeout
+static void base_forward_task(void *arg) {
+    uint8_t data[512];
+    int64_t due = INT64_MAX;
+    for (;;) {
+        int len = uart_gnss_read_wait(data, sizeof(data), wait_ms_until(due, esp_timer_get_time()));
+        int64_t now = esp_timer_get_time();
+        PROF_SAMPLE(prof_uart_rx, len + uart_gnss_rx_waiting());
+        PIPELINE_LOCK();
+        if (len > 0) base_feed(data, len, now);
+        base_service(now);
+        due = base_pipeline_next_us();
+#if NTRIP_CASTER
+        // The caster accepts, handshakes and evicts clients on its own clock,
+        // so a quiet receiver must not hold its poll back
+        int64_t caster_due = now + TASK_IDLE_WAKE_MS * 1000LL;
+        if (caster_due < due) due = caster_due;
+#endif
+        PIPELINE_UNLOCK();
+    }
+}
+
+#if LINK_ADAPT
+// Rover reports, woken by the ESP-NOW receive callback
+static void base_adapt_task(void *arg) {
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(TASK_IDLE_WAKE_MS));
+        PIPELINE_LOCK();
+        espnow_comm_receive_batch(base_on_feedback, NULL);
+        link_adapt_base_poll(&adapt, esp_timer_get_time());
+        PIPELINE_UNLOCK();
+    }
+}
+#endif
+#endif
+
+// Counters are copied under the pipeline lock and printed after it: the
+// console is far slower than the forward task
+static void base_print_rtcm_stats(void) {
+    static rtcm_sched_type_stats_t t[RTCM_SCHED_MAX_TYPES];   // off the main task's stack
+    const base_pipeline_t *base = base_pipeline_state();
+    PIPELINE_LOCK();
+    size_t count;
+    memcpy(t, rtcm_sched_get_stats(&base->sched, &count), sizeof(t));
+    uint32_t ewma_bps = base->sched.ewma_bps, over_budget = base->sched.over_budget;
+    int32_t budget_bps = base->sched.cfg.budget_bps;
+    int delta_on = base->delta_on;
+    uint32_t delta_in = base->delta.bytes_in, delta_out = base->delta.bytes_out;
+    uint32_t delta_coded = base->delta.coded, delta_keys = base->delta.keys;
+    PIPELINE_UNLOCK();
+    printf("[BASE] RTCM out: %u B/s (budget %d), over-budget epochs %u\n",
+           (unsigned)ewma_bps, (int)budget_bps, (unsigned)over_budget);
+    for (size_t i = 0; i < count; i++) {
+        printf("  %4u: %.1f Hz  %u frames  %u B (link %u B)  skip %u  shed %u  msm4 %u\n",
+               t[i].type, t[i].rate_hz, (unsigned)t[i].frames, (unsigned)t[i].bytes, (unsigned)t[i].link_bytes,
+               (unsigned)t[i].skipped, (unsigned)t[i].shed, (unsigned)t[i].downgraded);
+    }
+    if (delta_on && delta_in) {
+        printf("[BASE] Delta codec: %u B -> %u B (%u%%), %u delta, %u key frames\n",
+               (unsigned)delta_in, (unsigned)delta_out, (unsigned)((uint64_t)delta_out * 100 / delta_in),
+               (unsigned)delta_coded, (unsigned)delta_keys);
+    }
+}
+
+#if NTRIP_CASTER
+static void base_print_caster(void) {
+    PIPELINE_LOCK();
+    size_t streaming = ntrip_caster_streaming(&caster);
+    uint32_t accepted = caster.accepted, rejected = caster.rejected, evicted = caster.evicted;
+    uint64_t served = caster.bytes_served;
+    PIPELINE_UNLOCK();
+    printf("[BASE] NTRIP: %u clients, %u accepted, %u rejected, %u evicted, %llu B served\n", (unsigned)streaming,
+           (unsigned)accepted, (unsigned)rejected, (unsigned)evicted, (unsigned long long)served);
+}
+#endif
+#elif DEVICE_ROLE == DEVICE_ROLE_ROVER
+PROF_DECLARE(prof_link_rx);
+PROF_DECLARE(prof_link_poll);
+PROF_DECLARE(prof_gnss_parse);
+PROF_DECLARE(prof_telemetry);
+PROF_DECLARE(prof_espnow_q);
+PROF_DECLARE(prof_pool_q);
+PROF_DECLARE(prof_gnss_tx);
+PROF_DECLARE(prof_telemetry_q);
+
+#define ROVER_DISPLAY_MS 2000   // position and link status on the console
+
+static int path_espnow = -1;
+#if LINK_BOND_UDP
+static int path_udp = -1;
+#endif
+#if LINK_BOND_MQTT
+static int path_mqtt = -1;
+#endif
+
+// ctx carries the path index
+static void rover_on_packet(pkt_block_t *pkt, void *ctx) {
+    rover_pipeline_input_block(*(const int *)ctx, pkt, esp_timer_get_time());
+}
+
+#if LINK_ADAPT
+static link_adapt_rover_t adapt;
+
+static void rover_adapt_rate(uint8_t rate, void *ctx) {
+#if ROVER_RELAY
+    // Relayed packets leave at the same rate as the reports, and are meant
+    // for rovers further out than this one: both stay at the most robust rate
+    rate = 0;
+#endif
+    espnow_comm_set_rate(rate);
+}
+
+static void rover_adapt_channel(uint8_t channel, void *ctx) {
+    rover_espnow_set_channel(channel);
+}
+
+static void rover_adapt_send(const uint8_t *msg, size_t len, void *ctx) {
+    rover_espnow_send(msg, len);
+}
+
+static void rover_adapt_rssi(int8_t *avg, int8_t *min, void *ctx) {
+    rover_espnow_rssi(adapt.io.source, avg, min);
+}
+
+static int rover_cmd_adapt(int argc, char **argv) {
+    PIPELINE_LOCK();
+    link_adapt_rover_stats_t a = adapt.stats;
+    uint8_t channel = adapt.io.channel, hunting = adapt.hunting, report_rate = adapt.report_rate;
+    PIPELINE_UNLOCK();
+    printf("channel %u%s, reports at %s, %u data packets, %u reports sent, %u control messages, %u channel moves, %u hunting hops\n",
+           channel, hunting ? " (hunting)" : "", link_adapt_rates[report_rate].name,
+           (unsigned)a.data_packets, (unsigned)a.reports,
+           (unsigned)a.control, (unsigned)a.channel_moves, (unsigned)a.hops);
+    return 0;
+}
+#endif
+
+#if ROVER_RELAY
+static link_relay_t relay;
+
+static int rover_cmd_relay(int argc, char **argv) {
+    PIPELINE_LOCK();
+    link_relay_stats_t r = relay.stats;
+    PIPELINE_UNLOCK();
+    printf("%u heard, %u first copies (%u direct, %u/%u/%u after 1/2/3+ relays), %u duplicates\n",
+           (unsigned)r.heard, (unsigned)r.first, (unsigned)r.first_by_hops[0], (unsigned)r.first_by_hops[1],
+           (unsigned)r.first_by_hops[2], (unsigned)r.first_by_hops[3], (unsigned)r.duplicates);
+    printf("%u relayed, %u suppressed, %u out of TTL, %u queue full, %u not relayable\n", (unsigned)r.relayed,
+           (unsigned)r.suppressed, (unsigned)r.ttl_expired, (unsigned)r.queue_full, (unsigned)r.control);
+    return 0;
+}
+#endif
+
+// Everything heard on ESP-NOW: a relay repeats it, link adaptation messages
+// from the base stop here, the rest is corrections
+static void rover_on_espnow(pkt_block_t *pkt, void *ctx) {
+#if ROVER_RELAY
+    link_relay_input(&relay, pkt->data, pkt->len, esp_timer_get_time());
+#endif
+#if LINK_ADAPT
+    // Adapt to the base the corrections come from (LINK_BASE_ID until one is heard)
+    const rover_source_t *source = rover_pipeline_source();
+    if (source->used) link_adapt_rover_set_source(&adapt, source->id);
+    if (link_adapt_rover_input(&adapt, pkt->data, pkt->len, esp_timer_get_time())) return;
+#endif
+    rover_on_packet(pkt, ctx);
+}
+
+static void rover_receive_all(void) {
+    rover_espnow_receive_batch(rover_on_espnow, &path_espnow);
+#if LINK_BOND_UDP
+    wifi_comm_receive_batch(rover_on_packet, &path_udp);
+#endif
+#if LINK_BOND_MQTT
+    mqtt_comm_receive_batch(rover_on_packet, &path_mqtt);
+#endif
+}
+
+// Boot milestones off the pipeline state: first corrections written, first
+// position, first RTK fixed solution
+static int rover_marks_left = 3;
+
+static void rover_mark_boot(void) {
+    const rover_pipeline_t *rover = rover_pipeline_state();
+    if (rover->last_rtcm_us) platform_mark(PLATFORM_PHASE_FIRST_CORRECTION, rover->last_rtcm_us);
+    int fix, rtk;
+    if (rover->have_pvt) {
+        fix = rover->last_pvt.flags & UBX_PVT_FLAGS_GNSS_FIX_OK;
+        rtk = UBX_PVT_CARR_SOLN(rover->last_pvt.flags) == 2;
+    } else {
+        fix = rover->last_gga.quality > 0;
+        rtk = rover->last_gga.quality == 4;
+    }
+    if (fix) platform_mark(PLATFORM_PHASE_FIRST_FIX, rover->now_us);
+    if (rtk) platform_mark(PLATFORM_PHASE_RTK_FIX, rover->now_us);
+    rover_marks_left = !platform_reached(PLATFORM_PHASE_FIRST_CORRECTION) + !platform_reached(PLATFORM_PHASE_FIRST_FIX) +
+                       !platform_reached(PLATFORM_PHASE_RTK_FIX);
+}
+
+// Every queued RTCM packet from the base (first copy from any path), then the
+// timeouts: FEC gaps given up, corrections written as the UART has room
+static void rover_forward(void) {
+    PROF_SAMPLE(prof_espnow_q, rover_espnow_queued());
+    {
+        PROF_SCOPE(prof_link_rx);
+        rover_receive_all();
+    }
+    {
+        PROF_SCOPE(prof_link_poll);
+        rover_pipeline_poll(esp_timer_get_time());
+    }
+#if LINK_ADAPT
+    link_adapt_rover_poll(&adapt, esp_timer_get_time());
+#endif
+#if ROVER_RELAY
+    link_relay_poll(&relay, esp_timer_get_time());
+#endif
+    PROF_SAMPLE(prof_gnss_tx, uart_gnss_tx_queued());
+#if PROFILING
+    pkt_pool_stats_t pool_now;
+    pkt_pool_get_stats(&pool_now);
+    PROF_SAMPLE(prof_pool_q, pool_now.in_use);
+#endif
+}
+
+static void rover_print_paths(const link_bond_rx_path_t *paths, uint8_t count, uint32_t changed) {
+    for (uint8_t i = 0; i < count; i++) {
+        const link_bond_rx_path_t *p = &paths[i];
+        if (changed & (1u << i)) {
+            printf("[ROVER] path %s is %s\n", p->name, link_bond_state_name(p->state));
+        }
+    }
+    if (count < 2) return;
+    for (uint8_t i = 0; i < count; i++) {
+        const link_bond_rx_path_t *p = &paths[i];
+        printf("[ROVER] %-6s %-8s delivery %3u.%u%%  first %u  dup %u  lag %.1f ms\n",
+               p->name, link_bond_state_name(p->state), p->delivery_permille / 10, p->delivery_permille % 10,
+               (unsigned)p->first, (unsigned)p->duplicates, p->lag_us / 1000.0);
+    }
+}
+
+// One line per base heard: the selected one first marked '*', the one
+// about to take over '>'
+static void rover_print_sources(void) {
+    const rover_pipeline_t *rover = rover_pipeline_state();
+    int64_t now = esp_timer_get_time();
+    for (int i = 0; i < ROVER_SOURCES; i++) {
+        const rover_source_t *s = &rover->sources[i];
+        if (!s->used) continue;
+        char cost[12] = "-";
+        if (s->cost != ROVER_SOURCE_UNUSABLE) snprintf(cost, sizeof(cost), "%ld", (long)s->cost);
+        printf("[ROVER] %c base %-3u station %-4u cost %-5s age %6.1f ms  loss %3u.%u%%  rssi %4d  ",
+               s == rover->source ? '*' : s == rover->want ? '>' : ' ', s->id, s->arp.station_id, cost,
+               s->age_us / 1000.0, s->loss_permille / 10, s->loss_permille % 10, s->rssi);
+        if (s->have_baseline) printf("baseline %7.3f km  ", geo_enu_distance(&s->baseline) / 1e6);
+        else printf("baseline       -     ");
+        printf("heard %.1f s ago  epochs %u  written %u/%u  selected %u\n", (now - s->last_rx_us) / 1e6,
+               (unsigned)s->epochs, (unsigned)s->written, (unsigned)s->frames, (unsigned)s->selected);
+    }
+    if (rover->source_changes || rover->no_slot) {
+        printf("[ROVER] base switches %u  packets from bases beyond %d slots %u\n", (unsigned)rover->source_changes,
+               ROVER_SOURCES, (unsigned)rover->no_slot);
+    }
+}
+
+static int rover_cmd_sources(int argc, char **argv) {
+    PIPELINE_LOCK();
+    rover_print_sources();
+    PIPELINE_UNLOCK();
+    return 0;
+}
+
+static int rover_cmd_latency(int argc, char **argv) {
+    int reset = argc > 1 && strcmp(argv[1], "reset") == 0;
+    PIPELINE_LOCK();
+    link_stats_t *live = &rover_pipeline_source()->stats;
+    if (reset) link_stats_init(live);
+    link_stats_t stats = *live;
+    PIPELINE_UNLOCK();
+    if (reset) return 0;
+    if (argc > 1 && strcmp(argv[1], "bin") == 0) {
+        link_stats_frame_t frame;
+        size_t n = link_stats_pack(&stats, &frame);
+        const uint8_t *b = (const uint8_t *)&frame;
+        for (size_t i = 0; i < n; i++) printf("%02X", b[i]);
+        printf("\n");
+    } else {
+        link_stats_print(&stats);
+    }
+    return 0;
+}
+
+#if RAW_LOG
+// Corrections exactly as the receiver gets them
+static void rover_to_gnss(const uint8_t *data, size_t len) {
+    flash_log_write(RAW_LOG_SRC_ROVER_RTCM, data, len);
+    uart_gnss_write(data, len);
+}
+
+static int rover_cmd_log(int argc, char **argv) {
+    print_flash_log("ROVER");
+    return 0;
+}
+#endif
+
+#if PROFILING
+static int rover_cmd_prof(int argc, char **argv) {
+    print_profile("ROVER");
+    return 0;
+}
+#endif
+
+static int rover_cmd_pool(int argc, char **argv) {
+    pkt_pool_stats_t pool;
+    pkt_pool_get_stats(&pool);
+    printf("packet pool: %u blocks of %u B, %u in use, high-water %u, %u allocs, exhausted %u\n",
+           PKT_POOL_BLOCKS, (unsigned)PKT_BLOCK_SIZE, (unsigned)pool.in_use, (unsigned)pool.high_water,
+           (unsigned)pool.allocs, (unsigned)pool.exhausted);
+    return 0;
+}
+
+#if LINK_BOND_MQTT || ROVER_TELEMETRY
+static char mqtt_client_id[32];
+#endif
+
+#if ROVER_TELEMETRY
+static telemetry_t telemetry;
+static char telemetry_topic[64];
+
+static int rover_telemetry_send(const uint8_t *msg, size_t len, void *ctx) {
+    return mqtt_comm_enqueue(telemetry_topic, msg, len);
+}
+
+static void rover_on_solution(const ubx_nav_pvt_t *pvt, const ubx_nav_hpposllh_t *hp, void *ctx) {
+    const rover_pipeline_t *rover = rover_pipeline_state();
+    telemetry_record_t rec;
+    int64_t age = rover->last_rtcm_us ? rover->now_us - rover->last_rtcm_us : -1;
+    telemetry_record_from_nav(&rec, pvt, hp, age);
+    telemetry_add(&telemetry, &rec, rover->now_us);
+}
+
+// Published by the GNSS task after every poll: sends stay outside the
+// pipeline lock, so the console prints this copy rather than the live outbox
+static telemetry_stats_t telemetry_shown;
+static uint16_t telemetry_shown_count;
+
+static void rover_print_telemetry(void) {
+    PIPELINE_LOCK();
+    telemetry_stats_t t = telemetry_shown;
+    uint16_t count = telemetry_shown_count;
+    PIPELINE_UNLOCK();
+    printf("[ROVER] Telemetry: %u records, %u messages (avg %u, max %u records, %u B)  dropped %u  busy %u  outbox %u/%u\n",
+           (unsigned)t.records, (unsigned)t.messages, t.messages ? (unsigned)(t.sent / t.messages) : 0,
+           t.max_batch, (unsigned)t.bytes, (unsigned)t.dropped, (unsigned)t.busy, count, TELEMETRY_OUTBOX);
+}
+
+static int rover_cmd_telemetry(int argc, char **argv) {
+    printf("topic %s, interval %u ms, up to %u records per message\n", telemetry_topic,
+           (unsigned)(telemetry.interval_us / 1000), telemetry.max_batch);
+    rover_print_telemetry();
+    return 0;
+}
+#endif
+
+// Receiver output: NMEA and UBX are decoded as they complete
+static void rover_feed_gnss(const uint8_t *data, int len) {
+    PROF_SCOPE(prof_gnss_parse);
+    PIPELINE_LOCK();
+#if RAW_LOG
+    flash_log_write(RAW_LOG_SRC_ROVER_GNSS, data, len);
+#endif
+    rover_pipeline_feed_gnss(data, len, esp_timer_get_time());
+    if (rover_marks_left) rover_mark_boot();
+    PIPELINE_UNLOCK();
+}
+
+static void rover_poll_telemetry(void) {
+#if ROVER_TELEMETRY
+    PROF_SAMPLE(prof_telemetry_q, telemetry.count);
+    PROF_SCOPE(prof_telemetry);
+    telemetry_poll(&telemetry, esp_timer_get_time());
+    PIPELINE_LOCK();
+    telemetry_shown = telemetry.stats;
+    telemetry_shown_count = telemetry.count;
+    PIPELINE_UNLOCK();
+#endif
+}
+
+#if PIPELINE_TASKS
+// Radio packets -> FEC -> receiver UART. Woken by every packet a transport
+// queues; otherwise sleeps until a FEC gap expires, a queued correction goes
+// stale or the UART has room for the next one
+static void rover_forward_task(void *arg) {
+    int64_t due = INT64_MAX;
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait_ms_until(due, esp_timer_get_time())));
+        size_t tx_need;
+        PIPELINE_LOCK();
+        rover_forward();
+        due = rover_pipeline_next_us(&tx_need);
+#if ROVER_RELAY
+        int64_t relay_due = link_relay_next_us(&relay);
+        if (relay_due < due) due = relay_due;
+#endif
+        PIPELINE_UNLOCK();
+        if (tx_need) {
+            int64_t room = esp_timer_get_time() + uart_gnss_tx_wait_us(tx_need);
+            if (room < due) due = room;
+        }
+    }
+}
+
+// Receiver UART -> NMEA/UBX decoding, baseline, telemetry. Wakes on the UART
+// interrupt; off the correction path, so a burst of solutions never delays it
+static void rover_gnss_task(void *arg) {
+    uint8_t buf[512];
+    for (;;) {
+        int len = uart_gnss_read_wait(buf, sizeof(buf), TASK_IDLE_WAKE_MS);
+        PROF_SAMPLE(prof_uart_rx, len + uart_gnss_rx_waiting());
+        if (len > 0) rover_feed_gnss(buf, len);
+        rover_poll_telemetry();
+    }
+}
+#endif
+
+static void rover_display(void) {
+    const rover_pipeline_t *rover = rover_pipeline_state();
+    // Copied under the pipeline lock, printed after it: the console is far
+    // slower than the forward task
+    PIPELINE_LOCK();
+    rover_source_t *src = rover_pipeline_source();
+    int have_pvt = rover->have_pvt, have_baseline = rover->have_baseline;
+    ubx_nav_pvt_t pvt = rover->last_pvt;
+    ubx_nav_hpposllh_t hp = rover->last_hp;
+    nmea_gga_t gga = rover->last_gga;
+    geo_enu_t baseline = rover->baseline;
+    uint16_t base_station = rover->base_arp.station_id;
+    link_stats_t stats = src->stats;
+    uint32_t changed = link_bond_rx_poll(&src->bond, esp_timer_get_time());
+    link_bond_rx_path_t paths[LINK_BOND_MAX_PATHS];
+    uint8_t path_count = src->bond.count;
+    memcpy(paths, src->bond.paths, sizeof(paths));
+    uint32_t fec_recovered = src->fec.recovered, fec_unrecoverable = src->fec.unrecoverable;
+    uint32_t fec_reordered = src->fec.reordered, fec_late = src->fec.late, fec_duplicates = src->fec.duplicates;
+    uint32_t corrupted = rover->corrupted;
+    rtcm_txq_stats_t txq = rover->txq.stats;
+    uint32_t delta_coded = src->delta.coded, delta_missing = src->delta.missing_ref, delta_errors = src->delta.errors;
+    uint8_t src_id = src->id;
+    uint16_t src_station = src->arp.station_id;
+    uint32_t source_changes = rover->source_changes;
+    int bases = 0;
+    for (int i = 0; i < ROVER_SOURCES; i++) bases += rover->sources[i].used;
+#if ROVER_TELEMETRY
+    uint32_t telemetry_records = telemetry_shown.records;
+#endif
+    PIPELINE_UNLOCK();
+
+    // Prefer the binary solution when the receiver outputs UBX NAV
+    if (have_pvt) {
+        rover_display_pvt(&pvt, &hp);
+    } else {
+        rover_display_gga(&gga);
+    }
+    if (have_baseline) {
+        const geo_enu_t *b = &baseline;
+        printf("[ROVER] Baseline to %u: E %.3f  N %.3f  U %.3f m  %.3f m at %.1f deg\n",
+               base_station, b->east / 1000.0f, b->north / 1000.0f, b->up / 1000.0f,
+               geo_enu_distance(b) / 1000.0f, geo_enu_bearing(b));
+    }
+
+    pkt_ring_stats_t rx;
+    rover_espnow_get_stats(&rx);
+    if (rx.overflow || rx.dropped || rx.no_block) {
+        printf("[ROVER] RX queue: overflow %u  dropped %u  no block %u  high-water %u\n",
+               (unsigned)rx.overflow, (unsigned)rx.dropped, (unsigned)rx.no_block, (unsigned)rx.high_water);
+    }
+    pkt_pool_stats_t pool;
+    pkt_pool_get_stats(&pool);
+    if (pool.exhausted) {
+        printf("[ROVER] Packet pool: %u/%u in use  high-water %u  exhausted %u\n", (unsigned)pool.in_use,
+               PKT_POOL_BLOCKS, (unsigned)pool.high_water, (unsigned)pool.exhausted);
+    }
+    print_uart_errors("ROVER");
+#if RAW_LOG
+    flash_log_stats_t flog;
+    flash_log_get_stats(&flog);
+    if (flog.log.dropped || flog.log.flash_errors) print_flash_log("ROVER");
+#endif
+#if ROVER_TELEMETRY
+    if (telemetry_records) rover_print_telemetry();
+#endif
+    if (stats.samples) {
+        printf("[ROVER] RTCM age: last %.1f ms  avg %.1f ms  jitter %.1f ms  lost %u\n",
+               stats.lat_last_us / 1000.0, (double)stats.lat_sum_us / stats.samples / 1000.0,
+               stats.jitter_us / 1000.0, (unsigned)stats.lost);
+    }
+    rover_print_paths(paths, path_count, changed);
+    if (fec_recovered || fec_unrecoverable) {
+        printf("[ROVER] FEC: recovered %u  unrecoverable %u\n", (unsigned)fec_recovered, (unsigned)fec_unrecoverable);
+    }
+    if (fec_reordered || fec_late || fec_duplicates || corrupted || txq.stale || txq.overflow) {
+        printf("[ROVER] Jitter buffer: reordered %u  late %u  dup %u  corrupted %u  stale %u  overflow %u  "
+               "UART wait max %.1f ms  queue max %u B\n",
+               (unsigned)fec_reordered, (unsigned)fec_late, (unsigned)fec_duplicates,
+               (unsigned)corrupted, (unsigned)txq.stale, (unsigned)txq.overflow,
+               txq.wait_max_us / 1000.0, txq.queued_high_water);
+    }
+    if (delta_coded || delta_missing || delta_errors) {
+        printf("[ROVER] Delta: rebuilt %u  missing ref %u  errors %u\n", (unsigned)delta_coded,
+               (unsigned)delta_missing, (unsigned)delta_errors);
+    }
+    // Several bases heard: where the corrections come from, and when that changes
+    static uint32_t shown_changes;
+    if (bases > 1 || source_changes != shown_changes) {
+        if (source_changes != shown_changes) {
+            printf("[ROVER] Corrections now from base %u (station %u)\n", src_id, src_station);
+            shown_changes = source_changes;
+        }
+        PIPELINE_LOCK();
+        rover_print_sources();
+        PIPELINE_UNLOCK();
+    }
+}
+#endif
+
+#if GNSS_HIGH_RATE && !F9P_AUTO_CONFIG
+#error "GNSS_HIGH_RATE needs F9P_AUTO_CONFIG to move the receiver to the new rate"
+#endif
+#if BASE_SVIN_STORE && !F9P_AUTO_CONFIG && DEVICE_ROLE == DEVICE_ROLE_BASE
+#error "BASE_SVIN_STORE needs F9P_AUTO_CONFIG to turn on the receiver's NAV-SVIN output"
+#endif
+
+#if F9P_AUTO_CONFIG
+#define F9P_CFG_UART2_BAUD     0x40530001   // CFG-UART2-BAUDRATE
+#define F9P_CFG_UART2OUT_UBX   0x10760001   // CFG-UART2OUTPROT-UBX
+#define F9P_CFG_RATE_MEAS      0x30210001   // CFG-RATE-MEAS (ms)
+#define F9P_CFG_NAV_PVT_UART2  0x20910008   // CFG-MSGOUT-UBX_NAV_PVT_UART2
+#define F9P_CFG_HPPOSLLH_UART2 0x20910035   // CFG-MSGOUT-UBX_NAV_HPPOSLLH_UART2
+#define F9P_CFG_GSV_UART2      0x209100c6   // CFG-MSGOUT-NMEA_ID_GSV_UART2
+#define F9P_CFG_NAV_SVIN_UART2 0x2091008a   // CFG-MSGOUT-UBX_NAV_SVIN_UART2
+
+// Run-time changes to the generated tables
+static const f9p_cfg_value_t f9p_overrides[] = {
+#if GNSS_HIGH_RATE
+    { F9P_CFG_UART2_BAUD, GNSS_HIGH_RATE_BAUD },
+#if DEVICE_ROLE == DEVICE_ROLE_ROVER
+    { F9P_CFG_RATE_MEAS, 1000 / GNSS_NAV_RATE_HZ },
+    { F9P_CFG_GSV_UART2, GNSS_NAV_RATE_HZ },   // satellites in view once a second
+#endif
+#endif
+#if DEVICE_ROLE == DEVICE_ROLE_ROVER && (GNSS_HIGH_RATE || ROVER_TELEMETRY)
+    // Telemetry records are built from NAV-PVT; the rover dump has both off,
+    // and UBX output on UART2 as well
+    { F9P_CFG_UART2OUT_UBX, 1 },
+    { F9P_CFG_NAV_PVT_UART2, 1 },
+    { F9P_CFG_HPPOSLLH_UART2, 1 },
+#endif
+#if BASE_SVIN_STORE && DEVICE_ROLE == DEVICE_ROLE_BASE
+    { F9P_CFG_NAV_SVIN_UART2, 1 },
+#endif
+    { 0, 0 },
+};
+static f9p_cfg_t f9p_cfg;
+
+// Bring the receiver to the generated configuration before the pipelines start.
+// The stamp in NVS lets later boots of the same receiver skip the read-back
+static void f9p_auto_config(const f9p_cfg_table_t *table) {
+    nvs_handle_t nvs;
+    uint32_t stamp = 0;
+    int have_nvs = nvs_open("f9p", NVS_READWRITE, &nvs) == ESP_OK;
+    if (have_nvs) nvs_get_u32(nvs, "cfg_stamp", &stamp);
+
+    const f9p_cfg_config_t cfg = {
+        .table = table,
+        .write = uart_gnss_write,
+        .set_baud = uart_gnss_set_baud,
+        .baud = uart_gnss_baud(),
+        .baud_key = F9P_CFG_UART2_BAUD,
+        .ubx_out_key = F9P_CFG_UART2OUT_UBX,
+        .stamp = stamp,
+        .overrides = f9p_overrides,
+        .override_count = sizeof(f9p_overrides) / sizeof(f9p_overrides[0]) - 1,
+    };
+    uint8_t buf[256];
+    f9p_cfg_start(&f9p_cfg, &cfg, esp_timer_get_time());
+    while (f9p_cfg_poll(&f9p_cfg, esp_timer_get_time())) {
+        int len = uart_gnss_read(buf, sizeof(buf));
+        if (len > 0) f9p_cfg_feed(&f9p_cfg, buf, len, esp_timer_get_time());
+    }
+
+    const f9p_cfg_t *c = &f9p_cfg;
+    if (c->skipped) {
+        printf("F9P config: %s table already applied (stamp %08lX), %lu baud\n", table->name,
+               (unsigned long)c->stamp, (unsigned long)c->baud);
+    } else {
+        printf("F9P config: %s, %s table: %u of %u keys differed, %u written, %u rejected", f9p_cfg_state_name(c->state),
+               table->name, c->differing, table->count, c->written, c->rejected);
+        if (c->rejected) printf(" (last 0x%08lX)", (unsigned long)c->rejected_key);
+        printf(", %lu baud, %lld ms\n", (unsigned long)c->baud, (long long)(c->elapsed_us / 1000));
+    }
+    // Only a clean run is remembered, so a partial one is retried next boot
+    if (have_nvs) {
+        if (c->state == F9P_CFG_DONE && !c->rejected && c->stamp && c->stamp != stamp) {
+            nvs_set_u32(nvs, "cfg_stamp", c->stamp);
+            nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+}
+
+// The receiver is configured while the radio comes up; the pipeline waits
+// for PLATFORM_PHASE_RECEIVER before it reads the UART
+static void f9p_config_task(void *table) {
+    f9p_auto_config(table);
+    platform_mark(PLATFORM_PHASE_RECEIVER, esp_timer_get_time());
+    vTaskDelete(NULL);
+}
+#endif
+
+// UART first, so the receiver configuration overlaps the radio bring-up
+static void gnss_start(void) {
+    uart_gnss_init();
+    platform_mark(PLATFORM_PHASE_UART, esp_timer_get_time());
+#if F9P_AUTO_CONFIG
+#if DEVICE_ROLE == DEVICE_ROLE_BASE
+    const f9p_cfg_table_t *table = &f9p_cfg_table_base;
+#else
+    const f9p_cfg_table_t *table = &f9p_cfg_table_rover;
 #endif
+    xTaskCreate(f9p_config_task, "f9p_cfg", 4096, (void *)table, TASK_AUX_PRIO, NULL);
+#else
+    platform_mark(PLATFORM_PHASE_RECEIVER, esp_timer_get_time());
+#endif
+}
 
 void app_main(void)
 {
-    // Initialize NVS (required for Wi-Fi/ESP-NOW)
-    esp_err_t ret = nvs_flash_init();
-    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
-        ESP_ERROR_CHECK(nvs_flash_erase());
-        ret = nvs_flash_init();
-    }
-    ESP_ERROR_CHECK(ret);
+    // NVS first: Wi-Fi, ESP-NOW and the receiver configuration all use it
+    platform_nvs_init();
+#if PROFILING
+    prof_init(esp_rom_get_cpu_ticks_per_us());
+#if !PIPELINE_TASKS
+    PROF_REGISTER_STAGE(prof_loop, "loop");
+    PROF_REGISTER_STAGE(prof_uart_read, "uart read");
+#endif
+    PROF_REGISTER_DEPTH(prof_uart_rx, "uart rx", UART_GNSS_RX_BUF_SIZE);
+#endif
 
 #if DEVICE_ROLE == DEVICE_ROLE_BASE
     printf("=== RTK BASE STATION ===\n");
+    gnss_start();
+#if LINK_BOND_UDP || LINK_BOND_MQTT || NTRIP_CASTER
+    wifi_comm_init(LINK_WIFI_SSID, LINK_WIFI_PASSWORD, 1);
+#endif
+#if LINK_BOND_MQTT
+    mqtt_comm_init(LINK_MQTT_BROKER, "hagps-base", LINK_MQTT_TOPIC);
+#endif
     espnow_comm_init();
-    uart_gnss_init();
+    link_bond_tx_init(&bond_tx);
+    link_bond_tx_add_path(&bond_tx, "espnow", espnow_comm_send, NULL);
+#if LINK_BOND_UDP
+    link_bond_tx_add_path(&bond_tx, "udp", wifi_comm_send, wifi_comm_ready);
+#endif
+#if LINK_BOND_MQTT
+    link_bond_tx_add_path(&bond_tx, "mqtt", mqtt_comm_publish, mqtt_comm_connected);
+#endif
+    base_pipeline_init(NULL, base_send_bonded);
+    base_pipeline_set_source(LINK_BASE_ID, LINK_RELAY_TTL);
+#if LINK_ADAPT
+    // Associated with an AP the radio stays on the AP's channel. In a mesh the
+    // channel announcements are not relayed: rovers behind a relay would be
+    // left on the old channel
+    const int base_on_ap = LINK_BOND_UDP || LINK_BOND_MQTT || NTRIP_CASTER;
+    const int base_channel_fixed = base_on_ap || ROVER_RELAY;
+    const link_adapt_io_t adapt_io = {
+        .set_rate = base_adapt_rate,
+        .set_channel = base_channel_fixed ? NULL : base_adapt_channel,
+        .send = base_adapt_send,
+        .channels = adapt_channels,
+        .channel_count = sizeof(adapt_channels),
+        .channel = adapt_channels[0],
+        .source = LINK_BASE_ID,
+    };
+    if (!base_on_ap) espnow_comm_set_channel(adapt_channels[0]);
+    link_adapt_base_init(&adapt, &adapt_io, esp_timer_get_time());
+#endif
+#if RAW_LOG
+    if (flash_log_init() == 0) base_pipeline_set_tap(base_log_rtcm, NULL);
+#endif
+#if LINK_DELTA_CODEC
+    base_pipeline_set_delta(1, LINK_DELTA_KEY_INTERVAL);
+#endif
+#if NTRIP_CASTER
+    const ntrip_caster_config_t caster_cfg = { .port = 2101, .mountpoint = NTRIP_MOUNTPOINT };
+    if (ntrip_caster_init(&caster, &caster_cfg) == 0) {
+        base_pipeline_set_source_tap(base_to_caster, NULL);
+        printf("NTRIP caster on port 2101, mountpoint /%s\n", NTRIP_MOUNTPOINT);
+    } else {
+        printf("NTRIP caster failed to start\n");
+    }
+#endif
 
+    // The receiver configuration owns the UART until it is done. Without
+    // INCLUDE_vTaskSuspend even a forever wait can return early
+    while (!platform_wait(PLATFORM_PHASE_RECEIVER, PLATFORM_WAIT_FOREVER)) {
+    }
+#if BASE_SVIN_STORE
+    base_position_start();
+#endif
+
+    PROF_REGISTER_STAGE(prof_base_feed, "base feed");
+    PROF_REGISTER_STAGE(prof_base_poll, "base poll");
+    PROF_REGISTER_STAGE(prof_ntrip_poll, "ntrip poll");
+    PROF_REGISTER_STAGE(prof_stats, "stats");
+
+    int64_t next_stats_us = esp_timer_get_time() + 10000000;
+#if PROFILING
+    int64_t next_prof_us = esp_timer_get_time() + PROFILING_DUMP_S * 1000000LL;
+#endif
+#if PIPELINE_TASKS
+#if LINK_ADAPT
+    start_tasks(base_forward_task, "gnss_fwd", base_adapt_task, "link_adapt");
+    espnow_comm_set_wake(wake_aux, NULL);
+#else
+    start_tasks(base_forward_task, "gnss_fwd", NULL, NULL);
+#endif
+#else
     uint8_t data[512];
-    int rtcm_seen = 0;
+#endif
+    platform_mark(PLATFORM_PHASE_PIPELINE, esp_timer_get_time());
     
+    // Polling build: the whole pipeline runs here. Event-driven build: only the statistics
     while (1) {
-        int len = uart_gnss_read(data, sizeof(data));
-        if (len > 0) {
-            // Check for RTCM (0xD3 = start of RTCM3)
-            for (int i = 0; i < len; i++) {
-                if (data[i] == 0xD3) {
-                    if (!rtcm_seen) {
-                        rtcm_seen = 1;
-                        printf("\n*** SURVEY-IN COMPLETE - RTCM ACTIVE ***\n\n");
-                    }
-                    break;
-                }
-            }
-            
-            // Forward all data to rover immediately
-            espnow_comm_send(data, len);
+        PROF_START(loop_start);
+        int64_t now = esp_timer_get_time();
+#if !PIPELINE_TASKS
+        PROF_SAMPLE(prof_uart_rx, uart_gnss_rx_waiting());
+        int len;
+        // Drain the RX ring: a full read means more is waiting
+        do {
+            PROF_START(read_start);
+            len = uart_gnss_read(data, sizeof(data));
+            PROF_STOP(prof_uart_read, read_start);
+            now = esp_timer_get_time();
+            if (len > 0) base_feed(data, len, now);
+        } while (len == (int)sizeof(data));
+        base_service(now);
+#if LINK_ADAPT
+        espnow_comm_receive_batch(base_on_feedback, NULL);
+        link_adapt_base_poll(&adapt, now);
+#endif
+#endif
+
+        if (now >= next_stats_us) {
+            PROF_SCOPE(prof_stats);
+            next_stats_us = now + 10000000;
+            PIPELINE_LOCK();
+            rtcm_sched_update_rates(&base_pipeline_state()->sched, now);
+            PIPELINE_UNLOCK();
+            base_print_rtcm_stats();
+#if BASE_SVIN_STORE
+            base_print_position();
+#endif
+#if LINK_ADAPT
+            base_print_adapt();
+#endif
+            print_uart_errors("BASE");
+#if RAW_LOG
+            print_flash_log("BASE");
+#endif
+#if NTRIP_CASTER
+            base_print_caster();
+#endif
+        }
+        platform_print_boot("BASE");
+        PROF_STOP(prof_loop, loop_start);
+#if PROFILING
+        if (now >= next_prof_us) {
+            next_prof_us = now + PROFILING_DUMP_S * 1000000LL;
+            print_profile("BASE");
+            prof_reset();
         }
+#endif
+#if PIPELINE_TASKS
+        vTaskDelay(pdMS_TO_TICKS(1000));
+#else
         vTaskDelay(10 / portTICK_PERIOD_MS);
+#endif
     }
 
 #elif DEVICE_ROLE == DEVICE_ROLE_ROVER
     printf("=== RTK ROVER ===\n");
+    gnss_start();
+#if LINK_BOND_UDP || LINK_BOND_MQTT || ROVER_TELEMETRY
+    wifi_comm_init(LINK_WIFI_SSID, LINK_WIFI_PASSWORD, 0);
+#endif
+#if LINK_BOND_MQTT || ROVER_TELEMETRY
+    // Unique per rover: the broker drops a session when another client takes its id
+    uint8_t mac[6];
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    snprintf(mqtt_client_id, sizeof(mqtt_client_id), "hagps-rover-%02x%02x%02x", mac[3], mac[4], mac[5]);
+    mqtt_comm_init(LINK_MQTT_BROKER, mqtt_client_id, LINK_BOND_MQTT ? LINK_MQTT_TOPIC : NULL);
+#endif
     rover_espnow_receiver_init();
+#if RAW_LOG
+    flash_log_init();
+    rover_pipeline_init(rover_to_gnss, uart_gnss_tx_queue_us, uart_gnss_tx_free);
+#else
+    rover_pipeline_init(uart_gnss_write, uart_gnss_tx_queue_us, uart_gnss_tx_free);
+#endif
+    path_espnow = rover_pipeline_add_path("espnow");
+#if LINK_BOND_UDP
+    path_udp = rover_pipeline_add_path("udp");
+#endif
+#if LINK_BOND_MQTT
+    path_mqtt = rover_pipeline_add_path("mqtt");
+#endif
+    rover_pipeline_set_source_rssi(rover_espnow_source_rssi);
+    console_register_command("latency", "Correction latency stats: latency [bin|reset]", rover_cmd_latency);
+    console_register_command("sources", "Bases heard: ranking, age, loss, RSSI, baseline", rover_cmd_sources);
+    console_register_command("pool", "Packet block pool usage", rover_cmd_pool);
+#if LINK_ADAPT
+    const int rover_on_ap = LINK_BOND_UDP || LINK_BOND_MQTT || ROVER_TELEMETRY;
+    const int rover_channel_fixed = rover_on_ap || ROVER_RELAY;
+    const link_adapt_io_t adapt_io = {
+        .set_rate = rover_adapt_rate,
+        .set_channel = rover_channel_fixed ? NULL : rover_adapt_channel,
+        .send = rover_adapt_send,
+        .read_rssi = rover_adapt_rssi,
+        .channels = adapt_channels,
+        .channel_count = sizeof(adapt_channels),
+        .channel = adapt_channels[0],
+        .source = LINK_BASE_ID,
+    };
+    if (!rover_on_ap) rover_espnow_set_channel(adapt_channels[0]);
+    link_adapt_rover_init(&adapt, &adapt_io, esp_timer_get_time());
+    console_register_command("adapt", "Link adaptation: channel, reports and channel moves", rover_cmd_adapt);
+#endif
+#if ROVER_RELAY
+    link_relay_init(&relay, rover_espnow_send, esp_random());
+    console_register_command("relay", "Mesh relay: copies heard, relayed and suppressed", rover_cmd_relay);
+#endif
+#if PROFILING
+    PROF_REGISTER_STAGE(prof_link_rx, "link rx");
+    PROF_REGISTER_STAGE(prof_link_poll, "link poll");
+    PROF_REGISTER_STAGE(prof_gnss_parse, "gnss parse");
+    PROF_REGISTER_STAGE(prof_telemetry, "telemetry");
+    PROF_REGISTER_STAGE(prof_stats, "display");
+    PROF_REGISTER_DEPTH(prof_espnow_q, "espnow rx", ESPNOW_RX_SLOTS);
+    PROF_REGISTER_DEPTH(prof_pool_q, "pkt pool", PKT_POOL_BLOCKS);
+    PROF_REGISTER_DEPTH(prof_gnss_tx, "gnss tx", UART_GNSS_TX_BUF_SIZE);
+#if ROVER_TELEMETRY
+    PROF_REGISTER_DEPTH(prof_telemetry_q, "telemetry", TELEMETRY_OUTBOX);
+#endif
+    console_register_command("prof", "Loop stage timing, queue depths and task CPU/stack use", rover_cmd_prof);
+#endif
+#if RAW_LOG
+    console_register_command("log", "Raw stream log stats and worst-case stall", rover_cmd_log);
+#endif
+#if ROVER_TELEMETRY
+    snprintf(telemetry_topic, sizeof(telemetry_topic), "%s/%s", LINK_MQTT_TELEMETRY_TOPIC, mqtt_client_id);
+    telemetry_init(&telemetry, ROVER_TELEMETRY_INTERVAL_MS, ROVER_TELEMETRY_MAX_BATCH, rover_telemetry_send, NULL);
+    rover_pipeline_set_solution_cb(rover_on_solution, NULL);
+    console_register_command("telemetry", "Position telemetry publishing stats", rover_cmd_telemetry);
+#endif
+    console_init();
 
-    static uint8_t gnss_buf[2048]; // Static to avoid stack overflow
-    uint8_t buf[256];
-    size_t gnss_len = 0;
-    int rtcm_count = 0;
-    int loop_count = 0;
+#if PROFILING
+    int64_t next_prof_us = esp_timer_get_time() + PROFILING_DUMP_S * 1000000LL;
+#endif
+    int64_t next_display_us = esp_timer_get_time() + ROVER_DISPLAY_MS * 1000LL;
+    // The receiver configuration owns the UART until it is done. Without
+    // INCLUDE_vTaskSuspend even a forever wait can return early
+    while (!platform_wait(PLATFORM_PHASE_RECEIVER, PLATFORM_WAIT_FOREVER)) {
+    }
+#if PIPELINE_TASKS
+    start_tasks(rover_forward_task, "link_fwd", rover_gnss_task, "gnss_nav");
+    rover_espnow_set_wake(wake_forward, NULL);
+#if LINK_BOND_UDP
+    wifi_comm_set_wake(wake_forward, NULL);
+#endif
+#if LINK_BOND_MQTT
+    mqtt_comm_set_wake(wake_forward, NULL);
+#endif
+#else
+    uint8_t gnss_buf[512];
+#endif
+    platform_mark(PLATFORM_PHASE_PIPELINE, esp_timer_get_time());
     
+    // Polling build: the whole pipeline runs here. Event-driven build: only the display
     while (1) {
-        // Receive RTCM from base and forward to ZED-F9P
-        int len = rover_espnow_receive(buf, sizeof(buf));
-        if (len > 0) {
-            rover_forward_to_gnss(buf, len);
-            rtcm_count++;
-            if (rtcm_count % 50 == 0) {
-                printf("[ROVER] RTCM: %d packets\n", rtcm_count);
-            }
-        }
+        PROF_START(loop_start);
+#if !PIPELINE_TASKS
+        PROF_SAMPLE(prof_uart_rx, uart_gnss_rx_waiting());
+        rover_forward();
         
         // Read GPS data from ZED-F9P
-        int read_len = rover_uart_read(gnss_buf + gnss_len, sizeof(gnss_buf) - gnss_len);
-        if (read_len > 0) {
-            gnss_len += read_len;
-            
-            // Shift buffer if getting full
-            if (gnss_len > sizeof(gnss_buf) - 256) {
-                memmove(gnss_buf, gnss_buf + 1024, gnss_len - 1024);
-                gnss_len -= 1024;
-            }
-        }
+        int read_len;
+        do {
+            PROF_START(read_start);
+            read_len = uart_gnss_read(gnss_buf, sizeof(gnss_buf));
+            PROF_STOP(prof_uart_read, read_start);
+            if (read_len > 0) rover_feed_gnss(gnss_buf, read_len);
+        } while (read_len == (int)sizeof(gnss_buf));
+        rover_poll_telemetry();
+#endif
         
-        // Display GPS info every ~2 seconds
-        if (++loop_count >= 200) {
-            loop_count = 0;
-            rover_display_gga(gnss_buf, gnss_len);
+        if (esp_timer_get_time() >= next_display_us) {
+            PROF_SCOPE(prof_stats);
+            next_display_us = esp_timer_get_time() + ROVER_DISPLAY_MS * 1000LL;
+            rover_display();
         }
+        platform_print_boot("ROVER");
+        PROF_STOP(prof_loop, loop_start);
+#if PROFILING
+        if (esp_timer_get_time() >= next_prof_us) {
+            next_prof_us = esp_timer_get_time() + PROFILING_DUMP_S * 1000000LL;
+            print_profile("ROVER");
+            prof_reset();
+        }
+#endif
         
+#if PIPELINE_TASKS
+        vTaskDelay(pdMS_TO_TICKS(ROVER_DISPLAY_MS));
+#else
         vTaskDelay(10 / portTICK_PERIOD_MS);
+#endif
     }
 #endif
 }
\ No newline at end of file
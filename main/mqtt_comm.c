@@ -1,46 +1,54 @@
 #include "mqtt_comm.h"
+#include "pkt_ring.h"
+#include "platform.h"
 #include "esp_log.h"
 #include "esp_event.h"
-#include "nvs_flash.h"
+#include "esp_wifi.h"
 #include "mqtt_client.h"
 #include <string.h>
 
 static const char *TAG = "MQTT_COMM";
 static esp_mqtt_client_handle_t client = NULL;
 static char mqtt_topic[128] = {0};
-static uint8_t rx_buffer[512];
-static volatile int rx_len = 0;
+static volatile int connected = 0;
+static int started = 0;
+#define MQTT_RX_SLOTS 8
+static pkt_block_t *rx_slots[MQTT_RX_SLOTS];
+static pkt_ring_t rx_ring;
 
 static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data) {
     esp_mqtt_event_handle_t event = event_data;
     switch (event->event_id) {
         case MQTT_EVENT_CONNECTED:
             ESP_LOGI(TAG, "MQTT Connected");
+            // A clean session forgets subscriptions: renewed on every connection
+            if (mqtt_topic[0]) esp_mqtt_client_subscribe(client, mqtt_topic, 0);
+            connected = 1;
             break;
         case MQTT_EVENT_DISCONNECTED:
             ESP_LOGI(TAG, "MQTT Disconnected");
+            connected = 0;
             break;
         case MQTT_EVENT_DATA:
-            if (event->data_len > 0 && event->data_len < sizeof(rx_buffer)) {
-                memcpy(rx_buffer, event->data, event->data_len);
-                rx_len = event->data_len;
-            }
+            pkt_ring_push(&rx_ring, (const uint8_t *)event->data, event->data_len > 0 ? (size_t)event->data_len : 0);
             break;
         default:
             break;
     }
 }
 
-void mqtt_comm_init(const char *broker_url, const char *client_id, const char *topic) {
-    esp_err_t ret = nvs_flash_init();
-    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
-        ESP_ERROR_CHECK(nvs_flash_erase());
-        ret = nvs_flash_init();
-    }
-    ESP_ERROR_CHECK(ret);
+// The client starts with the first address: started earlier, its first
+// attempt fails and the retry waits out the reconnect timeout
+static void ip_event(void *arg, esp_event_base_t base, int32_t id, void *data) {
+    if (started) return;
+    started = 1;
+    esp_mqtt_client_start(client);
+}
 
-    esp_event_loop_create_default();
-    strncpy(mqtt_topic, topic, sizeof(mqtt_topic) - 1);
+void mqtt_comm_init(const char *broker_url, const char *client_id, const char *topic) {
+    platform_wifi_init();
+    pkt_ring_init(&rx_ring, rx_slots, MQTT_RX_SLOTS);
+    if (topic) strncpy(mqtt_topic, topic, sizeof(mqtt_topic) - 1);
 
     esp_mqtt_client_config_t mqtt_cfg = {
         .broker = {
@@ -54,22 +62,39 @@ void mqtt_comm_init(const char *broker_url, const char *client_id, const char *t
     };
     client = esp_mqtt_client_init(&mqtt_cfg);
     esp_mqtt_client_register_event(client, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL);
-    esp_mqtt_client_start(client);
-    esp_mqtt_client_subscribe(client, mqtt_topic, 0);
+    esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, ip_event, NULL);
+    if (platform_wifi_connected()) ip_event(NULL, IP_EVENT, IP_EVENT_STA_GOT_IP, NULL);
 }
 
 void mqtt_comm_publish(const uint8_t *data, size_t len) {
-    if (client) {
+    if (client && mqtt_topic[0]) {
         esp_mqtt_client_publish(client, mqtt_topic, (const char *)data, len, 0, 0);
     }
 }
 
+int mqtt_comm_enqueue(const char *topic, const uint8_t *data, size_t len) {
+    if (!client || !connected) return -1;
+    // QoS 0 messages are only kept in the outbox when stored, which makes its size the backlog
+    if (esp_mqtt_client_get_outbox_size(client) > MQTT_OUTBOX_LIMIT) return -1;
+    return esp_mqtt_client_enqueue(client, topic, (const char *)data, (int)len, 0, 0, true) < 0 ? -1 : 0;
+}
+
+int mqtt_comm_connected(void) {
+    return connected;
+}
+
 int mqtt_comm_subscribe(uint8_t *data, size_t max_len) {
-    if (rx_len > 0) {
-        int len = rx_len > max_len ? max_len : rx_len;
-        memcpy(data, rx_buffer, len);
-        rx_len = 0;
-        return len;
-    }
-    return 0;
+    return pkt_ring_pop(&rx_ring, data, max_len);
+}
+
+size_t mqtt_comm_receive_batch(pkt_ring_cb_t cb, void *ctx) {
+    return pkt_ring_drain(&rx_ring, cb, ctx, MQTT_RX_SLOTS);
+}
+
+void mqtt_comm_set_wake(pkt_ring_wake_fn_t wake, void *ctx) {
+    pkt_ring_set_wake(&rx_ring, wake, ctx);
+}
+
+void mqtt_comm_get_stats(pkt_ring_stats_t *stats) {
+    *stats = rx_ring.stats;
 }
@@ -3,9 +3,24 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include "pkt_ring.h"
 
+// Outbox bytes above which mqtt_comm_enqueue() reports the client busy
+#define MQTT_OUTBOX_LIMIT 8192
+
+// topic carries the RTCM link; NULL when the connection is only used for
+// mqtt_comm_enqueue(). Returns at once: the client connects once Wi-Fi has an
+// address (platform_wifi_connect())
 void mqtt_comm_init(const char *broker_url, const char *client_id, const char *topic);
 void mqtt_comm_publish(const uint8_t *data, size_t len);
+// Queue a QoS 0 message for the client task without blocking; returns -1 while
+// disconnected or while the outbox holds more than MQTT_OUTBOX_LIMIT bytes
+int mqtt_comm_enqueue(const char *topic, const uint8_t *data, size_t len);
+int mqtt_comm_connected(void);
 int mqtt_comm_subscribe(uint8_t *data, size_t max_len);
+size_t mqtt_comm_receive_batch(pkt_ring_cb_t cb, void *ctx);
+// Run wake(ctx) from the client task whenever a message is queued
+void mqtt_comm_set_wake(pkt_ring_wake_fn_t wake, void *ctx);
+void mqtt_comm_get_stats(pkt_ring_stats_t *stats);
 
 #endif // MQTT_COMM_H
@@ -0,0 +1,208 @@
+#include "nmea_parser.h"
+#include "geo.h"
+#include <string.h>
+#include <stdlib.h>
+
+enum {
+    NMEA_IDLE = 0,   // waiting for '$'
+    NMEA_BODY,       // collecting talker/sentence/fields
+    NMEA_CK_HI,      // first checksum hex digit
+    NMEA_CK_LO,      // second checksum hex digit
+    NMEA_EOL,        // waiting for CR/LF
+};
+
+static int hex_value(uint8_t c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+static float field_float(const char *f, float def) {
+    return f[0] ? strtof(f, NULL) : def;
+}
+
+static int field_int(const char *f, int def) {
+    return f[0] ? atoi(f) : def;
+}
+
+static void decode_gga(nmea_parser_t *p, char **f, int n) {
+    if (!p->handlers.on_gga || n < 15) {
+        p->ignored++;
+        return;
+    }
+    nmea_gga_t gga = {
+        .time = f[1],
+        .lat = geo_parse_nmea_coord(f[2], f[3]),
+        .lon = geo_parse_nmea_coord(f[4], f[5]),
+        .quality = field_int(f[6], 0),
+        .sats = field_int(f[7], 0),
+        .hdop = field_float(f[8], 0.0f),
+        .alt = field_float(f[9], 0.0f),
+        .geoid_sep = field_float(f[11], 0.0f),
+        .diff_age = field_float(f[13], -1.0f),
+        .diff_station = field_int(f[14], -1),
+        .has_position = f[2][0] && f[4][0],
+    };
+    p->handlers.on_gga(&gga, p->handlers.ctx);
+}
+
+static void decode_gsa(nmea_parser_t *p, char **f, int n) {
+    if (!p->handlers.on_gsa || n < 18) {
+        p->ignored++;
+        return;
+    }
+    nmea_gsa_t gsa = {
+        .mode = f[1][0],
+        .fix_type = field_int(f[2], 1),
+        .pdop = field_float(f[15], 0.0f),
+        .hdop = field_float(f[16], 0.0f),
+        .vdop = field_float(f[17], 0.0f),
+    };
+    for (int i = 3; i <= 14; i++) {
+        if (f[i][0]) gsa.sv_count++;
+    }
+    p->handlers.on_gsa(&gsa, p->handlers.ctx);
+}
+
+static void decode_rmc(nmea_parser_t *p, char **f, int n) {
+    if (!p->handlers.on_rmc || n < 10) {
+        p->ignored++;
+        return;
+    }
+    nmea_rmc_t rmc = {
+        .time = f[1],
+        .status = f[2][0],
+        .lat = geo_parse_nmea_coord(f[3], f[4]),
+        .lon = geo_parse_nmea_coord(f[5], f[6]),
+        .speed_kn = field_float(f[7], 0.0f),
+        .course_deg = field_float(f[8], 0.0f),
+        .date = f[9],
+        .mode = n > 12 ? f[12][0] : 0,
+    };
+    p->handlers.on_rmc(&rmc, p->handlers.ctx);
+}
+
+static void decode_gst(nmea_parser_t *p, char **f, int n) {
+    if (!p->handlers.on_gst || n < 9) {
+        p->ignored++;
+        return;
+    }
+    nmea_gst_t gst = {
+        .time = f[1],
+        .rms = field_float(f[2], 0.0f),
+        .semi_major = field_float(f[3], 0.0f),
+        .semi_minor = field_float(f[4], 0.0f),
+        .orient = field_float(f[5], 0.0f),
+        .lat_err = field_float(f[6], 0.0f),
+        .lon_err = field_float(f[7], 0.0f),
+        .alt_err = field_float(f[8], 0.0f),
+    };
+    p->handlers.on_gst(&gst, p->handlers.ctx);
+}
+
+// Split the checksum-valid body in place and hand it to the matching decoder
+static void dispatch(nmea_parser_t *p) {
+    char *fields[NMEA_MAX_FIELDS];
+    int n = 0;
+
+    p->line[p->len] = '\0';
+    fields[n++] = p->line;
+    for (size_t i = 0; i < p->len && n < NMEA_MAX_FIELDS; i++) {
+        if (p->line[i] == ',') {
+            p->line[i] = '\0';
+            fields[n++] = &p->line[i + 1];
+        }
+    }
+    // Pad missing trailing fields so decoders can index freely
+    for (int i = n; i < NMEA_MAX_FIELDS; i++) {
+        fields[i] = &p->line[p->len];
+    }
+
+    // Address field is talker (2 chars, e.g. GN/GP) + sentence type
+    const char *addr = fields[0];
+    if (strlen(addr) != 5) {
+        p->ignored++;
+        return;
+    }
+    const char *type = addr + 2;
+    if (memcmp(type, "GGA", 3) == 0)      decode_gga(p, fields, n);
+    else if (memcmp(type, "GSA", 3) == 0) decode_gsa(p, fields, n);
+    else if (memcmp(type, "RMC", 3) == 0) decode_rmc(p, fields, n);
+    else if (memcmp(type, "GST", 3) == 0) decode_gst(p, fields, n);
+    else p->ignored++;
+}
+
+void nmea_parser_init(nmea_parser_t *p, const nmea_handlers_t *handlers) {
+    memset(p, 0, sizeof(*p));
+    if (handlers) p->handlers = *handlers;
+}
+
+void nmea_parser_feed(nmea_parser_t *p, const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        uint8_t c = data[i];
+
+        if (c == '$') {
+            // A new start always resyncs, even mid-sentence
+            if (p->state != NMEA_IDLE) p->overflows++;
+            p->state = NMEA_BODY;
+            p->len = 0;
+            p->checksum = 0;
+            continue;
+        }
+
+        switch (p->state) {
+        case NMEA_IDLE:
+            break;
+
+        case NMEA_BODY:
+            if (c == '*') {
+                p->state = NMEA_CK_HI;
+            } else if (c < 0x20 || c > 0x7E || p->len >= NMEA_MAX_LINE - 1) {
+                // Binary data or runaway line - abandon it
+                p->overflows++;
+                p->state = NMEA_IDLE;
+            } else {
+                p->line[p->len++] = (char)c;
+                p->checksum ^= c;
+            }
+            break;
+
+        case NMEA_CK_HI: {
+            int v = hex_value(c);
+            if (v < 0) {
+                p->checksum_errors++;
+                p->state = NMEA_IDLE;
+            } else {
+                p->expected = (uint8_t)(v << 4);
+                p->state = NMEA_CK_LO;
+            }
+            break;
+        }
+
+        case NMEA_CK_LO: {
+            int v = hex_value(c);
+            if (v < 0) {
+                p->checksum_errors++;
+                p->state = NMEA_IDLE;
+            } else {
+                p->expected |= (uint8_t)v;
+                p->state = NMEA_EOL;
+            }
+            break;
+        }
+
+        case NMEA_EOL:
+            p->state = NMEA_IDLE;
+            if (c != '\r' && c != '\n') {
+                p->overflows++;
+            } else if (p->expected != p->checksum) {
+                p->checksum_errors++;
+            } else {
+                p->sentences++;
+                dispatch(p);
+            }
+            break;
+        }
+    }
+}
@@ -0,0 +1,88 @@
+#ifndef NMEA_PARSER_H
+#define NMEA_PARSER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Incremental NMEA 0183 parser. Bytes are fed as they arrive from the UART
+// (mixed with UBX/RTCM binary is fine); each sentence is checked against its
+// *hh checksum and decoded once, when its line ending is seen.
+
+#define NMEA_MAX_LINE   128   // u-blox sentences can exceed the 82 char spec
+#define NMEA_MAX_FIELDS 24
+
+// String fields point into the parser's line buffer and are only valid for
+// the duration of the callback.
+
+typedef struct {
+    const char *time;     // hhmmss.ss UTC
+    int64_t lat;          // 1e-9 deg, +N (geo.h)
+    int64_t lon;          // 1e-9 deg, +E
+    int quality;          // 0=invalid 1=GPS 2=DGPS 4=RTK fixed 5=RTK float 6=DR
+    int sats;
+    float hdop;
+    float alt;            // metres above MSL
+    float geoid_sep;      // metres
+    float diff_age;       // seconds since last correction, -1 if absent
+    int diff_station;     // -1 if absent
+    int has_position;     // lat/lon fields were populated
+} nmea_gga_t;
+
+typedef struct {
+    char mode;            // M=manual A=automatic
+    int fix_type;         // 1=none 2=2D 3=3D
+    int sv_count;         // satellites used in this sentence
+    float pdop;
+    float hdop;
+    float vdop;
+} nmea_gsa_t;
+
+typedef struct {
+    const char *time;     // hhmmss.ss UTC
+    const char *date;     // ddmmyy
+    char status;          // A=valid V=warning
+    int64_t lat;          // 1e-9 deg
+    int64_t lon;
+    float speed_kn;
+    float course_deg;
+    char mode;            // A/D/R/F/N positioning mode indicator
+} nmea_rmc_t;
+
+typedef struct {
+    const char *time;
+    float rms;            // range residual RMS, metres
+    float semi_major;     // error ellipse, metres
+    float semi_minor;
+    float orient;         // degrees from true north
+    float lat_err;        // 1-sigma, metres
+    float lon_err;
+    float alt_err;
+} nmea_gst_t;
+
+typedef struct {
+    void (*on_gga)(const nmea_gga_t *gga, void *ctx);
+    void (*on_gsa)(const nmea_gsa_t *gsa, void *ctx);
+    void (*on_rmc)(const nmea_rmc_t *rmc, void *ctx);
+    void (*on_gst)(const nmea_gst_t *gst, void *ctx);
+    void *ctx;
+} nmea_handlers_t;
+
+typedef struct {
+    char line[NMEA_MAX_LINE];
+    size_t len;
+    uint8_t state;
+    uint8_t checksum;     // running XOR of the sentence body
+    uint8_t expected;     // checksum parsed from *hh
+    nmea_handlers_t handlers;
+    uint32_t sentences;   // checksum-valid sentences
+    uint32_t checksum_errors;
+    uint32_t overflows;   // lines longer than NMEA_MAX_LINE or containing binary
+    uint32_t ignored;     // valid sentences with no decoder/handler
+} nmea_parser_t;
+
+// Reset parser state and counters; handlers may be NULL
+void nmea_parser_init(nmea_parser_t *p, const nmea_handlers_t *handlers);
+// Feed raw UART bytes
+void nmea_parser_feed(nmea_parser_t *p, const uint8_t *data, size_t len);
+
+#endif // NMEA_PARSER_H
@@ -0,0 +1,256 @@
+#include "ntrip_caster.h"
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#define RING_MASK (NTRIP_RING_SIZE - 1)
+
+static void set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+int ntrip_caster_init(ntrip_caster_t *c, const ntrip_caster_config_t *cfg) {
+    memset(c, 0, sizeof(*c));
+    c->cfg = *cfg;
+    for (int i = 0; i < NTRIP_MAX_CLIENTS; i++) c->clients[i].fd = -1;
+
+    c->listen_fd = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+    if (c->listen_fd < 0) return -1;
+    int one = 1;
+    setsockopt(c->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(cfg->port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(c->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(c->listen_fd, 4) < 0) {
+        close(c->listen_fd);
+        c->listen_fd = -1;
+        return -1;
+    }
+    set_nonblocking(c->listen_fd);
+    return 0;
+}
+
+uint16_t ntrip_caster_port(const ntrip_caster_t *c) {
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    if (c->listen_fd < 0 || getsockname(c->listen_fd, (struct sockaddr *)&addr, &len) < 0) return 0;
+    return ntohs(addr.sin_port);
+}
+
+void ntrip_caster_set_position(ntrip_caster_t *c, double lat, double lon) {
+    c->cfg.lat = lat;
+    c->cfg.lon = lon;
+}
+
+void ntrip_caster_write(ntrip_caster_t *c, const uint8_t *data, size_t len) {
+    if (len > NTRIP_RING_SIZE) return;
+    size_t at = c->head & RING_MASK;
+    size_t first = len < NTRIP_RING_SIZE - at ? len : NTRIP_RING_SIZE - at;
+    memcpy(c->ring + at, data, first);
+    memcpy(c->ring, data + first, len - first);
+    c->head += (uint32_t)len;
+}
+
+static void client_close(ntrip_client_t *cl) {
+    if (cl->fd >= 0) close(cl->fd);
+    cl->fd = -1;
+    cl->state = NTRIP_CLIENT_FREE;
+}
+
+static void accept_clients(ntrip_caster_t *c, int64_t now_us) {
+    for (;;) {
+        int fd = accept(c->listen_fd, NULL, NULL);
+        if (fd < 0) return;
+        ntrip_client_t *cl = NULL;
+        for (int i = 0; i < NTRIP_MAX_CLIENTS && !cl; i++) {
+            if (c->clients[i].state == NTRIP_CLIENT_FREE) cl = &c->clients[i];
+        }
+        if (!cl) {
+            close(fd);
+            c->rejected++;
+            continue;
+        }
+        set_nonblocking(fd);
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        memset(cl, 0, sizeof(*cl));
+        cl->fd = fd;
+        cl->state = NTRIP_CLIENT_REQUEST;
+        cl->since_us = now_us;
+        cl->progress_us = now_us;
+        c->accepted++;
+    }
+}
+
+static void build_sourcetable(ntrip_caster_t *c, ntrip_client_t *cl) {
+    // Empty latitude and longitude until the base knows where it is, not 0,0
+    char lat[16] = "", lon[16] = "";
+    if (c->cfg.lat != 0.0 || c->cfg.lon != 0.0) {
+        snprintf(lat, sizeof(lat), "%.2f", c->cfg.lat);
+        snprintf(lon, sizeof(lon), "%.2f", c->cfg.lon);
+    }
+    char str[256];
+    int n = snprintf(str, sizeof(str),
+                     "STR;%s;%s;RTCM 3.3;1005(10),1077(1),1087(1),1097(1),1127(1),1230(10);2;GPS+GLO+GAL+BDS;"
+                     "HAGPS;XXX;%s;%s;0;0;HAGPS base;none;N;N;0;\r\nENDSOURCETABLE\r\n",
+                     c->cfg.mountpoint, c->cfg.identifier ? c->cfg.identifier : c->cfg.mountpoint, lat, lon);
+    if (n < 0 || n >= (int)sizeof(str)) n = 0;
+    if (cl->v2) {
+        cl->reply_len = snprintf(cl->reply, sizeof(cl->reply),
+                                 "HTTP/1.1 200 OK\r\nNtrip-Version: Ntrip/2.0\r\nServer: NTRIP HAGPS/2.0\r\n"
+                                 "Content-Type: gnss/sourcetable\r\nContent-Length: %d\r\nConnection: close\r\n\r\n%s",
+                                 n, str);
+    } else {
+        cl->reply_len = snprintf(cl->reply, sizeof(cl->reply),
+                                 "SOURCETABLE 200 OK\r\nServer: NTRIP HAGPS/1.0\r\nContent-Type: text/plain\r\n"
+                                 "Content-Length: %d\r\n\r\n%s", n, str);
+    }
+    if (cl->reply_len >= sizeof(cl->reply)) cl->reply_len = sizeof(cl->reply) - 1;
+    cl->state = NTRIP_CLIENT_REPLY;
+    c->sourcetables++;
+}
+
+static void handle_request(ntrip_caster_t *c, ntrip_client_t *cl, uint32_t head) {
+    char method[8], path[64];
+    if (sscanf(cl->req, "%7s %63s", method, path) != 2 || strcmp(method, "GET") != 0) {
+        c->bad_requests++;
+        cl->reply_len = snprintf(cl->reply, sizeof(cl->reply), "HTTP/1.1 400 Bad Request\r\nConnection: close\r\n\r\n");
+        cl->state = NTRIP_CLIENT_REPLY;
+        return;
+    }
+    // Header names are case-insensitive; v2 clients announce themselves
+    for (const char *h = strstr(cl->req, "\r\n"); h; h = strstr(h + 2, "\r\n")) {
+        if (strncasecmp(h + 2, "Ntrip-Version:", 14) != 0) continue;
+        const char *v = h + 16 + strspn(h + 16, " ");
+        cl->v2 = strncasecmp(v, "Ntrip/2.0", 9) == 0;
+    }
+
+    if (path[0] != '/' || strcmp(path + 1, c->cfg.mountpoint) != 0) {
+        if (cl->v2 && path[1] != '\0') {
+            cl->reply_len = snprintf(cl->reply, sizeof(cl->reply),
+                                     "HTTP/1.1 404 Not Found\r\nNtrip-Version: Ntrip/2.0\r\nConnection: close\r\n\r\n");
+            cl->state = NTRIP_CLIENT_REPLY;
+            return;
+        }
+        build_sourcetable(c, cl);
+        return;
+    }
+
+    // The stream body is close-delimited (no chunked encoding), which NTRIP clients accept
+    if (cl->v2) {
+        cl->reply_len = snprintf(cl->reply, sizeof(cl->reply),
+                                 "HTTP/1.1 200 OK\r\nNtrip-Version: Ntrip/2.0\r\nServer: NTRIP HAGPS/2.0\r\n"
+                                 "Content-Type: gnss/data\r\nCache-Control: no-store\r\nConnection: close\r\n\r\n");
+    } else {
+        cl->reply_len = snprintf(cl->reply, sizeof(cl->reply), "ICY 200 OK\r\n\r\n");
+    }
+    cl->state = NTRIP_CLIENT_STREAM;
+    cl->pos = head;              // join at the next frame boundary
+}
+
+static void read_request(ntrip_caster_t *c, ntrip_client_t *cl, int64_t now_us) {
+    ssize_t n = recv(cl->fd, cl->req + cl->req_len, sizeof(cl->req) - 1 - cl->req_len, 0);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+        client_close(cl);
+        return;
+    }
+    if (n > 0) {
+        cl->req_len += (size_t)n;
+        cl->req[cl->req_len] = '\0';
+        if (strstr(cl->req, "\r\n\r\n")) {
+            handle_request(c, cl, c->head);
+            cl->progress_us = now_us;
+            return;
+        }
+    }
+    if (cl->req_len == sizeof(cl->req) - 1 || now_us - cl->since_us > NTRIP_REQUEST_TIMEOUT_US) {
+        c->bad_requests++;
+        client_close(cl);
+    }
+}
+
+// Send as much as the socket takes. Returns bytes sent, -1 if the client is gone
+static ssize_t send_some(ntrip_client_t *cl, const void *data, size_t len) {
+    ssize_t n = send(cl->fd, data, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (n >= 0) return n;
+    if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+    return -1;
+}
+
+static void write_client(ntrip_caster_t *c, ntrip_client_t *cl, int64_t now_us) {
+    if (cl->reply_sent < cl->reply_len) {
+        ssize_t n = send_some(cl, cl->reply + cl->reply_sent, cl->reply_len - cl->reply_sent);
+        if (n < 0) {
+            client_close(cl);
+            return;
+        }
+        cl->reply_sent += (size_t)n;
+        if (cl->reply_sent < cl->reply_len) return;
+        if (cl->state == NTRIP_CLIENT_REPLY) {
+            client_close(cl);
+            return;
+        }
+    }
+
+    uint32_t pending = c->head - cl->pos;
+    if (pending > NTRIP_RING_SIZE || (pending > 0 && now_us - cl->progress_us > NTRIP_STALL_US)) {
+        // Its unsent data is being overwritten, or it stopped reading
+        c->evicted++;
+        client_close(cl);
+        return;
+    }
+    while (pending > 0) {
+        size_t at = cl->pos & RING_MASK;
+        size_t chunk = pending < NTRIP_RING_SIZE - at ? pending : NTRIP_RING_SIZE - at;
+        ssize_t n = send_some(cl, c->ring + at, chunk);
+        if (n < 0) {
+            client_close(cl);
+            return;
+        }
+        if (n == 0) break;
+        cl->pos += (uint32_t)n;
+        cl->bytes_sent += (uint32_t)n;
+        c->bytes_served += (uint64_t)n;
+        cl->progress_us = now_us;
+        pending -= (uint32_t)n;
+    }
+    if (pending == 0) cl->progress_us = now_us;
+}
+
+void ntrip_caster_poll(ntrip_caster_t *c, int64_t now_us) {
+    if (c->listen_fd < 0) return;
+    accept_clients(c, now_us);
+    for (int i = 0; i < NTRIP_MAX_CLIENTS; i++) {
+        ntrip_client_t *cl = &c->clients[i];
+        if (cl->state == NTRIP_CLIENT_REQUEST) read_request(c, cl, now_us);
+        if (cl->state == NTRIP_CLIENT_REPLY || cl->state == NTRIP_CLIENT_STREAM) write_client(c, cl, now_us);
+    }
+}
+
+size_t ntrip_caster_streaming(const ntrip_caster_t *c) {
+    size_t n = 0;
+    for (int i = 0; i < NTRIP_MAX_CLIENTS; i++) {
+        const ntrip_client_t *cl = &c->clients[i];
+        if (cl->state == NTRIP_CLIENT_STREAM && cl->reply_sent == cl->reply_len) n++;
+    }
+    return n;
+}
+
+void ntrip_caster_close(ntrip_caster_t *c) {
+    for (int i = 0; i < NTRIP_MAX_CLIENTS; i++) client_close(&c->clients[i]);
+    if (c->listen_fd >= 0) close(c->listen_fd);
+    c->listen_fd = -1;
+}
@@ -0,0 +1,86 @@
+#ifndef NTRIP_CASTER_H
+#define NTRIP_CASTER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Minimal NTRIP v1/v2 caster for the base: one mountpoint, many TCP rovers.
+// RTCM frames are written once into a shared ring; each client only keeps
+// its read position in that ring, so its send queue is the window between
+// that position and the ring head and nothing is copied per client. Sockets
+// are non-blocking and driven from ntrip_caster_poll(). A client that falls
+// a full ring behind, or makes no progress for NTRIP_STALL_US, is evicted.
+// Uses BSD sockets only (lwIP on the device, the host stack on Linux).
+
+#ifndef NTRIP_MAX_CLIENTS
+#define NTRIP_MAX_CLIENTS    8       // keep below CONFIG_LWIP_MAX_SOCKETS
+#endif
+#ifndef NTRIP_RING_SIZE
+#define NTRIP_RING_SIZE      16384   // shared stream buffer, power of two
+#endif
+#define NTRIP_REQUEST_MAX    512
+#define NTRIP_REPLY_MAX      512
+#define NTRIP_REQUEST_TIMEOUT_US 5000000
+#ifndef NTRIP_STALL_US
+#define NTRIP_STALL_US       10000000
+#endif
+
+typedef enum {
+    NTRIP_CLIENT_FREE = 0,
+    NTRIP_CLIENT_REQUEST,        // reading the HTTP request
+    NTRIP_CLIENT_REPLY,          // sending a reply, then close
+    NTRIP_CLIENT_STREAM,         // reply header, then the RTCM stream
+} ntrip_client_state_t;
+
+typedef struct {
+    int fd;
+    ntrip_client_state_t state;
+    uint8_t v2;
+    char req[NTRIP_REQUEST_MAX];
+    size_t req_len;
+    char reply[NTRIP_REPLY_MAX];
+    size_t reply_len;
+    size_t reply_sent;
+    uint32_t pos;                // next stream byte to send (absolute offset)
+    int64_t since_us;
+    int64_t progress_us;         // last time a send made progress
+    uint32_t bytes_sent;
+} ntrip_client_t;
+
+typedef struct {
+    uint16_t port;               // 0 picks a free port (tests)
+    const char *mountpoint;
+    const char *identifier;      // sourcetable location text
+    double lat;                  // sourcetable position, left out while both are 0
+    double lon;
+} ntrip_caster_config_t;
+
+typedef struct {
+    int listen_fd;
+    ntrip_caster_config_t cfg;
+    uint8_t ring[NTRIP_RING_SIZE];
+    uint32_t head;               // total stream bytes written
+    ntrip_client_t clients[NTRIP_MAX_CLIENTS];
+    uint32_t accepted;
+    uint32_t rejected;           // connections refused, all slots busy
+    uint32_t evicted;            // slow clients dropped
+    uint32_t sourcetables;
+    uint32_t bad_requests;
+    uint64_t bytes_served;
+} ntrip_caster_t;
+
+// Start listening. Returns 0 on success, -1 on socket errors
+int ntrip_caster_init(ntrip_caster_t *c, const ntrip_caster_config_t *cfg);
+// Sourcetable position of the base antenna, degrees, once it is known
+void ntrip_caster_set_position(ntrip_caster_t *c, double lat, double lon);
+// Append complete RTCM3 frames to the shared stream
+void ntrip_caster_write(ntrip_caster_t *c, const uint8_t *data, size_t len);
+// Accept, read requests and push pending data; call from the base loop
+void ntrip_caster_poll(ntrip_caster_t *c, int64_t now_us);
+// Clients currently streaming
+size_t ntrip_caster_streaming(const ntrip_caster_t *c);
+// Port actually bound (after cfg.port = 0)
+uint16_t ntrip_caster_port(const ntrip_caster_t *c);
+void ntrip_caster_close(ntrip_caster_t *c);
+
+#endif // NTRIP_CASTER_H
@@ -0,0 +1,59 @@
+#include "pkt_pool.h"
+
+#if PKT_POOL_BLOCKS > 32 || PKT_POOL_BLOCKS < 1
+#error "PKT_POOL_BLOCKS must be 1..32"
+#endif
+
+#define ALL_BLOCKS ((uint32_t)(((uint64_t)1 << PKT_POOL_BLOCKS) - 1))
+
+static pkt_block_t blocks[PKT_POOL_BLOCKS];
+static atomic_uint used_mask;     // bit set = block handed out; zero init = all free
+static atomic_uint allocs;
+static atomic_uint exhausted;
+static atomic_uint high_water;
+
+pkt_block_t *pkt_pool_alloc(void) {
+    unsigned used = atomic_load_explicit(&used_mask, memory_order_relaxed);
+    unsigned bit;
+    do {
+        uint32_t free_bits = ~used & ALL_BLOCKS;
+        if (!free_bits) {
+            atomic_fetch_add_explicit(&exhausted, 1, memory_order_relaxed);
+            return NULL;
+        }
+        bit = (unsigned)__builtin_ctz(free_bits);
+    } while (!atomic_compare_exchange_weak_explicit(&used_mask, &used, used | (1u << bit),
+                                                    memory_order_acquire, memory_order_relaxed));
+
+    pkt_block_t *b = &blocks[bit];
+    b->len = 0;
+    atomic_store_explicit(&b->refs, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&allocs, 1, memory_order_relaxed);
+
+    // High-water only ever grows; a lost race just records it on the next alloc
+    unsigned n = (unsigned)__builtin_popcount(used | (1u << bit));
+    unsigned hw = atomic_load_explicit(&high_water, memory_order_relaxed);
+    while (n > hw && !atomic_compare_exchange_weak_explicit(&high_water, &hw, n, memory_order_relaxed,
+                                                            memory_order_relaxed)) {
+    }
+    return b;
+}
+
+void pkt_block_retain(pkt_block_t *b) {
+    atomic_fetch_add_explicit(&b->refs, 1, memory_order_relaxed);
+}
+
+void pkt_block_release(pkt_block_t *b) {
+    if (!b) return;
+    // The last holder's writes must be done before the block can be reused
+    if (atomic_fetch_sub_explicit(&b->refs, 1, memory_order_acq_rel) != 1) return;
+    unsigned bit = (unsigned)(b - blocks);
+    atomic_fetch_and_explicit(&used_mask, ~(1u << bit), memory_order_release);
+}
+
+void pkt_pool_get_stats(pkt_pool_stats_t *stats) {
+    stats->allocs = atomic_load_explicit(&allocs, memory_order_relaxed);
+    stats->exhausted = atomic_load_explicit(&exhausted, memory_order_relaxed);
+    stats->in_use = (uint32_t)__builtin_popcount(atomic_load_explicit(&used_mask, memory_order_relaxed));
+    stats->high_water = atomic_load_explicit(&high_water, memory_order_relaxed);
+}
@@ -0,0 +1,42 @@
+#ifndef PKT_POOL_H
+#define PKT_POOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include "link_packet.h"
+
+// Statically allocated pool of reference-counted packet blocks, shared by
+// the receive queues (ESP-NOW, MQTT, UDP) and the rover link stages. A block
+// is filled once where the packet arrives and is then passed by pointer: the
+// FEC decoder keeps a reference while a packet waits for its group instead of
+// copying it. The block returns to the pool when the last holder releases
+// it. Allocation and release are lock-free and may run in different tasks.
+
+#ifndef PKT_POOL_BLOCKS
+#define PKT_POOL_BLOCKS 32        // at most 32: one bit each in the free mask
+#endif
+#define PKT_BLOCK_SIZE  LINK_MAX_PACKET
+
+typedef struct {
+    uint8_t data[PKT_BLOCK_SIZE];
+    uint16_t len;
+    atomic_uint refs;
+} pkt_block_t;
+
+typedef struct {
+    uint32_t allocs;
+    uint32_t exhausted;           // allocations refused because every block was in use
+    uint32_t in_use;
+    uint32_t high_water;          // most blocks ever in use at once
+} pkt_pool_stats_t;
+
+// One block with a single reference and len 0, NULL when the pool is exhausted
+pkt_block_t *pkt_pool_alloc(void);
+// Take another reference for a stage that keeps the block beyond the call
+void pkt_block_retain(pkt_block_t *b);
+// Drop a reference; the last one returns the block to the pool
+void pkt_block_release(pkt_block_t *b);
+void pkt_pool_get_stats(pkt_pool_stats_t *stats);
+
+#endif // PKT_POOL_H
@@ -0,0 +1,86 @@
+#include "pkt_ring.h"
+#include <string.h>
+
+void pkt_ring_init(pkt_ring_t *r, pkt_block_t **slots, size_t count) {
+    memset(&r->stats, 0, sizeof(r->stats));
+    r->slots = slots;
+    r->mask = (uint32_t)count - 1;
+    atomic_init(&r->head, 0);
+    atomic_init(&r->tail, 0);
+    r->wake = NULL;
+    r->wake_ctx = NULL;
+}
+
+void pkt_ring_set_wake(pkt_ring_t *r, pkt_ring_wake_fn_t wake, void *ctx) {
+    r->wake_ctx = ctx;
+    r->wake = wake;
+}
+
+int pkt_ring_push(pkt_ring_t *r, const uint8_t *data, size_t len) {
+    if (len == 0 || len > PKT_BLOCK_SIZE) {
+        r->stats.dropped++;
+        return -1;
+    }
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    uint32_t used = head - tail;
+    if (used > r->mask) {
+        r->stats.overflow++;
+        return -1;
+    }
+    pkt_block_t *b = pkt_pool_alloc();
+    if (!b) {
+        r->stats.no_block++;
+        return -1;
+    }
+
+    // The only copy on the receive path: the driver reuses its buffer after the callback
+    memcpy(b->data, data, len);
+    b->len = (uint16_t)len;
+    r->slots[head & r->mask] = b;
+    // Publish the slot only after its contents are written
+    atomic_store_explicit(&r->head, head + 1, memory_order_release);
+
+    r->stats.pushed++;
+    if (used + 1 > r->stats.high_water) r->stats.high_water = used + 1;
+    pkt_ring_wake_fn_t wake = r->wake;
+    if (wake) wake(r->wake_ctx);
+    return 0;
+}
+
+int pkt_ring_pop(pkt_ring_t *r, uint8_t *data, size_t max_len) {
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+    if (head == tail) return 0;
+
+    pkt_block_t *b = r->slots[tail & r->mask];
+    size_t len = b->len < max_len ? b->len : max_len;
+    memcpy(data, b->data, len);
+    pkt_block_release(b);
+    atomic_store_explicit(&r->tail, tail + 1, memory_order_release);
+    r->stats.popped++;
+    return (int)len;
+}
+
+size_t pkt_ring_drain(pkt_ring_t *r, pkt_ring_cb_t cb, void *ctx, size_t max_count) {
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+    size_t n = 0;
+
+    while (tail != head && n < max_count) {
+        pkt_block_t *b = r->slots[tail & r->mask];
+        cb(b, ctx);
+        pkt_block_release(b);
+        tail++;
+        n++;
+        // Free each slot as soon as it is consumed so the producer can reuse it
+        atomic_store_explicit(&r->tail, tail, memory_order_release);
+    }
+    r->stats.popped += n;
+    return n;
+}
+
+size_t pkt_ring_count(pkt_ring_t *r) {
+    return atomic_load_explicit(&r->head, memory_order_acquire) -
+           atomic_load_explicit(&r->tail, memory_order_acquire);
+}
@@ -0,0 +1,53 @@
+#ifndef PKT_RING_H
+#define PKT_RING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include "pkt_pool.h"
+
+// Bounded single-producer / single-consumer ring of packet blocks (pkt_pool.h).
+// The producer is a driver callback (ESP-NOW recv, MQTT event), the consumer
+// is the forwarding task. Neither side blocks or takes a lock; an optional
+// wake callback lets the consumer sleep until a packet is queued.
+
+typedef struct {
+    uint32_t pushed;       // packets accepted
+    uint32_t popped;       // packets handed to the consumer
+    uint32_t overflow;     // packets dropped because every slot was full
+    uint32_t dropped;      // packets dropped as empty or larger than a block
+    uint32_t no_block;     // packets dropped because the block pool was exhausted
+    uint32_t high_water;   // most slots ever in use at once
+} pkt_ring_stats_t;
+
+// Run by the producer after each packet it queues
+typedef void (*pkt_ring_wake_fn_t)(void *ctx);
+
+typedef struct {
+    pkt_block_t **slots;
+    uint32_t mask;         // slot count - 1 (count is a power of two)
+    atomic_uint head;      // next slot to write, producer owned
+    atomic_uint tail;      // next slot to read, consumer owned
+    pkt_ring_stats_t stats;
+    pkt_ring_wake_fn_t wake;
+    void *wake_ctx;
+} pkt_ring_t;
+
+// Called by pkt_ring_drain() for each packet. The ring's reference is dropped
+// when cb returns; cb takes its own (pkt_block_retain) to keep the block
+typedef void (*pkt_ring_cb_t)(pkt_block_t *pkt, void *ctx);
+
+// slots holds the handles, count must be a power of two
+void pkt_ring_init(pkt_ring_t *r, pkt_block_t **slots, size_t count);
+// Call wake(ctx) from the producer after every packet queued; NULL for none
+void pkt_ring_set_wake(pkt_ring_t *r, pkt_ring_wake_fn_t wake, void *ctx);
+// Producer: copy one packet into a pool block and queue it. Returns 0 on success, -1 if dropped
+int pkt_ring_push(pkt_ring_t *r, const uint8_t *data, size_t len);
+// Consumer: copy the oldest packet out (truncated to max_len). Returns length, 0 if empty
+int pkt_ring_pop(pkt_ring_t *r, uint8_t *data, size_t max_len);
+// Consumer: hand up to max_count packets to cb without copying. Returns packets drained
+size_t pkt_ring_drain(pkt_ring_t *r, pkt_ring_cb_t cb, void *ctx, size_t max_count);
+// Slots currently occupied
+size_t pkt_ring_count(pkt_ring_t *r);
+
+#endif // PKT_RING_H
@@ -0,0 +1,121 @@
+#include "platform.h"
+#include "esp_wifi.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+#include "esp_timer.h"
+#include "nvs_flash.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include <stdio.h>
+#include <string.h>
+
+#define WIFI_SSID_MAXLEN 32
+#define WIFI_PASS_MAXLEN 64
+
+static StaticEventGroup_t events_buf;
+static EventGroupHandle_t events;
+static int64_t phase_us[PLATFORM_PHASES];
+static EventBits_t printed;
+static int nvs_done;
+static int wifi_done;
+static int connect_done;
+static volatile int wifi_up;
+
+static const char *const phase_names[PLATFORM_PHASES] = {
+    "nvs", "radio", "uart", "receiver config", "pipeline", "wifi",
+    "base position", "first correction", "first fix", "rtk fix",
+};
+
+static EventGroupHandle_t phase_events(void) {
+    if (!events) events = xEventGroupCreateStatic(&events_buf);
+    return events;
+}
+
+void platform_nvs_init(void) {
+    if (nvs_done) return;
+    nvs_done = 1;
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        ret = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(ret);
+    platform_mark(PLATFORM_PHASE_NVS, esp_timer_get_time());
+}
+
+void platform_wifi_init(void) {
+    if (wifi_done) return;
+    wifi_done = 1;
+    platform_nvs_init();
+    esp_netif_init();
+    esp_event_loop_create_default();
+    // Before the driver starts, so DHCP follows the station's start event
+    esp_netif_create_default_wifi_sta();
+    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
+    esp_wifi_init(&cfg);
+    // The configuration is set on every boot: keeping it out of flash saves the NVS writes
+    esp_wifi_set_storage(WIFI_STORAGE_RAM);
+    esp_wifi_set_mode(WIFI_MODE_STA);
+    esp_wifi_start();
+    platform_mark(PLATFORM_PHASE_RADIO, esp_timer_get_time());
+}
+
+static void wifi_event(void *arg, esp_event_base_t base, int32_t id, void *data) {
+    if (base == WIFI_EVENT && id == WIFI_EVENT_STA_DISCONNECTED) {
+        wifi_up = 0;
+        esp_wifi_connect();
+    } else if (base == IP_EVENT && id == IP_EVENT_STA_GOT_IP) {
+        wifi_up = 1;
+        platform_mark(PLATFORM_PHASE_WIFI, esp_timer_get_time());
+    }
+}
+
+void platform_wifi_connect(const char *ssid, const char *password) {
+    if (connect_done) return;
+    connect_done = 1;
+    platform_wifi_init();
+    esp_event_handler_register(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, wifi_event, NULL);
+    esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, wifi_event, NULL);
+    wifi_config_t wifi_config = {0};
+    strncpy((char *)wifi_config.sta.ssid, ssid, WIFI_SSID_MAXLEN);
+    strncpy((char *)wifi_config.sta.password, password, WIFI_PASS_MAXLEN);
+    esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+    esp_wifi_connect();
+}
+
+int platform_wifi_connected(void) {
+    return wifi_up;
+}
+
+void platform_mark(platform_phase_t phase, int64_t at_us) {
+    EventBits_t bit = (EventBits_t)1 << phase;
+    if (xEventGroupGetBits(phase_events()) & bit) return;
+    phase_us[phase] = at_us;
+    xEventGroupSetBits(phase_events(), bit);
+}
+
+int platform_reached(platform_phase_t phase) {
+    return (xEventGroupGetBits(phase_events()) >> phase) & 1;
+}
+
+int platform_wait(platform_phase_t phase, uint32_t timeout_ms) {
+    EventBits_t bit = (EventBits_t)1 << phase;
+    // pdMS_TO_TICKS would overflow a forever wait into a finite one
+    TickType_t ticks = timeout_ms == PLATFORM_WAIT_FOREVER ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+    return (xEventGroupWaitBits(phase_events(), bit, pdFALSE, pdTRUE, ticks) & bit) != 0;
+}
+
+void platform_print_boot(const char *role) {
+    EventBits_t reached = xEventGroupGetBits(phase_events());
+    if (!(reached & ~printed)) return;
+    for (int p = 0; p < PLATFORM_PHASES; p++) {
+        EventBits_t bit = (EventBits_t)1 << p;
+        if (!(reached & bit) || (printed & bit)) continue;
+        printf("[%s] Boot: %-16s at %7.1f ms\n", role, phase_names[p], phase_us[p] / 1000.0);
+    }
+    printed = reached;
+}
+
+const char *platform_phase_name(platform_phase_t phase) {
+    return phase < PLATFORM_PHASES ? phase_names[phase] : "?";
+}
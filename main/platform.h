@@ -0,0 +1,50 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include <stdint.h>
+
+// Shared bring-up of the ESP-IDF services the transports have in common
+// (NVS, netif, default event loop, Wi-Fi driver). Every call is idempotent:
+// the first caller does the work and later callers return at once, so each
+// module asks for what it uses in whatever order app_main starts them.
+//
+// Boot phases are timestamped (esp_timer, from application start) as they
+// are reached, from any task, and printed later from the console loop: the
+// time to first correction and to first fix of every build are measured,
+// not guessed. app_main calls platform_nvs_init() before anything else.
+
+typedef enum {
+    PLATFORM_PHASE_NVS = 0,           // NVS ready
+    PLATFORM_PHASE_RADIO,             // Wi-Fi driver started: ESP-NOW can send
+    PLATFORM_PHASE_UART,              // receiver UART driver installed
+    PLATFORM_PHASE_RECEIVER,          // receiver configuration done or skipped
+    PLATFORM_PHASE_PIPELINE,          // correction path running
+    PLATFORM_PHASE_WIFI,              // associated with the AP, address assigned
+    PLATFORM_PHASE_BASE_POSITION,     // base: surveyed in, or stored position checked and fixed
+    PLATFORM_PHASE_FIRST_CORRECTION,  // base: first link packet sent; rover: first RTCM to the receiver
+    PLATFORM_PHASE_FIRST_FIX,         // rover: first position solution
+    PLATFORM_PHASE_RTK_FIX,           // rover: first RTK fixed solution
+    PLATFORM_PHASES,
+} platform_phase_t;
+
+void platform_nvs_init(void);
+// Netif, default event loop and the Wi-Fi driver in station mode, started
+void platform_wifi_init(void);
+// Station connection in the background: returns at once, reconnects when the
+// AP drops it. PLATFORM_PHASE_WIFI marks the first address
+void platform_wifi_connect(const char *ssid, const char *password);
+// Associated with an address assigned
+int platform_wifi_connected(void);
+
+// Phase reached at at_us (esp_timer time); later marks of the same phase are ignored
+void platform_mark(platform_phase_t phase, int64_t at_us);
+int platform_reached(platform_phase_t phase);
+// Sleep until phase is reached or timeout_ms passes; 1 when reached.
+// PLATFORM_WAIT_FOREVER never times out
+#define PLATFORM_WAIT_FOREVER UINT32_MAX
+int platform_wait(platform_phase_t phase, uint32_t timeout_ms);
+// Phases reached since the last call, one line each; cheap when there are none
+void platform_print_boot(const char *role);
+const char *platform_phase_name(platform_phase_t phase);
+
+#endif // PLATFORM_H
@@ -0,0 +1,123 @@
+#include "prof.h"
+#include <stdio.h>
+#include <string.h>
+
+static prof_stage_t stages[PROF_MAX_STAGES];
+static prof_depth_t depths[PROF_MAX_DEPTHS];
+static int stage_count;
+static int depth_count;
+static uint32_t cycles_per_us = 1;
+
+// Log-linear buckets: values below 4 exactly, then PROF_SUB_BUCKETS per power of two
+static int bucket_of(uint32_t v) {
+    if (v < PROF_SUB_BUCKETS) return (int)v;
+    int msb = 31 - __builtin_clz(v);
+    return (msb - 1) * PROF_SUB_BUCKETS + (int)((v >> (msb - 2)) & (PROF_SUB_BUCKETS - 1));
+}
+
+static uint64_t bucket_top(int b) {
+    if (b < PROF_SUB_BUCKETS) return (uint64_t)b;
+    int msb = b / PROF_SUB_BUCKETS + 1, sub = b % PROF_SUB_BUCKETS;
+    return ((uint64_t)(PROF_SUB_BUCKETS + sub + 1) << (msb - 2)) - 1;
+}
+
+static void clear_stage(prof_stage_t *s) {
+    const char *name = s->name;
+    memset(s, 0, sizeof(*s));
+    s->name = name;
+    s->min = UINT32_MAX;
+}
+
+static void clear_depth(prof_depth_t *d) {
+    d->last = d->max = d->samples = 0;
+    d->sum = 0;
+}
+
+void prof_init(uint32_t cpu_cycles_per_us) {
+    cycles_per_us = cpu_cycles_per_us ? cpu_cycles_per_us : 1;
+    prof_reset();
+}
+
+int prof_stage(const char *name) {
+    for (int i = 0; i < stage_count; i++) {
+        if (strcmp(stages[i].name, name) == 0) return i;
+    }
+    if (stage_count == PROF_MAX_STAGES) return -1;
+    stages[stage_count].name = name;
+    clear_stage(&stages[stage_count]);
+    return stage_count++;
+}
+
+int prof_depth(const char *name, uint32_t capacity) {
+    for (int i = 0; i < depth_count; i++) {
+        if (strcmp(depths[i].name, name) == 0) return i;
+    }
+    if (depth_count == PROF_MAX_DEPTHS) return -1;
+    prof_depth_t *d = &depths[depth_count];
+    d->name = name;
+    d->capacity = capacity;
+    clear_depth(d);
+    return depth_count++;
+}
+
+void prof_record(int id, uint32_t cycles) {
+    if (id < 0 || id >= stage_count) return;
+    prof_stage_t *s = &stages[id];
+    s->count++;
+    s->sum += cycles;
+    if (cycles < s->min) s->min = cycles;
+    if (cycles > s->max) s->max = cycles;
+    s->hist[bucket_of(cycles)]++;
+}
+
+void prof_depth_sample(int id, uint32_t value) {
+    if (id < 0 || id >= depth_count) return;
+    prof_depth_t *d = &depths[id];
+    d->last = value;
+    d->samples++;
+    d->sum += value;
+    if (value > d->max) d->max = value;
+}
+
+uint32_t prof_percentile(const prof_stage_t *s, uint32_t permille) {
+    if (!s->count) return 0;
+    uint64_t want = ((uint64_t)s->count * permille + 999) / 1000, seen = 0;
+    for (int b = 0; b < PROF_BUCKETS; b++) {
+        seen += s->hist[b];
+        if (seen >= want) {
+            uint64_t top = bucket_top(b);
+            return top < s->max ? (uint32_t)top : s->max;
+        }
+    }
+    return s->max;
+}
+
+const prof_stage_t *prof_get_stage(int id) {
+    return id >= 0 && id < stage_count ? &stages[id] : NULL;
+}
+
+const prof_depth_t *prof_get_depth(int id) {
+    return id >= 0 && id < depth_count ? &depths[id] : NULL;
+}
+
+void prof_reset(void) {
+    for (int i = 0; i < stage_count; i++) clear_stage(&stages[i]);
+    for (int i = 0; i < depth_count; i++) clear_depth(&depths[i]);
+}
+
+void prof_print(const char *role) {
+    double k = 1.0 / cycles_per_us;
+    printf("[%s] stage              calls     min     avg     p99     max us\n", role);
+    for (int i = 0; i < stage_count; i++) {
+        const prof_stage_t *s = &stages[i];
+        if (!s->count) continue;
+        printf("[%s]   %-14s %9u %7.1f %7.1f %7.1f %7.1f\n", role, s->name, (unsigned)s->count, s->min * k,
+               (double)s->sum / s->count * k, prof_percentile(s, 990) * k, s->max * k);
+    }
+    for (int i = 0; i < depth_count; i++) {
+        const prof_depth_t *d = &depths[i];
+        if (!d->samples) continue;
+        printf("[%s]   %-14s depth %u  avg %.1f  max %u of %u\n", role, d->name, (unsigned)d->last,
+               (double)d->sum / d->samples, (unsigned)d->max, (unsigned)d->capacity);
+    }
+}
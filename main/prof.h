@@ -0,0 +1,111 @@
+#ifndef PROF_H
+#define PROF_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Hot-path profiling: named stages timed with the CPU cycle counter
+// (min/avg/p99/max per stage) and named queue depths sampled once per loop.
+// Compiled out entirely unless PROF_ENABLE is set (role_config.h PROFILING,
+// or the host build); the macros below then expand to nothing, arguments
+// included. Each stage or depth is recorded by one task; printing from another
+// may show a sample in flight. No ESP-IDF calls, see base_pipeline.h.
+
+#ifndef PROF_ENABLE
+#include "role_config.h"
+#define PROF_ENABLE PROFILING
+#endif
+
+#define PROF_MAX_STAGES 16
+#define PROF_MAX_DEPTHS 8
+#define PROF_SUB_BUCKETS 4                        // per power of two: p99 within 25%
+#define PROF_BUCKETS     (31 * PROF_SUB_BUCKETS)  // cycle counts up to 2^32
+
+typedef struct {
+    const char *name;
+    uint32_t count;
+    uint32_t min;                 // cycles
+    uint32_t max;
+    uint64_t sum;
+    uint32_t hist[PROF_BUCKETS];
+} prof_stage_t;
+
+typedef struct {
+    const char *name;
+    uint32_t capacity;
+    uint32_t last;
+    uint32_t max;
+    uint32_t samples;
+    uint64_t sum;
+} prof_depth_t;
+
+#if defined(__XTENSA__)
+static inline uint32_t prof_cycles(void) {
+    uint32_t c;
+    __asm__ volatile("rsr %0, ccount" : "=a"(c));
+    return c;
+}
+#else
+#include <time.h>
+// Host: nanoseconds stand in for cycles (prof_init(1000))
+static inline uint32_t prof_cycles(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec);
+}
+#endif
+
+// cycles_per_us converts the counter for printing (CPU MHz on the device)
+void prof_init(uint32_t cycles_per_us);
+// Register a stage or depth (a repeated name returns the same id); -1 when full
+int prof_stage(const char *name);
+int prof_depth(const char *name, uint32_t capacity);
+void prof_record(int id, uint32_t cycles);
+void prof_depth_sample(int id, uint32_t value);
+// Cycles below which permille of a stage's samples fall (bucket upper edge, at most max)
+uint32_t prof_percentile(const prof_stage_t *s, uint32_t permille);
+const prof_stage_t *prof_get_stage(int id);
+const prof_depth_t *prof_get_depth(int id);
+// Start a new window: counters cleared, registrations kept
+void prof_reset(void);
+// One line per stage (us) and per depth
+void prof_print(const char *role);
+
+#if PROF_ENABLE
+typedef struct {
+    int id;
+    uint32_t start;
+} prof_scope_t;
+
+static inline prof_scope_t prof_scope_begin(int id) {
+    return (prof_scope_t){ id, prof_cycles() };
+}
+
+static inline void prof_scope_end(prof_scope_t *s) {
+    prof_record(s->id, prof_cycles() - s->start);
+}
+
+#define PROF_CAT_(a, b) a##b
+#define PROF_CAT(a, b)  PROF_CAT_(a, b)
+// static int holding a stage or depth id
+#define PROF_DECLARE(id)                   static int id = -1
+#define PROF_REGISTER_STAGE(id, name)      (id = prof_stage(name))
+#define PROF_REGISTER_DEPTH(id, name, cap) (id = prof_depth(name, cap))
+// Time from here to the end of the enclosing block
+#define PROF_SCOPE(id) \
+    prof_scope_t PROF_CAT(prof_scope_, __LINE__) __attribute__((cleanup(prof_scope_end))) = prof_scope_begin(id)
+#define PROF_SAMPLE(id, value)             prof_depth_sample(id, (uint32_t)(value))
+// Time a span that is not a block of its own
+#define PROF_START(var)                    uint32_t var = prof_cycles()
+#define PROF_STOP(id, var)                 prof_record(id, prof_cycles() - (var))
+#else
+#define PROF_DECLARE(id)                   struct prof_unused_##id
+#define PROF_REGISTER_STAGE(id, name)      ((void)0)
+#define PROF_REGISTER_DEPTH(id, name, cap) ((void)0)
+#define PROF_SCOPE(id)                     do { } while (0)
+#define PROF_SAMPLE(id, value)             ((void)0)
+#define PROF_START(var)                    do { } while (0)
+#define PROF_STOP(id, var)                 ((void)0)
+#endif
+
+#endif // PROF_H
@@ -0,0 +1,167 @@
+#include "raw_log.h"
+#include <string.h>
+
+_Static_assert(sizeof(raw_log_sector_hdr_t) == 20, "raw log sector header layout");
+_Static_assert(sizeof(raw_log_rec_hdr_t) == 8, "raw log record header layout");
+
+enum { BUF_FREE = 0, BUF_FILLING, BUF_SEALED };
+
+#define HDR_LEN sizeof(raw_log_sector_hdr_t)
+
+static const char *const source_names[RAW_LOG_SRC_COUNT] = {
+    [RAW_LOG_SRC_BASE_GNSS] = "base_gnss",
+    [RAW_LOG_SRC_BASE_RTCM] = "base_rtcm",
+    [RAW_LOG_SRC_ROVER_GNSS] = "rover_gnss",
+    [RAW_LOG_SRC_ROVER_RTCM] = "rover_rtcm",
+};
+
+const char *raw_log_source_name(raw_log_source_t source) {
+    return source > 0 && source < RAW_LOG_SRC_COUNT ? source_names[source] : "unknown";
+}
+
+int raw_log_init(raw_log_t *log, const raw_log_flash_t *flash, raw_log_buf_t *bufs, uint16_t count,
+                 raw_log_wake_fn_t wake, void *wake_ctx) {
+    memset(log, 0, sizeof(*log));
+    log->flash = *flash;
+    log->bufs = bufs;
+    log->count = count;
+    log->wake = wake;
+    log->wake_ctx = wake_ctx;
+    log->sectors = flash->size / RAW_LOG_SECTOR_SIZE;
+    if (count < 2 || log->sectors < 2) return -1;
+    for (uint16_t i = 0; i < count; i++) atomic_store_explicit(&bufs[i].state, BUF_FREE, memory_order_relaxed);
+
+    // Mount: continue after the newest sector. A sector whose header is still
+    // erased was cut off mid-write and is simply reused
+    int found = 0;
+    uint32_t newest = 0, max_boot = 0;
+    for (uint32_t s = 0; s < log->sectors; s++) {
+        raw_log_sector_hdr_t hdr;
+        if (flash->read(flash->ctx, s * RAW_LOG_SECTOR_SIZE, &hdr, sizeof(hdr)) != 0) return -1;
+        if (hdr.magic != RAW_LOG_MAGIC) continue;
+        if (!found || hdr.seq > log->seq) {
+            log->seq = hdr.seq;
+            newest = s;
+        }
+        if (!found || hdr.boot > max_boot) max_boot = hdr.boot;
+        found = 1;
+    }
+    if (found) {
+        log->seq++;
+        log->boot = max_boot + 1;
+        log->next_sector = (newest + 1) % log->sectors;
+    }
+    return 0;
+}
+
+static void seal(raw_log_t *log, raw_log_buf_t *b) {
+    raw_log_sector_hdr_t hdr = {
+        .magic = RAW_LOG_MAGIC,
+        .boot = log->boot,
+        .time_ms = log->first_ms,
+        .dropped = atomic_load_explicit(&log->dropped, memory_order_relaxed),
+    };
+    memcpy(b->data, &hdr, HDR_LEN);   // seq is the writer's, set when the sector is known
+    atomic_store_explicit(&b->state, BUF_SEALED, memory_order_release);
+    log->fill_idx = (uint16_t)((log->fill_idx + 1) % log->count);
+    unsigned n = atomic_fetch_add_explicit(&log->sealed, 1, memory_order_relaxed) + 1;
+    if (n > log->stats.sealed_high_water) log->stats.sealed_high_water = (uint16_t)n;
+    if (log->wake) log->wake(log->wake_ctx);
+}
+
+// The buffer to append to, or NULL while the writer still holds it
+static raw_log_buf_t *filling(raw_log_t *log, uint32_t time_ms) {
+    raw_log_buf_t *b = &log->bufs[log->fill_idx];
+    unsigned state = atomic_load_explicit(&b->state, memory_order_acquire);
+    if (state == BUF_SEALED) return NULL;
+    if (state == BUF_FREE) {
+        b->fill = HDR_LEN;
+        log->first_ms = time_ms;
+        atomic_store_explicit(&b->state, BUF_FILLING, memory_order_relaxed);
+    }
+    return b;
+}
+
+static int append_one(raw_log_t *log, raw_log_source_t source, const uint8_t *data, size_t len, uint32_t time_ms) {
+    raw_log_buf_t *b = filling(log, time_ms);
+    if (b && b->fill + sizeof(raw_log_rec_hdr_t) + len > RAW_LOG_SECTOR_SIZE) {
+        seal(log, b);
+        b = filling(log, time_ms);
+    }
+    if (!b) {
+        atomic_fetch_add_explicit(&log->dropped, 1, memory_order_relaxed);
+        log->stats.dropped++;
+        log->stats.dropped_bytes += (uint32_t)len;
+        return -1;
+    }
+    raw_log_rec_hdr_t rec = {
+        .sync = RAW_LOG_REC_SYNC,
+        .source = (uint8_t)source,
+        .len = (uint16_t)len,
+        .time_ms = time_ms,
+    };
+    memcpy(b->data + b->fill, &rec, sizeof(rec));
+    memcpy(b->data + b->fill + sizeof(rec), data, len);
+    b->fill += (uint16_t)(sizeof(rec) + len);
+    log->stats.records++;
+    log->stats.bytes += (uint32_t)len;
+    if (time_ms - log->first_ms >= RAW_LOG_FLUSH_MS) seal(log, b);
+    return 0;
+}
+
+int raw_log_append(raw_log_t *log, raw_log_source_t source, const uint8_t *data, size_t len, uint32_t time_ms) {
+    if (len > RAW_LOG_MAX_RECORD) log->stats.oversize++;
+    int ret = 0;
+    do {
+        size_t n = len > RAW_LOG_MAX_RECORD ? RAW_LOG_MAX_RECORD : len;
+        if (append_one(log, source, data, n, time_ms) != 0) ret = -1;
+        data += n;
+        len -= n;
+    } while (len);
+    return ret;
+}
+
+void raw_log_flush(raw_log_t *log) {
+    raw_log_buf_t *b = &log->bufs[log->fill_idx];
+    if (atomic_load_explicit(&b->state, memory_order_relaxed) == BUF_FILLING && b->fill > HDR_LEN) seal(log, b);
+}
+
+static uint32_t elapsed_us(const raw_log_t *log, int64_t start) {
+    return log->flash.now_us ? (uint32_t)(log->flash.now_us() - start) : 0;
+}
+
+int raw_log_service(raw_log_t *log) {
+    int written = 0;
+    while (atomic_load_explicit(&log->sealed, memory_order_relaxed)) {
+        raw_log_buf_t *b = &log->bufs[log->write_idx];
+        if (atomic_load_explicit(&b->state, memory_order_acquire) != BUF_SEALED) break;
+
+        uint32_t offset = log->next_sector * RAW_LOG_SECTOR_SIZE;
+        memcpy(b->data + offsetof(raw_log_sector_hdr_t, seq), &log->seq, sizeof(log->seq));
+        int64_t t0 = log->flash.now_us ? log->flash.now_us() : 0;
+        int err = log->flash.erase(log->flash.ctx, offset, RAW_LOG_SECTOR_SIZE);
+        uint32_t us = elapsed_us(log, t0);
+        if (us > log->stats.erase_max_us) log->stats.erase_max_us = us;
+        if (!err) {
+            // Records first, header last: a sector cut off by a reset has no header and is skipped
+            t0 = log->flash.now_us ? log->flash.now_us() : 0;
+            err = log->flash.write(log->flash.ctx, offset + HDR_LEN, b->data + HDR_LEN, b->fill - HDR_LEN);
+            if (!err) err = log->flash.write(log->flash.ctx, offset, b->data, HDR_LEN);
+            us = elapsed_us(log, t0);
+            if (us > log->stats.write_max_us) log->stats.write_max_us = us;
+        }
+        if (err) {
+            log->stats.flash_errors++;
+        } else {
+            log->stats.sectors++;
+        }
+        // A failed sector is skipped rather than retried, so one bad block cannot stall the log
+        log->seq++;
+        log->next_sector = (log->next_sector + 1) % log->sectors;
+        log->write_idx = (uint16_t)((log->write_idx + 1) % log->count);
+        atomic_store_explicit(&b->state, BUF_FREE, memory_order_release);
+        atomic_fetch_sub_explicit(&log->sealed, 1, memory_order_relaxed);
+        written++;
+    }
+    return written;
+}
@@ -0,0 +1,114 @@
+#ifndef RAW_LOG_H
+#define RAW_LOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+// Raw stream log in a flash partition, kept as a circular sequence of sectors
+// for post-processing (host/rawlog_extract.c). Sector layout:
+//   raw_log_sector_hdr_t | records | 0xFF padding
+//   record: raw_log_rec_hdr_t | len bytes, never spanning two sectors
+// The log always erases the oldest sector next, so every sector wears at the
+// same rate. Records are assembled in RAM sector buffers by raw_log_append(),
+// which never waits for flash, and a low-priority writer moves sealed buffers
+// to flash with raw_log_service(). When every buffer is still waiting for
+// the writer, records are dropped and counted instead of stalling the caller.
+// One producer task, one writer task. No ESP-IDF calls: the flash is reached
+// through raw_log_flash_t.
+
+#define RAW_LOG_SECTOR_SIZE  4096
+#define RAW_LOG_MAGIC        0x474F4C52u   // "RLOG"
+#define RAW_LOG_REC_SYNC     0xA5
+#ifndef RAW_LOG_FLUSH_MS
+#define RAW_LOG_FLUSH_MS     5000          // a part-filled buffer goes to flash after this long
+#endif
+
+typedef enum {
+    RAW_LOG_SRC_BASE_GNSS = 1,    // base receiver UART output (RTCM, UBX, NMEA)
+    RAW_LOG_SRC_BASE_RTCM,        // RTCM frames the base scheduled for the link
+    RAW_LOG_SRC_ROVER_GNSS,       // rover receiver UART output (UBX, NMEA)
+    RAW_LOG_SRC_ROVER_RTCM,       // corrections written to the rover receiver
+    RAW_LOG_SRC_COUNT
+} raw_log_source_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t seq;                 // increases by one per sector written, never wraps in practice
+    uint32_t boot;                // increases by one per mount
+    uint32_t time_ms;             // first record's time
+    uint32_t dropped;             // records dropped this boot before the sector was sealed
+} raw_log_sector_hdr_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t sync;                 // RAW_LOG_REC_SYNC; 0xFF is the end of the sector
+    uint8_t source;               // raw_log_source_t
+    uint16_t len;
+    uint32_t time_ms;             // since boot
+} raw_log_rec_hdr_t;
+
+#define RAW_LOG_MAX_RECORD (RAW_LOG_SECTOR_SIZE - sizeof(raw_log_sector_hdr_t) - sizeof(raw_log_rec_hdr_t))
+
+typedef struct {
+    int (*read)(void *ctx, uint32_t offset, void *data, size_t len);
+    int (*write)(void *ctx, uint32_t offset, const void *data, size_t len);
+    int (*erase)(void *ctx, uint32_t offset, size_t len);
+    int64_t (*now_us)(void);      // optional, times erases and writes
+    void *ctx;
+    uint32_t size;                // a multiple of RAW_LOG_SECTOR_SIZE
+} raw_log_flash_t;
+
+typedef struct {
+    uint8_t data[RAW_LOG_SECTOR_SIZE];
+    uint16_t fill;
+    atomic_uint state;            // free, filling (producer) or sealed (writer)
+} raw_log_buf_t;
+
+typedef struct {
+    uint32_t records;
+    uint32_t bytes;
+    uint32_t dropped;             // records refused: every buffer waiting for flash
+    uint32_t dropped_bytes;
+    uint32_t oversize;            // records longer than RAW_LOG_MAX_RECORD (split)
+    uint32_t sectors;             // written this boot
+    uint32_t flash_errors;
+    uint32_t erase_max_us;
+    uint32_t write_max_us;
+    uint16_t sealed_high_water;   // buffers waiting for the writer at once
+} raw_log_stats_t;
+
+typedef void (*raw_log_wake_fn_t)(void *ctx);
+
+typedef struct {
+    raw_log_flash_t flash;
+    raw_log_buf_t *bufs;
+    uint16_t count;
+    uint16_t fill_idx;            // producer: buffer being filled
+    uint16_t write_idx;           // writer: next buffer to write
+    atomic_uint sealed;           // buffers waiting for the writer
+    uint32_t sectors;             // in the partition
+    uint32_t next_sector;
+    uint32_t seq;
+    uint32_t boot;
+    uint32_t first_ms;            // first record in the filling buffer
+    atomic_uint dropped;
+    raw_log_wake_fn_t wake;
+    void *wake_ctx;
+    raw_log_stats_t stats;
+} raw_log_t;
+
+// bufs: count >= 2 sector buffers (double buffering or more); wake is called
+// by raw_log_append() whenever a buffer is sealed, to run the writer.
+// Scans the partition for the newest sector and continues after it.
+// Returns -1 if the partition is too small or unreadable
+int raw_log_init(raw_log_t *log, const raw_log_flash_t *flash, raw_log_buf_t *bufs, uint16_t count,
+                 raw_log_wake_fn_t wake, void *wake_ctx);
+// Producer: copy one chunk into the log; returns -1 if it was dropped
+int raw_log_append(raw_log_t *log, raw_log_source_t source, const uint8_t *data, size_t len, uint32_t time_ms);
+// Producer: seal a part-filled buffer now (before a planned reset)
+void raw_log_flush(raw_log_t *log);
+// Writer: write every sealed buffer to flash; returns the sectors written
+int raw_log_service(raw_log_t *log);
+const char *raw_log_source_name(raw_log_source_t source);
+
+#endif // RAW_LOG_H
@@ -12,4 +12,101 @@
 // *** SET YOUR DEVICE ROLE HERE ***
 #define DEVICE_ROLE DEVICE_ROLE_ROVER
 
+// Bonded correction link: ESP-NOW is always used; these add redundant paths
+// (same packets, the rover keeps the first copy of each)
+#define LINK_BOND_UDP   0   // UDP broadcast on the local Wi-Fi (wifi_comm)
+#define LINK_BOND_MQTT  0   // MQTT broker over the same Wi-Fi connection
+
+// Lossless MSM epoch-delta coding on the radio link (base). Saves roughly
+// 37% of the MSM bytes; the rover always decodes, so only the base needs it.
+// A lost frame costs the deltas after it until the next unchanged key frame,
+// sent every LINK_DELTA_KEY_INTERVAL frames per MSM type (rtcm_delta.h)
+#define LINK_DELTA_CODEC        0
+#define LINK_DELTA_KEY_INTERVAL 4
+
+// Bring the ZED-F9P to the configuration in f9p-config/ at boot: only keys
+// that differ are written (RAM, BBR and flash), then skipped on later boots
+// of the same receiver. Needs the receiver's UART2 wired to the ESP
+#define F9P_AUTO_CONFIG 1
+
+// High-rate mode (needs F9P_AUTO_CONFIG): the ZED-F9P UART is moved to
+// GNSS_HIGH_RATE_BAUD and the rover navigates at GNSS_NAV_RATE_HZ with UBX
+// NAV-PVT/HPPOSLLH output; UART buffers are sized to match
+#define GNSS_HIGH_RATE      0
+#define GNSS_HIGH_RATE_BAUD 921600
+#define GNSS_NAV_RATE_HZ    20
+
+// Base position memory (needs F9P_AUTO_CONFIG for the NAV-SVIN output): the
+// surveyed-in antenna position is kept in NVS. Later boots check it against a
+// short fresh survey and put the receiver straight into fixed mode; a moved
+// antenna is surveyed in again. With LINK_BOND_MQTT the survey progress goes
+// out as a 32-byte record on LINK_MQTT_TELEMETRY_TOPIC/hagps-base
+#define BASE_SVIN_STORE 1
+
+// NTRIP caster on the base (needs the Wi-Fi connection): serves the full
+// RTCM stream to TCP rovers and NTRIP tools on port 2101
+#define NTRIP_CASTER    0
+#define NTRIP_MOUNTPOINT "HAGPS"
+
+// Rover position telemetry over MQTT (needs the Wi-Fi connection): every
+// navigation epoch as a 32-byte record, batched into one message per interval
+// on LINK_MQTT_TELEMETRY_TOPIC/<client id>
+#define ROVER_TELEMETRY             0
+#define ROVER_TELEMETRY_INTERVAL_MS 1000
+#define ROVER_TELEMETRY_MAX_BATCH   64
+
+// Record the raw receiver output and the RTCM stream (base: as sent, rover:
+// as written to the receiver) to the "rawlog" flash partition (partitions.csv),
+// a 2.4 MB circular log of the last several minutes. Extract with host/rawlog_extract
+#define RAW_LOG 0
+
+// Hot-path profiling (prof.h): loop stages timed with the CPU cycle counter,
+// queue depths, and task CPU use and stack high-water marks, printed every
+// PROFILING_DUMP_S and by the rover's "prof" console command
+#define PROFILING        0
+#define PROFILING_DUMP_S 10
+
+// Adaptive ESP-NOW link (link_adapt.h): the rover reports loss and RSSI back
+// to the base, which steps its PHY rate between 250 kbps long-range and
+// 54 Mbps. Without a Wi-Fi connection (no UDP/MQTT/NTRIP/telemetry) and
+// without ROVER_RELAY both ends also move together through
+// LINK_ADAPT_CHANNELS when even the most robust rate keeps losing packets.
+// With several bases a rover adapts to the one it takes corrections from,
+// and other bases ignore its reports. Base and rover need the same settings
+#define LINK_ADAPT          0
+#define LINK_ADAPT_CHANNELS 1, 6, 11
+
+// Multi-hop ESP-NOW mesh (link_relay.h): a rover with ROVER_RELAY repeats the
+// base's packets one hop further after a short random backoff, unless relays
+// nearby already did. Every rover keeps the first copy to reach it. The base
+// stamps LINK_BASE_ID (distinct per base on one site) on its packets and lets
+// them pass at most LINK_RELAY_TTL relays. Link adaptation only sees the
+// rovers in direct range, and its channel announcements are not relayed:
+// ROVER_RELAY keeps base and rovers on the first of LINK_ADAPT_CHANNELS, so
+// set it on the base too. A relaying rover sends at the most robust rate
+// (LR 250k with LINK_ADAPT, else 1M)
+#define ROVER_RELAY    0
+#define LINK_BASE_ID   1
+#define LINK_RELAY_TTL 3
+
+// Event-driven pipeline: instead of one loop polling every 10 ms, each
+// stage sleeps until it has work. The receiver UART reader wakes on the
+// driver's events (RX FIFO threshold and line idle timeout interrupts), the
+// rover's correction task on every packet a transport queues, and otherwise
+// each sleeps only until its pipeline's next timeout. The main task keeps
+// the statistics. 0 runs the polling loop, to compare (host/rtk_replay --poll)
+#define PIPELINE_TASKS 1
+// Core (0 also runs the Wi-Fi stack) and priority of each task
+#define TASK_FORWARD_CORE 1   // base: UART -> framing -> radio; rover: radio -> FEC -> UART
+#define TASK_FORWARD_PRIO 12
+#define TASK_AUX_CORE     0   // rover: NMEA/UBX, baseline, telemetry; base: link adaptation
+#define TASK_AUX_PRIO     8
+#define TASK_IDLE_WAKE_MS 100 // longest sleep: NTRIP sends, link adaptation and telemetry timers
+
+#define LINK_WIFI_SSID     "your-ssid"
+#define LINK_WIFI_PASSWORD "your-password"
+#define LINK_MQTT_BROKER   "mqtt://192.168.1.10"
+#define LINK_MQTT_TOPIC    "hagps/rtcm"
+#define LINK_MQTT_TELEMETRY_TOPIC "hagps/track"
+
 #endif // ROLE_CONFIG_H
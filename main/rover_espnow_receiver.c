@@ -1,49 +1,76 @@
 #include "rover_espnow_receiver.h"
+#include "platform.h"
+#include "pkt_ring.h"
+#include "link_packet.h"
+#include "rover_source.h"
+#include "geo.h"
 #include "esp_now.h"
 #include "esp_wifi.h"
+#include "esp_timer.h"
 #include "esp_log.h"
-#include "esp_event.h"
+#include "role_config.h"
 #include "esp_err.h"
-#include "nvs_flash.h"
-#include "driver/uart.h"
+#include "freertos/FreeRTOS.h"
+#include <stdio.h>
 #include <string.h>
-#include <stdlib.h>
-#include <math.h>
-
-// Use UART2 (RX2/TX2 pins) - UART1 is used by USB connection
-#define UART_GNSS_PORT_NUM UART_NUM_2
-#define UART_GNSS_TXD 17
-#define UART_GNSS_RXD 16
-#define UART_GNSS_BAUD_RATE 115200
-#define UART_GNSS_BUF_SIZE 512
-#define ESPNOW_MAX_SIZE 250
 
 static const char *TAG = "ROVER_ESPNOW";
-static uint8_t rx_buffer[ESPNOW_MAX_SIZE];
-static volatile int rx_len = 0;
+static uint8_t broadcast_mac[6] = {0xFF,0xFF,0xFF,0xFF,0xFF,0xFF};
+static pkt_block_t *rx_slots[ESPNOW_RX_SLOTS];
+static pkt_ring_t rx_ring;
+
+// Per base (link header source byte), slot by the id's low bits: average
+// over about 16 packets in 1/16 dBm (0 = free), and the packets since the
+// last rover_espnow_rssi()
+#define SOURCE_RSSI_SLOTS 8
+static portMUX_TYPE rssi_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint8_t source_ids[SOURCE_RSSI_SLOTS];
+static int16_t source_rssi[SOURCE_RSSI_SLOTS];
+static int32_t rssi_sum[SOURCE_RSSI_SLOTS];
+static uint16_t rssi_count[SOURCE_RSSI_SLOTS];
+static int8_t rssi_min[SOURCE_RSSI_SLOTS];
+static int64_t direct_us[SOURCE_RSSI_SLOTS];   // last packet straight from the base
 
 static void espnow_recv_cb(const esp_now_recv_info_t *recv_info, const uint8_t *data, int len) {
-    if (len > 0 && len <= ESPNOW_MAX_SIZE) {
-        memcpy(rx_buffer, data, len);
-        rx_len = len;
+    // Runs in the Wi-Fi task: never blocks, drops (and counts) when full
+    pkt_ring_push(&rx_ring, data, len > 0 ? (size_t)len : 0);
+    int8_t rssi = recv_info->rx_ctrl->rssi;
+    // Base data and parity packets only: control messages carry no source
+    // byte there
+    if (len < (int)sizeof(link_hdr_t) || (data[offsetof(link_hdr_t, flags)] & LINK_FLAG_CONTROL)) return;
+    uint8_t id = data[offsetof(link_hdr_t, source)];
+    // The source ranking and link adaptation judge the base's own signal: a
+    // relayed copy has the relay's RSSI
+    if (LINK_HOPS(data[offsetof(link_hdr_t, hops)]) != 0) return;
+    int64_t now_us = esp_timer_get_time();
+    int slot = id & (SOURCE_RSSI_SLOTS - 1);
+    portENTER_CRITICAL(&rssi_lock);
+    if (source_ids[slot] != id) {
+        source_ids[slot] = id;
+        source_rssi[slot] = 0;
+        rssi_count[slot] = 0;
+    }
+    if (rssi_count[slot] == 0 || rssi < rssi_min[slot]) rssi_min[slot] = rssi;
+    rssi_sum[slot] = rssi_count[slot] ? rssi_sum[slot] + rssi : rssi;
+    rssi_count[slot]++;
+    direct_us[slot] = now_us;
+    if (!source_rssi[slot]) {
+        source_rssi[slot] = (int16_t)(rssi * 16);
+    } else {
+        source_rssi[slot] += (int16_t)((rssi * 16 - source_rssi[slot]) / 16);
     }
+    portEXIT_CRITICAL(&rssi_lock);
 }
 
 void rover_espnow_receiver_init(void) {
-    // Initialize NVS
-    esp_err_t ret = nvs_flash_init();
-    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
-        ESP_ERROR_CHECK(nvs_flash_erase());
-        ret = nvs_flash_init();
-    }
-    ESP_ERROR_CHECK(ret);
+    pkt_ring_init(&rx_ring, rx_slots, ESPNOW_RX_SLOTS);
 
-    esp_netif_init();
-    esp_event_loop_create_default();
-    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
-    esp_wifi_init(&cfg);
-    esp_wifi_set_mode(WIFI_MODE_STA);
-    esp_wifi_start();
+    // Wi-Fi may already be up (bonded UDP/MQTT paths); ESP-NOW then shares the AP channel
+    platform_wifi_init();
+#if LINK_ADAPT
+    // The base may step down to the long-range rates (link_adapt.h)
+    esp_wifi_set_protocol(WIFI_IF_STA, WIFI_PROTOCOL_11B | WIFI_PROTOCOL_11G | WIFI_PROTOCOL_11N | WIFI_PROTOCOL_LR);
+#endif
 
     if (esp_now_init() != ESP_OK) {
         ESP_LOGE(TAG, "ESP-NOW init failed");
@@ -51,214 +78,121 @@ void rover_espnow_receiver_init(void) {
     }
     esp_now_register_recv_cb(espnow_recv_cb);
 
-    // UART GNSS setup
-    const uart_config_t uart_config = {
-        .baud_rate = UART_GNSS_BAUD_RATE,
-        .data_bits = UART_DATA_8_BITS,
-        .parity    = UART_PARITY_DISABLE,
-        .stop_bits = UART_STOP_BITS_1,
-        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE
-    };
-    esp_err_t err;
-    
-    err = uart_param_config(UART_GNSS_PORT_NUM, &uart_config);
-    ESP_LOGI(TAG, "uart_param_config: %s", esp_err_to_name(err));
-    
-    err = uart_set_pin(UART_GNSS_PORT_NUM, UART_GNSS_TXD, UART_GNSS_RXD, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
-    ESP_LOGI(TAG, "uart_set_pin(TX=%d, RX=%d): %s", UART_GNSS_TXD, UART_GNSS_RXD, esp_err_to_name(err));
-    
-    err = uart_driver_install(UART_GNSS_PORT_NUM, UART_GNSS_BUF_SIZE * 2, UART_GNSS_BUF_SIZE * 2, 0, NULL, 0);
-    ESP_LOGI(TAG, "uart_driver_install: %s", esp_err_to_name(err));
-    
-    // Test UART TX with a UBX command (poll firmware version)
-    // UBX-MON-VER poll: B5 62 0A 04 00 00 0E 34
-    // If ZED-F9P receives this, it will respond in u-center
-    const uint8_t ubx_poll_ver[] = {0xB5, 0x62, 0x0A, 0x04, 0x00, 0x00, 0x0E, 0x34};
-    int test_written = uart_write_bytes(UART_GNSS_PORT_NUM, (const char *)ubx_poll_ver, sizeof(ubx_poll_ver));
-    ESP_LOGI(TAG, "UART test: Sent UBX-MON-VER poll (%d bytes). Check u-center packet console for response.", test_written);
-    uart_wait_tx_done(UART_GNSS_PORT_NUM, pdMS_TO_TICKS(100));
+    // Return channel to the base (link adaptation reports); espnow_comm_set_rate picks its rate
+    esp_now_peer_info_t peerInfo = {0};
+    memcpy(peerInfo.peer_addr, broadcast_mac, 6);
+    peerInfo.channel = 0;
+    peerInfo.ifidx = ESP_IF_WIFI_STA;
+    peerInfo.encrypt = false;
+    if (esp_now_add_peer(&peerInfo) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to add ESP-NOW peer");
+        return;
+    }
 }
 
-int rover_espnow_receive(uint8_t *data, size_t max_len) {
-    if (rx_len > 0) {
-        int len = rx_len > max_len ? max_len : rx_len;
-        memcpy(data, rx_buffer, len);
-        rx_len = 0;
-        return len;
+void rover_espnow_send(const uint8_t *data, size_t len) {
+    esp_err_t result = esp_now_send(broadcast_mac, data, len);
+    if (result != ESP_OK) {
+        ESP_LOGE(TAG, "ESP-NOW send error: %d", result);
     }
-    return 0;
 }
 
-void rover_forward_to_gnss(const uint8_t *data, size_t len) {
-    // Send data to GNSS module via UART (non-blocking)
-    uart_write_bytes(UART_GNSS_PORT_NUM, (const char *)data, len);
+void rover_espnow_set_channel(uint8_t channel) {
+    esp_err_t err = esp_wifi_set_channel(channel, WIFI_SECOND_CHAN_NONE);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "channel %u: %d", channel, err);
+    }
 }
 
-int rover_uart_read(uint8_t *data, size_t max_len) {
-    return uart_read_bytes(UART_GNSS_PORT_NUM, data, max_len, pdMS_TO_TICKS(10));
+void rover_espnow_rssi(uint8_t source, int8_t *avg, int8_t *min) {
+    int slot = source & (SOURCE_RSSI_SLOTS - 1);
+    portENTER_CRITICAL(&rssi_lock);
+    uint16_t count = source_ids[slot] == source ? rssi_count[slot] : 0;
+    int32_t sum = rssi_sum[slot];
+    *min = rssi_min[slot];
+    if (count) rssi_count[slot] = 0;
+    portEXIT_CRITICAL(&rssi_lock);
+    if (count == 0) {
+        *avg = *min = -128;  // LINK_ADAPT_RSSI_NONE
+    } else {
+        *avg = (int8_t)(sum / count);
+    }
 }
 
-// Parse NMEA GGA sentence to extract fix quality
-// Fix quality: 0=Invalid, 1=GPS, 2=DGPS, 4=RTK Fixed, 5=RTK Float
-int rover_parse_gga_fix(const uint8_t *data, size_t len) {
-    // Validate input
-    if (data == NULL || len < 50) {
-        return -1;
-    }
-    
-    // Look for $GNGGA or $GPGGA
-    for (size_t i = 0; i <= len - 50; i++) {
-        // Bounds check before accessing array
-        if (i + 4 >= len) break;
-        
-        if (data[i] == '$' && data[i+2] == 'G' && data[i+3] == 'G' && data[i+4] == 'A') {
-            // Find 6th comma (fix quality field)
-            int comma_count = 0;
-            size_t max_j = (i + 80 < len) ? i + 80 : len;
-            for (size_t j = i; j < max_j; j++) {
-                if (data[j] == ',') {
-                    comma_count++;
-                    if (comma_count == 6 && j + 1 < len) {
-                        // Ensure the character is a valid ASCII digit
-                        if (data[j + 1] >= '0' && data[j + 1] <= '9') {
-                            return data[j + 1] - '0'; // Convert ASCII to int
-                        }
-                    }
-                }
-            }
-        }
-    }
-    return -1; // Not found
+int8_t rover_espnow_source_rssi(uint8_t source) {
+    int slot = source & (SOURCE_RSSI_SLOTS - 1);
+    portENTER_CRITICAL(&rssi_lock);
+    int16_t avg = source_ids[slot] == source ? source_rssi[slot] : 0;
+    int64_t direct = direct_us[slot];
+    portEXIT_CRITICAL(&rssi_lock);
+    // Heard only through relays lately: no RSSI of its own
+    if (esp_timer_get_time() - direct >= ROVER_SOURCE_STALE_US) avg = 0;
+    return avg ? (int8_t)(avg / 16) : -128;  // ROVER_SOURCE_RSSI_NONE
 }
 
-// Extract a field from NMEA sentence between specified comma positions
-static void extract_field(const uint8_t *data, size_t len, int field_num, char *output, size_t max_out) {
-    if (!data || !output || max_out == 0 || len == 0) {
-        if (output && max_out > 0) output[0] = '\0';
-        return;
-    }
-    
-    int comma_count = 0;
-    size_t field_start = 0;
-    output[0] = '\0';
-    
-    for (size_t i = 0; i < len && comma_count <= field_num; i++) {
-        if (data[i] == ',') {
-            if (comma_count == field_num && comma_count > 0 && field_start < i) {
-                size_t field_len = i - field_start;
-                if (field_len > max_out - 1) field_len = max_out - 1;
-                if (field_len > 0 && field_start < len) {
-                    memcpy(output, &data[field_start], field_len);
-                    output[field_len] = '\0';
-                }
-                return;
-            }
-            comma_count++;
-            field_start = i + 1;
-        }
-    }
-    
-    // Last field (after final comma)
-    if (comma_count == field_num && field_start < len) {
-        size_t field_len = len - field_start;
-        // Stop at *, \r, \n
-        for (size_t i = field_start; i < len; i++) {
-            if (data[i] == '*' || data[i] == '\r' || data[i] == '\n') {
-                field_len = i - field_start;
-                break;
-            }
-        }
-        if (field_len > max_out - 1) field_len = max_out - 1;
-        if (field_len > 0) {
-            memcpy(output, &data[field_start], field_len);
-            output[field_len] = '\0';
-        }
-    }
+int rover_espnow_receive(uint8_t *data, size_t max_len) {
+    return pkt_ring_pop(&rx_ring, data, max_len);
 }
 
-// Parse and display GGA data (lat, lon, altitude, sats, quality)
-void rover_display_gga(const uint8_t *data, size_t len) {
-    if (!data || len < 60) return;
-    
-    // Find the LAST complete GGA sentence in buffer
-    int last_gga = -1;
-    for (size_t i = 0; i < len - 60; i++) {
-        if (data[i] == '$' && data[i+1] == 'G' && 
-            (data[i+2] == 'N' || data[i+2] == 'P') &&
-            data[i+3] == 'G' && data[i+4] == 'G' && data[i+5] == 'A') {
-            last_gga = i;
-        }
-    }
-    
-    if (last_gga < 0) return;
-    
-    // Extract just what we need from the last GGA
-    const uint8_t *gga = data + last_gga;
-    int field = 0;
-    int pos = 0;
-    char fields[15][20] = {0}; // Store up to 15 fields
-    
-    // Parse fields separated by commas
-    for (size_t i = 0; i < 150 && gga[i] != '\n' && gga[i] != '\r' && field < 15; i++) {
-        if (gga[i] == ',') {
-            fields[field][pos] = '\0';
-            field++;
-            pos = 0;
-        } else if (gga[i] != '$' && pos < 19) {
-            fields[field][pos++] = gga[i];
-        }
-    }
-    
-    // Fields: 0=GNGGA, 1=time, 2=lat, 3=N/S, 4=lon, 5=E/W, 6=quality, 7=sats, 9=alt
-    if (strlen(fields[2]) > 0 && strlen(fields[4]) > 0) {
-        // Convert lat/lon from DDMM.MMMM to DD.DDDDDD
-        double lat = atof(fields[2]);
-        int lat_d = (int)(lat / 100);
-        double lat_m = lat - (lat_d * 100);
-        lat = lat_d + (lat_m / 60.0);
-        if (fields[3][0] == 'S') lat = -lat;
-        
-        double lon = atof(fields[4]);
-        int lon_d = (int)(lon / 100);
-        double lon_m = lon - (lon_d * 100);
-        lon = lon_d + (lon_m / 60.0);
-        if (fields[5][0] == 'W') lon = -lon;
-        
-        // RTK quality indicator (from NMEA GGA field 6)
-        // 0=No fix, 1=GPS, 2=DGPS, 4=RTK Fix, 5=RTK Float
-        const char *fix = "No Fix";
-        int q = atoi(fields[6]);
-        if (q == 4) fix = "RTK FIX";        // Best accuracy (cm-level)
-        else if (q == 5) fix = "RTK Float"; // Good accuracy (dm-level)
-        else if (q == 2) fix = "DGPS";      // Meter-level
-        else if (q == 1) fix = "GPS";       // Meter-level
-        
-        printf("Lat: %.7f  Lon: %.7f  Alt: %sm  Sats: %s  [%s]\n", 
-               lat, lon, fields[9], fields[7], fix);
-    }
+size_t rover_espnow_receive_batch(pkt_ring_cb_t cb, void *ctx) {
+    return pkt_ring_drain(&rx_ring, cb, ctx, ESPNOW_RX_SLOTS);
 }
 
-// Parse and display GSA data (HDOP, VDOP, PDOP)
-void rover_display_gsa(const uint8_t *data, size_t len) {
-    char hdop[10] = {0}, pdop[10] = {0};
-    
-    // Look for GSA sentence
-    for (size_t i = 0; i < len - 30; i++) {
-        if (i + 2 >= len) break;
-        if (data[i] == '$' && (data[i+2] == 'S' || data[i+3] == 'S')) {
-            // Find end of sentence
-            size_t sent_end = i;
-            while (sent_end < len && data[sent_end] != '\n') sent_end++;
-            if (sent_end >= len) sent_end = len - 1;
-            
-            // Extract fields: 15=PDOP, 16=HDOP, 17=VDOP
-            extract_field(data + i, sent_end - i, 15, pdop, sizeof(pdop));
-            extract_field(data + i, sent_end - i, 16, hdop, sizeof(hdop));
-            
-            if (hdop[0] && pdop[0]) {
-                printf("[DOP] HDOP: %s  PDOP: %s\n", hdop, pdop);
-            }
-            return;
-        }
-    }
+void rover_espnow_set_wake(pkt_ring_wake_fn_t wake, void *ctx) {
+    pkt_ring_set_wake(&rx_ring, wake, ctx);
+}
+
+size_t rover_espnow_queued(void) {
+    return pkt_ring_count(&rx_ring);
+}
+
+void rover_espnow_get_stats(pkt_ring_stats_t *stats) {
+    *stats = rx_ring.stats;
+}
+
+// Display formatted GGA data (lat, lon, altitude, sats, quality)
+void rover_display_gga(const nmea_gga_t *gga) {
+    if (!gga || !gga->has_position) return;
+
+    // RTK quality indicator (from NMEA GGA field 6)
+    // 0=No fix, 1=GPS, 2=DGPS, 4=RTK Fix, 5=RTK Float
+    const char *fix = "No Fix";
+    int q = gga->quality;
+    if (q == 4) fix = "RTK FIX";        // Best accuracy (cm-level)
+    else if (q == 5) fix = "RTK Float"; // Good accuracy (dm-level)
+    else if (q == 2) fix = "DGPS";      // Meter-level
+    else if (q == 1) fix = "GPS";       // Meter-level
+
+    char lat[24], lon[24];
+    geo_format_deg(lat, sizeof(lat), gga->lat, 7);
+    geo_format_deg(lon, sizeof(lon), gga->lon, 7);
+    printf("Lat: %s  Lon: %s  Alt: %.3fm  Sats: %d  [%s]\n", lat, lon, gga->alt, gga->sats, fix);
+}
+
+// Display GSA data (HDOP, PDOP)
+void rover_display_gsa(const nmea_gsa_t *gsa) {
+    if (!gsa || gsa->pdop <= 0.0f) return;
+    printf("[DOP] HDOP: %.2f  PDOP: %.2f\n", gsa->hdop, gsa->pdop);
+}
+
+// Display solution from UBX-NAV-PVT (plus NAV-HPPOSLLH for sub-mm lat/lon when available)
+void rover_display_pvt(const ubx_nav_pvt_t *pvt, const ubx_nav_hpposllh_t *hp) {
+    if (!pvt) return;
+
+    geo_pos_t pos;
+    if (hp && hp->iTOW == pvt->iTOW && !(hp->flags & 0x01)) geo_from_hpposllh(hp, &pos);
+    else geo_from_pvt(pvt, &pos);
+    char lat[24], lon[24];
+    geo_format_deg(lat, sizeof(lat), pos.lat, 9);
+    geo_format_deg(lon, sizeof(lon), pos.lon, 9);
+
+    const char *fix = "No Fix";
+    int carr = UBX_PVT_CARR_SOLN(pvt->flags);
+    if (carr == 2) fix = "RTK FIX";
+    else if (carr == 1) fix = "RTK Float";
+    else if (pvt->flags & UBX_PVT_FLAGS_DIFF_SOLN) fix = "DGPS";
+    else if (pvt->fixType >= 2) fix = "GPS";
+
+    printf("Lat: %s  Lon: %s  Alt: %.3fm  Sats: %d  hAcc: %.3fm  vAcc: %.3fm  [%s]\n",
+           lat, lon, pvt->hMSL / 1000.0f, pvt->numSV, pvt->hAcc / 1000.0f, pvt->vAcc / 1000.0f, fix);
 }
@@ -3,21 +3,40 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include "pkt_ring.h"
+#include "nmea_parser.h"
+#include "ubx.h"
+
+#define ESPNOW_RX_SLOTS 16  // power of two; holds a full MSM epoch burst (blocks come from pkt_pool)
 
 // Call this to initialize ESP-NOW for receiving RTCM data
 void rover_espnow_receiver_init(void);
 // Call this to receive RTCM data (returns number of bytes received)
 int rover_espnow_receive(uint8_t *data, size_t max_len);
-// Call this to forward received RTCM data to ZED-F9P via UART
-void rover_forward_to_gnss(const uint8_t *data, size_t len);
-// Call this to read data from UART (for loopback test)
-int rover_uart_read(uint8_t *data, size_t max_len);
-// Parse NMEA GGA to get fix quality (0=none, 1=GPS, 4=RTK Fixed, 5=RTK Float)
-int rover_parse_gga_fix(const uint8_t *data, size_t len);
+// Call this to hand every queued packet to cb without copying (returns packets drained)
+size_t rover_espnow_receive_batch(pkt_ring_cb_t cb, void *ctx);
+// Run wake(ctx) from the Wi-Fi task whenever a packet is queued, so the
+// consumer can block instead of polling
+void rover_espnow_set_wake(pkt_ring_wake_fn_t wake, void *ctx);
+// Packets waiting in the receive queue, of ESPNOW_RX_SLOTS
+size_t rover_espnow_queued(void);
+// Send to the base over the ESP-NOW broadcast peer (link adaptation reports)
+void rover_espnow_send(const uint8_t *data, size_t len);
+void rover_espnow_set_channel(uint8_t channel);
+// Average and weakest RSSI (dBm) of one base's packets since the last call,
+// straight from the base only; -128 when none
+void rover_espnow_rssi(uint8_t source, int8_t *avg, int8_t *min);
+// Average RSSI (dBm) of the packets straight from one base; -128 when none
+// was heard, also when the base is only heard through relays
+int8_t rover_espnow_source_rssi(uint8_t source);
+// Receive queue counters (accepted, overflow, drops, high-water)
+void rover_espnow_get_stats(pkt_ring_stats_t *stats);
 // Display formatted GGA data (lat, lon, alt, sats, fix)
-void rover_display_gga(const uint8_t *data, size_t len);
-// Display formatted GSA data (HDOP, PDOP, VDOP)
-void rover_display_gsa(const uint8_t *data, size_t len);
+void rover_display_gga(const nmea_gga_t *gga);
+// Display formatted GSA data (HDOP, PDOP)
+void rover_display_gsa(const nmea_gsa_t *gsa);
+// Display UBX NAV solution (hp may be NULL)
+void rover_display_pvt(const ubx_nav_pvt_t *pvt, const ubx_nav_hpposllh_t *hp);
 
 #endif // ROVER_ESPNOW_RECEIVER_H
 
@@ -0,0 +1,302 @@
+#include "rover_pipeline.h"
+#include "link_clock.h"
+#include <string.h>
+#include <math.h>
+
+// Single instance: the link callbacks carry no context pointer
+static rover_pipeline_t rp;
+
+static void update_baseline(const geo_pos_t *pos) {
+    for (int i = 0; i < ROVER_SOURCES; i++) {
+        rover_source_t *src = &rp.sources[i];
+        if (!src->used || !src->have_base || geo_ltp_enu(&src->ltp, pos, &src->baseline) != 0) continue;
+        src->have_baseline = 1;
+        if (src != rp.source) continue;
+        rp.baseline = src->baseline;
+        rp.have_baseline = 1;
+        rp.baseline_count++;
+    }
+}
+
+// The selected base's position and baseline, where the display reads them
+static void show_source(void) {
+    const rover_source_t *src = rp.source;
+    rp.base_arp = src->arp;
+    rp.have_base = src->have_base;
+    rp.baseline = src->baseline;
+    rp.have_baseline = src->have_baseline;
+}
+
+static void on_gga(const nmea_gga_t *gga, void *ctx) {
+    rp.last_gga = *gga;
+    rp.last_gga.time = NULL; // points into the parser line buffer
+    rp.gga_count++;
+    // Receivers that send UBX NAV get their baseline from the solution
+    if (!rp.have_pvt && gga->has_position && gga->quality) {
+        geo_pos_t pos = { gga->lat, gga->lon, (int32_t)lroundf((gga->alt + gga->geoid_sep) * 1000.0f) };
+        update_baseline(&pos);
+    }
+}
+
+static void solution(const ubx_nav_hpposllh_t *hp) {
+    rp.pvt_pending = 0;
+    if (rp.last_pvt.fixType >= 2 && rp.last_pvt.fixType <= 4) {
+        geo_pos_t pos;
+        if (hp && !(hp->flags & 0x01)) geo_from_hpposllh(hp, &pos);
+        else geo_from_pvt(&rp.last_pvt, &pos);
+        update_baseline(&pos);
+    }
+    if (rp.on_solution) rp.on_solution(&rp.last_pvt, hp, rp.solution_ctx);
+}
+
+// NAV-PVT and NAV-HPPOSLLH of one epoch may come in either order; a PVT
+// without its HPPOSLLH goes out alone when the next epoch starts
+static void on_pvt(const ubx_nav_pvt_t *pvt, void *ctx) {
+    if (rp.pvt_pending) solution(NULL);
+    rp.last_pvt = *pvt;
+    rp.have_pvt = 1;
+    rp.pvt_count++;
+    link_clock_discipline(pvt->iTOW, rp.now_us - LINK_CLOCK_PVT_DELAY_US);
+    if (rp.have_hp && rp.last_hp.iTOW == pvt->iTOW) solution(&rp.last_hp);
+    else rp.pvt_pending = 1;
+}
+
+static void on_hpposllh(const ubx_nav_hpposllh_t *hp, void *ctx) {
+    rp.last_hp = *hp;
+    rp.have_hp = 1;
+    if (rp.pvt_pending && rp.last_pvt.iTOW == hp->iTOW) solution(&rp.last_hp);
+}
+
+static void gnss_write(const uint8_t *data, size_t len) {
+    rp.to_gnss(data, len);
+    rp.last_rtcm_us = rp.now_us;
+}
+
+static void queue_run(const uint8_t *data, size_t len) {
+    if (len) rtcm_txq_push(&rp.txq, data, len, rp.pkt_age_us, rp.now_us);
+}
+
+// The first base heard is taken at once. Later switches wait until both
+// streams are between epochs; a base gone quiet has no epoch left to finish
+static int may_switch(const rover_source_t *src) {
+    if (!rp.source) return 1;
+    if (src != rp.want || src->in_epoch) return 0;
+    return !rp.source->in_epoch || rp.now_us - rp.source->last_rx_us > ROVER_SOURCE_EPOCH_US;
+}
+
+static void switch_to(rover_source_t *src) {
+    if (rp.source) rp.source_changes++;
+    rp.source = src;
+    rp.want = NULL;
+    src->selected++;
+    // The receiver needs the new base's position before its observations,
+    // and the position only comes every few epochs
+    queue_run(src->arp_frame, src->arp_len);
+    queue_run(src->bias_frame, src->bias_len);
+    show_source();
+}
+
+// Depacketizer output is one or more whole frames. Only frames with a good
+// CRC go on, and before the delta decoder: a corrupt key frame would spoil
+// every delta built on it. Every base's frames are decoded, only the
+// selected base's are queued; runs of frames that pass through unchanged are
+// queued as one
+static void on_link_rtcm(const uint8_t *data, size_t len) {
+    rover_source_t *src = rp.current;
+    int forward = src == rp.source;
+    size_t run = 0, pos = 0;
+    while (len - pos >= RTCM3_HEADER_LEN + RTCM3_CRC_LEN && data[pos] == RTCM3_PREAMBLE) {
+        size_t flen = RTCM3_HEADER_LEN + rtcm3_payload_len(data + pos) + RTCM3_CRC_LEN;
+        if (flen > len - pos) break;
+        if (!rtcm3_frame_valid(data + pos, flen)) {
+            if (forward) queue_run(data + run, pos - run);
+            rp.corrupted++;
+            pos += flen;
+            run = pos;
+            continue;
+        }
+        if (!forward && may_switch(src)) {
+            switch_to(src);
+            forward = 1;
+            run = pos;
+        }
+        const uint8_t *out;
+        size_t n = rtcm_delta_decode(&src->delta, data + pos, flen, rp.delta_buf, &out);
+        if (n) {
+            rover_source_frame(src, out, n);
+            if (forward) src->written++;
+        } else {
+            src->stats.delta_dropped++;
+        }
+        if (!forward) {
+            run = pos + flen;
+        } else if (out != data + pos) {
+            queue_run(data + run, pos - run);
+            queue_run(out, n);
+            run = pos + flen;
+        }
+        pos += flen;
+    }
+    if (forward) {
+        queue_run(data + run, pos - run);
+        show_source();
+    }
+    if (len > pos) rp.corrupted++;
+}
+
+static void on_data_packet(const uint8_t *pkt, size_t len) {
+    rover_source_t *src = rp.current;
+    link_hdr_t hdr;
+    rp.pkt_age_us = 0;
+    if (len >= sizeof(hdr)) {
+        memcpy(&hdr, pkt, sizeof(hdr));
+        // Queue delay is sampled before this packet is written behind it
+        uint32_t queued = rp.queue_delay ? rp.queue_delay(rp.txq.queued) : 0;
+        link_stats_record(&src->stats, &hdr, rp.now_us, queued);
+        // Age on arrival: the latency sample without the UART queue
+        if (src->stats.lat_last_us > queued) rp.pkt_age_us = src->stats.lat_last_us - queued;
+        rover_source_packet(src, &hdr, rp.pkt_age_us);
+    }
+    link_depacketizer_input(&src->depacketizer, pkt, len);
+}
+
+static void chain_init(rover_source_t *src) {
+    link_depacketizer_init(&src->depacketizer, on_link_rtcm);
+    rtcm_delta_init(&src->delta, 0);
+    link_fec_decoder_init(&src->fec, on_data_packet);
+    link_stats_init(&src->stats);
+    link_bond_rx_init(&src->bond);
+    for (uint8_t p = 0; p < rp.path_count; p++) link_bond_rx_add_path(&src->bond, rp.path_names[p]);
+}
+
+// The slot of the base that sent pkt. A new base takes a free slot or one
+// silent for ROVER_SOURCE_STALE_US; NULL when there is none
+static rover_source_t *source_of(const uint8_t *pkt, size_t len, int64_t now_us) {
+    if (len < sizeof(link_hdr_t)) return NULL;
+    uint8_t id = pkt[offsetof(link_hdr_t, source)];
+    rover_source_t *slot = NULL;
+    for (int i = 0; i < ROVER_SOURCES; i++) {
+        rover_source_t *src = &rp.sources[i];
+        if (src->used && src->id == id) return src;
+        if (!slot && (!src->used || (src != rp.source && now_us - src->last_rx_us >= ROVER_SOURCE_STALE_US))) {
+            slot = src;
+        }
+    }
+    if (!slot) {
+        rp.no_slot++;
+        return NULL;
+    }
+    if (rp.want == slot) rp.want = NULL;
+    link_fec_decoder_clear(&slot->fec);
+    memset(slot, 0, sizeof(*slot));
+    chain_init(slot);
+    rover_source_init(slot, id);
+    return slot;
+}
+
+static void choose(int64_t now_us) {
+    for (int i = 0; i < ROVER_SOURCES && rp.source_rssi; i++) {
+        if (rp.sources[i].used) rp.sources[i].rssi = rp.source_rssi(rp.sources[i].id);
+    }
+    int active = rp.source ? (int)(rp.source - rp.sources) : -1;
+    int pick = rover_source_select(rp.sources, ROVER_SOURCES, active, now_us);
+    rp.want = pick >= 0 && pick != active ? &rp.sources[pick] : NULL;
+}
+
+static void receive(rover_source_t *src, pkt_block_t *pkt, int64_t now_us) {
+    src->last_rx_us = now_us;
+    rp.current = src;
+    // FEC releases data packets in sequence order, rebuilding single losses
+    link_fec_decoder_input(&src->fec, pkt, now_us);
+    choose(now_us);
+}
+
+void rover_pipeline_init(link_output_fn_t to_gnss, rover_queue_delay_fn_t queue_delay, rtcm_txq_space_fn_t tx_space) {
+    // Blocks still held from a previous run go back to the pool
+    for (int i = 0; i < ROVER_SOURCES; i++) link_fec_decoder_clear(&rp.sources[i].fec);
+    memset(&rp, 0, sizeof(rp));
+    rp.to_gnss = to_gnss;
+    rp.queue_delay = queue_delay;
+    rtcm_txq_init(&rp.txq, gnss_write, tx_space, 0);
+    for (int i = 0; i < ROVER_SOURCES; i++) chain_init(&rp.sources[i]);
+
+    const nmea_handlers_t nmea_handlers = { .on_gga = on_gga };
+    nmea_parser_init(&rp.nmea, &nmea_handlers);
+    const ubx_handlers_t ubx_handlers = { .on_pvt = on_pvt, .on_hpposllh = on_hpposllh };
+    ubx_parser_init(&rp.ubx, &ubx_handlers);
+    const gnss_demux_targets_t demux_targets = { .nmea = &rp.nmea, .ubx = &rp.ubx };
+    gnss_demux_init(&rp.demux, &demux_targets);
+}
+
+void rover_pipeline_set_deadline(uint32_t deadline_us) {
+    rp.txq.deadline_us = deadline_us ? deadline_us : RTCM_TXQ_DEADLINE_US;
+}
+
+void rover_pipeline_set_solution_cb(rover_solution_fn_t cb, void *ctx) {
+    rp.on_solution = cb;
+    rp.solution_ctx = ctx;
+}
+
+void rover_pipeline_set_source_rssi(rover_source_rssi_fn_t fn) {
+    rp.source_rssi = fn;
+}
+
+int rover_pipeline_add_path(const char *name) {
+    if (rp.path_count == LINK_BOND_MAX_PATHS) return -1;
+    rp.path_names[rp.path_count] = name;
+    for (int i = 0; i < ROVER_SOURCES; i++) link_bond_rx_add_path(&rp.sources[i].bond, name);
+    return rp.path_count++;
+}
+
+void rover_pipeline_input_block(int path, pkt_block_t *pkt, int64_t now_us) {
+    rp.now_us = now_us;
+    rover_source_t *src = source_of(pkt->data, pkt->len, now_us);
+    if (!src || !link_bond_rx_input(&src->bond, path, pkt->data, pkt->len, now_us)) return;
+    receive(src, pkt, now_us);
+}
+
+void rover_pipeline_input(int path, const uint8_t *pkt, size_t len, int64_t now_us) {
+    rp.now_us = now_us;
+    if (len > PKT_BLOCK_SIZE) return;
+    rover_source_t *src = source_of(pkt, len, now_us);
+    if (!src || !link_bond_rx_input(&src->bond, path, pkt, len, now_us)) return;
+    pkt_block_t *b = pkt_pool_alloc();
+    if (!b) return;
+    memcpy(b->data, pkt, len);
+    b->len = (uint16_t)len;
+    receive(src, b, now_us);
+    pkt_block_release(b);
+}
+
+void rover_pipeline_poll(int64_t now_us) {
+    rp.now_us = now_us;
+    for (int i = 0; i < ROVER_SOURCES; i++) {
+        if (!rp.sources[i].used) continue;
+        rp.current = &rp.sources[i];
+        link_fec_decoder_poll(&rp.current->fec, now_us);
+    }
+    rtcm_txq_poll(&rp.txq, now_us);
+}
+
+int64_t rover_pipeline_next_us(size_t *tx_need) {
+    int64_t next = rtcm_txq_next_us(&rp.txq, tx_need);
+    for (int i = 0; i < ROVER_SOURCES; i++) {
+        if (!rp.sources[i].used) continue;
+        int64_t t = link_fec_decoder_next_us(&rp.sources[i].fec);
+        if (t < next) next = t;
+    }
+    return next;
+}
+
+void rover_pipeline_feed_gnss(const uint8_t *data, size_t len, int64_t now_us) {
+    rp.now_us = now_us;
+    gnss_demux_feed(&rp.demux, data, len);
+}
+
+rover_pipeline_t *rover_pipeline_state(void) {
+    return &rp;
+}
+
+rover_source_t *rover_pipeline_source(void) {
+    return rp.source ? rp.source : &rp.sources[0];
+}
@@ -0,0 +1,93 @@
+#ifndef ROVER_PIPELINE_H
+#define ROVER_PIPELINE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "rover_source.h"
+#include "gnss_demux.h"
+#include "rtcm_txq.h"
+
+// Rover correction path: radio packets from one or more transports -> per
+// base (rover_source.h): duplicate filter -> FEC decoder (in sequence order)
+// -> depacketizer -> CRC check -> MSM delta decoder, then the selected base
+// only -> UART queue (deadline, paced) -> receiver UART, plus decoding of the
+// receiver's NMEA/UBX output and the baseline of each solution from the base
+// antenna positions the corrections carry (1005/1006). No ESP-IDF calls, see
+// base_pipeline.h.
+
+// Time the bytes already queued for the receiver UART, and pending more
+// waiting to be written behind them, need to drain (us)
+typedef uint32_t (*rover_queue_delay_fn_t)(size_t pending);
+// One navigation solution: NAV-PVT and, when the receiver sends it, the
+// NAV-HPPOSLLH of the same epoch (else NULL)
+typedef void (*rover_solution_fn_t)(const ubx_nav_pvt_t *pvt, const ubx_nav_hpposllh_t *hp, void *ctx);
+// ESP-NOW RSSI of a base's packets (dBm), ROVER_SOURCE_RSSI_NONE when not heard
+typedef int8_t (*rover_source_rssi_fn_t)(uint8_t source);
+
+typedef struct {
+    rover_source_t sources[ROVER_SOURCES];
+    rover_source_t *source;       // the base the receiver gets corrections from, NULL before the first
+    rover_source_t *want;         // the base to switch to at the next epoch boundary, NULL for none
+    rover_source_t *current;      // being decoded: the link callbacks carry no context
+    uint32_t source_changes;      // switches from one base to another
+    uint32_t no_slot;             // packets from more bases than ROVER_SOURCES
+    const char *path_names[LINK_BOND_MAX_PATHS];
+    uint8_t path_count;
+    rover_source_rssi_fn_t source_rssi;
+    uint8_t delta_buf[RTCM3_MAX_FRAME];
+    rtcm_txq_t txq;
+    uint32_t corrupted;           // frames failing the CRC, bytes that frame nothing
+    uint32_t pkt_age_us;          // of the packet being depacketized
+    gnss_demux_t demux;
+    nmea_parser_t nmea;
+    ubx_parser_t ubx;
+    nmea_gga_t last_gga;
+    ubx_nav_pvt_t last_pvt;
+    ubx_nav_hpposllh_t last_hp;
+    int have_pvt;
+    int have_hp;
+    int pvt_pending;              // last_pvt waits for its NAV-HPPOSLLH
+    rtcm3_arp_t base_arp;         // of the selected base, from its last 1005/1006
+    int have_base;
+    geo_enu_t baseline;           // last solution from the selected base's antenna
+    int have_baseline;
+    uint32_t baseline_count;
+    int64_t last_rtcm_us;         // corrections last written to the receiver, 0 = never
+    rover_solution_fn_t on_solution;
+    void *solution_ctx;
+    uint32_t gga_count;
+    uint32_t pvt_count;
+    link_output_fn_t to_gnss;
+    rover_queue_delay_fn_t queue_delay;
+    int64_t now_us;
+} rover_pipeline_t;
+
+// to_gnss receives the rebuilt RTCM3 stream, whole frames only, never more
+// than tx_space reports; queue_delay and tx_space may be NULL
+void rover_pipeline_init(link_output_fn_t to_gnss, rover_queue_delay_fn_t queue_delay, rtcm_txq_space_fn_t tx_space);
+// Corrections older than this are dropped rather than written (us)
+void rover_pipeline_set_deadline(uint32_t deadline_us);
+// Register a transport; returns the path index for rover_pipeline_input()
+int rover_pipeline_add_path(const char *name);
+// One link packet received on a path at now_us; copies already seen on another path are dropped
+void rover_pipeline_input_block(int path, pkt_block_t *pkt, int64_t now_us);
+// Same for a packet not in a pool block yet (copied into one once accepted)
+void rover_pipeline_input(int path, const uint8_t *pkt, size_t len, int64_t now_us);
+// Called once per navigation epoch decoded from the receiver output
+void rover_pipeline_set_solution_cb(rover_solution_fn_t cb, void *ctx);
+// Per-base RSSI for the source ranking; without it RSSI does not count
+void rover_pipeline_set_source_rssi(rover_source_rssi_fn_t fn);
+// Give up on FEC gaps that have been held too long, write what the UART has
+// room for
+void rover_pipeline_poll(int64_t now_us);
+// Earliest time rover_pipeline_poll() has work (a FEC gap given up, queued
+// corrections going stale), INT64_MAX for none. tx_need gets the UART room
+// the oldest queued run waits for (0 for none): poll again once it is free
+int64_t rover_pipeline_next_us(size_t *tx_need);
+// Bytes read from the receiver UART at now_us
+void rover_pipeline_feed_gnss(const uint8_t *data, size_t len, int64_t now_us);
+rover_pipeline_t *rover_pipeline_state(void);
+// The selected base, or the first slot (statistics all zero) before any
+rover_source_t *rover_pipeline_source(void);
+
+#endif // ROVER_PIPELINE_H
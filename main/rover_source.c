@@ -0,0 +1,109 @@
+#include "rover_source.h"
+#include "rtcm_msm.h"
+#include <string.h>
+
+#define TYPE_ARP         1005
+#define TYPE_ARP_HEIGHT  1006
+#define TYPE_GLO_BIAS    1230
+#define MSM_MULTIPLE_BIT 54       // multiple message flag, same place in every MSM header
+#define LOSS_SHIFT       5        // average over about 32 packets
+#define AGE_SHIFT        3
+#define MAX_GAP          64       // longer gaps count as this many losses
+#define ROUND            ((1 << LOSS_SHIFT) - 1) // so the average reaches 0 and 1000
+
+void rover_source_init(rover_source_t *s, uint8_t id) {
+    s->id = id;
+    s->used = 1;
+    s->rssi = ROVER_SOURCE_RSSI_NONE;
+    s->cost = ROVER_SOURCE_UNUSABLE;
+}
+
+void rover_source_packet(rover_source_t *s, const link_hdr_t *hdr, uint32_t age_us) {
+    if (s->have_seq) {
+        uint16_t gap = (uint16_t)(hdr->seq - s->last_seq - 1);
+        if (gap >= 0x8000) return;                 // older than the last one: a rebuilt packet counted already
+        if (gap > MAX_GAP) gap = MAX_GAP;
+        while (gap--) s->loss_permille += (1000 - s->loss_permille + ROUND) >> LOSS_SHIFT;
+        s->age_us += ((int32_t)age_us - (int32_t)s->age_us) / (1 << AGE_SHIFT);
+    } else {
+        s->age_us = age_us;
+    }
+    s->loss_permille -= (s->loss_permille + ROUND) >> LOSS_SHIFT;
+    s->last_seq = hdr->seq;
+    s->have_seq = 1;
+}
+
+static void keep(uint8_t *dst, uint8_t *dst_len, const uint8_t *frame, size_t len) {
+    if (len > ROVER_SOURCE_STATION_MAX) return;
+    memcpy(dst, frame, len);
+    *dst_len = (uint8_t)len;
+}
+
+// A base that moves or is replaced gets a new tangent plane; the double math
+// runs only then, not per epoch
+static void base_position(rover_source_t *s, const uint8_t *frame, size_t len) {
+    rtcm3_arp_t arp;
+    if (rtcm3_parse_arp(frame, len, &arp) != 0) return;
+    keep(s->arp_frame, &s->arp_len, frame, len);
+    if (s->have_base && arp.x == s->arp.x && arp.y == s->arp.y && arp.z == s->arp.z) return;
+    geo_pos_t origin;
+    if (geo_from_ecef(arp.x, arp.y, arp.z, &origin) != 0) return;
+    geo_ltp_init(&s->ltp, &origin);
+    s->arp = arp;
+    s->have_base = 1;
+    s->have_baseline = 0;
+}
+
+void rover_source_frame(rover_source_t *s, const uint8_t *frame, size_t len) {
+    s->frames++;
+    uint16_t type = rtcm3_msg_type(frame, len);
+    if (type == TYPE_ARP || type == TYPE_ARP_HEIGHT) {
+        base_position(s, frame, len);
+    } else if (type == TYPE_GLO_BIAS) {
+        keep(s->bias_frame, &s->bias_len, frame, len);
+    } else if (rtcm_msm_level(type) && len > RTCM3_HEADER_LEN + RTCM3_CRC_LEN + MSM_MULTIPLE_BIT / 8) {
+        s->in_epoch = (uint8_t)rtcm3_get_bits(frame + RTCM3_HEADER_LEN, MSM_MULTIPLE_BIT, 1);
+        if (!s->in_epoch) s->epochs++;
+    }
+}
+
+int32_t rover_source_cost(const rover_source_t *s, int64_t now_us) {
+    int64_t silent = now_us - s->last_rx_us;
+    if (!s->used || !s->frames || silent >= ROVER_SOURCE_STALE_US) return ROVER_SOURCE_UNUSABLE;
+    int64_t age = s->age_us;
+    if (silent > ROVER_SOURCE_EPOCH_US) age += silent - ROVER_SOURCE_EPOCH_US;
+    int64_t cost = age * ROVER_SOURCE_AGE_POINTS / 100000;
+    cost += (int64_t)s->loss_permille * ROVER_SOURCE_LOSS_POINTS / 10;
+    if (s->rssi != ROVER_SOURCE_RSSI_NONE && s->rssi < ROVER_SOURCE_RSSI_GOOD) {
+        cost += (ROVER_SOURCE_RSSI_GOOD - s->rssi) * ROVER_SOURCE_RSSI_POINTS;
+    }
+    if (s->have_baseline) cost += (int64_t)geo_enu_distance(&s->baseline) * ROVER_SOURCE_BASELINE_POINTS / 1000000;
+    return cost < ROVER_SOURCE_UNUSABLE ? (int32_t)cost : ROVER_SOURCE_UNUSABLE - 1;
+}
+
+int rover_source_select(rover_source_t *sources, int count, int active, int64_t now_us) {
+    int best = -1;
+    for (int i = 0; i < count; i++) {
+        rover_source_t *s = &sources[i];
+        s->cost = rover_source_cost(s, now_us);
+        if (s->cost != ROVER_SOURCE_UNUSABLE && (best < 0 || s->cost < sources[best].cost)) best = i;
+    }
+    // Nothing better to go to: keep writing whatever still comes
+    if (best < 0) return active;
+    if (active < 0 || sources[active].cost == ROVER_SOURCE_UNUSABLE) return best;
+
+    int32_t bar = sources[active].cost - ROVER_SOURCE_HYSTERESIS;
+    for (int i = 0; i < count; i++) {
+        rover_source_t *s = &sources[i];
+        if (i == active || s->cost > bar) {
+            s->better = 0;
+        } else if (!s->better) {
+            s->better = 1;
+            s->better_since_us = now_us;
+        }
+    }
+    if (best != active && sources[best].better && now_us - sources[best].better_since_us >= ROVER_SOURCE_HOLD_US) {
+        return best;
+    }
+    return active;
+}
@@ -0,0 +1,99 @@
+#ifndef ROVER_SOURCE_H
+#define ROVER_SOURCE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "link_packet.h"
+#include "link_fec.h"
+#include "link_stats.h"
+#include "link_bond.h"
+#include "rtcm_delta.h"
+#include "geo.h"
+
+// Several bases on one site, told apart by the link header source byte
+// (LINK_BASE_ID). The rover keeps a receive chain per base (duplicate filter,
+// FEC, depacketizer, delta decoder, statistics) and writes the corrections
+// of one of them to the receiver: two interleaved streams are garbage to it.
+// Sources are ranked on a cost in points, lower is better:
+//   correction age     ROVER_SOURCE_AGE_POINTS per 100 ms on arrival, plus silence past an epoch
+//   loss after FEC     ROVER_SOURCE_LOSS_POINTS per percent
+//   ESP-NOW RSSI       ROVER_SOURCE_RSSI_POINTS per dB below ROVER_SOURCE_RSSI_GOOD
+//   baseline length    ROVER_SOURCE_BASELINE_POINTS per km (RTK error grows about 1 ppm)
+// A source heard within ROVER_SOURCE_STALE_US is a candidate. Another one
+// takes over when it costs ROVER_SOURCE_HYSTERESIS points less for
+// ROVER_SOURCE_HOLD_US, or at once when the active one goes stale. The switch
+// itself waits until both streams are between epochs, and the new base's
+// last antenna position and GLONASS bias frames go out first, so the receiver
+// never sees a mixed epoch or MSMs from a base it has no position for.
+// No ESP-IDF calls, see base_pipeline.h.
+
+#ifndef ROVER_SOURCES
+#define ROVER_SOURCES                 2        // bases tracked at once, each about 40 KB (delta references)
+#endif
+#ifndef ROVER_SOURCE_STALE_US
+#define ROVER_SOURCE_STALE_US         2500000  // silent this long: not a candidate, the slot can be reused
+#endif
+#ifndef ROVER_SOURCE_HOLD_US
+#define ROVER_SOURCE_HOLD_US          10000000 // a better source has to stay better this long
+#endif
+#ifndef ROVER_SOURCE_HYSTERESIS
+#define ROVER_SOURCE_HYSTERESIS       30       // points a better source has to win by
+#endif
+#ifndef ROVER_SOURCE_EPOCH_US
+#define ROVER_SOURCE_EPOCH_US         1000000  // correction interval; silence past it counts as age
+#endif
+#define ROVER_SOURCE_AGE_POINTS       10
+#define ROVER_SOURCE_LOSS_POINTS      10
+#define ROVER_SOURCE_RSSI_POINTS      5
+#define ROVER_SOURCE_RSSI_GOOD        (-80)
+#define ROVER_SOURCE_BASELINE_POINTS  10
+#define ROVER_SOURCE_RSSI_NONE        (-128)   // not heard over ESP-NOW
+#define ROVER_SOURCE_UNUSABLE         INT32_MAX
+#define ROVER_SOURCE_STATION_MAX      32       // 1005/1006 and 1230 frames kept for a switch
+
+typedef struct {
+    uint8_t id;                   // LINK_BASE_ID of the base
+    uint8_t used;
+    link_bond_rx_t bond;
+    link_fec_decoder_t fec;
+    link_depacketizer_t depacketizer;
+    link_stats_t stats;
+    rtcm_delta_t delta;           // always on: plain frames pass through unchanged
+    uint8_t arp_frame[ROVER_SOURCE_STATION_MAX];
+    uint8_t bias_frame[ROVER_SOURCE_STATION_MAX];
+    uint8_t arp_len;
+    uint8_t bias_len;
+    rtcm3_arp_t arp;              // from the last 1005/1006
+    int have_base;
+    geo_ltp_t ltp;                // tangent plane at arp
+    geo_enu_t baseline;           // last solution from this base's antenna
+    int have_baseline;
+    uint8_t in_epoch;             // the last MSM said more follow for its epoch
+    uint16_t last_seq;            // newest data seq delivered, for the loss average
+    uint8_t have_seq;
+    uint16_t loss_permille;       // average over about 32 data packets, after FEC
+    uint32_t age_us;              // average correction age on arrival
+    int8_t rssi;                  // ROVER_SOURCE_RSSI_NONE when not known
+    int32_t cost;                 // from the last ranking
+    uint8_t better;               // cheaper than the active source by the hysteresis...
+    int64_t better_since_us;      // ...since then
+    int64_t last_rx_us;           // any packet
+    uint32_t epochs;              // MSM epochs completed
+    uint32_t frames;              // RTCM frames decoded
+    uint32_t written;             // of those, queued for the receiver
+    uint32_t selected;            // times it became the active source
+} rover_source_t;
+
+// Claim a zeroed slot for base id; the receive chain is the pipeline's to set up
+void rover_source_init(rover_source_t *s, uint8_t id);
+// One data packet out of the FEC decoder, age_us old on arrival
+void rover_source_packet(rover_source_t *s, const link_hdr_t *hdr, uint32_t age_us);
+// One good RTCM frame as the receiver would get it (after the delta decoder)
+void rover_source_frame(rover_source_t *s, const uint8_t *frame, size_t len);
+// Cost at now_us, ROVER_SOURCE_UNUSABLE when not a candidate
+int32_t rover_source_cost(const rover_source_t *s, int64_t now_us);
+// Rank the used sources; returns the index that should be active: active
+// (-1 for none) unless another one has earned the switch
+int rover_source_select(rover_source_t *sources, int count, int active, int64_t now_us);
+
+#endif // ROVER_SOURCE_H
@@ -0,0 +1,172 @@
+#include "rtcm3.h"
+#include <string.h>
+
+static uint32_t crc24q_table[256];
+static int crc24q_ready = 0;
+
+static void crc24q_build_table(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i << 16;
+        for (int b = 0; b < 8; b++) {
+            crc <<= 1;
+            if (crc & 0x1000000) crc ^= 0x1864CFB;
+        }
+        crc24q_table[i] = crc & 0xFFFFFF;
+    }
+    crc24q_ready = 1;
+}
+
+uint32_t rtcm3_crc24q(const uint8_t *data, size_t len) {
+    if (!crc24q_ready) crc24q_build_table();
+    uint32_t crc = 0;
+    for (size_t i = 0; i < len; i++) {
+        crc = ((crc << 8) & 0xFFFFFF) ^ crc24q_table[((crc >> 16) ^ data[i]) & 0xFF];
+    }
+    return crc;
+}
+
+size_t rtcm3_payload_len(const uint8_t *frame) {
+    return ((size_t)(frame[1] & 0x03) << 8) | frame[2];
+}
+
+int rtcm3_frame_valid(const uint8_t *data, size_t len) {
+    if (len < RTCM3_HEADER_LEN + RTCM3_CRC_LEN || data[0] != RTCM3_PREAMBLE ||
+        RTCM3_HEADER_LEN + rtcm3_payload_len(data) + RTCM3_CRC_LEN != len) {
+        return 0;
+    }
+    size_t body = len - RTCM3_CRC_LEN;
+    uint32_t crc = ((uint32_t)data[body] << 16) | ((uint32_t)data[body + 1] << 8) | data[body + 2];
+    return rtcm3_crc24q(data, body) == crc;
+}
+
+uint16_t rtcm3_msg_type(const uint8_t *frame, size_t len) {
+    if (len < RTCM3_HEADER_LEN + 2 || rtcm3_payload_len(frame) < 2) return 0;
+    return (uint16_t)((frame[3] << 4) | (frame[4] >> 4));
+}
+
+size_t rtcm3_finish_frame(uint8_t *frame, size_t payload_len) {
+    frame[0] = RTCM3_PREAMBLE;
+    frame[1] = (uint8_t)((payload_len >> 8) & 0x03);
+    frame[2] = (uint8_t)(payload_len & 0xFF);
+    size_t body = RTCM3_HEADER_LEN + payload_len;
+    uint32_t crc = rtcm3_crc24q(frame, body);
+    frame[body] = (uint8_t)(crc >> 16);
+    frame[body + 1] = (uint8_t)(crc >> 8);
+    frame[body + 2] = (uint8_t)crc;
+    return body + RTCM3_CRC_LEN;
+}
+
+uint32_t rtcm3_get_bits(const uint8_t *buf, size_t pos, int len) {
+    uint32_t v = 0;
+    for (int i = 0; i < len; i++, pos++) {
+        v = (v << 1) | ((buf[pos >> 3] >> (7 - (pos & 7))) & 1u);
+    }
+    return v;
+}
+
+int32_t rtcm3_get_bits_signed(const uint8_t *buf, size_t pos, int len) {
+    uint32_t v = rtcm3_get_bits(buf, pos, len);
+    if (len <= 0 || len >= 32 || !(v & (1u << (len - 1)))) return (int32_t)v;
+    return (int32_t)(v | (~0u << len));
+}
+
+static int64_t get_bits38(const uint8_t *buf, size_t pos) {
+    return (int64_t)rtcm3_get_bits_signed(buf, pos, 6) * 4294967296LL + rtcm3_get_bits(buf, pos + 6, 32);
+}
+
+int rtcm3_parse_arp(const uint8_t *frame, size_t len, rtcm3_arp_t *arp) {
+    uint16_t type = rtcm3_msg_type(frame, len);
+    // 152 bits of 1005; 1006 appends the antenna height
+    if ((type != 1005 && type != 1006) || rtcm3_payload_len(frame) < 19) return -1;
+    const uint8_t *p = frame + RTCM3_HEADER_LEN;
+    arp->station_id = (uint16_t)rtcm3_get_bits(p, 12, 12);
+    arp->x = get_bits38(p, 34);
+    arp->y = get_bits38(p, 74);
+    arp->z = get_bits38(p, 114);
+    return 0;
+}
+
+void rtcm3_set_bits(uint8_t *buf, size_t pos, int len, uint32_t value) {
+    for (int i = len - 1; i >= 0; i--, pos++) {
+        uint8_t mask = (uint8_t)(1u << (7 - (pos & 7)));
+        if ((value >> i) & 1u) buf[pos >> 3] |= mask;
+        else buf[pos >> 3] &= (uint8_t)~mask;
+    }
+}
+
+void rtcm3_framer_init(rtcm3_framer_t *f) {
+    memset(f, 0, sizeof(*f));
+    if (!crc24q_ready) crc24q_build_table();
+}
+
+// Discard buffered bytes up to the next preamble at or after index 'from'
+static void framer_drop(rtcm3_framer_t *f, size_t from) {
+    size_t k = f->pos;
+    if (from < f->pos) {
+        const uint8_t *p = memchr(f->buf + from, RTCM3_PREAMBLE, f->pos - from);
+        if (p) k = (size_t)(p - f->buf);
+    }
+    f->skipped += k;
+    memmove(f->buf, f->buf + k, f->pos - k);
+    f->pos -= k;
+}
+
+// Validate whatever is buffered; returns once more input is needed
+static void framer_process(rtcm3_framer_t *f, rtcm3_frame_cb_t cb, void *ctx) {
+    while (f->pos > 0) {
+        if (f->buf[0] != RTCM3_PREAMBLE) {
+            framer_drop(f, 0);
+            continue;
+        }
+        if (f->pos < RTCM3_HEADER_LEN) return;
+        // 6 reserved bits after the preamble must be zero
+        if (f->buf[1] & 0xFC) {
+            framer_drop(f, 1);
+            continue;
+        }
+        size_t frame_len = RTCM3_HEADER_LEN + rtcm3_payload_len(f->buf) + RTCM3_CRC_LEN;
+        if (f->pos < frame_len) return;
+
+        size_t body = frame_len - RTCM3_CRC_LEN;
+        uint32_t crc = ((uint32_t)f->buf[body] << 16) | ((uint32_t)f->buf[body + 1] << 8) | f->buf[body + 2];
+        if (rtcm3_crc24q(f->buf, body) != crc) {
+            // False preamble or corrupted frame - resync from the next D3
+            f->crc_errors++;
+            framer_drop(f, 1);
+            continue;
+        }
+        f->frames++;
+        if (cb) cb(f->buf, frame_len, ctx);
+        memmove(f->buf, f->buf + frame_len, f->pos - frame_len);
+        f->pos -= frame_len;
+    }
+}
+
+void rtcm3_framer_feed(rtcm3_framer_t *f, const uint8_t *data, size_t len, rtcm3_frame_cb_t cb, void *ctx) {
+    while (len > 0) {
+        if (f->pos == 0) {
+            // Hunt for a preamble without copying noise into the buffer
+            const uint8_t *p = memchr(data, RTCM3_PREAMBLE, len);
+            if (!p) {
+                f->skipped += len;
+                return;
+            }
+            f->skipped += (size_t)(p - data);
+            len -= (size_t)(p - data);
+            data = p;
+        }
+
+        size_t want;
+        if (f->pos < RTCM3_HEADER_LEN) {
+            want = RTCM3_HEADER_LEN - f->pos;
+        } else {
+            want = RTCM3_HEADER_LEN + rtcm3_payload_len(f->buf) + RTCM3_CRC_LEN - f->pos;
+        }
+        size_t n = want < len ? want : len;
+        memcpy(f->buf + f->pos, data, n);
+        f->pos += n;
+        data += n;
+        len -= n;
+        framer_process(f, cb, ctx);
+    }
+}
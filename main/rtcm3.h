@@ -0,0 +1,56 @@
+#ifndef RTCM3_H
+#define RTCM3_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// RTCM3 transport layer: D3 | 6 reserved bits + 10 bit length | payload | CRC-24Q
+#define RTCM3_PREAMBLE     0xD3
+#define RTCM3_HEADER_LEN   3
+#define RTCM3_CRC_LEN      3
+#define RTCM3_MAX_PAYLOAD  1023
+#define RTCM3_MAX_FRAME    (RTCM3_HEADER_LEN + RTCM3_MAX_PAYLOAD + RTCM3_CRC_LEN)
+
+// Called once for every complete, CRC-valid frame (header + payload + CRC)
+typedef void (*rtcm3_frame_cb_t)(const uint8_t *frame, size_t len, void *ctx);
+
+typedef struct {
+    uint8_t buf[RTCM3_MAX_FRAME];
+    size_t pos;            // bytes currently held in buf
+    uint32_t frames;       // valid frames emitted
+    uint32_t crc_errors;   // frames rejected on CRC
+    uint32_t skipped;      // bytes discarded while hunting for a preamble
+} rtcm3_framer_t;
+
+// CRC-24Q as used by RTCM3 (poly 0x1864CFB, init 0)
+uint32_t rtcm3_crc24q(const uint8_t *data, size_t len);
+// Reset framer state and counters
+void rtcm3_framer_init(rtcm3_framer_t *f);
+// Feed raw UART bytes; cb fires for each valid frame found
+void rtcm3_framer_feed(rtcm3_framer_t *f, const uint8_t *data, size_t len, rtcm3_frame_cb_t cb, void *ctx);
+// Payload length of a frame from its 3 byte header
+size_t rtcm3_payload_len(const uint8_t *frame);
+// 1 if data holds exactly one frame: preamble, length matching len and a good CRC
+int rtcm3_frame_valid(const uint8_t *data, size_t len);
+// 12 bit message number of a frame (0 if payload is empty)
+uint16_t rtcm3_msg_type(const uint8_t *frame, size_t len);
+// Reference station antenna position from a 1005/1006 frame
+typedef struct {
+    uint16_t station_id;
+    int64_t x;             // ECEF, 0.1 mm
+    int64_t y;
+    int64_t z;
+} rtcm3_arp_t;
+
+// 0 on success, -1 if the frame is not a complete 1005/1006
+int rtcm3_parse_arp(const uint8_t *frame, size_t len, rtcm3_arp_t *arp);
+// Write preamble, length and CRC around a payload already placed at frame + 3.
+// Returns the total frame length
+size_t rtcm3_finish_frame(uint8_t *frame, size_t payload_len);
+
+// Big-endian bit field access (pos counted in bits from buf[0] MSB, len <= 32)
+uint32_t rtcm3_get_bits(const uint8_t *buf, size_t pos, int len);
+int32_t rtcm3_get_bits_signed(const uint8_t *buf, size_t pos, int len);
+void rtcm3_set_bits(uint8_t *buf, size_t pos, int len, uint32_t value);
+
+#endif // RTCM3_H
@@ -0,0 +1,653 @@
+#include "rtcm_delta.h"
+#include <string.h>
+
+#define EPOCH_MASK    0x3FFFFFFFu
+#define GLO_TOD_MASK  0x07FFFFFFu   // GLONASS epoch: 3 bit day of week, 27 bit time of day
+#define DAY_MS        86400000
+#define WEEK_MS       604800000
+#define MAX_DT_MS     30000         // longer steps are coded without prediction
+#define EPOCH_K       10            // Exp-Golomb order of the epoch step
+#define COMMON_K      8             // ... of a field's common offset
+#define MAX_ZEROS     48            // longest Exp-Golomb prefix accepted
+// 0.0001 m/s * ms -> 2^-31 ms: (x * RANGE_Q32) >> 32, RANGE_Q32 = 2^63 / c[1e-7 m/ms]
+#define RANGE_Q32     3076586
+
+enum { SAT_MS, SAT_EXT, SAT_MOD, SAT_RATE };
+enum { CELL_PR, CELL_PH, CELL_LOCK, CELL_HALF, CELL_CNR, CELL_RATE };
+
+// Field widths by MSM level, in payload order. Satellite: DF397, extended
+// info, DF398, DF399. Signal: DF400/405, DF401/406, DF402/407, DF420,
+// DF403/408, DF404
+static const uint8_t sat_bits[8][4] = {
+    [1] = { 0, 0, 10, 0 }, [2] = { 0, 0, 10, 0 }, [3] = { 0, 0, 10, 0 }, [4] = { 8, 0, 10, 0 },
+    [5] = { 8, 4, 10, 14 }, [6] = { 8, 0, 10, 0 }, [7] = { 8, 4, 10, 14 },
+};
+static const uint8_t cell_bits[8][6] = {
+    [1] = { 15, 0, 0, 0, 0, 0 },   [2] = { 0, 22, 4, 1, 0, 0 },   [3] = { 15, 22, 4, 1, 0, 0 },
+    [4] = { 15, 22, 4, 1, 6, 0 },  [5] = { 15, 22, 4, 1, 6, 15 }, [6] = { 20, 24, 10, 1, 10, 0 },
+    [7] = { 20, 24, 10, 1, 10, 15 },
+};
+static const uint8_t sat_signed[4] = { 0, 0, 0, 1 };
+static const uint8_t cell_signed[6] = { 1, 1, 0, 0, 0, 1 };
+
+// Bit stream being written (out set, buffer cleared) or read
+typedef struct {
+    uint8_t *out;
+    const uint8_t *in;
+    size_t pos;
+    size_t end;
+    int err;
+} coder_t;
+
+static int bitlen64(uint64_t v) {
+    return v ? 64 - __builtin_clzll(v) : 0;
+}
+
+// Big-endian bit access, byte at a time (n <= 32)
+static uint32_t bits_get(const uint8_t *buf, size_t pos, int n) {
+    if (n == 0) return 0;
+    size_t last = (pos + n - 1) >> 3;
+    uint64_t acc = 0;
+    for (size_t i = pos >> 3; i <= last; i++) acc = (acc << 8) | buf[i];
+    return (uint32_t)((acc >> (7 - ((pos + n - 1) & 7))) & ((1ull << n) - 1));
+}
+
+// Into a cleared buffer
+static void bits_put(uint8_t *buf, size_t pos, int n, uint32_t v) {
+    while (n > 0) {
+        int off = (int)(pos & 7);
+        int take = 8 - off < n ? 8 - off : n;
+        uint32_t chunk = (v >> (n - take)) & ((1u << take) - 1);
+        buf[pos >> 3] |= (uint8_t)(chunk << (8 - off - take));
+        pos += take;
+        n -= take;
+    }
+}
+
+static int32_t sign_extend(uint32_t v, int width) {
+    uint32_t sign = 1u << (width - 1);
+    return (int32_t)((v ^ sign) - sign);
+}
+
+static void put(coder_t *c, int n, uint32_t v) {
+    if (c->pos + n > c->end) {
+        c->err = 1;
+        return;
+    }
+    bits_put(c->out, c->pos, n, v);
+    c->pos += n;
+}
+
+static uint32_t get(coder_t *c, int n) {
+    if (c->pos + n > c->end) {
+        c->err = 1;
+        return 0;
+    }
+    uint32_t v = bits_get(c->in, c->pos, n);
+    c->pos += n;
+    return v;
+}
+
+static uint64_t zigzag(int64_t v) {
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static int64_t unzigzag(uint64_t u) {
+    return (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+}
+
+// Exp-Golomb of order k: prefix zeros, (u >> k) + 1, then the low k bits
+static void put_eg(coder_t *c, uint64_t u, int k) {
+    uint64_t q = (u >> k) + 1;
+    int nb = bitlen64(q);
+    if (c->pos + nb - 1 > c->end) {
+        c->err = 1;
+        return;
+    }
+    c->pos += nb - 1;
+    if (nb > 32) put(c, nb - 32, (uint32_t)(q >> 32));
+    put(c, nb > 32 ? 32 : nb, (uint32_t)q);
+    put(c, k, (uint32_t)(u & ((1ull << k) - 1)));
+}
+
+static uint64_t get_eg(coder_t *c, int k) {
+    int zeros = 0;
+    while (!c->err && get(c, 1) == 0) {
+        if (++zeros > MAX_ZEROS) c->err = 1;
+    }
+    uint64_t q = 1;
+    if (zeros > 32) {
+        q = (q << (zeros - 32)) | get(c, zeros - 32);
+        zeros = 32;
+    }
+    q = (q << zeros) | get(c, zeros);
+    return ((q - 1) << k) | get(c, k);
+}
+
+static uint64_t eg_cost(const uint64_t *u, size_t n, int k) {
+    uint64_t bits = 0;
+    for (size_t i = 0; i < n; i++) bits += 2 * bitlen64((u[i] >> k) + 1) - 1 + k;
+    return bits;
+}
+
+// Order with the fewest bits, searched from the one the mean suggests
+static int best_k(const uint64_t *u, size_t n) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < n; i++) sum += u[i];
+    int k = bitlen64(sum / n);
+    k = k > 0 ? k - 1 : 0;
+    if (k > 31) k = 31;
+    uint64_t best = eg_cost(u, n, k);
+    int start = k;
+    while (k > 0) {
+        uint64_t cost = eg_cost(u, n, k - 1);
+        if (cost >= best) break;
+        best = cost;
+        k--;
+    }
+    while (k == start && k < 31) {
+        uint64_t cost = eg_cost(u, n, k + 1);
+        if (cost >= best) break;
+        best = cost;
+        start = ++k;
+    }
+    return k;
+}
+
+// One field of n values against d->pred. With common set, cells flagged in
+// d->hist share an offset (the median residual) sent once: receiver clock
+// changes move every pseudorange and phase together
+static void code_field(rtcm_delta_t *d, coder_t *c, int32_t *vals, size_t n, int width, int is_signed, int common) {
+    if (!c || n == 0) return;
+    size_t nh = 0;
+    for (size_t i = 0; common && i < n; i++) nh += d->hist[i];
+    int64_t offset = 0;
+
+    if (c->out) {
+        if (nh) {
+            int64_t sorted[RTCM_MSM_MAX_CELLS];
+            size_t m = 0;
+            for (size_t i = 0; i < n; i++) {
+                if (!d->hist[i]) continue;
+                int64_t r = vals[i] - d->pred[i];
+                size_t j = m++;
+                for (; j > 0 && sorted[j - 1] > r; j--) sorted[j] = sorted[j - 1];
+                sorted[j] = r;
+            }
+            offset = sorted[m / 2];
+            put_eg(c, zigzag(offset), COMMON_K);
+        }
+        for (size_t i = 0; i < n; i++) {
+            int64_t r = vals[i] - d->pred[i] - (common && d->hist[i] ? offset : 0);
+            d->code[i] = zigzag(r);
+        }
+        int k = best_k(d->code, n);
+        put(c, 5, (uint32_t)k);
+        for (size_t i = 0; i < n; i++) put_eg(c, d->code[i], k);
+        return;
+    }
+
+    if (nh) offset = unzigzag(get_eg(c, COMMON_K));
+    int k = (int)get(c, 5);
+    int64_t lo = is_signed ? -(1ll << (width - 1)) : 0;
+    int64_t hi = is_signed ? (1ll << (width - 1)) - 1 : (1ll << width) - 1;
+    for (size_t i = 0; i < n && !c->err; i++) {
+        uint64_t v = (uint64_t)d->pred[i] + (uint64_t)unzigzag(get_eg(c, k));
+        if (common && d->hist[i]) v += (uint64_t)offset;
+        if ((int64_t)v < lo || (int64_t)v > hi) c->err = 1;
+        vals[i] = (int32_t)v;
+    }
+}
+
+static int32_t epoch_step(int gnss, uint32_t from, uint32_t to) {
+    int64_t dt, period;
+    if (gnss == RTCM_GNSS_GLONASS) {
+        dt = (int64_t)(to & GLO_TOD_MASK) - (from & GLO_TOD_MASK);
+        period = DAY_MS;
+    } else {
+        dt = (int64_t)to - from;
+        period = WEEK_MS;
+    }
+    if (dt < 0) dt += period;
+    return dt > 0 && dt <= MAX_DT_MS ? (int32_t)dt : 0;
+}
+
+static size_t msm_bits(const rtcm_msm_header_t *h, int level) {
+    size_t sat = 0, cell = 0;
+    for (int f = 0; f < 4; f++) sat += sat_bits[level][f];
+    for (int f = 0; f < 6; f++) cell += cell_bits[level][f];
+    return h->header_bits + h->nsat * sat + h->ncell * cell;
+}
+
+static void index_cells(rtcm_delta_msm_t *m) {
+    uint8_t sig[32];
+    size_t nsig = 0, s = 0, c = 0, cell = 0;
+    for (int b = 0; b < 32; b++) {
+        if (m->h.sig_mask & (1u << (31 - b))) sig[nsig++] = (uint8_t)b;
+    }
+    for (int b = 0; b < 64; b++) {
+        if (!(m->h.sat_mask & (1ull << (63 - b)))) continue;
+        m->sat_prn[s] = (uint8_t)b;
+        for (size_t g = 0; g < nsig; g++, cell++) {
+            if (!(m->h.cell_mask & (1ull << (63 - cell)))) continue;
+            m->cell_sat[c] = (uint8_t)s;
+            m->cell_key[c] = (uint16_t)(b << 5 | sig[g]);
+            c++;
+        }
+        s++;
+    }
+}
+
+// Unpack an MSM frame. Fails for frames this codec would not rebuild
+// exactly (extra payload bytes, non-zero padding)
+static int msm_read(rtcm_delta_msm_t *m, const uint8_t *frame, size_t len) {
+    const uint8_t *p = frame + RTCM3_HEADER_LEN;
+    size_t plen = rtcm3_payload_len(frame);
+    if (len != RTCM3_HEADER_LEN + plen + RTCM3_CRC_LEN || rtcm_msm_parse_header(p, plen, &m->h) != 0) return -1;
+    int level = rtcm_msm_level(m->h.type);
+    size_t bits = msm_bits(&m->h, level);
+    if (plen != (bits + 7) / 8 || ((bits & 7) && (p[plen - 1] & (0xFF >> (bits & 7))))) return -1;
+
+    m->misc = bits_get(p, 54, 19);
+    index_cells(m);
+    size_t pos = m->h.header_bits;
+    for (int f = 0; f < 4; f++) {
+        int w = sat_bits[level][f];
+        for (size_t i = 0; w && i < m->h.nsat; i++, pos += w) {
+            uint32_t v = bits_get(p, pos, w);
+            m->sat[f][i] = sat_signed[f] ? sign_extend(v, w) : (int32_t)v;
+        }
+    }
+    for (int f = 0; f < 6; f++) {
+        int w = cell_bits[level][f];
+        for (size_t i = 0; w && i < m->h.ncell; i++, pos += w) {
+            uint32_t v = bits_get(p, pos, w);
+            m->cell[f][i] = cell_signed[f] ? sign_extend(v, w) : (int32_t)v;
+        }
+    }
+    return 0;
+}
+
+static size_t msm_write(const rtcm_delta_msm_t *m, uint8_t *out) {
+    int level = rtcm_msm_level(m->h.type);
+    size_t bits = msm_bits(&m->h, level);
+    size_t plen = (bits + 7) / 8;
+    if (plen > RTCM3_MAX_PAYLOAD) return 0;
+    uint8_t *p = out + RTCM3_HEADER_LEN;
+    memset(p, 0, plen);
+
+    bits_put(p, 0, 12, m->h.type);
+    bits_put(p, 12, 12, m->h.station_id);
+    bits_put(p, 24, 30, m->h.epoch);
+    bits_put(p, 54, 19, m->misc);
+    bits_put(p, 73, 32, (uint32_t)(m->h.sat_mask >> 32));
+    bits_put(p, 105, 32, (uint32_t)m->h.sat_mask);
+    bits_put(p, 137, 32, m->h.sig_mask);
+    size_t cells = m->h.header_bits - 169;
+    for (size_t pos = 0; pos < cells; pos += 32) {
+        int n = cells - pos < 32 ? (int)(cells - pos) : 32;
+        bits_put(p, 169 + pos, n, (uint32_t)((m->h.cell_mask << pos) >> (64 - n)));
+    }
+    size_t pos = m->h.header_bits;
+    for (int f = 0; f < 4; f++) {
+        int w = sat_bits[level][f];
+        for (size_t i = 0; w && i < m->h.nsat; i++, pos += w) {
+            bits_put(p, pos, w, (uint32_t)m->sat[f][i] & ((1u << w) - 1));
+        }
+    }
+    for (int f = 0; f < 6; f++) {
+        int w = cell_bits[level][f];
+        for (size_t i = 0; w && i < m->h.ncell; i++, pos += w) {
+            bits_put(p, pos, w, (uint32_t)m->cell[f][i] & ((1u << w) - 1));
+        }
+    }
+    return rtcm3_finish_frame(out, plen);
+}
+
+static rtcm_delta_ref_t *find_ref(rtcm_delta_t *d, uint16_t type, int create) {
+    rtcm_delta_ref_t *victim = &d->refs[0];
+    for (size_t i = 0; i < RTCM_DELTA_STREAMS; i++) {
+        rtcm_delta_ref_t *r = &d->refs[i];
+        if (r->type == type) {
+            r->used = ++d->clock;
+            return r;
+        }
+        if (victim->type != 0 && (r->type == 0 || r->used < victim->used)) victim = r;
+    }
+    if (!create) return NULL;
+    memset(victim, 0, sizeof(*victim));
+    victim->type = type;
+    victim->used = ++d->clock;
+    return victim;
+}
+
+static void drop_ref(rtcm_delta_t *d, uint16_t type) {
+    rtcm_delta_ref_t *r = find_ref(d, type, 0);
+    if (r) r->type = 0;
+}
+
+static int sat_known(const rtcm_delta_ref_t *ref, int32_t dt, uint8_t prn) {
+    return dt && ((ref->sat_mask >> (63 - prn)) & 1);
+}
+
+// Pseudorange or phase: predict the full range from the reference cell,
+// code the fine field against it less the rough range
+static void code_range(rtcm_delta_t *d, const rtcm_delta_ref_t *ref, coder_t *c, int field, int width, int frac,
+                       int32_t dt, int has_rate) {
+    rtcm_delta_msm_t *m = &d->msm;
+    int sh = frac - 10, unit = 31 - frac;
+    size_t nc = m->h.ncell;
+    for (size_t j = 0; j < nc; j++) {
+        const rtcm_delta_cell_t *p = d->prev[j] >= 0 ? &ref->cells[d->prev[j]] : NULL;
+        d->hist[j] = p != NULL;
+        if (!p) {
+            d->pred[j] = 0;
+            continue;
+        }
+        int64_t full = field == CELL_PR ? p->pr : p->ph;
+        int64_t change = field == CELL_PR ? p->pr_d : p->ph_d;
+        if (has_rate) {
+            // Mean of the two epochs' range rates over the step
+            int64_t moved = ((int64_t)p->rate + d->rate[j]) / 2 * dt;
+            full += (moved * RANGE_Q32) >> 32 >> unit;
+        } else if (p->depth >= 2 && ref->dt_ms) {
+            full += change * dt / ref->dt_ms;
+        }
+        d->pred[j] = full - ((int64_t)d->range[m->cell_sat[j]] << sh);
+    }
+    code_field(d, c, m->cell[field], nc, width, 1, 1);
+    for (size_t j = 0; j < nc; j++) {
+        const rtcm_delta_cell_t *p = d->prev[j] >= 0 ? &ref->cells[d->prev[j]] : NULL;
+        int64_t full = ((int64_t)d->range[m->cell_sat[j]] << sh) + m->cell[field][j];
+        if (field == CELL_PR) {
+            d->next[j].pr = full;
+            d->next[j].pr_d = p ? full - p->pr : 0;
+        } else {
+            d->next[j].ph = full;
+            d->next[j].ph_d = p ? full - p->ph : 0;
+        }
+    }
+}
+
+// The model shared by encoder and decoder. With a coder it writes or reads
+// the satellite and cell fields of d->msm against predictions from ref;
+// without one (key frames) it only derives the next reference state. Returns
+// the epoch step used for prediction, 0 if none
+static int32_t code_body(rtcm_delta_t *d, const rtcm_delta_ref_t *ref, coder_t *c, int predict) {
+    rtcm_delta_msm_t *m = &d->msm;
+    int level = rtcm_msm_level(m->h.type);
+    const uint8_t *sb = sat_bits[level], *cb = cell_bits[level];
+    size_t ns = m->h.nsat, nc = m->h.ncell;
+    int decoding = c && !c->out;
+    int32_t dt = predict ? epoch_step(rtcm_msm_gnss(m->h.type), ref->epoch, m->h.epoch) : 0;
+
+    // Satellites: rough range (DF397 and DF398 as one value), extended info, rough rate
+    for (size_t i = 0; i < ns; i++) {
+        d->pred[i] = sat_known(ref, dt, m->sat_prn[i]) ? ref->sat_range[m->sat_prn[i]] : 0;
+        if (!decoding) d->range[i] = (sb[SAT_MS] ? m->sat[SAT_MS][i] << 10 : 0) | m->sat[SAT_MOD][i];
+    }
+    code_field(d, c, d->range, ns, sb[SAT_MS] + sb[SAT_MOD], 0, 0);
+    if (decoding) {
+        for (size_t i = 0; i < ns; i++) {
+            m->sat[SAT_MS][i] = sb[SAT_MS] ? d->range[i] >> 10 : 0;
+            m->sat[SAT_MOD][i] = d->range[i] & 0x3FF;
+        }
+    }
+    if (sb[SAT_EXT]) {
+        for (size_t i = 0; i < ns; i++) {
+            d->pred[i] = sat_known(ref, dt, m->sat_prn[i]) ? ref->sat_ext[m->sat_prn[i]] : 0;
+        }
+        code_field(d, c, m->sat[SAT_EXT], ns, sb[SAT_EXT], 0, 0);
+    }
+    if (sb[SAT_RATE]) {
+        for (size_t i = 0; i < ns; i++) {
+            d->pred[i] = sat_known(ref, dt, m->sat_prn[i]) ? ref->sat_rate[m->sat_prn[i]] : 0;
+        }
+        code_field(d, c, m->sat[SAT_RATE], ns, sb[SAT_RATE], 1, 0);
+    }
+
+    // Cells: match the reference cells by key, both are in mask order
+    size_t k = 0;
+    for (size_t j = 0; j < nc; j++) {
+        d->prev[j] = -1;
+        if (!dt) continue;
+        while (k < ref->ncell && ref->cells[k].key < m->cell_key[j]) k++;
+        if (k < ref->ncell && ref->cells[k].key == m->cell_key[j]) d->prev[j] = (int16_t)k;
+    }
+    memset(d->next, 0, nc * sizeof(d->next[0]));
+
+    int has_rate = cb[CELL_RATE] != 0;
+    if (has_rate) {
+        for (size_t j = 0; j < nc; j++) {
+            const rtcm_delta_cell_t *p = d->prev[j] >= 0 ? &ref->cells[d->prev[j]] : NULL;
+            int64_t rough = (int64_t)m->sat[SAT_RATE][m->cell_sat[j]] * 10000;
+            if (!p) {
+                d->pred[j] = 0;
+                continue;
+            }
+            int64_t full = p->rate;
+            if (p->depth >= 2 && ref->dt_ms) full += (int64_t)p->rate_d * dt / ref->dt_ms;
+            d->pred[j] = full - rough;
+        }
+        code_field(d, c, m->cell[CELL_RATE], nc, cb[CELL_RATE], 1, 0);
+        for (size_t j = 0; j < nc; j++) {
+            d->rate[j] = m->sat[SAT_RATE][m->cell_sat[j]] * 10000 + m->cell[CELL_RATE][j];
+        }
+    }
+    if (cb[CELL_PR]) code_range(d, ref, c, CELL_PR, cb[CELL_PR], level >= 6 ? 29 : 24, dt, has_rate);
+    if (cb[CELL_PH]) code_range(d, ref, c, CELL_PH, cb[CELL_PH], level >= 6 ? 31 : 29, dt, has_rate);
+    static const uint8_t tail[3] = { CELL_LOCK, CELL_HALF, CELL_CNR };
+    for (int t = 0; t < 3; t++) {
+        int f = tail[t];
+        if (!cb[f]) continue;
+        for (size_t j = 0; j < nc; j++) {
+            const rtcm_delta_cell_t *p = d->prev[j] >= 0 ? &ref->cells[d->prev[j]] : NULL;
+            d->pred[j] = !p ? 0 : f == CELL_LOCK ? p->lock : f == CELL_HALF ? p->half : p->cnr;
+        }
+        code_field(d, c, m->cell[f], nc, cb[f], 0, 0);
+    }
+
+    for (size_t j = 0; j < nc; j++) {
+        const rtcm_delta_cell_t *p = d->prev[j] >= 0 ? &ref->cells[d->prev[j]] : NULL;
+        rtcm_delta_cell_t *n = &d->next[j];
+        n->key = m->cell_key[j];
+        n->depth = p ? (p->depth < 2 ? p->depth + 1 : 2) : 1;
+        n->lock = cb[CELL_LOCK] ? (uint16_t)m->cell[CELL_LOCK][j] : 0;
+        n->half = cb[CELL_HALF] ? (uint8_t)m->cell[CELL_HALF][j] : 0;
+        n->cnr = cb[CELL_CNR] ? (uint16_t)m->cell[CELL_CNR][j] : 0;
+        n->rate = has_rate ? d->rate[j] : 0;
+        n->rate_d = p ? n->rate - p->rate : 0;
+    }
+    return dt;
+}
+
+static void commit_ref(rtcm_delta_t *d, rtcm_delta_ref_t *ref, int32_t dt) {
+    const rtcm_delta_msm_t *m = &d->msm;
+    int level = rtcm_msm_level(m->h.type);
+    ref->station = m->h.station_id;
+    ref->epoch = m->h.epoch;
+    ref->dt_ms = dt;
+    ref->misc = m->misc;
+    ref->sat_mask = m->h.sat_mask;
+    ref->sig_mask = m->h.sig_mask;
+    ref->cell_mask = m->h.cell_mask;
+    for (size_t i = 0; i < m->h.nsat; i++) {
+        uint8_t prn = m->sat_prn[i];
+        ref->sat_range[prn] = d->range[i];
+        ref->sat_ext[prn] = sat_bits[level][SAT_EXT] ? (uint8_t)m->sat[SAT_EXT][i] : 0;
+        ref->sat_rate[prn] = sat_bits[level][SAT_RATE] ? (int16_t)m->sat[SAT_RATE][i] : 0;
+    }
+    ref->ncell = m->h.ncell;
+    memcpy(ref->cells, d->next, m->h.ncell * sizeof(d->next[0]));
+}
+
+// A frame sent unchanged: both sides restart the chain from it
+static void key_frame(rtcm_delta_t *d, uint16_t type) {
+    rtcm_delta_ref_t *ref = find_ref(d, type, 1);
+    code_body(d, ref, NULL, 0);
+    commit_ref(d, ref, 0);
+    ref->since_key = 0;
+    d->keys++;
+}
+
+static void put_cell_mask(coder_t *c, uint64_t mask, size_t cells) {
+    for (size_t pos = 0; pos < cells; pos += 32) {
+        int n = cells - pos < 32 ? (int)(cells - pos) : 32;
+        put(c, n, (uint32_t)((mask << pos) >> (64 - n)));
+    }
+}
+
+// Delta frame into out, 0 unless it is shorter than the original
+static size_t encode_delta(rtcm_delta_t *d, rtcm_delta_ref_t *ref, uint8_t *out, size_t raw_len) {
+    const rtcm_delta_msm_t *m = &d->msm;
+    size_t max_payload = raw_len - RTCM3_HEADER_LEN - RTCM3_CRC_LEN - 1;
+    coder_t c = { .out = out + RTCM3_HEADER_LEN, .end = max_payload * 8 };
+    memset(c.out, 0, max_payload);
+
+    put(&c, 12, RTCM_DELTA_MSG_TYPE);
+    put(&c, 12, m->h.type);
+    put(&c, 30, ref->epoch);
+    put_eg(&c, (m->h.epoch - ref->epoch) & EPOCH_MASK, EPOCH_K);
+    int same = m->h.station_id == ref->station;
+    put(&c, 1, same);
+    if (!same) put(&c, 12, m->h.station_id);
+    same = m->misc == ref->misc;
+    put(&c, 1, same);
+    if (!same) put(&c, 19, m->misc);
+    same = m->h.sat_mask == ref->sat_mask && m->h.sig_mask == ref->sig_mask && m->h.cell_mask == ref->cell_mask;
+    put(&c, 1, same);
+    if (!same) {
+        put(&c, 32, (uint32_t)(m->h.sat_mask >> 32));
+        put(&c, 32, (uint32_t)m->h.sat_mask);
+        put(&c, 32, m->h.sig_mask);
+        put_cell_mask(&c, m->h.cell_mask, m->h.header_bits - 169);
+    }
+    int32_t dt = code_body(d, ref, &c, 1);
+    if (c.err) return 0;
+    commit_ref(d, ref, dt);
+    return rtcm3_finish_frame(out, (c.pos + 7) / 8);
+}
+
+static size_t decode_delta(rtcm_delta_t *d, const uint8_t *frame, size_t len, uint8_t *out) {
+    rtcm_delta_msm_t *m = &d->msm;
+    size_t plen = rtcm3_payload_len(frame);
+    coder_t c = { .in = frame + RTCM3_HEADER_LEN, .end = plen * 8 };
+    if (len != RTCM3_HEADER_LEN + plen + RTCM3_CRC_LEN) {
+        d->errors++;
+        return 0;
+    }
+    get(&c, 12);
+    uint16_t type = (uint16_t)get(&c, 12);
+    uint32_t ref_epoch = get(&c, 30);
+    uint64_t step = get_eg(&c, EPOCH_K);
+    if (c.err || rtcm_msm_level(type) == 0 || step > EPOCH_MASK) {
+        d->errors++;
+        return 0;
+    }
+    rtcm_delta_ref_t *ref = find_ref(d, type, 0);
+    if (!ref || ref->epoch != ref_epoch) {
+        d->missing_ref++;
+        return 0;
+    }
+
+    memset(&m->h, 0, sizeof(m->h));
+    m->h.type = type;
+    m->h.epoch = (uint32_t)(ref_epoch + step) & EPOCH_MASK;
+    m->h.station_id = get(&c, 1) ? ref->station : (uint16_t)get(&c, 12);
+    m->misc = get(&c, 1) ? ref->misc : get(&c, 19);
+    m->h.multiple = (uint8_t)(m->misc >> 18);
+    size_t cells;
+    if (get(&c, 1)) {
+        m->h.sat_mask = ref->sat_mask;
+        m->h.sig_mask = ref->sig_mask;
+        m->h.cell_mask = ref->cell_mask;
+        cells = (size_t)__builtin_popcountll(ref->sat_mask) * (size_t)__builtin_popcount(ref->sig_mask);
+    } else {
+        m->h.sat_mask = (uint64_t)get(&c, 32) << 32;
+        m->h.sat_mask |= get(&c, 32);
+        m->h.sig_mask = get(&c, 32);
+        cells = (size_t)__builtin_popcountll(m->h.sat_mask) * (size_t)__builtin_popcount(m->h.sig_mask);
+        if (cells > RTCM_MSM_MAX_CELLS) {
+            d->errors++;
+            return 0;
+        }
+        for (size_t pos = 0; pos < cells; pos += 32) {
+            int n = cells - pos < 32 ? (int)(cells - pos) : 32;
+            m->h.cell_mask |= (uint64_t)get(&c, n) << (64 - n - pos);
+        }
+    }
+    m->h.nsat = (uint8_t)__builtin_popcountll(m->h.sat_mask);
+    m->h.nsig = (uint8_t)__builtin_popcount(m->h.sig_mask);
+    m->h.ncell = (uint8_t)__builtin_popcountll(m->h.cell_mask);
+    m->h.header_bits = 169 + cells;
+    index_cells(m);
+
+    int32_t dt = code_body(d, ref, &c, 1);
+    size_t n = c.err ? 0 : msm_write(m, out);
+    if (n == 0) {
+        d->errors++;
+        return 0;
+    }
+    commit_ref(d, ref, dt);
+    return n;
+}
+
+void rtcm_delta_init(rtcm_delta_t *d, int key_interval) {
+    memset(d, 0, sizeof(*d));
+    if (key_interval <= 0) key_interval = RTCM_DELTA_KEY_INTERVAL;
+    d->key_interval = (uint8_t)(key_interval > 255 ? 255 : key_interval);
+}
+
+size_t rtcm_delta_encode(rtcm_delta_t *d, const uint8_t *frame, size_t len, uint8_t *out, const uint8_t **result) {
+    d->frames++;
+    d->bytes_in += len;
+    *result = frame;
+    uint16_t type = rtcm3_msg_type(frame, len);
+    if (rtcm_msm_level(type) == 0) {
+        d->bytes_out += len;
+        return len;
+    }
+    if (msm_read(&d->msm, frame, len) != 0) {
+        // Not rebuildable bit for bit: send as is, nothing to chain from
+        drop_ref(d, type);
+        d->bytes_out += len;
+        return len;
+    }
+    rtcm_delta_ref_t *ref = find_ref(d, type, 0);
+    if (ref && ref->since_key + 1 < d->key_interval) {
+        size_t n = encode_delta(d, ref, out, len);
+        if (n) {
+            ref->since_key++;
+            d->coded++;
+            d->bytes_out += n;
+            *result = out;
+            return n;
+        }
+    }
+    key_frame(d, type);
+    d->bytes_out += len;
+    return len;
+}
+
+size_t rtcm_delta_decode(rtcm_delta_t *d, const uint8_t *frame, size_t len, uint8_t *out, const uint8_t **result) {
+    d->frames++;
+    d->bytes_in += len;
+    *result = frame;
+    uint16_t type = rtcm3_msg_type(frame, len);
+    if (type != RTCM_DELTA_MSG_TYPE) {
+        // Unchanged MSM frames are the key frames the base chains from
+        if (rtcm_msm_level(type) != 0) {
+            if (msm_read(&d->msm, frame, len) == 0) key_frame(d, type);
+            else drop_ref(d, type);
+        }
+        d->bytes_out += len;
+        return len;
+    }
+    size_t n = decode_delta(d, frame, len, out);
+    *result = n ? out : NULL;
+    if (n) {
+        d->coded++;
+        d->bytes_out += n;
+    }
+    return n;
+}
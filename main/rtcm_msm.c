@@ -0,0 +1,124 @@
+#include "rtcm_msm.h"
+#include "rtcm3.h"
+#include <string.h>
+
+#define MSM_TYPE_FIRST 1071
+#define MSM_TYPE_LAST  1137
+
+int rtcm_msm_gnss(uint16_t type) {
+    if (type < MSM_TYPE_FIRST || type > MSM_TYPE_LAST) return -1;
+    int level = type % 10;
+    if (level < 1 || level > 7) return -1;
+    return (type - 1070) / 10;
+}
+
+int rtcm_msm_level(uint16_t type) {
+    return rtcm_msm_gnss(type) < 0 ? 0 : type % 10;
+}
+
+static int popcount64(uint64_t v) {
+    int n = 0;
+    while (v) {
+        v &= v - 1;
+        n++;
+    }
+    return n;
+}
+
+int rtcm_msm_parse_header(const uint8_t *payload, size_t len, rtcm_msm_header_t *h) {
+    // Fixed part of the header is 169 bits
+    if (len * 8 < 169) return -1;
+    memset(h, 0, sizeof(*h));
+    h->type = (uint16_t)rtcm3_get_bits(payload, 0, 12);
+    if (rtcm_msm_level(h->type) == 0) return -1;
+    h->station_id = (uint16_t)rtcm3_get_bits(payload, 12, 12);
+    h->epoch = rtcm3_get_bits(payload, 24, 30);
+    h->multiple = (uint8_t)rtcm3_get_bits(payload, 54, 1);
+    h->sat_mask = ((uint64_t)rtcm3_get_bits(payload, 73, 32) << 32) | rtcm3_get_bits(payload, 105, 32);
+    h->sig_mask = rtcm3_get_bits(payload, 137, 32);
+    h->nsat = (uint8_t)popcount64(h->sat_mask);
+    h->nsig = (uint8_t)popcount64(h->sig_mask);
+
+    int cells = h->nsat * h->nsig;
+    if (cells > RTCM_MSM_MAX_CELLS || len * 8 < 169 + (size_t)cells) return -1;
+    for (int i = 0; i < cells; i++) {
+        h->cell_mask = (h->cell_mask << 1) | rtcm3_get_bits(payload, 169 + i, 1);
+    }
+    if (cells) h->cell_mask <<= (64 - cells);
+    h->ncell = (uint8_t)popcount64(h->cell_mask);
+    h->header_bits = 169 + cells;
+    return 0;
+}
+
+// DF407 (10 bit, ms with growing step) -> DF402 (4 bit, power of two ms)
+static uint32_t lock_ext_to_lock(uint32_t ext) {
+    uint32_t k = ext < 64 ? 0 : ext / 32 - 1;
+    uint64_t ms = (uint64_t)(ext - 32 * k) << k;
+    if (ms < 32) return 0;
+    uint32_t i = 0;
+    while ((ms >> (i + 5)) > 1 && i < 14) i++;
+    return i + 1;
+}
+
+static int32_t clamp(int32_t v, int32_t limit) {
+    if (v > limit) return limit;
+    if (v < -limit) return -limit;
+    return v;
+}
+
+size_t rtcm_msm7_to_msm4(const uint8_t *frame, size_t len, uint8_t *out, size_t out_max) {
+    if (len < RTCM3_HEADER_LEN + RTCM3_CRC_LEN) return 0;
+    const uint8_t *in = frame + RTCM3_HEADER_LEN;
+    size_t in_len = rtcm3_payload_len(frame);
+
+    rtcm_msm_header_t h;
+    if (rtcm_msm_parse_header(in, in_len, &h) != 0 || rtcm_msm_level(h.type) != 7) return 0;
+
+    size_t ns = h.nsat, nc = h.ncell;
+    size_t in_bits = h.header_bits + ns * 36 + nc * 80;
+    size_t out_bits = h.header_bits + ns * 18 + nc * 48;
+    size_t out_payload = (out_bits + 7) / 8;
+    if (in_len * 8 < in_bits || out_max < RTCM3_HEADER_LEN + out_payload + RTCM3_CRC_LEN) return 0;
+
+    uint8_t *o = out + RTCM3_HEADER_LEN;
+    memset(o, 0, out_payload);
+
+    // Header is identical apart from the message number
+    for (size_t pos = 0; pos < h.header_bits; pos += 32) {
+        int n = h.header_bits - pos < 32 ? (int)(h.header_bits - pos) : 32;
+        rtcm3_set_bits(o, pos, n, rtcm3_get_bits(in, pos, n));
+    }
+    rtcm3_set_bits(o, 0, 12, h.type - 3);
+
+    // Satellite data: keep DF397 rough range ms and DF398 rough range mod 1 ms
+    size_t ip = h.header_bits, op = h.header_bits;
+    for (size_t i = 0; i < ns; i++, op += 8) rtcm3_set_bits(o, op, 8, rtcm3_get_bits(in, ip + i * 8, 8));
+    ip += ns * 8 + ns * 4;  // skip extended satellite info
+    for (size_t i = 0; i < ns; i++, op += 10) rtcm3_set_bits(o, op, 10, rtcm3_get_bits(in, ip + i * 10, 10));
+    ip += ns * 10 + ns * 14; // skip rough phase range rates
+
+    // Signal data
+    size_t pr = ip, cp = pr + nc * 20, lock = cp + nc * 24, half = lock + nc * 10, cnr = half + nc;
+    for (size_t i = 0; i < nc; i++, op += 15) {
+        int32_t v = rtcm3_get_bits_signed(in, pr + i * 20, 20);
+        v = (v == -(1 << 19)) ? -(1 << 14) : clamp((v + 16) >> 5, (1 << 14) - 1);
+        rtcm3_set_bits(o, op, 15, (uint32_t)v);
+    }
+    for (size_t i = 0; i < nc; i++, op += 22) {
+        int32_t v = rtcm3_get_bits_signed(in, cp + i * 24, 24);
+        v = (v == -(1 << 23)) ? -(1 << 21) : clamp((v + 2) >> 2, (1 << 21) - 1);
+        rtcm3_set_bits(o, op, 22, (uint32_t)v);
+    }
+    for (size_t i = 0; i < nc; i++, op += 4) {
+        rtcm3_set_bits(o, op, 4, lock_ext_to_lock(rtcm3_get_bits(in, lock + i * 10, 10)));
+    }
+    for (size_t i = 0; i < nc; i++, op += 1) {
+        rtcm3_set_bits(o, op, 1, rtcm3_get_bits(in, half + i, 1));
+    }
+    for (size_t i = 0; i < nc; i++, op += 6) {
+        uint32_t v = (rtcm3_get_bits(in, cnr + i * 10, 10) + 8) >> 4;
+        rtcm3_set_bits(o, op, 6, v > 63 ? 63 : v);
+    }
+
+    return rtcm3_finish_frame(out, out_payload);
+}
@@ -0,0 +1,47 @@
+#ifndef RTCM_MSM_H
+#define RTCM_MSM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// RTCM3 Multiple Signal Messages (MSM1..MSM7): classification, header
+// decoding and lossy MSM7 -> MSM4 re-encoding.
+
+typedef enum {
+    RTCM_GNSS_GPS = 0,
+    RTCM_GNSS_GLONASS,
+    RTCM_GNSS_GALILEO,
+    RTCM_GNSS_SBAS,
+    RTCM_GNSS_QZSS,
+    RTCM_GNSS_BEIDOU,
+    RTCM_GNSS_NAVIC,
+    RTCM_GNSS_COUNT,
+} rtcm_gnss_t;
+
+#define RTCM_MSM_MAX_CELLS 64
+
+typedef struct {
+    uint16_t type;
+    uint16_t station_id;
+    uint32_t epoch;          // GNSS specific epoch time field (30 bits)
+    uint8_t  multiple;       // 1 = more MSMs follow for this epoch
+    uint8_t  nsat;
+    uint8_t  nsig;
+    uint8_t  ncell;
+    uint64_t sat_mask;
+    uint32_t sig_mask;
+    uint64_t cell_mask;      // nsat * nsig bits, first cell in the MSB
+    size_t   header_bits;    // bit offset of the satellite data
+} rtcm_msm_header_t;
+
+// Constellation of an MSM message type, -1 if the type is not an MSM
+int rtcm_msm_gnss(uint16_t type);
+// MSM level 1..7, 0 if the type is not an MSM
+int rtcm_msm_level(uint16_t type);
+// Decode an MSM header from a frame payload. Returns 0 on success
+int rtcm_msm_parse_header(const uint8_t *payload, size_t len, rtcm_msm_header_t *h);
+// Re-encode a complete MSM7 frame as MSM4 (drops extended info, Doppler and
+// the extra resolution). Returns the new frame length, 0 on failure
+size_t rtcm_msm7_to_msm4(const uint8_t *frame, size_t len, uint8_t *out, size_t out_max);
+
+#endif // RTCM_MSM_H
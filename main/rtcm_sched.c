@@ -0,0 +1,221 @@
+#include "rtcm_sched.h"
+#include <string.h>
+
+#define RTCM_TYPE_ARP        1005
+#define RTCM_TYPE_ARP_HEIGHT 1006
+#define RTCM_TYPE_GLO_BIAS   1230
+
+static uint8_t scratch[RTCM3_MAX_FRAME];
+
+void rtcm_sched_default_config(rtcm_sched_config_t *cfg) {
+    static const uint8_t default_priority[RTCM_GNSS_COUNT] = {
+        RTCM_GNSS_GPS, RTCM_GNSS_GALILEO, RTCM_GNSS_BEIDOU, RTCM_GNSS_GLONASS,
+        RTCM_GNSS_QZSS, RTCM_GNSS_SBAS, RTCM_GNSS_NAVIC,
+    };
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->budget_bps = RTCM_SCHED_BUDGET_BPS;
+    cfg->arp_interval = 10;
+    cfg->bias_interval = 10;
+    memcpy(cfg->priority, default_priority, sizeof(cfg->priority));
+    cfg->epoch_timeout_us = 200000;
+}
+
+void rtcm_sched_init(rtcm_sched_t *s, const rtcm_sched_config_t *cfg, rtcm3_frame_cb_t output, void *ctx) {
+    memset(s, 0, sizeof(*s));
+    if (cfg) s->cfg = *cfg;
+    else rtcm_sched_default_config(&s->cfg);
+    if (s->cfg.arp_interval == 0) s->cfg.arp_interval = 1;
+    if (s->cfg.bias_interval == 0) s->cfg.bias_interval = 1;
+    s->output = output;
+    s->ctx = ctx;
+    s->tokens = s->cfg.budget_bps;
+}
+
+void rtcm_sched_set_budget(rtcm_sched_t *s, int32_t budget_bps) {
+    s->cfg.budget_bps = budget_bps;
+    if (s->tokens > budget_bps) s->tokens = budget_bps;
+}
+
+static rtcm_sched_type_stats_t *type_stats(rtcm_sched_t *s, uint16_t type) {
+    for (size_t i = 0; i < s->type_count; i++) {
+        if (s->types[i].type == type) return &s->types[i];
+    }
+    if (s->type_count == RTCM_SCHED_MAX_TYPES) return NULL;
+    rtcm_sched_type_stats_t *t = &s->types[s->type_count++];
+    memset(t, 0, sizeof(*t));
+    t->type = type;
+    return t;
+}
+
+// Expected link bytes for a frame, from what frames of this type (or of the
+// type it was converted from) measured on the link so far
+static int64_t link_cost(rtcm_sched_t *s, uint16_t type, uint16_t from_type, size_t len) {
+    const rtcm_sched_type_stats_t *t = type_stats(s, type);
+    if (!t || !t->link_permille) t = type_stats(s, from_type);
+    uint32_t permille = t && t->link_permille ? t->link_permille : 1000;
+    return (int64_t)len * permille / 1000;
+}
+
+void rtcm_sched_set_link_len(rtcm_sched_t *s, size_t len) {
+    s->out_link_len = len;
+}
+
+// Station messages that only need to go out every few epochs. Counted from
+// the last one sent rather than epochs % interval: the receiver may already
+// decimate them to a rate that never lands on a multiple of the interval
+static int cadence_allows(rtcm_sched_t *s, uint16_t type) {
+    uint8_t interval;
+    if (type == RTCM_TYPE_ARP || type == RTCM_TYPE_ARP_HEIGHT) interval = s->cfg.arp_interval;
+    else if (type == RTCM_TYPE_GLO_BIAS) interval = s->cfg.bias_interval;
+    else return 1;
+    const rtcm_sched_type_stats_t *t = type_stats(s, type);
+    return !t || !t->frames || s->epochs - t->last_epoch >= interval;
+}
+
+static void release_epoch(rtcm_sched_t *s, int64_t now_us) {
+    if (s->count == 0) return;
+
+    // Refill the token bucket; at most one second of budget can accumulate
+    int64_t dt = s->last_refill_us ? now_us - s->last_refill_us : 1000000;
+    s->last_refill_us = now_us;
+    if (s->cfg.budget_bps > 0) {
+        s->tokens += (int64_t)s->cfg.budget_bps * dt / 1000000;
+        if (s->tokens > s->cfg.budget_bps) s->tokens = s->cfg.budget_bps;
+    }
+
+    uint8_t send[RTCM_SCHED_MAX_FRAMES];
+    int64_t total = 0;
+    for (size_t i = 0; i < s->count; i++) {
+        send[i] = (uint8_t)cadence_allows(s, s->entries[i].type);
+        if (send[i]) total += link_cost(s, s->entries[i].type, s->entries[i].type, s->entries[i].len);
+        else {
+            rtcm_sched_type_stats_t *t = type_stats(s, s->entries[i].type);
+            if (t) t->skipped++;
+        }
+    }
+
+    if (s->cfg.budget_bps > 0 && total > s->tokens) {
+        s->over_budget++;
+
+        // First lose resolution: MSM7 -> MSM4 in place (the result is always shorter)
+        for (size_t i = 0; i < s->count && total > s->tokens; i++) {
+            rtcm_sched_entry_t *e = &s->entries[i];
+            if (!send[i] || e->gnss < 0 || rtcm_msm_level(e->type) != 7) continue;
+            size_t n = rtcm_msm7_to_msm4(s->buf + e->offset, e->len, scratch, sizeof(scratch));
+            if (n == 0 || n >= e->len) continue;
+            rtcm_sched_type_stats_t *t = type_stats(s, e->type);
+            if (t) t->downgraded++;
+            memcpy(s->buf + e->offset, scratch, n);
+            total -= link_cost(s, e->type, e->type, e->len) - link_cost(s, e->type - 3, e->type, n);
+            e->len = (uint16_t)n;
+            e->type -= 3;
+        }
+
+        // Then whole constellations, lowest priority first; the top one is always kept
+        for (int p = RTCM_GNSS_COUNT - 1; p > 0 && total > s->tokens; p--) {
+            for (size_t i = 0; i < s->count; i++) {
+                rtcm_sched_entry_t *e = &s->entries[i];
+                if (!send[i] || e->gnss != s->cfg.priority[p]) continue;
+                send[i] = 0;
+                total -= link_cost(s, e->type, e->type, e->len);
+                rtcm_sched_type_stats_t *t = type_stats(s, e->type);
+                if (t) t->shed++;
+            }
+        }
+    }
+
+    // Observables first, by constellation priority, then everything else
+    int64_t sent = 0;
+    for (int pass = 0; pass <= RTCM_GNSS_COUNT; pass++) {
+        for (size_t i = 0; i < s->count; i++) {
+            rtcm_sched_entry_t *e = &s->entries[i];
+            if (!send[i]) continue;
+            int match = pass < RTCM_GNSS_COUNT ? e->gnss == s->cfg.priority[pass] : e->gnss < 0;
+            if (!match) continue;
+            s->out_link_len = 0;
+            s->output(s->buf + e->offset, e->len, s->ctx);
+            size_t link = s->out_link_len ? s->out_link_len : e->len;
+            sent += link;
+            rtcm_sched_type_stats_t *t = type_stats(s, e->type);
+            if (t) {
+                t->frames++;
+                t->last_epoch = s->epochs;
+                t->bytes += e->len;
+                t->link_bytes += link;
+                uint32_t permille = (uint32_t)(link * 1000 / e->len);
+                t->link_permille = t->link_permille ? (uint16_t)((t->link_permille * 7 + permille) / 8)
+                                                    : (uint16_t)permille;
+            }
+        }
+    }
+
+    if (s->cfg.budget_bps > 0) {
+        s->tokens -= sent;
+        if (s->tokens < -s->cfg.budget_bps) s->tokens = -s->cfg.budget_bps;
+    }
+    if (dt > 0) {
+        uint32_t inst = (uint32_t)(sent * 1000000 / dt);
+        s->ewma_bps = s->ewma_bps ? (s->ewma_bps * 7 + inst) / 8 : inst;
+    }
+
+    // Only observation epochs advance the cadence counter; a lone trailing
+    // station message released by the timeout does not
+    if (s->gnss_seen) s->epochs++;
+    s->fill = 0;
+    s->count = 0;
+    s->gnss_seen = 0;
+}
+
+void rtcm_sched_add_frame(rtcm_sched_t *s, const uint8_t *frame, size_t len, int64_t now_us) {
+    uint16_t type = rtcm3_msg_type(frame, len);
+    int gnss = rtcm_msm_gnss(type);
+    rtcm_msm_header_t h;
+    int msm = gnss >= 0 && rtcm_msm_parse_header(frame + RTCM3_HEADER_LEN, rtcm3_payload_len(frame), &h) == 0;
+    if (!msm) gnss = -1;
+
+    // A new epoch time on a constellation already held closes the epoch even
+    // without a final MSM (epoch fields differ between constellations)
+    if (msm && (s->gnss_seen & (1u << gnss)) && h.epoch != s->epoch_time[gnss]) release_epoch(s, now_us);
+    if (s->fill + len > sizeof(s->buf) || s->count == RTCM_SCHED_MAX_FRAMES) release_epoch(s, now_us);
+
+    if (s->count == 0) s->epoch_start_us = now_us;
+    rtcm_sched_entry_t *e = &s->entries[s->count++];
+    e->type = type;
+    e->len = (uint16_t)len;
+    e->offset = (uint16_t)s->fill;
+    e->gnss = (int8_t)gnss;
+    memcpy(s->buf + s->fill, frame, len);
+    s->fill += len;
+
+    if (msm) {
+        s->gnss_seen |= (uint8_t)(1u << gnss);
+        s->epoch_time[gnss] = h.epoch;
+        // Multiple message bit clear: last MSM of this epoch
+        if (!h.multiple) release_epoch(s, now_us);
+    }
+}
+
+void rtcm_sched_poll(rtcm_sched_t *s, int64_t now_us) {
+    if (s->count > 0 && now_us - s->epoch_start_us >= s->cfg.epoch_timeout_us) {
+        release_epoch(s, now_us);
+    }
+}
+
+int64_t rtcm_sched_next_us(const rtcm_sched_t *s) {
+    return s->count > 0 ? s->epoch_start_us + s->cfg.epoch_timeout_us : INT64_MAX;
+}
+
+const rtcm_sched_type_stats_t *rtcm_sched_get_stats(const rtcm_sched_t *s, size_t *count) {
+    *count = s->type_count;
+    return s->types;
+}
+
+void rtcm_sched_update_rates(rtcm_sched_t *s, int64_t now_us) {
+    int64_t dt = now_us - s->rate_window_us;
+    if (dt <= 0) return;
+    for (size_t i = 0; i < s->type_count; i++) {
+        s->types[i].rate_hz = (float)(s->types[i].frames - s->rate_frames[i]) * 1e6f / (float)dt;
+        s->rate_frames[i] = s->types[i].frames;
+    }
+    s->rate_window_us = now_us;
+}
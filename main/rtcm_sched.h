@@ -0,0 +1,95 @@
+#ifndef RTCM_SCHED_H
+#define RTCM_SCHED_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "rtcm3.h"
+#include "rtcm_msm.h"
+
+// Epoch scheduler between the RTCM3 framer and the link packetizer. Frames
+// are collected per epoch and released MSM-first in constellation priority
+// order. Station messages go out at a reduced cadence, and when an epoch
+// would exceed the link byte budget MSM7 is downgraded to MSM4 and the
+// lowest priority constellations are shed. The budget is charged with the
+// bytes each frame takes on the link, so frames coded after scheduling (see
+// rtcm_delta.h) are costed at their measured coded size.
+
+#define RTCM_SCHED_EPOCH_BUF   6144   // bytes of frames held per epoch
+#define RTCM_SCHED_MAX_FRAMES  48     // frames held per epoch
+#define RTCM_SCHED_MAX_TYPES   24     // distinct message types tracked
+
+#ifndef RTCM_SCHED_BUDGET_BPS
+#define RTCM_SCHED_BUDGET_BPS  12000  // default link budget, bytes/s
+#endif
+
+typedef struct {
+    int32_t budget_bps;           // link budget in bytes/s, 0 = unlimited
+    uint8_t arp_interval;         // send 1005/1006 once N epochs have passed since the last
+    uint8_t bias_interval;        // same for 1230
+    uint8_t priority[RTCM_GNSS_COUNT]; // rtcm_gnss_t, most important first
+    int64_t epoch_timeout_us;     // release an epoch if it never completes
+} rtcm_sched_config_t;
+
+typedef struct {
+    uint16_t type;
+    uint32_t frames;              // frames sent
+    uint32_t bytes;               // bytes sent
+    uint32_t skipped;             // frames held back by cadence
+    uint32_t shed;                // frames dropped for budget
+    uint32_t downgraded;          // MSM7 frames sent as MSM4
+    uint32_t link_bytes;          // bytes they took on the link
+    uint16_t link_permille;       // link bytes per 1000 frame bytes, 0 = not measured yet
+    float rate_hz;                // frames/s over the last report window
+    uint32_t last_epoch;          // epoch count when last sent, for the station message cadence
+} rtcm_sched_type_stats_t;
+
+typedef struct {
+    uint16_t type;
+    uint16_t len;
+    uint16_t offset;
+    int8_t gnss;                  // -1 for non-MSM
+} rtcm_sched_entry_t;
+
+typedef struct {
+    rtcm_sched_config_t cfg;
+    rtcm3_frame_cb_t output;
+    void *ctx;
+
+    uint8_t buf[RTCM_SCHED_EPOCH_BUF];
+    size_t fill;
+    rtcm_sched_entry_t entries[RTCM_SCHED_MAX_FRAMES];
+    size_t count;
+    uint32_t epoch_time[RTCM_GNSS_COUNT]; // MSM epoch field per constellation
+    uint8_t gnss_seen;            // constellations with an MSM in the held epoch
+    int64_t epoch_start_us;       // arrival of the first held frame, still valid inside output()
+    size_t out_link_len;          // set through rtcm_sched_set_link_len() inside output()
+
+    int64_t tokens;               // byte budget available (token bucket)
+    int64_t last_refill_us;
+    uint32_t epochs;              // observation epochs released
+    uint32_t over_budget;         // epochs that needed downgrade or shedding
+    uint32_t ewma_bps;            // measured output rate
+
+    rtcm_sched_type_stats_t types[RTCM_SCHED_MAX_TYPES];
+    size_t type_count;
+    int64_t rate_window_us;
+    uint32_t rate_frames[RTCM_SCHED_MAX_TYPES];
+} rtcm_sched_t;
+
+void rtcm_sched_default_config(rtcm_sched_config_t *cfg);
+void rtcm_sched_init(rtcm_sched_t *s, const rtcm_sched_config_t *cfg, rtcm3_frame_cb_t output, void *ctx);
+// Queue one complete frame from the framer
+void rtcm_sched_add_frame(rtcm_sched_t *s, const uint8_t *frame, size_t len, int64_t now_us);
+// Release an epoch that has been held past its timeout
+void rtcm_sched_poll(rtcm_sched_t *s, int64_t now_us);
+// When rtcm_sched_poll() next releases an epoch, INT64_MAX with none held
+int64_t rtcm_sched_next_us(const rtcm_sched_t *s);
+// Inside output(): the bytes the frame being released takes on the link
+void rtcm_sched_set_link_len(rtcm_sched_t *s, size_t len);
+// Update the link budget (bytes/s) at runtime
+void rtcm_sched_set_budget(rtcm_sched_t *s, int32_t budget_bps);
+// Per-type counters; rates are refreshed by rtcm_sched_update_rates()
+const rtcm_sched_type_stats_t *rtcm_sched_get_stats(const rtcm_sched_t *s, size_t *count);
+void rtcm_sched_update_rates(rtcm_sched_t *s, int64_t now_us);
+
+#endif // RTCM_SCHED_H
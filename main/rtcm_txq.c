@@ -0,0 +1,113 @@
+#include "rtcm_txq.h"
+#include <string.h>
+
+void rtcm_txq_init(rtcm_txq_t *q, link_output_fn_t write, rtcm_txq_space_fn_t space, int64_t deadline_us) {
+    memset(q, 0, sizeof(*q));
+    q->write = write;
+    q->space = space;
+    q->deadline_us = deadline_us > 0 ? deadline_us : RTCM_TXQ_DEADLINE_US;
+}
+
+static rtcm_txq_entry_t *oldest(rtcm_txq_t *q) {
+    return &q->entries[q->head];
+}
+
+static void drop_oldest(rtcm_txq_t *q) {
+    q->queued -= oldest(q)->len;
+    q->head = (uint16_t)((q->head + 1) % RTCM_TXQ_FRAMES);
+    if (--q->count == 0) q->tail = 0;
+}
+
+// Buffer offset for len contiguous bytes, or -1. Runs never wrap: the
+// end of the buffer is skipped when the next run does not fit there
+static int place(const rtcm_txq_t *q, size_t len) {
+    if (q->count == RTCM_TXQ_FRAMES) return -1;
+    if (q->count == 0) return len <= RTCM_TXQ_BYTES ? 0 : -1;
+    uint16_t start = q->entries[q->head].offset;
+    if (q->tail > start) {
+        if (len <= RTCM_TXQ_BYTES - (size_t)q->tail) return q->tail;
+        return len <= start ? 0 : -1;
+    }
+    return len <= (size_t)(start - q->tail) ? q->tail : -1;
+}
+
+static size_t space_now(const rtcm_txq_t *q) {
+    return q->space ? q->space() : SIZE_MAX;
+}
+
+void rtcm_txq_poll(rtcm_txq_t *q, int64_t now_us) {
+    size_t space = space_now(q);
+    while (q->count) {
+        rtcm_txq_entry_t *e = oldest(q);
+        if (now_us > e->deadline_us) {
+            q->stats.stale++;
+            drop_oldest(q);
+            continue;
+        }
+        if (e->len > space) break;
+        // Runs stored back to back in the buffer leave in one write
+        uint16_t offset = e->offset;
+        size_t run = 0;
+        uint16_t n = 0;
+        while (n < q->count) {
+            const rtcm_txq_entry_t *f = &q->entries[(q->head + n) % RTCM_TXQ_FRAMES];
+            if (f->offset != offset + run || run + f->len > space || now_us > f->deadline_us) break;
+            uint32_t waited = (uint32_t)(now_us - f->queued_us);
+            if (waited > q->stats.wait_max_us) q->stats.wait_max_us = waited;
+            run += f->len;
+            n++;
+        }
+        q->write(q->buf + offset, run);
+        q->stats.writes++;
+        q->stats.runs += n;
+        q->stats.bytes += run;
+        space -= run;
+        while (n--) drop_oldest(q);
+    }
+}
+
+void rtcm_txq_push(rtcm_txq_t *q, const uint8_t *frames, size_t len, uint32_t age_us, int64_t now_us) {
+    if (age_us >= q->deadline_us) {
+        q->stats.stale++;
+        return;
+    }
+    if (q->count == 0 && len <= space_now(q)) {
+        q->write(frames, len);
+        q->stats.writes++;
+        q->stats.runs++;
+        q->stats.bytes += len;
+        return;
+    }
+    int offset;
+    while ((offset = place(q, len)) < 0 && q->count) {
+        // Newer corrections are worth more than the oldest ones
+        q->stats.overflow++;
+        drop_oldest(q);
+    }
+    if (offset < 0) {
+        q->stats.overflow++;
+        return;
+    }
+    memcpy(q->buf + offset, frames, len);
+    rtcm_txq_entry_t *e = &q->entries[(q->head + q->count) % RTCM_TXQ_FRAMES];
+    e->offset = (uint16_t)offset;
+    e->len = (uint16_t)len;
+    e->queued_us = now_us;
+    e->deadline_us = now_us + q->deadline_us - age_us;
+    q->count++;
+    q->tail = (uint16_t)(offset + len);
+    q->queued += (uint16_t)len;
+    q->stats.deferred++;
+    if (q->queued > q->stats.queued_high_water) q->stats.queued_high_water = q->queued;
+    rtcm_txq_poll(q, now_us);
+}
+
+int64_t rtcm_txq_next_us(const rtcm_txq_t *q, size_t *need) {
+    if (q->count == 0) {
+        *need = 0;
+        return INT64_MAX;
+    }
+    const rtcm_txq_entry_t *e = &q->entries[q->head];
+    *need = e->len;
+    return e->deadline_us;
+}
@@ -0,0 +1,70 @@
+#ifndef RTCM_TXQ_H
+#define RTCM_TXQ_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "link_packet.h"
+
+// Rover correction output to the receiver UART: runs of whole RTCM3 frames,
+// in the order the link delivered them, wait here until the UART driver can take
+// them without blocking, so the UART paces the queue and the forwarding task
+// never stalls in a write. Every frame carries a deadline from its age at arrival;
+// a run that is still queued when the deadline passes is dropped instead of
+// written, as is the oldest run when the queue is full. Runs go to the UART
+// whole, several at once when they fit. No ESP-IDF calls, see
+// base_pipeline.h.
+
+#define RTCM_TXQ_BYTES  4096      // a full correction epoch, as the UART TX ring
+#define RTCM_TXQ_FRAMES 64
+#ifndef RTCM_TXQ_DEADLINE_US
+#define RTCM_TXQ_DEADLINE_US 1000000  // older corrections are superseded by the next epoch
+#endif
+
+// Bytes the UART takes now without blocking
+typedef size_t (*rtcm_txq_space_fn_t)(void);
+
+typedef struct {
+    uint16_t offset;
+    uint16_t len;
+    int64_t queued_us;
+    int64_t deadline_us;
+} rtcm_txq_entry_t;
+
+typedef struct {
+    uint32_t runs;            // written to the UART
+    uint32_t bytes;
+    uint32_t writes;          // UART writes (queued runs are batched)
+    uint32_t deferred;        // runs that had to wait for UART space
+    uint32_t stale;           // dropped past their deadline
+    uint32_t overflow;        // dropped from a full queue
+    uint32_t wait_max_us;     // longest a written run waited
+    uint16_t queued_high_water;
+} rtcm_txq_stats_t;
+
+typedef struct {
+    uint8_t buf[RTCM_TXQ_BYTES];
+    rtcm_txq_entry_t entries[RTCM_TXQ_FRAMES];
+    uint16_t head;            // oldest entry
+    uint16_t count;
+    uint16_t tail;            // buf offset after the newest frame
+    uint16_t queued;          // bytes waiting
+    int64_t deadline_us;
+    link_output_fn_t write;
+    rtcm_txq_space_fn_t space;
+    rtcm_txq_stats_t stats;
+} rtcm_txq_t;
+
+// space NULL: the writer never blocks, frames go straight through.
+// deadline_us <= 0 selects RTCM_TXQ_DEADLINE_US
+void rtcm_txq_init(rtcm_txq_t *q, link_output_fn_t write, rtcm_txq_space_fn_t space, int64_t deadline_us);
+// Queue whole frames that were age_us old on arrival; written at once when
+// nothing is waiting ahead of them and the UART has room
+void rtcm_txq_push(rtcm_txq_t *q, const uint8_t *frames, size_t len, uint32_t age_us, int64_t now_us);
+// Write what the UART has room for, drop what is past its deadline
+void rtcm_txq_poll(rtcm_txq_t *q, int64_t now_us);
+// When rtcm_txq_poll() next has work besides waiting for UART room: the
+// oldest run's deadline, INT64_MAX when empty. need gets the room that run
+// waits for (0 when empty)
+int64_t rtcm_txq_next_us(const rtcm_txq_t *q, size_t *need);
+
+#endif // RTCM_TXQ_H
@@ -0,0 +1,51 @@
+#include "task_stats.h"
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#if configUSE_TRACE_FACILITY && configGENERATE_RUN_TIME_STATS
+static TaskStatus_t tasks[TASK_STATS_MAX];
+static struct {
+    UBaseType_t number;
+    uint32_t runtime;
+} prev[TASK_STATS_MAX];
+static size_t prev_count;
+static uint32_t prev_total;
+
+static uint32_t prev_runtime(UBaseType_t number) {
+    for (size_t i = 0; i < prev_count; i++) {
+        if (prev[i].number == number) return prev[i].runtime;
+    }
+    return 0;
+}
+
+void task_stats_print(const char *role) {
+    uint32_t total = 0;
+    UBaseType_t n = uxTaskGetSystemState(tasks, TASK_STATS_MAX, &total);
+    uint32_t elapsed = total - prev_total;
+    double idle[2] = { 0 };
+    printf("[%s] task             prio   cpu%%  stack free B\n", role);
+    for (UBaseType_t i = 0; i < n; i++) {
+        const TaskStatus_t *t = &tasks[i];
+        uint32_t run = (uint32_t)t->ulRunTimeCounter - prev_runtime(t->xTaskNumber);
+        // The per-core idle tasks are IDLE0 and IDLE1
+        if (strncmp(t->pcTaskName, "IDLE", 4) == 0 && (t->pcTaskName[4] == '0' || t->pcTaskName[4] == '1'))
+            idle[t->pcTaskName[4] - '0'] = elapsed ? run * 100.0 / elapsed : 0.0;
+        printf("[%s]   %-16s %4u %6.1f %8u\n", role, t->pcTaskName, (unsigned)t->uxCurrentPriority,
+               elapsed ? run * 100.0 / elapsed : 0.0, (unsigned)t->usStackHighWaterMark);
+    }
+    printf("[%s] CPU idle: core 0 %.1f%%  core 1 %.1f%%\n", role, idle[0], idle[1]);
+    prev_count = n;
+    for (UBaseType_t i = 0; i < n; i++) {
+        prev[i].number = tasks[i].xTaskNumber;
+        prev[i].runtime = (uint32_t)tasks[i].ulRunTimeCounter;
+    }
+    prev_total = total;
+    if (n == 0) printf("[%s]   more than %d tasks\n", role, TASK_STATS_MAX);
+}
+#else
+void task_stats_print(const char *role) {
+    printf("[%s] task stats need CONFIG_FREERTOS_USE_TRACE_FACILITY and CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS\n", role);
+}
+#endif
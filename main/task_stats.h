@@ -0,0 +1,14 @@
+#ifndef TASK_STATS_H
+#define TASK_STATS_H
+
+// FreeRTOS task CPU use and stack high-water marks, needs
+// CONFIG_FREERTOS_USE_TRACE_FACILITY and CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+// (sdkconfig.defaults)
+
+#define TASK_STATS_MAX 24
+
+// One line per task, then the idle share of each core; CPU % is of one core
+// since the previous call (since boot the first time)
+void task_stats_print(const char *role);
+
+#endif // TASK_STATS_H
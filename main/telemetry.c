@@ -0,0 +1,129 @@
+#include "telemetry.h"
+#include <string.h>
+
+_Static_assert(sizeof(telemetry_hdr_t) == 8, "telemetry header layout");
+_Static_assert(sizeof(telemetry_record_t) == 32, "telemetry record layout");
+
+#define WEEK_S       604800
+#define GPS_EPOCH_S  315964800   // 1980-01-06 in Unix time
+#define LEAP_S       18          // GPS - UTC; an error only shifts the week guess, which iTOW corrects
+
+static uint16_t sat_u16(uint64_t v) {
+    return v > 0xFFFE ? 0xFFFE : (uint16_t)v;
+}
+
+// Days since 1970-01-01 for a proleptic Gregorian date
+static int64_t days_from_civil(int y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    unsigned yoe = (unsigned)(y - era * 400);
+    unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (int64_t)doe - 719468;
+}
+
+// NAV-PVT carries the UTC date but not the GPS week: derive it, then let
+// iTOW settle which side of a week boundary the epoch is on
+static uint16_t gps_week(const ubx_nav_pvt_t *pvt) {
+    if ((pvt->valid & 0x03) != 0x03) return TELEMETRY_WEEK_UNKNOWN;
+    int64_t unix_s = days_from_civil(pvt->year, pvt->month, pvt->day) * 86400 + pvt->hour * 3600 + pvt->min * 60 + pvt->sec;
+    int64_t gps_s = unix_s - GPS_EPOCH_S + LEAP_S;
+    if (gps_s < 0) return TELEMETRY_WEEK_UNKNOWN;
+    int64_t week = gps_s / WEEK_S;
+    int64_t tow = gps_s % WEEK_S, itow = pvt->iTOW / 1000;
+    if (tow - itow > WEEK_S / 2) week++;
+    else if (itow - tow > WEEK_S / 2) week--;
+    return week >= 0 && week < TELEMETRY_WEEK_UNKNOWN ? (uint16_t)week : TELEMETRY_WEEK_UNKNOWN;
+}
+
+void telemetry_init(telemetry_t *t, uint32_t interval_ms, uint16_t max_batch, telemetry_send_fn_t send, void *ctx) {
+    memset(t, 0, sizeof(*t));
+    t->interval_us = (int64_t)(interval_ms ? interval_ms : TELEMETRY_INTERVAL_MS) * 1000;
+    t->max_batch = max_batch && max_batch < TELEMETRY_MAX_BATCH ? max_batch : TELEMETRY_MAX_BATCH;
+    t->send = send;
+    t->send_ctx = ctx;
+}
+
+void telemetry_record_from_nav(telemetry_record_t *r, const ubx_nav_pvt_t *pvt, const ubx_nav_hpposllh_t *hp,
+                               int64_t corr_age_us) {
+    memset(r, 0, sizeof(*r));
+    r->tow_ms = pvt->iTOW;
+    r->week = gps_week(pvt);
+    r->fix = (uint8_t)((pvt->fixType & 0x07) | ((pvt->flags >> 6) & 0x03) << 3 | (pvt->flags & 0x01) << 5);
+    r->sats = pvt->numSV;
+    r->pdop = pvt->pDOP;
+    r->corr_age = corr_age_us < 0 ? TELEMETRY_AGE_NONE : sat_u16((uint64_t)corr_age_us / 10000);
+    if (hp && hp->iTOW == pvt->iTOW && !(hp->flags & 0x01)) {
+        r->lat = hp->lat;
+        r->lon = hp->lon;
+        r->height = hp->height;
+        r->lat_hp = hp->latHp;
+        r->lon_hp = hp->lonHp;
+        r->height_hp = hp->heightHp;
+        r->h_acc = sat_u16(hp->hAcc / 10);
+        r->v_acc = sat_u16(hp->vAcc / 10);
+    } else {
+        r->lat = pvt->lat;
+        r->lon = pvt->lon;
+        r->height = pvt->height;
+        r->h_acc = sat_u16(pvt->hAcc);
+        r->v_acc = sat_u16(pvt->vAcc);
+    }
+}
+
+void telemetry_add(telemetry_t *t, const telemetry_record_t *r, int64_t now_us) {
+    t->stats.records++;
+    if (t->count == TELEMETRY_OUTBOX) {
+        // Backpressure: the newest track matters more than a stale backlog
+        t->head = (t->head + 1) % TELEMETRY_OUTBOX;
+        t->count--;
+        t->stats.dropped++;
+        if (t->dropped_since < 0xFFFF) t->dropped_since++;
+    }
+    if (t->count == 0) t->first_us = now_us;
+    t->outbox[(t->head + t->count) % TELEMETRY_OUTBOX] = *r;
+    t->count++;
+    if (t->count > t->stats.outbox_high_water) t->stats.outbox_high_water = t->count;
+}
+
+// Returns 0 once the transport has taken one batch from the head of the outbox
+static int send_batch(telemetry_t *t) {
+    uint16_t n = t->count < t->max_batch ? t->count : t->max_batch;
+    telemetry_hdr_t hdr = {
+        .magic = TELEMETRY_MAGIC,
+        .version = TELEMETRY_VERSION,
+        .record_len = sizeof(telemetry_record_t),
+        .count = (uint8_t)n,
+        .seq = t->seq,
+        .dropped = t->dropped_since,
+    };
+    memcpy(t->msg, &hdr, sizeof(hdr));
+    uint8_t *p = t->msg + sizeof(hdr);
+    for (uint16_t i = 0; i < n; i++, p += sizeof(telemetry_record_t)) {
+        memcpy(p, &t->outbox[(t->head + i) % TELEMETRY_OUTBOX], sizeof(telemetry_record_t));
+    }
+    size_t len = (size_t)(p - t->msg);
+    if (!t->send || t->send(t->msg, len, t->send_ctx) != 0) {
+        t->stats.busy++;
+        return -1;
+    }
+    t->head = (t->head + n) % TELEMETRY_OUTBOX;
+    t->count -= n;
+    t->seq++;
+    t->dropped_since = 0;
+    t->stats.messages++;
+    t->stats.sent += n;
+    t->stats.bytes += len;
+    if (n > t->stats.max_batch) t->stats.max_batch = n;
+    return 0;
+}
+
+void telemetry_poll(telemetry_t *t, int64_t now_us) {
+    for (int i = 0; i < TELEMETRY_BURST && t->count; i++) {
+        int overdue = now_us - t->first_us >= t->interval_us;
+        if (t->count < t->max_batch && !overdue) return;
+        if (send_batch(t) != 0) return;
+        // What follows a full batch starts its own interval; an overdue backlog keeps draining
+        if (!overdue) t->first_us = now_us;
+    }
+}
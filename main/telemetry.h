@@ -0,0 +1,95 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "ubx.h"
+
+// Rover position telemetry: every navigation solution becomes a fixed
+// 32-byte record; records are batched into one message per interval (or
+// per TELEMETRY_MAX_BATCH records) for the broker. Records wait in a bounded
+// outbox while the transport pushes back; when it is full the oldest go.
+// Message layout, little-endian:
+//   telemetry_hdr_t | count * telemetry_record_t
+// No ESP-IDF calls, see base_pipeline.h.
+
+#define TELEMETRY_MAGIC        'T'
+#define TELEMETRY_VERSION      1
+#define TELEMETRY_MAX_BATCH    64        // records per message
+#ifndef TELEMETRY_OUTBOX
+#define TELEMETRY_OUTBOX       128       // records held while the transport is busy
+#endif
+#ifndef TELEMETRY_INTERVAL_MS
+#define TELEMETRY_INTERVAL_MS  1000      // oldest record waits at most this long
+#endif
+#define TELEMETRY_BURST        4         // messages per poll when catching up
+#define TELEMETRY_WEEK_UNKNOWN 0xFFFF
+#define TELEMETRY_AGE_NONE     0xFFFF
+
+typedef struct __attribute__((packed)) {
+    uint8_t magic;
+    uint8_t version;
+    uint8_t record_len;
+    uint8_t count;
+    uint16_t seq;             // message sequence: gaps are lost messages
+    uint16_t dropped;         // records dropped from the outbox since the previous message
+} telemetry_hdr_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t tow_ms;          // GPS time of week
+    uint16_t week;            // GPS week, TELEMETRY_WEEK_UNKNOWN before the receiver knows the date
+    uint8_t fix;              // bits 0-2 fixType, 3-4 carrier solution (1 float, 2 fixed), 5 gnssFixOK
+    uint8_t sats;
+    int32_t lat;              // 1e-7 deg
+    int32_t lon;              // 1e-7 deg
+    int32_t height;           // mm above the ellipsoid
+    int8_t lat_hp;            // 1e-9 deg, 0 without NAV-HPPOSLLH
+    int8_t lon_hp;
+    int8_t height_hp;         // 0.1 mm
+    uint8_t reserved;
+    uint16_t h_acc;           // mm, saturated
+    uint16_t v_acc;
+    uint16_t corr_age;        // 10 ms since corrections last reached the receiver, TELEMETRY_AGE_NONE if never
+    uint16_t pdop;            // 0.01
+} telemetry_record_t;
+
+// Hand one message to the transport; nonzero = busy, keep it for later
+typedef int (*telemetry_send_fn_t)(const uint8_t *msg, size_t len, void *ctx);
+
+typedef struct {
+    uint32_t records;         // solutions added
+    uint32_t messages;        // messages the transport took
+    uint32_t sent;            // records in them
+    uint32_t dropped;         // records pushed out of a full outbox
+    uint32_t busy;            // sends refused by the transport
+    uint32_t bytes;
+    uint16_t max_batch;
+    uint16_t outbox_high_water;
+} telemetry_stats_t;
+
+typedef struct {
+    telemetry_record_t outbox[TELEMETRY_OUTBOX];
+    uint16_t head;            // oldest record
+    uint16_t count;
+    uint16_t seq;
+    uint16_t dropped_since;   // goes in the next header
+    uint16_t max_batch;
+    int64_t interval_us;
+    int64_t first_us;         // when the oldest waiting record arrived
+    telemetry_send_fn_t send;
+    void *send_ctx;
+    uint8_t msg[sizeof(telemetry_hdr_t) + TELEMETRY_MAX_BATCH * sizeof(telemetry_record_t)];
+    telemetry_stats_t stats;
+} telemetry_t;
+
+// interval_ms 0 and max_batch 0 select the defaults
+void telemetry_init(telemetry_t *t, uint32_t interval_ms, uint16_t max_batch, telemetry_send_fn_t send, void *ctx);
+// Fill a record from a NAV-PVT and, if it is for the same epoch, NAV-HPPOSLLH (hp may be NULL);
+// corr_age_us < 0 means no corrections yet
+void telemetry_record_from_nav(telemetry_record_t *r, const ubx_nav_pvt_t *pvt, const ubx_nav_hpposllh_t *hp,
+                               int64_t corr_age_us);
+void telemetry_add(telemetry_t *t, const telemetry_record_t *r, int64_t now_us);
+// Send whatever is due: a full batch, or records older than the interval
+void telemetry_poll(telemetry_t *t, int64_t now_us);
+
+#endif // TELEMETRY_H
@@ -1,5 +1,48 @@
 #include "uart_gnss.h"
 #include "driver/uart.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+// The output set has to fit the line with room for bursts
+#if UART_GNSS_RX_BPS * 10 > UART_GNSS_BAUD_RATE / 10 * 8
+#error "GNSS output set needs more than 80% of the UART line rate: raise GNSS_HIGH_RATE_BAUD"
+#endif
+
+#define UART_GNSS_FIFO_LEN 128
+
+static QueueHandle_t events;
+static uint32_t baud = UART_GNSS_BAUD_RATE;
+static uart_gnss_stats_t stats;
+
+// Bytes on the line in us microseconds at the current rate, rounded up
+static uint32_t bytes_in_us(uint32_t us) {
+    return (uint32_t)(((uint64_t)baud * us + 10 * 1000000 - 1) / (10 * 1000000));
+}
+
+// FIFO threshold and idle timeout scale with the rate: at 921600 the FIFO
+// fills in 1.4 ms, so the interrupt has to come well before it is full
+static void apply_rate(void) {
+    uint32_t headroom = bytes_in_us(UART_GNSS_ISR_LATENCY_US);
+    int threshold = headroom + 16 < UART_GNSS_FIFO_LEN ? UART_GNSS_FIFO_LEN - (int)headroom : 16;
+    uart_set_rx_full_threshold(UART_GNSS_PORT_NUM, threshold > 120 ? 120 : threshold);
+    uint32_t idle = bytes_in_us(UART_GNSS_RX_IDLE_US);
+    uart_set_rx_timeout(UART_GNSS_PORT_NUM, (uint8_t)(idle < 2 ? 2 : idle > 100 ? 100 : idle));
+}
+
+static void count_events(void) {
+    uart_event_t ev;
+    while (xQueueReceive(events, &ev, 0) == pdTRUE) {
+        switch (ev.type) {
+        case UART_FIFO_OVF: stats.fifo_overflow++; break;
+        case UART_BUFFER_FULL: stats.buffer_full++; break;
+        case UART_FRAME_ERR: stats.frame_errors++; break;
+        case UART_PARITY_ERR: stats.parity_errors++; break;
+        case UART_BREAK: stats.breaks++; break;
+        default: break;
+        }
+    }
+}
 
 void uart_gnss_init(void) {
     const uart_config_t uart_config = {
@@ -11,10 +54,96 @@ void uart_gnss_init(void) {
     };
     uart_param_config(UART_GNSS_PORT_NUM, &uart_config);
     uart_set_pin(UART_GNSS_PORT_NUM, UART_GNSS_TXD, UART_GNSS_RXD, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
-    uart_driver_install(UART_GNSS_PORT_NUM, UART_GNSS_BUF_SIZE * 2, 0, 0, NULL, 0);
+    uart_driver_install(UART_GNSS_PORT_NUM, UART_GNSS_RX_BUF_SIZE, UART_GNSS_TX_BUF_SIZE,
+                        UART_GNSS_EVENT_QUEUE, &events, 0);
+    apply_rate();
 }
 
 int uart_gnss_read(uint8_t *data, size_t max_len) {
-    int len = uart_read_bytes(UART_GNSS_PORT_NUM, data, max_len, 10 / portTICK_PERIOD_MS);
-    return len;
+    // The driver queues an event per chunk; drain them so overruns are not lost behind a full queue
+    count_events();
+    size_t waiting = 0;
+    uart_get_buffered_data_len(UART_GNSS_PORT_NUM, &waiting);
+    if (waiting > stats.rx_high_water) stats.rx_high_water = waiting;
+    if (waiting == 0) {
+        return uart_read_bytes(UART_GNSS_PORT_NUM, data, max_len, UART_GNSS_READ_WAIT_MS / portTICK_PERIOD_MS);
+    }
+    return uart_read_bytes(UART_GNSS_PORT_NUM, data, waiting < max_len ? waiting : max_len, 0);
+}
+
+int uart_gnss_read_wait(uint8_t *data, size_t max_len, uint32_t wait_ms) {
+    TickType_t start = xTaskGetTickCount(), ticks = pdMS_TO_TICKS(wait_ms);
+    size_t waiting = 0;
+    for (;;) {
+        count_events();
+        uart_get_buffered_data_len(UART_GNSS_PORT_NUM, &waiting);
+        if (waiting) break;
+        // Peek: the event is counted, with any error events, on the next pass
+        uart_event_t ev;
+        TickType_t spent = xTaskGetTickCount() - start;
+        if (spent >= ticks || xQueuePeek(events, &ev, ticks - spent) != pdTRUE) return 0;
+    }
+    if (waiting > stats.rx_high_water) stats.rx_high_water = waiting;
+    return uart_read_bytes(UART_GNSS_PORT_NUM, data, waiting < max_len ? waiting : max_len, 0);
+}
+
+void uart_gnss_write(const uint8_t *data, size_t len) {
+    uart_write_bytes(UART_GNSS_PORT_NUM, (const char *)data, len);
+}
+
+void uart_gnss_set_baud(uint32_t rate) {
+    // Let queued bytes leave at the old rate: a full TX ring plus a FIFO
+    uint32_t drain_ms = (uint32_t)((uint64_t)(UART_GNSS_TX_BUF_SIZE + UART_GNSS_FIFO_LEN) * 10 * 1000 / baud) + 10;
+    uart_wait_tx_done(UART_GNSS_PORT_NUM, drain_ms / portTICK_PERIOD_MS + 1);
+    uart_set_baudrate(UART_GNSS_PORT_NUM, rate);
+    baud = rate;
+    apply_rate();
+    uart_flush_input(UART_GNSS_PORT_NUM);
+}
+
+uint32_t uart_gnss_baud(void) {
+    return baud;
+}
+
+size_t uart_gnss_rx_waiting(void) {
+    size_t waiting = 0;
+    uart_get_buffered_data_len(UART_GNSS_PORT_NUM, &waiting);
+    return waiting;
+}
+
+size_t uart_gnss_tx_queued(void) {
+#if UART_GNSS_TX_BUF_SIZE == 0
+    return 0;
+#else
+    size_t free_bytes = 0;
+    if (uart_get_tx_buffer_free_size(UART_GNSS_PORT_NUM, &free_bytes) != ESP_OK) return 0;
+    return UART_GNSS_TX_BUF_SIZE > free_bytes ? UART_GNSS_TX_BUF_SIZE - free_bytes : 0;
+#endif
+}
+
+size_t uart_gnss_tx_free(void) {
+#if UART_GNSS_TX_BUF_SIZE == 0
+    return SIZE_MAX;
+#else
+    size_t free_bytes = 0;
+    if (uart_get_tx_buffer_free_size(UART_GNSS_PORT_NUM, &free_bytes) != ESP_OK) return 0;
+    // Each write also stores ring item headers
+    return free_bytes > UART_GNSS_TX_ITEM_SLACK ? free_bytes - UART_GNSS_TX_ITEM_SLACK : 0;
+#endif
+}
+
+uint32_t uart_gnss_tx_wait_us(size_t len) {
+    size_t free_bytes = uart_gnss_tx_free();
+    if (len <= free_bytes) return 0;
+    return (uint32_t)((uint64_t)(len - free_bytes) * 10 * 1000000 / baud) + 1;
+}
+
+uint32_t uart_gnss_tx_queue_us(size_t pending) {
+    // Bytes still in the driver TX ring go out at 10 bits each
+    return (uint32_t)((uint64_t)(uart_gnss_tx_queued() + pending) * 10 * 1000000 / baud);
+}
+
+// Counted by the reader, which owns the event queue
+void uart_gnss_get_stats(uart_gnss_stats_t *out) {
+    *out = stats;
 }
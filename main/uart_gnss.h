@@ -3,14 +3,88 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include "role_config.h"
 
+// ZED-F9P UART, both roles. The driver rings, FIFO threshold and timeouts
+// follow from the line rate and the output set the receiver is configured for
+#if DEVICE_ROLE == DEVICE_ROLE_ROVER
+#define UART_GNSS_PORT_NUM UART_NUM_2   // UART1 is used by USB connection
+#else
 #define UART_GNSS_PORT_NUM UART_NUM_1
+#endif
 #define UART_GNSS_TXD 17
 #define UART_GNSS_RXD 16
+#if GNSS_HIGH_RATE
+#define UART_GNSS_BAUD_RATE GNSS_HIGH_RATE_BAUD
+#define UART_GNSS_NAV_HZ    GNSS_NAV_RATE_HZ
+#else
 #define UART_GNSS_BAUD_RATE 115200
-#define UART_GNSS_BUF_SIZE 2048
+#define UART_GNSS_NAV_HZ    1
+#endif
+
+// Output set: one RTCM epoch (full MSM7 on four constellations plus 1005/1230)
+// and one navigation epoch (NMEA set with GSV, UBX NAV-PVT and NAV-HPPOSLLH)
+#define UART_GNSS_RTCM_EPOCH_BYTES 4096
+#define UART_GNSS_NAV_EPOCH_BYTES  1536
+#if DEVICE_ROLE == DEVICE_ROLE_ROVER
+#define UART_GNSS_BURST_BYTES UART_GNSS_NAV_EPOCH_BYTES
+#define UART_GNSS_RX_BPS      (UART_GNSS_NAV_EPOCH_BYTES * UART_GNSS_NAV_HZ)
+#define UART_GNSS_TX_BUF_SIZE UART_GNSS_RTCM_EPOCH_BYTES   // a correction epoch queued to the receiver
+#else
+#define UART_GNSS_BURST_BYTES (UART_GNSS_RTCM_EPOCH_BYTES + UART_GNSS_NAV_EPOCH_BYTES)
+#define UART_GNSS_RX_BPS      UART_GNSS_BURST_BYTES
+#define UART_GNSS_TX_BUF_SIZE 0                            // configuration only, writes block
+#endif
+
+// TX ring space a write loses to the driver's item headers
+#define UART_GNSS_TX_ITEM_SLACK 32
+
+// Longest the reader may leave the RX ring unread
+#define UART_GNSS_RX_HOLD_MS   100
+#define UART_GNSS_RX_BUF_SIZE  (UART_GNSS_BURST_BYTES + UART_GNSS_RX_BPS * UART_GNSS_RX_HOLD_MS / 1000)
+// Interrupt latency the hardware FIFO (128 bytes) must absorb before it overruns
+#define UART_GNSS_ISR_LATENCY_US 500
+// Line idle time that hands a partial FIFO to the driver
+#define UART_GNSS_RX_IDLE_US   100
+// Wait for data when the RX ring is empty (polling loop)
+#define UART_GNSS_READ_WAIT_MS 10
+#define UART_GNSS_EVENT_QUEUE  64
+
+// Line errors and overruns reported by the driver
+typedef struct {
+    uint32_t fifo_overflow;   // hardware FIFO overran: bytes lost
+    uint32_t buffer_full;     // RX ring full: the driver stopped reading the FIFO
+    uint32_t frame_errors;
+    uint32_t parity_errors;
+    uint32_t breaks;
+    size_t rx_high_water;     // most bytes seen waiting in the RX ring
+} uart_gnss_stats_t;
 
 void uart_gnss_init(void);
+// Read what is waiting without blocking; waits UART_GNSS_READ_WAIT_MS only
+// when nothing is. A return of max_len means more may be waiting
 int uart_gnss_read(uint8_t *data, size_t max_len);
+// Event-driven read: sleeps on the driver's event queue until bytes arrive
+// (the RX FIFO threshold or the line idle timeout interrupt hands them over)
+// or wait_ms passes, then reads what is waiting. The event queue has one
+// consumer: use either this or uart_gnss_read(), from one task
+int uart_gnss_read_wait(uint8_t *data, size_t max_len, uint32_t wait_ms);
+// Write to the ZED-F9P (queued on the rover, blocks on the base)
+void uart_gnss_write(const uint8_t *data, size_t len);
+// Change the UART rate, e.g. after reconfiguring the receiver
+void uart_gnss_set_baud(uint32_t baud);
+uint32_t uart_gnss_baud(void);
+// Time the bytes already queued for the ZED-F9P, and pending more written
+// behind them, need to leave the UART (us)
+uint32_t uart_gnss_tx_queue_us(size_t pending);
+// Bytes uart_gnss_write() takes now without blocking (unlimited on the base,
+// where writes always block)
+size_t uart_gnss_tx_free(void);
+// Time until uart_gnss_write() takes len bytes without blocking (us, 0 = now)
+uint32_t uart_gnss_tx_wait_us(size_t len);
+// Ring occupancy: received bytes not read yet, bytes not yet sent (0 on the base)
+size_t uart_gnss_rx_waiting(void);
+size_t uart_gnss_tx_queued(void);
+void uart_gnss_get_stats(uart_gnss_stats_t *stats);
 
 #endif // UART_GNSS_H
@@ -0,0 +1,161 @@
+#include "ubx.h"
+#include <string.h>
+
+_Static_assert(sizeof(ubx_nav_pvt_t) == 92, "NAV-PVT layout");
+_Static_assert(sizeof(ubx_nav_hpposllh_t) == 36, "NAV-HPPOSLLH layout");
+_Static_assert(sizeof(ubx_nav_relposned_t) == 64, "NAV-RELPOSNED layout");
+_Static_assert(sizeof(ubx_nav_svin_t) == 40, "NAV-SVIN layout");
+
+void ubx_checksum(const uint8_t *data, size_t len, uint8_t *ck_a, uint8_t *ck_b) {
+    uint8_t a = 0, b = 0;
+    for (size_t i = 0; i < len; i++) {
+        a += data[i];
+        b += a;
+    }
+    *ck_a = a;
+    *ck_b = b;
+}
+
+size_t ubx_build(uint8_t *out, size_t max_len, uint8_t cls, uint8_t id, const uint8_t *payload, size_t len) {
+    size_t total = UBX_HEADER_LEN + len + UBX_CHECKSUM_LEN;
+    if (total > max_len || len > 0xFFFF) return 0;
+    out[0] = UBX_SYNC1;
+    out[1] = UBX_SYNC2;
+    out[2] = cls;
+    out[3] = id;
+    out[4] = (uint8_t)(len & 0xFF);
+    out[5] = (uint8_t)(len >> 8);
+    if (len) memcpy(out + UBX_HEADER_LEN, payload, len);
+    ubx_checksum(out + 2, len + 4, &out[total - 2], &out[total - 1]);
+    return total;
+}
+
+int ubx_decode_nav_pvt(const uint8_t *payload, size_t len, ubx_nav_pvt_t *out) {
+    if (len != sizeof(*out)) return -1;
+    memcpy(out, payload, sizeof(*out));
+    return 0;
+}
+
+int ubx_decode_nav_hpposllh(const uint8_t *payload, size_t len, ubx_nav_hpposllh_t *out) {
+    if (len != sizeof(*out)) return -1;
+    memcpy(out, payload, sizeof(*out));
+    return 0;
+}
+
+int ubx_decode_nav_relposned(const uint8_t *payload, size_t len, ubx_nav_relposned_t *out) {
+    if (len != sizeof(*out)) return -1;
+    memcpy(out, payload, sizeof(*out));
+    return 0;
+}
+
+int ubx_decode_nav_svin(const uint8_t *payload, size_t len, ubx_nav_svin_t *out) {
+    if (len != sizeof(*out)) return -1;
+    memcpy(out, payload, sizeof(*out));
+    return 0;
+}
+
+void ubx_parser_init(ubx_parser_t *p, const ubx_handlers_t *handlers) {
+    memset(p, 0, sizeof(*p));
+    if (handlers) p->handlers = *handlers;
+}
+
+static void dispatch(ubx_parser_t *p, uint8_t cls, uint8_t id, const uint8_t *payload, size_t len) {
+    const ubx_handlers_t *h = &p->handlers;
+
+    if (cls == UBX_CLASS_NAV) {
+        if (id == UBX_NAV_PVT && h->on_pvt) {
+            ubx_nav_pvt_t pvt;
+            if (ubx_decode_nav_pvt(payload, len, &pvt) == 0) h->on_pvt(&pvt, h->ctx);
+            return;
+        }
+        if (id == UBX_NAV_HPPOSLLH && h->on_hpposllh) {
+            ubx_nav_hpposllh_t hp;
+            if (ubx_decode_nav_hpposllh(payload, len, &hp) == 0) h->on_hpposllh(&hp, h->ctx);
+            return;
+        }
+        if (id == UBX_NAV_RELPOSNED && h->on_relposned) {
+            ubx_nav_relposned_t rel;
+            if (ubx_decode_nav_relposned(payload, len, &rel) == 0) h->on_relposned(&rel, h->ctx);
+            return;
+        }
+        if (id == UBX_NAV_SVIN && h->on_svin) {
+            ubx_nav_svin_t svin;
+            if (ubx_decode_nav_svin(payload, len, &svin) == 0) h->on_svin(&svin, h->ctx);
+            return;
+        }
+    }
+    if (h->on_message) h->on_message(cls, id, payload, len, h->ctx);
+}
+
+// Discard buffered bytes up to the next sync char at or after index 'from'
+static void parser_drop(ubx_parser_t *p, size_t from) {
+    size_t k = p->pos;
+    if (from < p->pos) {
+        const uint8_t *s = memchr(p->buf + from, UBX_SYNC1, p->pos - from);
+        if (s) k = (size_t)(s - p->buf);
+    }
+    p->skipped += k;
+    memmove(p->buf, p->buf + k, p->pos - k);
+    p->pos -= k;
+}
+
+static size_t frame_len(const uint8_t *buf) {
+    return UBX_HEADER_LEN + (buf[4] | ((size_t)buf[5] << 8)) + UBX_CHECKSUM_LEN;
+}
+
+static void parser_process(ubx_parser_t *p) {
+    while (p->pos > 0) {
+        if (p->buf[0] != UBX_SYNC1) {
+            parser_drop(p, 0);
+            continue;
+        }
+        if (p->pos < 2) return;
+        if (p->buf[1] != UBX_SYNC2) {
+            parser_drop(p, 1);
+            continue;
+        }
+        if (p->pos < UBX_HEADER_LEN) return;
+        size_t total = frame_len(p->buf);
+        if (total > sizeof(p->buf)) {
+            p->oversize++;
+            parser_drop(p, 1);
+            continue;
+        }
+        if (p->pos < total) return;
+
+        uint8_t ck_a, ck_b;
+        ubx_checksum(p->buf + 2, total - 4, &ck_a, &ck_b);
+        if (ck_a != p->buf[total - 2] || ck_b != p->buf[total - 1]) {
+            p->checksum_errors++;
+            parser_drop(p, 1);
+            continue;
+        }
+        p->messages++;
+        dispatch(p, p->buf[2], p->buf[3], p->buf + UBX_HEADER_LEN, total - UBX_HEADER_LEN - UBX_CHECKSUM_LEN);
+        memmove(p->buf, p->buf + total, p->pos - total);
+        p->pos -= total;
+    }
+}
+
+void ubx_parser_feed(ubx_parser_t *p, const uint8_t *data, size_t len) {
+    while (len > 0) {
+        if (p->pos == 0) {
+            const uint8_t *s = memchr(data, UBX_SYNC1, len);
+            if (!s) {
+                p->skipped += len;
+                return;
+            }
+            p->skipped += (size_t)(s - data);
+            len -= (size_t)(s - data);
+            data = s;
+        }
+
+        size_t want = p->pos < UBX_HEADER_LEN ? UBX_HEADER_LEN - p->pos : frame_len(p->buf) - p->pos;
+        size_t n = want < len ? want : len;
+        memcpy(p->buf + p->pos, data, n);
+        p->pos += n;
+        data += n;
+        len -= n;
+        parser_process(p);
+    }
+}
@@ -0,0 +1,172 @@
+#ifndef UBX_H
+#define UBX_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// u-blox UBX binary protocol: B5 62 | class | id | len16 LE | payload | CK_A CK_B
+#define UBX_SYNC1          0xB5
+#define UBX_SYNC2          0x62
+#define UBX_HEADER_LEN     6
+#define UBX_CHECKSUM_LEN   2
+#define UBX_MAX_PAYLOAD    1024   // larger messages (e.g. full CFG dumps) are skipped
+#define UBX_MAX_FRAME      (UBX_HEADER_LEN + UBX_MAX_PAYLOAD + UBX_CHECKSUM_LEN)
+
+#define UBX_CLASS_NAV      0x01
+#define UBX_CLASS_ACK      0x05
+#define UBX_CLASS_CFG      0x06
+#define UBX_CLASS_MON      0x0A
+#define UBX_CLASS_SEC      0x27
+
+#define UBX_NAV_PVT        0x07
+#define UBX_NAV_HPPOSLLH   0x14
+#define UBX_NAV_SVIN       0x3B
+#define UBX_NAV_RELPOSNED  0x3C
+#define UBX_ACK_NAK        0x00
+#define UBX_ACK_ACK        0x01
+#define UBX_MON_VER        0x04
+#define UBX_CFG_VALSET     0x8A
+#define UBX_CFG_VALGET     0x8B
+#define UBX_SEC_UNIQID     0x03
+
+// NAV-PVT flags: carrier phase solution (bits 6..7)
+#define UBX_PVT_FLAGS_GNSS_FIX_OK  0x01
+#define UBX_PVT_FLAGS_DIFF_SOLN    0x02
+#define UBX_PVT_CARR_SOLN(flags)   (((flags) >> 6) & 0x03)   // 0=none 1=float 2=fixed
+
+// RELPOSNED flags
+#define UBX_RELPOS_FLAGS_GNSS_FIX_OK      0x0001
+#define UBX_RELPOS_FLAGS_DIFF_SOLN        0x0002
+#define UBX_RELPOS_FLAGS_REL_POS_VALID    0x0004
+#define UBX_RELPOS_CARR_SOLN(flags)       (((flags) >> 3) & 0x03)
+
+// Payload layouts (ZED-F9P, protocol 27.x). The ESP32 is little-endian, so
+// these map directly onto the wire format.
+
+typedef struct __attribute__((packed)) {
+    uint32_t iTOW;          // ms, GPS time of week
+    uint16_t year;
+    uint8_t  month, day, hour, min, sec;
+    uint8_t  valid;
+    uint32_t tAcc;          // ns
+    int32_t  nano;          // ns
+    uint8_t  fixType;       // 0=none 2=2D 3=3D 4=GNSS+DR 5=time only
+    uint8_t  flags;
+    uint8_t  flags2;
+    uint8_t  numSV;
+    int32_t  lon;           // 1e-7 deg
+    int32_t  lat;           // 1e-7 deg
+    int32_t  height;        // mm above ellipsoid
+    int32_t  hMSL;          // mm above MSL
+    uint32_t hAcc;          // mm
+    uint32_t vAcc;          // mm
+    int32_t  velN, velE, velD;   // mm/s
+    int32_t  gSpeed;        // mm/s
+    int32_t  headMot;       // 1e-5 deg
+    uint32_t sAcc;          // mm/s
+    uint32_t headAcc;       // 1e-5 deg
+    uint16_t pDOP;          // 0.01
+    uint16_t flags3;
+    uint8_t  reserved0[4];
+    int32_t  headVeh;       // 1e-5 deg
+    int16_t  magDec;
+    uint16_t magAcc;
+} ubx_nav_pvt_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t  version;
+    uint8_t  reserved0[2];
+    uint8_t  flags;         // bit0 invalidLlh
+    uint32_t iTOW;
+    int32_t  lon;           // 1e-7 deg
+    int32_t  lat;           // 1e-7 deg
+    int32_t  height;        // mm
+    int32_t  hMSL;          // mm
+    int8_t   lonHp;         // 1e-9 deg
+    int8_t   latHp;         // 1e-9 deg
+    int8_t   heightHp;      // 0.1 mm
+    int8_t   hMSLHp;        // 0.1 mm
+    uint32_t hAcc;          // 0.1 mm
+    uint32_t vAcc;          // 0.1 mm
+} ubx_nav_hpposllh_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t  version;
+    uint8_t  reserved0;
+    uint16_t refStationId;
+    uint32_t iTOW;
+    int32_t  relPosN;       // cm
+    int32_t  relPosE;
+    int32_t  relPosD;
+    int32_t  relPosLength;  // cm
+    int32_t  relPosHeading; // 1e-5 deg
+    uint8_t  reserved1[4];
+    int8_t   relPosHPN;     // 0.1 mm
+    int8_t   relPosHPE;
+    int8_t   relPosHPD;
+    int8_t   relPosHPLength;
+    uint32_t accN;          // 0.1 mm
+    uint32_t accE;
+    uint32_t accD;
+    uint32_t accLength;
+    uint32_t accHeading;    // 1e-5 deg
+    uint8_t  reserved2[4];
+    uint32_t flags;
+} ubx_nav_relposned_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t  version;
+    uint8_t  reserved0[3];
+    uint32_t iTOW;
+    uint32_t dur;           // s, survey-in so far
+    int32_t  meanX;         // cm, ECEF mean position
+    int32_t  meanY;
+    int32_t  meanZ;
+    int8_t   meanXHP;       // 0.1 mm
+    int8_t   meanYHP;
+    int8_t   meanZHP;
+    uint8_t  reserved1;
+    uint32_t meanAcc;       // 0.1 mm
+    uint32_t obs;           // position observations used
+    uint8_t  valid;         // survey-in position valid
+    uint8_t  active;        // survey-in in progress
+    uint8_t  reserved2[2];
+} ubx_nav_svin_t;
+
+typedef struct {
+    void (*on_pvt)(const ubx_nav_pvt_t *pvt, void *ctx);
+    void (*on_hpposllh)(const ubx_nav_hpposllh_t *hp, void *ctx);
+    void (*on_relposned)(const ubx_nav_relposned_t *rel, void *ctx);
+    void (*on_svin)(const ubx_nav_svin_t *svin, void *ctx);
+    // Every other valid message (ACK/NAK, CFG, MON...)
+    void (*on_message)(uint8_t cls, uint8_t id, const uint8_t *payload, size_t len, void *ctx);
+    void *ctx;
+} ubx_handlers_t;
+
+typedef struct {
+    uint8_t buf[UBX_MAX_FRAME];
+    size_t pos;
+    ubx_handlers_t handlers;
+    uint32_t messages;          // checksum-valid messages
+    uint32_t checksum_errors;
+    uint32_t oversize;          // messages longer than UBX_MAX_PAYLOAD
+    uint32_t skipped;           // bytes discarded while hunting for sync
+} ubx_parser_t;
+
+// Fletcher-8 over class..payload, as defined by u-blox
+void ubx_checksum(const uint8_t *data, size_t len, uint8_t *ck_a, uint8_t *ck_b);
+// Build a complete UBX frame into out. Returns frame length, 0 if out is too small
+size_t ubx_build(uint8_t *out, size_t max_len, uint8_t cls, uint8_t id, const uint8_t *payload, size_t len);
+
+// Reset parser state and counters; handlers may be NULL
+void ubx_parser_init(ubx_parser_t *p, const ubx_handlers_t *handlers);
+// Feed raw bytes; handlers fire for each valid message
+void ubx_parser_feed(ubx_parser_t *p, const uint8_t *data, size_t len);
+
+// Copy a payload into its typed struct. Return 0 on success, -1 on a length mismatch
+int ubx_decode_nav_pvt(const uint8_t *payload, size_t len, ubx_nav_pvt_t *out);
+int ubx_decode_nav_hpposllh(const uint8_t *payload, size_t len, ubx_nav_hpposllh_t *out);
+int ubx_decode_nav_relposned(const uint8_t *payload, size_t len, ubx_nav_relposned_t *out);
+int ubx_decode_nav_svin(const uint8_t *payload, size_t len, ubx_nav_svin_t *out);
+
+#endif // UBX_H
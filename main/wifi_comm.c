@@ -1,44 +1,34 @@
 #include "wifi_comm.h"
-#include "esp_wifi.h"
+#include "platform.h"
 #include "esp_log.h"
-#include "esp_event.h"
-#include "nvs_flash.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include <string.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 
-#define WIFI_SSID_MAXLEN 32
-#define WIFI_PASS_MAXLEN 64
 #define WIFI_PORT 5000
 
 static const char *TAG = "WIFI_COMM";
 static int sock = -1;
 static struct sockaddr_in peer_addr;
+static pkt_block_t *rx_slots[WIFI_COMM_RX_SLOTS];
+static pkt_ring_t rx_ring;
 
-void wifi_comm_init(const char *ssid, const char *password, int is_base) {
-    // Initialize NVS
-    esp_err_t ret = nvs_flash_init();
-    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
-        ESP_ERROR_CHECK(nvs_flash_erase());
-        ret = nvs_flash_init();
+static void rx_task(void *arg) {
+    uint8_t buf[PKT_BLOCK_SIZE];
+    for (;;) {
+        int len = recv(sock, buf, sizeof(buf), 0);
+        if (len > 0) pkt_ring_push(&rx_ring, buf, (size_t)len);
+        else vTaskDelay(100 / portTICK_PERIOD_MS);   // socket error: do not spin
     }
-    ESP_ERROR_CHECK(ret);
-
-    esp_netif_init();
-    esp_event_loop_create_default();
-    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
-    esp_wifi_init(&cfg);
-    esp_wifi_set_mode(WIFI_MODE_STA);
-    wifi_config_t wifi_config = {0};
-    strncpy((char *)wifi_config.sta.ssid, ssid, WIFI_SSID_MAXLEN);
-    strncpy((char *)wifi_config.sta.password, password, WIFI_PASS_MAXLEN);
-    esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
-    esp_wifi_start();
-    esp_wifi_connect();
+}
 
-    // Wait for connection (simple delay for demo)
-    vTaskDelay(3000 / portTICK_PERIOD_MS);
+void wifi_comm_init(const char *ssid, const char *password, int is_base) {
+    // Connects in the background: the socket works from the moment an
+    // address is assigned, and wifi_comm_ready() gates sending until then
+    platform_wifi_connect(ssid, password);
 
     // Socket setup
     sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
@@ -56,6 +46,25 @@ void wifi_comm_init(const char *ssid, const char *password, int is_base) {
     // Allow broadcast
     int broadcastEnable = 1;
     setsockopt(sock, SOL_SOCKET, SO_BROADCAST, &broadcastEnable, sizeof(broadcastEnable));
+
+    if (!is_base) {
+        // Rover listens for the base broadcasts
+        struct sockaddr_in local = {0};
+        local.sin_family = AF_INET;
+        local.sin_port = htons(WIFI_PORT);
+        local.sin_addr.s_addr = htonl(INADDR_ANY);
+        if (bind(sock, (struct sockaddr *)&local, sizeof(local)) < 0) {
+            ESP_LOGE(TAG, "Unable to bind UDP port %d", WIFI_PORT);
+            return;
+        }
+        pkt_ring_init(&rx_ring, rx_slots, WIFI_COMM_RX_SLOTS);
+        xTaskCreatePinnedToCore(rx_task, "udp_rx", WIFI_COMM_RX_STACK, NULL, WIFI_COMM_RX_PRIO, NULL,
+                                TASK_FORWARD_CORE);
+    }
+}
+
+int wifi_comm_ready(void) {
+    return sock >= 0 && platform_wifi_connected();
 }
 
 void wifi_comm_send(const uint8_t *data, size_t len) {
@@ -63,10 +72,10 @@ void wifi_comm_send(const uint8_t *data, size_t len) {
     sendto(sock, data, len, 0, (struct sockaddr *)&peer_addr, sizeof(peer_addr));
 }
 
-int wifi_comm_receive(uint8_t *data, size_t max_len) {
-    if (sock < 0) return 0;
-    struct sockaddr_in from;
-    socklen_t fromlen = sizeof(from);
-    int len = recvfrom(sock, data, max_len, MSG_DONTWAIT, (struct sockaddr *)&from, &fromlen);
-    return len > 0 ? len : 0;
+size_t wifi_comm_receive_batch(pkt_ring_cb_t cb, void *ctx) {
+    return rx_ring.slots ? pkt_ring_drain(&rx_ring, cb, ctx, WIFI_COMM_RX_SLOTS) : 0;
+}
+
+void wifi_comm_set_wake(pkt_ring_wake_fn_t wake, void *ctx) {
+    pkt_ring_set_wake(&rx_ring, wake, ctx);
 }
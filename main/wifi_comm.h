@@ -3,9 +3,23 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include "pkt_ring.h"
+#include "role_config.h"
+
+// Rover: datagrams are read by a task of their own, blocking, and queued for
+// the correction task like the ESP-NOW and MQTT callbacks queue theirs
+#define WIFI_COMM_RX_SLOTS 16
+#define WIFI_COMM_RX_STACK 3072
+#define WIFI_COMM_RX_PRIO  (TASK_FORWARD_PRIO + 1)
 
-void wifi_comm_init(const char *ssid, const char *password, int is_base);
 void wifi_comm_send(const uint8_t *data, size_t len);
-int wifi_comm_receive(uint8_t *data, size_t max_len);
+// Rover: hand every queued datagram to cb without copying (returns datagrams drained)
+size_t wifi_comm_receive_batch(pkt_ring_cb_t cb, void *ctx);
+// Rover: run wake(ctx) whenever a datagram is queued
+void wifi_comm_set_wake(pkt_ring_wake_fn_t wake, void *ctx);
+// Returns without waiting for the AP (platform_wifi_connect())
+void wifi_comm_init(const char *ssid, const char *password, int is_base);
+// 1 while associated to the AP with the socket open
+int wifi_comm_ready(void);
 
 #endif // WIFI_COMM_H